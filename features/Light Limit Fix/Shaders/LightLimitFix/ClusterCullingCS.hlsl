@@ -3,19 +3,30 @@
 cbuffer PerFrame : register(b0)
 {
 	uint LightCount;
+	float4 EyeOffset[2];  // eye position relative to the light origin
+	row_major float4x4 View[2];
 }
 
 //references
 //https://github.com/pezcode/Cluster
 
 StructuredBuffer<ClusterAABB> clusters : register(t0);
-StructuredBuffer<Light> lights : register(t1);
+StructuredBuffer<Light> lightSources : register(t1);  // positionWS[0] relative to the light origin, the same for every view
 
 RWStructuredBuffer<uint> lightIndexCounter : register(u0);
 RWStructuredBuffer<uint> lightIndexList : register(u1);
 RWStructuredBuffer<LightGrid> lightGrid : register(u2);
+RWStructuredBuffer<Light> lights : register(u3);  // lightSources resolved for this view, read by the pixel shaders
 
-groupshared Light sharedLights[GROUP_SIZE];
+#define LIGHT_BATCH_SIZE 512
+
+#if defined(VR)
+#	define EYE_COUNT 2
+#else
+#	define EYE_COUNT 1
+#endif
+
+groupshared float4 sharedLights[LIGHT_BATCH_SIZE][EYE_COUNT];  // view space position and squared radius
 
 bool LightIntersectsCluster(float3 position, float radius, ClusterAABB cluster)
 {
@@ -31,8 +42,8 @@ bool LightIntersectsCluster(float3 position, float radius, ClusterAABB cluster)
 	: SV_DispatchThreadID, uint3 groupThreadId
 	: SV_GroupThreadID, uint groupIndex
 	: SV_GroupIndex) {
-	if (any(dispatchThreadId >= uint3(CLUSTER_BUILDING_DISPATCH_SIZE_X, CLUSTER_BUILDING_DISPATCH_SIZE_Y, CLUSTER_BUILDING_DISPATCH_SIZE_Z)))
-		return;
+	// threads past the edge still take part in loading the lights, they only skip the cluster
+	bool validCluster = all(dispatchThreadId < uint3(CLUSTER_BUILDING_DISPATCH_SIZE_X, CLUSTER_BUILDING_DISPATCH_SIZE_Y, CLUSTER_BUILDING_DISPATCH_SIZE_Z));
 
 	uint visibleLightCount = 0;
 	uint visibleLightIndices[MAX_CLUSTER_LIGHTS];
@@ -41,36 +52,53 @@ bool LightIntersectsCluster(float3 position, float radius, ClusterAABB cluster)
 	                    dispatchThreadId.y * CLUSTER_BUILDING_DISPATCH_SIZE_X +
 	                    dispatchThreadId.z * (CLUSTER_BUILDING_DISPATCH_SIZE_X * CLUSTER_BUILDING_DISPATCH_SIZE_Y);
 
-	ClusterAABB cluster = clusters[clusterIndex];
+	ClusterAABB cluster = clusters[validCluster ? clusterIndex : 0];
 
-	if (groupIndex < LightCount) {
-		uint lightIndex = groupIndex;
-		Light light = lights[lightIndex];
-		sharedLights[groupIndex] = light;
-	}
+	for (uint batch = 0; batch < LightCount; batch += LIGHT_BATCH_SIZE) {
+		uint batchCount = min(LightCount - batch, LIGHT_BATCH_SIZE);
+
+		if (groupIndex < batchCount) {
+			Light light = lightSources[batch + groupIndex];
+			float3 position = light.positionWS[0].xyz;
+
+			[unroll] for (uint eyeIndex = 0; eyeIndex < 2; eyeIndex++)
+			{
+				light.positionWS[eyeIndex].xyz = position - EyeOffset[eyeIndex].xyz;
+				light.positionVS[eyeIndex].xyz = mul(float4(light.positionWS[eyeIndex].xyz, 1), View[eyeIndex]).xyz;
+			}
 
-	GroupMemoryBarrierWithGroupSync();
+			[unroll] for (uint eyeIndex = 0; eyeIndex < EYE_COUNT; eyeIndex++)
+				sharedLights[groupIndex][eyeIndex] = float4(light.positionVS[eyeIndex].xyz, light.radius * light.radius);
 
-	for (uint i = 0; i < LightCount; i++) {
-		Light light = lights[i];
+			// one group publishes the lights for the pixel shaders
+			if (all(groupId == 0))
+				lights[batch + groupIndex] = light;
+		}
 
-		float radius = light.radius * light.radius;
+		GroupMemoryBarrierWithGroupSync();
 
+		if (validCluster) {
+			for (uint i = 0; i < batchCount && visibleLightCount < MAX_CLUSTER_LIGHTS; i++) {
+				float4 light = sharedLights[i][0];
 #if defined(VR)
-		[branch] if (LightIntersectsCluster(light.positionVS[0], radius, cluster) || LightIntersectsCluster(light.positionVS[1], radius, cluster))
-		{
+				float4 lightRight = sharedLights[i][1];
+				[branch] if (LightIntersectsCluster(light.xyz, light.w, cluster) || LightIntersectsCluster(lightRight.xyz, lightRight.w, cluster))
+				{
 #else
-		[branch] if (LightIntersectsCluster(light.positionVS[0], radius, cluster))
-		{
+				[branch] if (LightIntersectsCluster(light.xyz, light.w, cluster))
+				{
 #endif
-			visibleLightIndices[visibleLightCount] = i;
-			visibleLightCount++;
-			if (visibleLightCount >= MAX_CLUSTER_LIGHTS)
-				break;
+					visibleLightIndices[visibleLightCount] = batch + i;
+					visibleLightCount++;
+				}
+			}
 		}
+
+		GroupMemoryBarrierWithGroupSync();
 	}
 
-	GroupMemoryBarrierWithGroupSync();
+	if (!validCluster)
+		return;
 
 	uint offset = 0;
 	InterlockedAdd(lightIndexCounter[0], visibleLightCount, offset);
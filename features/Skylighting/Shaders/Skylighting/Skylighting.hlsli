@@ -13,9 +13,22 @@ namespace Skylighting
 	Texture2DArray<float3> stbn_vec3_2Dx1D_128x128x64 : register(t51);
 #endif
 
-	const static uint3 ARRAY_DIM = uint3(256, 256, 128);
-	const static float3 ARRAY_SIZE = 4096.f * 2.5f * float3(1, 1, 0.5);
-	const static float3 CELL_SIZE = ARRAY_SIZE / ARRAY_DIM;
+	// probes form a clipmap: every level has LEVEL_DIM cells, twice the cell size of the level before, and is stacked along z in the probe array
+	const static uint NUM_LEVELS = SKYLIGHTING_NUM_LEVELS;
+	const static uint3 LEVEL_DIM = uint3(128, 128, 64);
+	const static float3 ARRAY_SIZE = 4096.f * 2.5f * float3(1, 1, 0.5);  // extent of the coarsest level
+	const static float3 CELL_SIZE = ARRAY_SIZE / (LEVEL_DIM << (NUM_LEVELS - 1));  // cell size of the finest level
+	const static float LEVEL_BLEND = 0.1;  // fraction of a level's extent over which it fades into the next coarser one
+
+	float3 getCellSize(uint level)
+	{
+		return CELL_SIZE * (1u << level);
+	}
+
+	float3 getLevelSize(uint level)
+	{
+		return getCellSize(level) * LEVEL_DIM;
+	}
 
 	float getFadeOutFactor(float3 positionMS)
 	{
@@ -35,28 +48,12 @@ namespace Skylighting
 		return lerp(params.MinSpecularVisibility, 1.0, saturate(visibility));
 	}
 
-	sh2 sample(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, Texture2DArray<float3> blueNoise, float2 screenPosition, float3 positionMS, float3 normalWS)
+	sh2 sampleLevel(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, uint level, float3 positionMS, float3 normalWS, bool useTangentWeight)
 	{
-		const static sh2 unitSH = float4(sqrt(4 * Math::PI), 0, 0, 0);
-		sh2 scaledUnitSH = unitSH / 1e-10;
-
-		if (SharedData::InInterior)
-			return scaledUnitSH;
-
-		positionMS.xyz += normalWS * CELL_SIZE * 0.5;  // Receiver normal bias
-
-		if (SharedData::FrameCount) {  // Check TAA
-			float3 offset = blueNoise[int3(screenPosition.xy % 128, SharedData::FrameCount % 64)] * 2.0 - 1.0;
-			positionMS.xyz += offset * CELL_SIZE * 0.5;
-		}
+		float3 positionMSAdjusted = positionMS - params.PosOffset[level].xyz;
+		float3 uvw = positionMSAdjusted / getLevelSize(level) + .5;
 
-		float3 positionMSAdjusted = positionMS - params.PosOffset.xyz;
-		float3 uvw = positionMSAdjusted / ARRAY_SIZE + .5;
-
-		if (any(uvw < 0) || any(uvw > 1))
-			return scaledUnitSH;
-
-		float3 cellVxCoord = uvw * ARRAY_DIM;
+		float3 cellVxCoord = uvw * LEVEL_DIM;
 		int3 cell000 = floor(cellVxCoord - 0.5);
 		float3 trilinearPos = cellVxCoord - 0.5 - cell000;
 
@@ -69,23 +66,26 @@ namespace Skylighting
 			int3 offset = int3(i, j, k);
 			int3 cellID = cell000 + offset;
 
-			if (any(cellID < 0) || any((uint3)cellID >= ARRAY_DIM))
+			if (any(cellID < 0) || any((uint3)cellID >= LEVEL_DIM))
 				continue;
 
-			float3 cellCentreMS = cellID + 0.5 - ARRAY_DIM / 2;
-			cellCentreMS = cellCentreMS * CELL_SIZE;
+			float3 trilinearWeights = 1 - abs(offset - trilinearPos);
+			float w = trilinearWeights.x * trilinearWeights.y * trilinearWeights.z;
 
-			// https://handmade.network/p/75/monter/blog/p/7288-engine_work__global_illumination_with_irradiance_probes
-			// basic tangent checks
-			float tangentWeight = dot(normalize(cellCentreMS - positionMSAdjusted), normalWS);
-			if (tangentWeight <= 0.0)
-				continue;
-			tangentWeight = sqrt(tangentWeight);
+			if (useTangentWeight) {
+				float3 cellCentreMS = cellID + 0.5 - LEVEL_DIM / 2;
+				cellCentreMS = cellCentreMS * getCellSize(level);
 
-			float3 trilinearWeights = 1 - abs(offset - trilinearPos);
-			float w = trilinearWeights.x * trilinearWeights.y * trilinearWeights.z * tangentWeight;
+				// https://handmade.network/p/75/monter/blog/p/7288-engine_work__global_illumination_with_irradiance_probes
+				// basic tangent checks
+				float tangentWeight = dot(normalize(cellCentreMS - positionMSAdjusted), normalWS);
+				if (tangentWeight <= 0.0)
+					continue;
+				w *= sqrt(tangentWeight);
+			}
 
-			uint3 cellTexID = (cellID + params.ArrayOrigin.xyz) % ARRAY_DIM;
+			uint3 cellTexID = (cellID + params.ArrayOrigin[level].xyz) % LEVEL_DIM;
+			cellTexID.z += level * LEVEL_DIM.z;
 			sh2 probe = SphericalHarmonics::Scale(probeArray[cellTexID], w);
 
 			sum = SphericalHarmonics::Add(sum, probe);
@@ -95,50 +95,67 @@ namespace Skylighting
 		return SphericalHarmonics::Scale(sum, rcp(wsum + 1e-10));
 	}
 
-	sh2 sampleNoBias(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, float3 positionMS)
+	// 1 well inside the level, fading to 0 towards its border, leaving room for the trilinear footprint
+	float getLevelWeight(SharedData::SkylightingSettings params, uint level, float3 positionMS)
+	{
+		float3 uvw = (positionMS - params.PosOffset[level].xyz) / getLevelSize(level) + .5;
+		float3 dists = min(uvw, 1 - uvw) - rcp(float3(LEVEL_DIM));
+		return saturate(min(dists.x, min(dists.y, dists.z)) / LEVEL_BLEND);
+	}
+
+	sh2 sampleClipmap(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, float3 positionMS, float3 normalWS, bool useTangentWeight)
 	{
 		const static sh2 unitSH = float4(sqrt(4 * Math::PI), 0, 0, 0);
 		sh2 scaledUnitSH = unitSH / 1e-10;
 
-		if (SharedData::InInterior)
-			return scaledUnitSH;
-
-		float3 positionMSAdjusted = positionMS - params.PosOffset.xyz;
-		float3 uvw = positionMSAdjusted / ARRAY_SIZE + .5;
-
+		float3 uvw = (positionMS - params.PosOffset[NUM_LEVELS - 1].xyz) / ARRAY_SIZE + .5;
 		if (any(uvw < 0) || any(uvw > 1))
 			return scaledUnitSH;
 
-		float3 cellVxCoord = uvw * ARRAY_DIM;
-		int3 cell000 = floor(cellVxCoord - 0.5);
-		float3 trilinearPos = cellVxCoord - 0.5 - cell000;
-
+		// finest level first; levels are nested, so only their blend bands take a second level
 		sh2 sum = 0;
-		float wsum = 0;
-		[unroll] for (int i = 0; i < 2; i++)
-			[unroll] for (int j = 0; j < 2; j++)
-				[unroll] for (int k = 0; k < 2; k++)
+		float remaining = 1;
+		[unroll] for (uint level = 0; level < NUM_LEVELS; level++)
 		{
-			int3 offset = int3(i, j, k);
-			int3 cellID = cell000 + offset;
+			float w = level == NUM_LEVELS - 1 ? 1 : getLevelWeight(params, level, positionMS);
+			if (w > 0) {
+				sum = SphericalHarmonics::Add(sum, SphericalHarmonics::Scale(sampleLevel(params, probeArray, level, positionMS, normalWS, useTangentWeight), remaining * w));
+				remaining *= 1 - w;
+			}
+			if (remaining <= 0)
+				break;
+		}
 
-			if (any(cellID < 0) || any((uint3)cellID >= ARRAY_DIM))
-				continue;
+		return sum;
+	}
 
-			float3 cellCentreMS = cellID + 0.5 - ARRAY_DIM / 2;
-			cellCentreMS = cellCentreMS * CELL_SIZE;
+	sh2 sample(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, Texture2DArray<float3> blueNoise, float2 screenPosition, float3 positionMS, float3 normalWS)
+	{
+		const static sh2 unitSH = float4(sqrt(4 * Math::PI), 0, 0, 0);
+		sh2 scaledUnitSH = unitSH / 1e-10;
 
-			float3 trilinearWeights = 1 - abs(offset - trilinearPos);
-			float w = trilinearWeights.x * trilinearWeights.y * trilinearWeights.z;
+		if (SharedData::InInterior)
+			return scaledUnitSH;
 
-			uint3 cellTexID = (cellID + params.ArrayOrigin.xyz) % ARRAY_DIM;
-			sh2 probe = SphericalHarmonics::Scale(probeArray[cellTexID], w);
+		positionMS.xyz += normalWS * CELL_SIZE * 0.5;  // Receiver normal bias
 
-			sum = SphericalHarmonics::Add(sum, probe);
-			wsum += w;
+		if (SharedData::FrameCount) {  // Check TAA
+			float3 offset = blueNoise[int3(screenPosition.xy % 128, SharedData::FrameCount % 64)] * 2.0 - 1.0;
+			positionMS.xyz += offset * CELL_SIZE * 0.5;
 		}
 
-		return SphericalHarmonics::Scale(sum, rcp(wsum + 1e-10));
+		return sampleClipmap(params, probeArray, positionMS, normalWS, true);
+	}
+
+	sh2 sampleNoBias(SharedData::SkylightingSettings params, Texture3D<sh2> probeArray, float3 positionMS)
+	{
+		const static sh2 unitSH = float4(sqrt(4 * Math::PI), 0, 0, 0);
+		sh2 scaledUnitSH = unitSH / 1e-10;
+
+		if (SharedData::InInterior)
+			return scaledUnitSH;
+
+		return sampleClipmap(params, probeArray, positionMS, 0, false);
 	}
 }
 
@@ -14,11 +14,14 @@ SamplerComparisonState comparisonSampler : register(s0);
 	const static sh2 unitSH = float4(sqrt(4.0 * Math::PI), 0, 0, 0);
 	const SharedData::SkylightingSettings settings = SharedData::skylightingSettings;
 
-	uint3 cellID = (int3(dtid) - settings.ArrayOrigin.xyz) % Skylighting::ARRAY_DIM;
-	bool isValid = all(cellID >= max(0, settings.ValidMargin.xyz)) && all(cellID <= Skylighting::ARRAY_DIM - 1 + min(0, settings.ValidMargin.xyz));  // check if the cell is newly added
+	uint level = dtid.z / Skylighting::LEVEL_DIM.z;
+	uint3 levelDtid = uint3(dtid.xy, dtid.z % Skylighting::LEVEL_DIM.z);
 
-	float3 cellCentreMS = cellID + 0.5 - Skylighting::ARRAY_DIM / 2;
-	cellCentreMS = cellCentreMS / Skylighting::ARRAY_DIM * Skylighting::ARRAY_SIZE + settings.PosOffset.xyz;
+	uint3 cellID = (int3(levelDtid) - settings.ArrayOrigin[level].xyz) % Skylighting::LEVEL_DIM;
+	bool isValid = all(cellID >= max(0, settings.ValidMargin[level].xyz)) && all(cellID <= Skylighting::LEVEL_DIM - 1 + min(0, settings.ValidMargin[level].xyz));  // check if the cell is newly added
+
+	float3 cellCentreMS = cellID + 0.5 - Skylighting::LEVEL_DIM / 2;
+	cellCentreMS = cellCentreMS * Skylighting::getCellSize(level) + settings.PosOffset[level].xyz;
 
 	float3 cellCentreOS = mul(settings.OcclusionViewProj, float4(cellCentreMS, 1)).xyz;
 	cellCentreOS.y = -cellCentreOS.y;
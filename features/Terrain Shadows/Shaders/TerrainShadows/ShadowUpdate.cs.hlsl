@@ -1,4 +1,5 @@
 Texture2D<float> TexHeight : register(t0);
+Texture2D<float2> TexOuterShadowHeights : register(t1);  // coarse map of the whole worldspace, around a window
 RWTexture2D<float2> RWTexShadowHeights : register(u0);
 
 cbuffer ShadowUpdateCB : register(b0)
@@ -7,9 +8,11 @@ cbuffer ShadowUpdateCB : register(b0)
 	float2 LightDeltaZ : packoffset(c0.z);  // per lightUVDir, normalised, [upper, lower] penumbra, should be negative
 	uint StartPxCoord : packoffset(c1.x);
 	float2 PxSize : packoffset(c1.y);
-	float pad : packoffset(c1.w);
+	uint HasOuterMap : packoffset(c1.w);
 	float2 PosRange : packoffset(c2.x);
 	float2 ZRange : packoffset(c2.z);
+	float4 OuterTransform : packoffset(c3);  // window UV to outer UV, scale in xy and offset in zw
+	uint4 KeptRect : packoffset(c4);         // pixels blended with what they held, the rest are replaced
 }
 
 float GetInterpolatedHeight(float2 pxCoord, bool isVertical)
@@ -59,6 +62,21 @@ float2 GetInterpolatedHeightRW(float2 pxCoord, bool isVertical)
 		return heightA;
 }
 
+// bilinear and clamped to the edge, without a sampler bound
+float2 SampleOuterShadowHeights(float2 uv)
+{
+	uint2 dims;
+	TexOuterShadowHeights.GetDimensions(dims.x, dims.y);
+
+	float2 pos = (uv * OuterTransform.xy + OuterTransform.zw) * dims - .5;
+	float2 base = floor(pos);
+	int2 pxA = clamp(int2(base), 0, int2(dims) - 1);
+	int2 pxB = clamp(int2(base) + 1, 0, int2(dims) - 1);
+	float2 t = pos - base;
+	return lerp(lerp(TexOuterShadowHeights[pxA], TexOuterShadowHeights[int2(pxB.x, pxA.y)], t.x),
+		lerp(TexOuterShadowHeights[int2(pxA.x, pxB.y)], TexOuterShadowHeights[pxB], t.x), t.y);
+}
+
 #define NTHREADS 128
 groupshared float2 g_shadowHeight[NTHREADS];
 
@@ -88,9 +106,15 @@ groupshared float2 g_shadowHeight[NTHREADS];
 		// bifilter
 		float2 heights = GetInterpolatedHeight(threadPxCoord, isVertical).xx;
 
-		// fetch last dispatch
-		if (gtid == 0 && all(floor(rawThreadUV - lightUVDir) == floor(rawThreadUV))) {
-			float2 sampleHeights = GetInterpolatedHeightRW(threadPxCoord - LightPxDir, isVertical) + LightDeltaZ;
+		if (all(floor(rawThreadUV - lightUVDir) == floor(rawThreadUV))) {
+			// fetch last dispatch
+			if (gtid == 0) {
+				float2 sampleHeights = GetInterpolatedHeightRW(threadPxCoord - LightPxDir, isVertical) + LightDeltaZ;
+				heights = heights.x > sampleHeights.x ? heights : sampleHeights;
+			}
+		} else if (HasOuterMap) {
+			// the ray enters the window here, it continues from the outer map
+			float2 sampleHeights = SampleOuterShadowHeights(threadUV - lightUVDir) + LightDeltaZ;
 			heights = heights.x > sampleHeights.x ? heights : sampleHeights;
 		}
 
@@ -115,6 +139,8 @@ groupshared float2 g_shadowHeight[NTHREADS];
 
 	// save
 	if (isValid) {
-		RWTexShadowHeights[uint2(threadPxCoord)] = lerp(pastHeights, g_shadowHeight[gtid], 0.5f);
+		uint2 px = uint2(threadPxCoord);
+		bool isKept = all(px >= KeptRect.xy) && all(px < KeptRect.zw);
+		RWTexShadowHeights[px] = lerp(pastHeights, g_shadowHeight[gtid], isKept ? 0.5f : 1.f);
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 namespace TerrainShadows
 {
-	Texture2D<float2> ShadowHeightTexture : register(t60);
+	Texture2D<float2> ShadowHeightTexture : register(t60);        // coarse, the whole worldspace
+	Texture2D<float2> ShadowHeightWindowTexture : register(t61);  // full resolution around the player
 
 	float2 GetTerrainShadowUV(float2 xy)
 	{
@@ -17,11 +18,18 @@ namespace TerrainShadows
 		return float2(GetTerrainZ(norm_z.x), GetTerrainZ(norm_z.y));
 	}
 
+	float2 SampleShadowHeight(float2 xy, SamplerState samp)
+	{
+		float2 windowUV = xy * SharedData::terraOccSettings.WindowScale + SharedData::terraOccSettings.WindowOffset;
+		if (all(windowUV > SharedData::terraOccSettings.WindowBounds.xy && windowUV < SharedData::terraOccSettings.WindowBounds.zw))
+			return ShadowHeightWindowTexture.SampleLevel(samp, windowUV, 0);
+		return ShadowHeightTexture.SampleLevel(samp, GetTerrainShadowUV(xy), 0);
+	}
+
 	float GetTerrainShadow(const float3 worldPos, SamplerState samp)
 	{
 		if (SharedData::terraOccSettings.EnableTerrainShadow) {
-			float2 terraOccUV = GetTerrainShadowUV(worldPos.xy);
-			float2 shadowHeight = GetTerrainZ(ShadowHeightTexture.SampleLevel(samp, terraOccUV, 0));
+			float2 shadowHeight = GetTerrainZ(SampleShadowHeight(worldPos.xy, samp));
 			float shadowFraction = saturate((worldPos.z - shadowHeight.y) / (shadowHeight.x - shadowHeight.y));
 			return shadowFraction;
 		}
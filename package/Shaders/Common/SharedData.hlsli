@@ -4,6 +4,9 @@
 #include "Common/FrameBuffer.hlsli"
 #include "Common/VR.hlsli"
 
+// skylighting probe clipmap levels; keep in sync with Skylighting::NumLevels
+#define SKYLIGHTING_NUM_LEVELS 2
+
 namespace SharedData
 {
 
@@ -61,6 +64,9 @@ namespace SharedData
 		float3 Scale;
 		float2 ZRange;
 		float2 Offset;
+		float2 WindowScale;   // world xy to UV of the full resolution window
+		float2 WindowOffset;
+		float4 WindowBounds;  // window UV sampled from the window, empty while there is none
 	};
 
 	struct LightLimitFixSettings
@@ -121,9 +127,9 @@ namespace SharedData
 		row_major float4x4 OcclusionViewProj;
 		float4 OcclusionDir;
 
-		float4 PosOffset;   // xyz: cell origin in camera model space
-		uint4 ArrayOrigin;  // xyz: array origin
-		int4 ValidMargin;
+		float4 PosOffset[SKYLIGHTING_NUM_LEVELS];   // per clipmap level, xyz: cell origin in camera model space
+		uint4 ArrayOrigin[SKYLIGHTING_NUM_LEVELS];  // per clipmap level, xyz: array origin
+		int4 ValidMargin[SKYLIGHTING_NUM_LEVELS];
 
 		float MinDiffuseVisibility;
 		float MinSpecularVisibility;
@@ -177,6 +177,8 @@ void Deferred::SetupResources()
 		prevDiffuseAmbientTexture->CreateSRV(srvDesc);
 		prevDiffuseAmbientTexture->CreateUAV(uavDesc);
 	}
+
+	PrecompileShaders();
 }
 
 void Deferred::CopyShadowData()
@@ -645,25 +647,71 @@ void Deferred::ClearShaderCache()
 		mainCompositeInteriorCS->Release();
 		mainCompositeInteriorCS = nullptr;
 	}
+	for (auto task : { &ambientCompositeTask, &ambientCompositeInteriorTask, &mainCompositeTask, &mainCompositeInteriorTask }) {
+		if (auto shader = Util::TakeShader(*task))
+			shader->Release();
+	}
 }
 
-ID3D11ComputeShader* Deferred::GetComputeAmbientComposite()
+std::vector<std::pair<const char*, const char*>> Deferred::GetAmbientCompositeDefines(bool a_interior)
 {
-	if (!ambientCompositeCS) {
-		logger::debug("Compiling AmbientCompositeCS");
+	std::vector<std::pair<const char*, const char*>> defines;
 
-		std::vector<std::pair<const char*, const char*>> defines;
+	if (a_interior)
+		defines.push_back({ "INTERIOR", nullptr });
+	else if (Skylighting::GetSingleton()->loaded)
+		defines.push_back({ "SKYLIGHTING", nullptr });
 
-		if (Skylighting::GetSingleton()->loaded)
-			defines.push_back({ "SKYLIGHTING", nullptr });
+	if (ScreenSpaceGI::GetSingleton()->loaded)
+		defines.push_back({ "SSGI", nullptr });
 
-		if (ScreenSpaceGI::GetSingleton()->loaded)
-			defines.push_back({ "SSGI", nullptr });
+	if (REL::Module::IsVR())
+		defines.push_back({ "FRAMEBUFFER", nullptr });
 
-		if (REL::Module::IsVR())
-			defines.push_back({ "FRAMEBUFFER", nullptr });
+	return defines;
+}
+
+std::vector<std::pair<const char*, const char*>> Deferred::GetMainCompositeDefines(bool a_interior)
+{
+	std::vector<std::pair<const char*, const char*>> defines;
+
+	if (a_interior)
+		defines.push_back({ "INTERIOR", nullptr });
 
-		ambientCompositeCS = static_cast<ID3D11ComputeShader*>(Util::CompileShader(L"Data\\Shaders\\AmbientCompositeCS.hlsl", defines, "cs_5_0"));
+	if (DynamicCubemaps::GetSingleton()->loaded)
+		defines.push_back({ "DYNAMIC_CUBEMAPS", nullptr });
+
+	if (!a_interior && Skylighting::GetSingleton()->loaded)
+		defines.push_back({ "SKYLIGHTING", nullptr });
+
+	if (ScreenSpaceGI::GetSingleton()->loaded)
+		defines.push_back({ "SSGI", nullptr });
+
+	if (REL::Module::IsVR())
+		defines.push_back({ "FRAMEBUFFER", nullptr });
+
+	return defines;
+}
+
+void Deferred::PrecompileShaders()
+{
+	// compile all of them in parallel so a getter only waits for its own shader
+	if (!ambientCompositeCS && !ambientCompositeTask.valid())
+		ambientCompositeTask = Util::CompileShaderAsync(L"Data\\Shaders\\AmbientCompositeCS.hlsl", GetAmbientCompositeDefines(false), "cs_5_0");
+	if (!ambientCompositeInteriorCS && !ambientCompositeInteriorTask.valid())
+		ambientCompositeInteriorTask = Util::CompileShaderAsync(L"Data\\Shaders\\AmbientCompositeCS.hlsl", GetAmbientCompositeDefines(true), "cs_5_0");
+	if (!mainCompositeCS && !mainCompositeTask.valid())
+		mainCompositeTask = Util::CompileShaderAsync(L"Data\\Shaders\\DeferredCompositeCS.hlsl", GetMainCompositeDefines(false), "cs_5_0");
+	if (!mainCompositeInteriorCS && !mainCompositeInteriorTask.valid())
+		mainCompositeInteriorTask = Util::CompileShaderAsync(L"Data\\Shaders\\DeferredCompositeCS.hlsl", GetMainCompositeDefines(true), "cs_5_0");
+}
+
+ID3D11ComputeShader* Deferred::GetComputeAmbientComposite()
+{
+	if (!ambientCompositeCS) {
+		logger::debug("Compiling AmbientCompositeCS");
+		PrecompileShaders();
+		ambientCompositeCS = static_cast<ID3D11ComputeShader*>(Util::TakeShader(ambientCompositeTask));
 	}
 	return ambientCompositeCS;
 }
@@ -672,17 +720,8 @@ ID3D11ComputeShader* Deferred::GetComputeAmbientCompositeInterior()
 {
 	if (!ambientCompositeInteriorCS) {
 		logger::debug("Compiling AmbientCompositeCS INTERIOR");
-
-		std::vector<std::pair<const char*, const char*>> defines;
-		defines.push_back({ "INTERIOR", nullptr });
-
-		if (ScreenSpaceGI::GetSingleton()->loaded)
-			defines.push_back({ "SSGI", nullptr });
-
-		if (REL::Module::IsVR())
-			defines.push_back({ "FRAMEBUFFER", nullptr });
-
-		ambientCompositeInteriorCS = static_cast<ID3D11ComputeShader*>(Util::CompileShader(L"Data\\Shaders\\AmbientCompositeCS.hlsl", defines, "cs_5_0"));
+		PrecompileShaders();
+		ambientCompositeInteriorCS = static_cast<ID3D11ComputeShader*>(Util::TakeShader(ambientCompositeInteriorTask));
 	}
 	return ambientCompositeInteriorCS;
 }
@@ -691,22 +730,8 @@ ID3D11ComputeShader* Deferred::GetComputeMainComposite()
 {
 	if (!mainCompositeCS) {
 		logger::debug("Compiling DeferredCompositeCS");
-
-		std::vector<std::pair<const char*, const char*>> defines;
-
-		if (DynamicCubemaps::GetSingleton()->loaded)
-			defines.push_back({ "DYNAMIC_CUBEMAPS", nullptr });
-
-		if (Skylighting::GetSingleton()->loaded)
-			defines.push_back({ "SKYLIGHTING", nullptr });
-
-		if (ScreenSpaceGI::GetSingleton()->loaded)
-			defines.push_back({ "SSGI", nullptr });
-
-		if (REL::Module::IsVR())
-			defines.push_back({ "FRAMEBUFFER", nullptr });
-
-		mainCompositeCS = static_cast<ID3D11ComputeShader*>(Util::CompileShader(L"Data\\Shaders\\DeferredCompositeCS.hlsl", defines, "cs_5_0"));
+		PrecompileShaders();
+		mainCompositeCS = static_cast<ID3D11ComputeShader*>(Util::TakeShader(mainCompositeTask));
 	}
 	return mainCompositeCS;
 }
@@ -715,20 +740,8 @@ ID3D11ComputeShader* Deferred::GetComputeMainCompositeInterior()
 {
 	if (!mainCompositeInteriorCS) {
 		logger::debug("Compiling DeferredCompositeCS INTERIOR");
-
-		std::vector<std::pair<const char*, const char*>> defines;
-		defines.push_back({ "INTERIOR", nullptr });
-
-		if (DynamicCubemaps::GetSingleton()->loaded)
-			defines.push_back({ "DYNAMIC_CUBEMAPS", nullptr });
-
-		if (ScreenSpaceGI::GetSingleton()->loaded)
-			defines.push_back({ "SSGI", nullptr });
-
-		if (REL::Module::IsVR())
-			defines.push_back({ "FRAMEBUFFER", nullptr });
-
-		mainCompositeInteriorCS = static_cast<ID3D11ComputeShader*>(Util::CompileShader(L"Data\\Shaders\\DeferredCompositeCS.hlsl", defines, "cs_5_0"));
+		PrecompileShaders();
+		mainCompositeInteriorCS = static_cast<ID3D11ComputeShader*>(Util::TakeShader(mainCompositeInteriorTask));
 	}
 	return mainCompositeInteriorCS;
 }
@@ -33,6 +33,12 @@ public:
 	void PrepassPasses();
 
 	void ClearShaderCache();
+	/**
+	 * @brief Queues the composite shaders that are not compiled yet on the compilation pool.
+	 */
+	void PrecompileShaders();
+	std::vector<std::pair<const char*, const char*>> GetAmbientCompositeDefines(bool a_interior);
+	std::vector<std::pair<const char*, const char*>> GetMainCompositeDefines(bool a_interior);
 	ID3D11ComputeShader* GetComputeAmbientComposite();
 	ID3D11ComputeShader* GetComputeAmbientCompositeInterior();
 	ID3D11ComputeShader* GetComputeMainComposite();
@@ -50,6 +56,11 @@ public:
 	ID3D11ComputeShader* mainCompositeCS = nullptr;
 	ID3D11ComputeShader* mainCompositeInteriorCS = nullptr;
 
+	std::shared_future<ID3D11DeviceChild*> ambientCompositeTask;
+	std::shared_future<ID3D11DeviceChild*> ambientCompositeInteriorTask;
+	std::shared_future<ID3D11DeviceChild*> mainCompositeTask;
+	std::shared_future<ID3D11DeviceChild*> mainCompositeInteriorTask;
+
 	bool inWorld = false;
 	bool inBlendedDecals = false;
 	bool inDecals = false;
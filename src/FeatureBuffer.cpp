@@ -11,24 +11,33 @@
 #include "TruePBR.h"
 
 template <class... Ts>
-std::pair<unsigned char*, size_t> _GetFeatureBufferData(Ts... feat_datas)
+bool FeatureBuffer::Write(const Ts&... a_featureDatas)
 {
-	size_t totalSize = (... + sizeof(Ts));
-	auto data = new unsigned char[totalSize];
+	bool changed = false;
+	if (data.empty()) {
+		size = (... + sizeof(Ts));
+		data.resize((size + sizeof(Block) - 1) / sizeof(Block));
+		changed = true;
+	}
+
+	auto bytes = reinterpret_cast<uint8_t*>(data.data());
 	size_t offset = 0;
 
 	([&] {
-		*((decltype(feat_datas)*)(data + offset)) = feat_datas;
-		offset += sizeof(decltype(feat_datas));
+		if (memcmp(bytes + offset, &a_featureDatas, sizeof(Ts)) != 0) {
+			memcpy(bytes + offset, &a_featureDatas, sizeof(Ts));
+			changed = true;
+		}
+		offset += sizeof(Ts);
 	}(),
 		...);
 
-	return std::make_pair(data, totalSize);
+	return changed;
 }
 
-std::pair<unsigned char*, size_t> GetFeatureBufferData(bool a_inWorld)
+bool FeatureBuffer::Update(bool a_inWorld)
 {
-	return _GetFeatureBufferData(
+	return Write(
 		GrassLighting::GetSingleton()->settings,
 		ExtendedMaterials::GetSingleton()->settings,
 		DynamicCubemaps::GetSingleton()->settings,
@@ -36,4 +45,4 @@ std::pair<unsigned char*, size_t> GetFeatureBufferData(bool a_inWorld)
 		LightLimitFix::GetSingleton()->GetCommonBufferData(),
 		WetnessEffects::GetSingleton()->GetCommonBufferData(),
 		Skylighting::GetSingleton()->GetCommonBufferData(a_inWorld));
-}
\ No newline at end of file
+}
@@ -1,3 +1,39 @@
 #pragma once
 
-std::pair<unsigned char*, size_t> GetFeatureBufferData(bool a_early);
\ No newline at end of file
+/**
+ * Persistent copy of the FeatureData constant buffer.
+ *
+ * Every feature owns a fixed slice, in the order the shaders declare them. Each frame the
+ * feature data is compared against its slice and only copied when it differs, so the buffer only
+ * needs uploading in frames where a setting or derived value actually changed.
+ */
+class FeatureBuffer
+{
+public:
+	static FeatureBuffer* GetSingleton()
+	{
+		static FeatureBuffer singleton;
+		return &singleton;
+	}
+
+	/**
+	 * @brief Refreshes every slice from its feature.
+	 * @return True if any slice changed since the last call.
+	 */
+	bool Update(bool a_inWorld);
+
+	const void* GetData() const { return data.data(); }
+	size_t GetSize() const { return size; }
+
+private:
+	template <class... Ts>
+	bool Write(const Ts&... a_featureDatas);
+
+	struct alignas(16) Block
+	{
+		uint8_t bytes[16];
+	};
+
+	std::vector<Block> data;
+	size_t size = 0;
+};
@@ -0,0 +1,167 @@
+#include "Features/LightLimitFix/ClusterCulling.h"
+
+namespace ClusterCulling
+{
+	namespace SClusterCulling
+	{
+		static Vector3 Min(const Vector3& a_lhs, const Vector3& a_rhs)
+		{
+			return { std::min(a_lhs.x, a_rhs.x), std::min(a_lhs.y, a_rhs.y), std::min(a_lhs.z, a_rhs.z) };
+		}
+
+		static Vector3 Max(const Vector3& a_lhs, const Vector3& a_rhs)
+		{
+			return { std::max(a_lhs.x, a_rhs.x), std::max(a_lhs.y, a_rhs.y), std::max(a_lhs.z, a_rhs.z) };
+		}
+
+		static Vector3 GetPositionVS(float a_texcoordX, float a_texcoordY, float a_depth, const Matrix& a_invProjMatrix)
+		{
+			const float clipSpaceLocation[4] = {
+				a_texcoordX * 2.0f - 1.0f,  // convert from [0,1] to [-1,1]
+				-(a_texcoordY * 2.0f - 1.0f),
+				a_depth,
+				1.0f
+			};
+			// row vector times row-major matrix, as mul(v, M) in the shader
+			float homogenousLocation[4] = {};
+			for (int column = 0; column < 4; column++) {
+				for (int row = 0; row < 4; row++) {
+					homogenousLocation[column] += clipSpaceLocation[row] * a_invProjMatrix.m[row][column];
+				}
+			}
+			return { homogenousLocation[0] / homogenousLocation[3], homogenousLocation[1] / homogenousLocation[3], homogenousLocation[2] / homogenousLocation[3] };
+		}
+
+		static Vector3 IntersectionZPlane(const Vector3& a_direction, float a_zDistance)
+		{
+			float t = a_zDistance / a_direction.z;
+			return { a_direction.x * t, a_direction.y * t, a_direction.z * t };
+		}
+
+		static bool LightIntersectsCluster(const Vector3& a_position, float a_radiusSquared, const ClusterAABB& a_cluster)
+		{
+			const float dx = std::max(a_cluster.minPoint.x, std::min(a_position.x, a_cluster.maxPoint.x)) - a_position.x;
+			const float dy = std::max(a_cluster.minPoint.y, std::min(a_position.y, a_cluster.maxPoint.y)) - a_position.y;
+			const float dz = std::max(a_cluster.minPoint.z, std::min(a_position.z, a_cluster.maxPoint.z)) - a_position.z;
+			return dx * dx + dy * dy + dz * dz <= a_radiusSquared;
+		}
+
+		static size_t GetHistogramBucket(uint a_lightCount)
+		{
+			return std::min<size_t>(std::bit_width(a_lightCount), Statistics{}.histogram.size() - 1);
+		}
+	}
+
+	void BuildClusters(const Config& a_config, const Matrix (&a_invProjMatrix)[2], float a_near, float a_far, std::vector<ClusterAABB>& o_clusters)
+	{
+		using namespace SClusterCulling;
+
+		const auto [sizeX, sizeY, sizeZ] = a_config.clusterSize;
+		o_clusters.resize(sizeX * sizeY * sizeZ);
+
+		const float clusterSizeX = 1.0f / sizeX;
+		const float clusterSizeY = 1.0f / sizeY;
+
+		for (uint z = 0; z < sizeZ; z++) {
+			float clusterNear = a_near * std::pow(a_far / a_near, z / float(sizeZ));
+			float clusterFar = a_near * std::pow(a_far / a_near, (z + 1) / float(sizeZ));
+
+			for (uint y = 0; y < sizeY; y++) {
+				for (uint x = 0; x < sizeX; x++) {
+					const float texcoordMaxX = float(x + 1) * clusterSizeX, texcoordMaxY = float(y + 1) * clusterSizeY;
+					const float texcoordMinX = float(x) * clusterSizeX, texcoordMinY = float(y) * clusterSizeY;
+
+					Vector3 maxPointVS = GetPositionVS(texcoordMaxX, texcoordMaxY, 1.0f, a_invProjMatrix[0]);
+					Vector3 minPointVS = GetPositionVS(texcoordMinX, texcoordMinY, 1.0f, a_invProjMatrix[0]);
+					if (a_config.stereo) {
+						maxPointVS = Max(maxPointVS, GetPositionVS(texcoordMaxX, texcoordMaxY, 1.0f, a_invProjMatrix[1]));
+						minPointVS = Min(minPointVS, GetPositionVS(texcoordMinX, texcoordMinY, 1.0f, a_invProjMatrix[1]));
+					}
+
+					Vector3 minPointNear = IntersectionZPlane(minPointVS, clusterNear);
+					Vector3 minPointFar = IntersectionZPlane(minPointVS, clusterFar);
+					Vector3 maxPointNear = IntersectionZPlane(maxPointVS, clusterNear);
+					Vector3 maxPointFar = IntersectionZPlane(maxPointVS, clusterFar);
+
+					Vector3 minPointAABB = Min(Min(minPointNear, minPointFar), Min(maxPointNear, maxPointFar));
+					Vector3 maxPointAABB = Max(Max(minPointNear, minPointFar), Max(maxPointNear, maxPointFar));
+
+					auto& cluster = o_clusters[x + y * sizeX + z * (sizeX * sizeY)];
+					cluster.minPoint = { minPointAABB.x, minPointAABB.y, minPointAABB.z, 0.0f };
+					cluster.maxPoint = { maxPointAABB.x, maxPointAABB.y, maxPointAABB.z, 0.0f };
+				}
+			}
+		}
+	}
+
+	void CullLights(const Config& a_config, std::span<const ClusterAABB> a_clusters, std::span<const Light> a_lights, std::vector<LightGrid>& o_grid, std::vector<uint>& o_lightIndices, Statistics* o_statistics)
+	{
+		o_grid.resize(a_clusters.size());
+		o_lightIndices.clear();
+
+		if (o_statistics) {
+			o_statistics->clusterCount = static_cast<uint>(a_clusters.size());
+			o_statistics->lightCount = static_cast<uint>(a_lights.size());
+		}
+
+		for (size_t clusterIndex = 0; clusterIndex < a_clusters.size(); clusterIndex++) {
+			const auto& cluster = a_clusters[clusterIndex];
+			const auto offset = static_cast<uint>(o_lightIndices.size());
+
+			// the shader stops at the limit, keep counting to see how much it drops
+			uint intersectingLights = 0;
+			for (uint i = 0; i < a_lights.size(); i++) {
+				const auto& light = a_lights[i];
+				float radius = light.radius * light.radius;
+
+				if (SClusterCulling::LightIntersectsCluster(light.positionVS[0], radius, cluster) ||
+					(a_config.stereo && SClusterCulling::LightIntersectsCluster(light.positionVS[1], radius, cluster))) {
+					if (intersectingLights < a_config.maxClusterLights) {
+						o_lightIndices.push_back(i);
+					} else if (!o_statistics) {
+						break;
+					}
+					intersectingLights++;
+				}
+			}
+
+			const auto visibleLightCount = static_cast<uint>(o_lightIndices.size()) - offset;
+			o_grid[clusterIndex] = { offset, visibleLightCount };
+
+			if (o_statistics) {
+				o_statistics->emptyClusters += visibleLightCount == 0;
+				o_statistics->maxClusterLights = std::max(o_statistics->maxClusterLights, intersectingLights);
+				o_statistics->overflowedClusters += intersectingLights > a_config.maxClusterLights;
+				o_statistics->droppedLights += intersectingLights - visibleLightCount;
+				o_statistics->histogram[SClusterCulling::GetHistogramBucket(visibleLightCount)]++;
+			}
+		}
+
+		if (o_statistics && !a_clusters.empty()) {
+			o_statistics->averageClusterLights = static_cast<float>(o_lightIndices.size()) / static_cast<float>(a_clusters.size());
+		}
+	}
+
+	Statistics Analyze(const Config& a_config, const Matrix (&a_invProjMatrix)[2], float a_near, float a_far, std::span<const Light> a_lights)
+	{
+		using Clock = std::chrono::steady_clock;
+		using Milliseconds = std::chrono::duration<float, std::milli>;
+
+		std::vector<ClusterAABB> clusters;
+		std::vector<LightGrid> grid;
+		std::vector<uint> lightIndices;
+		Statistics statistics;
+
+		auto start = Clock::now();
+		BuildClusters(a_config, a_invProjMatrix, a_near, a_far, clusters);
+		statistics.buildMilliseconds = Milliseconds(Clock::now() - start).count();
+
+		// timed without statistics so the cost matches what the shader does
+		start = Clock::now();
+		CullLights(a_config, clusters, a_lights, grid, lightIndices);
+		statistics.cullMilliseconds = Milliseconds(Clock::now() - start).count();
+
+		CullLights(a_config, clusters, a_lights, grid, lightIndices, &statistics);
+		return statistics;
+	}
+}
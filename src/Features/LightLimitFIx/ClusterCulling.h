@@ -0,0 +1,88 @@
+#pragma once
+
+/**
+ * CPU mirror of ClusterBuildingCS and ClusterCullingCS.
+ *
+ * Follows the shaders step by step so cluster dimensions and light limits can be evaluated on
+ * the lights of a real frame without a GPU in the loop. The GPU appends light lists in whatever
+ * order its groups finish, here they are laid out in cluster order; all other output matches.
+ */
+namespace ClusterCulling
+{
+	// plain types rather than SimpleMath, so this builds without DirectX for the tests in tools/Tests
+	struct Vector3
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+	};
+
+	struct Vector4
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+		float w = 0.0f;
+	};
+
+	// row-major, applied to row vectors as mul(v, M) in the shaders; same layout as float4x4
+	struct Matrix
+	{
+		float m[4][4];
+	};
+
+	struct ClusterAABB
+	{
+		Vector4 minPoint;
+		Vector4 maxPoint;
+	};
+
+	struct LightGrid
+	{
+		uint offset;
+		uint lightCount;
+	};
+
+	struct Light
+	{
+		Vector3 positionVS[2];
+		float radius;
+	};
+
+	struct Config
+	{
+		std::array<uint, 3> clusterSize;
+		uint maxClusterLights;
+		bool stereo;
+	};
+
+	struct Statistics
+	{
+		uint clusterCount = 0;
+		uint lightCount = 0;
+		uint emptyClusters = 0;
+		uint maxClusterLights = 0;     // most lights found in one cluster, before truncation
+		uint overflowedClusters = 0;   // clusters that hit the limit and dropped lights
+		uint droppedLights = 0;        // light references lost to truncation over all clusters
+		float averageClusterLights = 0;
+		std::array<uint, 9> histogram{};  // clusters with 0, 1, 2-3, 4-7, ... 128+ lights
+		float buildMilliseconds = 0;
+		float cullMilliseconds = 0;
+	};
+
+	/**
+	 * @brief Mirrors ClusterBuildingCS, one view-space AABB per cluster.
+	 */
+	void BuildClusters(const Config& a_config, const Matrix (&a_invProjMatrix)[2], float a_near, float a_far, std::vector<ClusterAABB>& o_clusters);
+
+	/**
+	 * @brief Mirrors ClusterCullingCS, lights are visited in order and truncated at maxClusterLights.
+	 * @param o_statistics Optional, filled with counts the shader does not keep.
+	 */
+	void CullLights(const Config& a_config, std::span<const ClusterAABB> a_clusters, std::span<const Light> a_lights, std::vector<LightGrid>& o_grid, std::vector<uint>& o_lightIndices, Statistics* o_statistics = nullptr);
+
+	/**
+	 * @brief Builds and culls a frame and times both stages.
+	 */
+	Statistics Analyze(const Config& a_config, const Matrix (&a_invProjMatrix)[2], float a_near, float a_far, std::span<const Light> a_lights);
+}
@@ -0,0 +1,371 @@
+#include "Features/LightLimitFix/ParticleLightClustering.h"
+
+namespace ParticleLightClustering
+{
+	namespace SParticleLightClustering
+	{
+		constexpr uint32_t SamplesMagic = 0x4C505343;  // "CSPL"
+		static_assert(sizeof(Sample) == 28);
+
+		// 21 bits per axis; cells only alias tens of millions of units apart, far beyond light range
+		static uint64_t GetCellKey(int64_t a_x, int64_t a_y, int64_t a_z)
+		{
+			return (static_cast<uint64_t>(a_x) & 0x1FFFFF) | ((static_cast<uint64_t>(a_y) & 0x1FFFFF) << 21) | ((static_cast<uint64_t>(a_z) & 0x1FFFFF) << 42);
+		}
+
+		// std::floor is a library call without SSE4.1, and this runs several times per particle
+		static int64_t FloorToInt(float a_value)
+		{
+			const auto truncated = static_cast<int64_t>(a_value);
+			return truncated - (static_cast<float>(truncated) > a_value);
+		}
+
+		static uint64_t GetCellKey(const float3& a_position, float a_cellScale)
+		{
+			return GetCellKey(FloorToInt(a_position.x * a_cellScale), FloorToInt(a_position.y * a_cellScale), FloorToInt(a_position.z * a_cellScale));
+		}
+
+		static size_t GetSlot(uint64_t a_key, size_t a_mask)
+		{
+			return static_cast<size_t>((a_key * 0x9E3779B97F4A7C15ull) >> 32) & a_mask;
+		}
+
+		static std::array<int64_t, 3> GetCell(const float3& a_position, float a_cellScale)
+		{
+			return { FloorToInt(a_position.x * a_cellScale), FloorToInt(a_position.y * a_cellScale), FloorToInt(a_position.z * a_cellScale) };
+		}
+
+		static int64_t GetTile(int64_t a_cell)
+		{
+			return (a_cell >= 0 ? a_cell : a_cell - (Clusterer::TileCells - 1)) / Clusterer::TileCells;
+		}
+
+		// unsigned order of the result follows the order of the floats; only used to make the visiting order canonical
+		static uint32_t GetOrderedBits(float a_value)
+		{
+			const auto bits = std::bit_cast<uint32_t>(a_value);
+			return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+		}
+
+		// total order on the bits of everything but the x position, which the sort key already holds
+		static bool IsCanonicallyBefore(const Sample& a_lhs, const Sample& a_rhs)
+		{
+			auto bits = [](const Sample& a_sample) {
+				return std::array<uint32_t, 6>{ GetOrderedBits(a_sample.position.y), GetOrderedBits(a_sample.position.z), GetOrderedBits(a_sample.radius),
+					GetOrderedBits(a_sample.color.x), GetOrderedBits(a_sample.color.y), GetOrderedBits(a_sample.color.z) };
+			};
+			return bits(a_lhs) < bits(a_rhs);
+		}
+
+		// a sample is a light of one particle; the border pass clusters lights
+		static float3 GetPosition(const Sample& a_sample) { return a_sample.position; }
+		static float GetRadius(const Sample& a_sample) { return a_sample.radius; }
+		static float3 GetPosition(const Cluster& a_sum) { return a_sum.position / static_cast<float>(a_sum.count); }
+		static float GetRadius(const Cluster& a_sum) { return a_sum.radius / static_cast<float>(a_sum.count); }
+
+		static bool CanMerge(const float3& a_lightPosition, float a_lightRadius, const float3& a_position, float a_radius, float a_threshold)
+		{
+			return std::abs(a_lightRadius - a_radius) + float3::Distance(a_lightPosition, a_position) <= a_threshold;
+		}
+
+		static void Add(Cluster& a_sum, const Sample& a_sample)
+		{
+			a_sum.position += a_sample.position;
+			a_sum.radius += a_sample.radius;
+			a_sum.color += a_sample.color;
+			a_sum.count++;
+		}
+
+		static void Add(Cluster& a_sum, const Cluster& a_other)
+		{
+			a_sum.position += a_other.position;
+			a_sum.radius += a_other.radius;
+			a_sum.color += a_other.color;
+			a_sum.count += a_other.count;
+		}
+	}
+
+	bool Clusterer::Grid::IsUsed(size_t a_slot) const
+	{
+		return (used[a_slot / 64] >> (a_slot % 64)) & 1;
+	}
+
+	Clusterer::Cell& Clusterer::Grid::FindCell(uint64_t a_key)
+	{
+		const size_t mask = cells.size() - 1;
+		for (size_t slot = SParticleLightClustering::GetSlot(a_key, mask);; slot = (slot + 1) & mask) {
+			auto& cell = cells[slot];
+			if (!IsUsed(slot)) {
+				used[slot / 64] |= 1ull << (slot % 64);
+				cell = { a_key, None };
+				return cell;
+			}
+			if (cell.key == a_key) {
+				return cell;
+			}
+		}
+	}
+
+	const Clusterer::Cell* Clusterer::Grid::FindCellIfUsed(uint64_t a_key) const
+	{
+		// most probes are for empty cells, which the bitmap answers without touching the table
+		const size_t mask = cells.size() - 1;
+		for (size_t slot = SParticleLightClustering::GetSlot(a_key, mask); IsUsed(slot); slot = (slot + 1) & mask) {
+			if (cells[slot].key == a_key) {
+				return &cells[slot];
+			}
+		}
+		return nullptr;
+	}
+
+	void Clusterer::Grid::Insert(uint32_t a_cluster, uint64_t a_key)
+	{
+		auto& cell = FindCell(a_key);
+		lights[a_cluster].cell = a_key;
+		lights[a_cluster].next = cell.head;
+		cell.head = a_cluster;
+	}
+
+	void Clusterer::Grid::Remove(uint32_t a_cluster)
+	{
+		auto* next = &FindCell(lights[a_cluster].cell).head;
+		while (*next != a_cluster) {
+			next = &lights[*next].next;
+		}
+		*next = lights[a_cluster].next;
+	}
+
+	void Clusterer::Grid::Place(uint32_t a_cluster)
+	{
+		const auto cell = SParticleLightClustering::GetCellKey(lights[a_cluster].position, cellScale);
+		if (cell != lights[a_cluster].cell) {
+			if (lights[a_cluster].cell != NoCell) {
+				Remove(a_cluster);
+			}
+			Insert(a_cluster, cell);
+		}
+	}
+
+	template <class Input>
+	void Clusterer::Grid::Build(std::span<const Input> a_inputs, float a_threshold)
+	{
+		using namespace SParticleLightClustering;
+
+		lights.clear();
+		if (a_inputs.empty()) {
+			return;
+		}
+
+		// at most one cell per cluster and one cluster per input, so the table stays at most half full
+		const size_t cellCount = std::bit_ceil(std::max<size_t>(a_inputs.size() * 2, 64));
+		if (cells.size() < cellCount) {
+			cells.resize(cellCount);
+		}
+		used.assign(cells.size() / 64, 0);
+		cellScale = 0.5f / a_threshold;
+
+		// consecutive particles mostly belong to the same cell, so the light the previous particle joined is tried
+		// first; it is kept here, like the greedy pass kept its one light, and only written back and filed into the
+		// grid once the particles move on
+		Cluster open{};
+		uint32_t previous = None;
+		auto close = [&]() {
+			auto& light = lights[previous];
+			light.sum = open;
+			light.position = open.position / static_cast<float>(open.count);
+			light.radius = open.radius / static_cast<float>(open.count);
+			Place(previous);
+		};
+
+		for (const auto& input : a_inputs) {
+			const float3 position = GetPosition(input);
+			const float radius = GetRadius(input);
+			if (previous != None) {
+				if (CanMerge(open.position / static_cast<float>(open.count), open.radius / static_cast<float>(open.count), position, radius, a_threshold)) {
+					Add(open, input);
+					continue;
+				}
+				close();
+			}
+
+			// a light within the threshold lies in this cell or the neighbour on the side of the nearer face, per axis;
+			// the nearer neighbour is the other one of the cells half a cell down and half a cell up
+			uint32_t target = None;
+			const float3 scaled = position * cellScale;
+			const std::array<int64_t, 3> own = { FloorToInt(scaled.x), FloorToInt(scaled.y), FloorToInt(scaled.z) };
+			const std::array<int64_t, 3> lower = { FloorToInt(scaled.x - 0.5f), FloorToInt(scaled.y - 0.5f), FloorToInt(scaled.z - 0.5f) };
+			const std::array<int64_t, 3> other = { 2 * lower[0] + 1 - own[0], 2 * lower[1] + 1 - own[1], 2 * lower[2] + 1 - own[2] };
+			for (uint32_t neighbour = 0; neighbour < 8 && target == None; ++neighbour) {
+				const auto* cell = FindCellIfUsed(GetCellKey(neighbour & 1 ? other[0] : own[0], neighbour & 2 ? other[1] : own[1], neighbour & 4 ? other[2] : own[2]));
+				for (auto cluster = cell ? cell->head : None; cluster != None; cluster = lights[cluster].next) {
+					if (CanMerge(lights[cluster].position, lights[cluster].radius, position, radius, a_threshold)) {
+						target = cluster;
+						break;
+					}
+				}
+			}
+
+			if (target == None) {
+				target = static_cast<uint32_t>(lights.size());
+				lights.emplace_back();
+				open = {};
+			} else {
+				open = lights[target].sum;
+			}
+			Add(open, input);
+			previous = target;
+		}
+		if (previous != None) {
+			close();
+		}
+	}
+
+	size_t Clusterer::Partition(std::span<const Sample> a_samples, float a_threshold)
+	{
+		using namespace SParticleLightClustering;
+
+		samples = a_samples;
+		threshold = a_threshold;
+		const float cellScale = 0.5f / a_threshold;
+
+		tileIds.clear();
+		tileInfos.clear();
+		sampleTiles.resize(a_samples.size());
+		uint64_t previousKey = NoCell;
+		uint32_t previousId = None;
+		for (size_t i = 0; i < a_samples.size(); ++i) {
+			const auto cell = GetCell(a_samples[i].position, cellScale);
+			const std::array<int64_t, 3> tile = { GetTile(cell[0]), GetTile(cell[1]), GetTile(cell[2]) };
+			const uint64_t key = GetCellKey(tile[0], tile[1], tile[2]);
+			// particles of a system are gathered together and mostly share a tile
+			if (key != previousKey) {
+				auto [it, inserted] = tileIds.try_emplace(key, static_cast<uint32_t>(tileInfos.size()));
+				if (inserted) {
+					tileInfos.push_back({ key, { tile[0] * TileCells, tile[1] * TileCells, tile[2] * TileCells } });
+				}
+				previousKey = key;
+				previousId = it->second;
+			}
+			sampleTiles[i] = previousId;
+		}
+
+		// tiles in key order, so neither the output nor the work of a tile depends on which sample came first
+		const size_t tileCount = tileInfos.size();
+		tileOrder.resize(tileCount);
+		std::iota(tileOrder.begin(), tileOrder.end(), 0u);
+		std::ranges::sort(tileOrder, {}, [&](uint32_t a_id) { return tileInfos[a_id].key; });
+		tileRanks.resize(tileCount);
+		for (uint32_t rank = 0; rank < tileCount; ++rank) {
+			tileRanks[tileOrder[rank]] = rank;
+		}
+
+		// counting sort of the samples by tile
+		tiles.resize(tileCount);
+		for (uint32_t rank = 0; rank < tileCount; ++rank) {
+			tiles[rank].origin = tileInfos[tileOrder[rank]].origin;
+			tiles[rank].begin = 0;
+			tiles[rank].end = 0;
+		}
+		for (auto& tile : sampleTiles) {
+			tile = tileRanks[tile];
+			tiles[tile].end++;
+		}
+		uint32_t offset = 0;
+		for (auto& tile : tiles) {
+			tile.begin = offset;
+			offset += tile.end;
+			tile.end = tile.begin;
+		}
+		sampleIndices.resize(a_samples.size());
+		for (uint32_t i = 0; i < a_samples.size(); ++i) {
+			sampleIndices[tiles[sampleTiles[i]].end++] = i;
+		}
+		return tileCount;
+	}
+
+	void Clusterer::BuildTile(size_t a_tile)
+	{
+		using namespace SParticleLightClustering;
+
+		auto& tile = tiles[a_tile];
+		const float cellScale = 0.5f / threshold;
+
+		// canonical order: by cell within the tile, then by the sample's bits
+		tile.order.clear();
+		for (uint32_t i = tile.begin; i < tile.end; ++i) {
+			const auto& sample = samples[sampleIndices[i]];
+			const auto cell = GetCell(sample.position, cellScale);
+			const auto local = static_cast<uint64_t>(((cell[2] - tile.origin[2]) * TileCells + cell[1] - tile.origin[1]) * TileCells + cell[0] - tile.origin[0]);
+			tile.order.emplace_back(local << 32 | GetOrderedBits(sample.position.x), sampleIndices[i]);
+		}
+		std::ranges::sort(tile.order, [&](const auto& a_lhs, const auto& a_rhs) {
+			return a_lhs.first != a_rhs.first ? a_lhs.first < a_rhs.first : IsCanonicallyBefore(samples[a_lhs.second], samples[a_rhs.second]);
+		});
+
+		tile.samples.clear();
+		for (const auto& [key, index] : tile.order) {
+			tile.samples.push_back(samples[index]);
+		}
+		tile.grid.Build(std::span<const Sample>(tile.samples), threshold);
+	}
+
+	void Clusterer::Finish(std::vector<Cluster>& o_clusters)
+	{
+		// a light can only pass the test with something across a face it is within the threshold of, which is half
+		// a cell; the margin is a little wider so rounding of the scaled average never leaves one out
+		constexpr float FaceMargin = 0.5f + 1.0f / 64.0f;
+		const float cellScale = 0.5f / threshold;
+
+		o_clusters.clear();
+		borderLights.clear();
+		for (const auto& tile : tiles) {
+			for (const auto& light : tile.grid.lights) {
+				const float3 local = { light.position.x * cellScale - static_cast<float>(tile.origin[0]), light.position.y * cellScale - static_cast<float>(tile.origin[1]),
+					light.position.z * cellScale - static_cast<float>(tile.origin[2]) };
+				auto nearFace = [](float a_offset) { return a_offset <= FaceMargin || a_offset >= TileCells - FaceMargin; };
+				if (nearFace(local.x) || nearFace(local.y) || nearFace(local.z)) {
+					borderLights.push_back(light.sum);
+				} else {
+					o_clusters.push_back({ light.position, light.radius, light.sum.color, light.sum.count });
+				}
+			}
+		}
+
+		border.Build(std::span<const Cluster>(borderLights), threshold);
+		for (const auto& light : border.lights) {
+			o_clusters.push_back({ light.position, light.radius, light.sum.color, light.sum.count });
+		}
+		samples = {};
+	}
+
+	void Clusterer::Build(std::span<const Sample> a_samples, float a_threshold, std::vector<Cluster>& o_clusters)
+	{
+		const size_t tileCount = Partition(a_samples, a_threshold);
+		for (size_t tile = 0; tile < tileCount; ++tile) {
+			BuildTile(tile);
+		}
+		Finish(o_clusters);
+	}
+
+	bool SaveSamples(const std::filesystem::path& a_path, std::span<const Sample> a_samples)
+	{
+		std::error_code ec;
+		std::filesystem::create_directories(a_path.parent_path(), ec);
+		std::ofstream out(a_path, std::ios::binary | std::ios::trunc);
+		const std::array<uint32_t, 2> header = { SParticleLightClustering::SamplesMagic, static_cast<uint32_t>(a_samples.size()) };
+		out.write(reinterpret_cast<const char*>(header.data()), sizeof(header));
+		out.write(reinterpret_cast<const char*>(a_samples.data()), a_samples.size_bytes());
+		return static_cast<bool>(out);
+	}
+
+	bool LoadSamples(const std::filesystem::path& a_path, std::vector<Sample>& o_samples)
+	{
+		std::ifstream in(a_path, std::ios::binary);
+		std::array<uint32_t, 2> header{};
+		if (!in.read(reinterpret_cast<char*>(header.data()), sizeof(header)) || header[0] != SParticleLightClustering::SamplesMagic) {
+			return false;
+		}
+		o_samples.resize(header[1]);
+		return static_cast<bool>(in.read(reinterpret_cast<char*>(o_samples.data()), o_samples.size() * sizeof(Sample)));
+	}
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+/**
+ * Merges nearby particles of similar size into single lights.
+ *
+ * Space is split into tiles of TileCells cells per axis, which are clustered independently, so the
+ * tiles of a frame can be built on any threads. Within a tile, particles are visited in a canonical
+ * order, by cell and then by their bits, so the output only depends on the set of samples, never
+ * on the order the particle systems were gathered in or on scheduling.
+ *
+ * A particle first tries the light the previous particle joined, then every light whose average
+ * position lies in a neighbouring cell, and joins the first one whose average position and radius
+ * are within the threshold, the same test the old greedy pass used; otherwise it starts a new light.
+ * Cells are twice the threshold wide, so the eight cells nearest a particle hold every light it
+ * could join, and they are searched in a fixed order. Only lights whose average lies within the
+ * threshold of a tile face can pass the test with anything across it; those are clustered once more,
+ * in tile order and with the same test, which joins lights a tile border split.
+ *
+ * Lights keep the average position and radius and the summed color of their particles.
+ */
+namespace ParticleLightClustering
+{
+	struct Sample
+	{
+		float3 position;  // relative to the first eye
+		float radius;
+		float3 color;
+	};
+
+	struct Cluster
+	{
+		float3 position;
+		float radius;
+		float3 color;
+		uint32_t count;
+	};
+
+	/**
+	 * Clusters samples, keeping its buffers between calls so a frame allocates nothing once warm.
+	 *
+	 * Partition() buckets the samples into tiles, BuildTile() clusters one tile and may run for
+	 * different tiles on different threads at once, and Finish() joins the tiles; Build() runs all
+	 * three on the calling thread. The output is the same either way.
+	 */
+	class Clusterer
+	{
+	public:
+		static constexpr int64_t TileCells = 16;
+
+		/**
+		 * @brief Buckets samples into tiles; a_samples must stay alive until Finish().
+		 * @param a_threshold Maximum distance plus radius difference between a sample and its light.
+		 * @return Number of tiles to build.
+		 */
+		size_t Partition(std::span<const Sample> a_samples, float a_threshold);
+		void BuildTile(size_t a_tile);
+
+		/**
+		 * @brief Joins lights across tile borders; clusters are returned by tile, border lights last.
+		 */
+		void Finish(std::vector<Cluster>& o_clusters);
+
+		void Build(std::span<const Sample> a_samples, float a_threshold, std::vector<Cluster>& o_clusters);
+
+	private:
+		static constexpr uint32_t None = UINT32_MAX;
+		static constexpr uint64_t NoCell = UINT64_MAX;  // cell keys use 63 bits
+
+		struct Cell
+		{
+			uint64_t key;
+			uint32_t head;  // first cluster whose average lies in the cell, or None
+		};
+
+		struct Light
+		{
+			Cluster sum;
+			float3 position;  // average of the samples
+			float radius;     // average of the samples
+			uint64_t cell = NoCell;  // cell the light is filed under, or NoCell before it first is
+			uint32_t next = None;    // next cluster in the same cell, or None
+		};
+
+		// one clustering pass over samples, or over lights for the border pass
+		struct Grid
+		{
+			template <class Input>
+			void Build(std::span<const Input> a_inputs, float a_threshold);
+
+			bool IsUsed(size_t a_slot) const;
+			Cell& FindCell(uint64_t a_key);
+			const Cell* FindCellIfUsed(uint64_t a_key) const;
+			void Insert(uint32_t a_cluster, uint64_t a_key);
+			void Remove(uint32_t a_cluster);
+			void Place(uint32_t a_cluster);  // files the light under the cell of its average
+
+			float cellScale = 1.0f;
+			std::vector<Cell> cells;      // open addressing, power of two sized
+			std::vector<uint64_t> used;  // one bit per slot of cells, cleared every build
+			std::vector<Light> lights;
+		};
+
+		struct Tile
+		{
+			std::array<int64_t, 3> origin;  // first cell of the tile
+			uint32_t begin;                 // range of the tile in sampleIndices
+			uint32_t end;
+			std::vector<std::pair<uint64_t, uint32_t>> order;  // canonical order key and sample index
+			std::vector<Sample> samples;                       // the tile's samples in canonical order
+			Grid grid;
+		};
+
+		struct TileInfo
+		{
+			uint64_t key;
+			std::array<int64_t, 3> origin;
+		};
+
+		std::span<const Sample> samples;
+		float threshold = 1.0f;
+		ankerl::unordered_dense::map<uint64_t, uint32_t> tileIds;  // tile key to id by first appearance
+		std::vector<TileInfo> tileInfos;                          // by id
+		std::vector<uint32_t> tileOrder;                          // ids in key order
+		std::vector<uint32_t> tileRanks;                          // position of every id in key order
+		std::vector<uint32_t> sampleTiles;                        // tile of every sample
+		std::vector<uint32_t> sampleIndices;                      // samples grouped by tile, tiles in key order
+		std::vector<Tile> tiles;                                  // in key order
+		std::vector<Cluster> borderLights;
+		Grid border;
+	};
+
+	/**
+	 * @brief Saves samples for the clustering benchmark.
+	 */
+	bool SaveSamples(const std::filesystem::path& a_path, std::span<const Sample> a_samples);
+	bool LoadSamples(const std::filesystem::path& a_path, std::vector<Sample>& o_samples);
+}
@@ -0,0 +1,66 @@
+#include "Features/LightLimitFix/ParticleLightGrid.h"
+
+ParticleLightGrid::ParticleLightGrid(std::span<const Light> a_lights) :
+	lights(a_lights.begin(), a_lights.end())
+{
+	// about two buckets per light keeps collisions between unrelated cells rare
+	const auto bucketCount = std::bit_ceil(std::max<size_t>(lights.size() * 2, 1));
+	bucketMask = static_cast<uint32_t>(bucketCount - 1);
+
+	std::vector<std::pair<uint32_t, uint32_t>> entries;  // bucket, light
+	entries.reserve(lights.size() * 2);
+	std::vector<uint32_t> buckets;
+	for (uint32_t lightIndex = 0; lightIndex < lights.size(); ++lightIndex) {
+		const auto& light = lights[lightIndex];
+		const std::array<float, 3> position{ light.position.x, light.position.y, light.position.z };
+
+		std::array<int32_t, 3> minCell{};
+		std::array<int32_t, 3> maxCell{};
+		float cellCount = 1.0f;
+		for (size_t axis = 0; axis < 3; ++axis) {
+			const float minCellF = std::floor((position[axis] - light.radius) / CellSize);
+			const float maxCellF = std::floor((position[axis] + light.radius) / CellSize);
+			cellCount *= maxCellF - minCellF + 1.0f;
+			minCell[axis] = static_cast<int32_t>(minCellF);
+			maxCell[axis] = static_cast<int32_t>(maxCellF);
+		}
+		// also catches non-finite positions and radii
+		if (!(cellCount <= static_cast<float>(MaxCellsPerLight))) {
+			largeLights.push_back(lightIndex);
+			continue;
+		}
+
+		// distinct cells of one light can share a bucket, it must only be listed there once
+		buckets.clear();
+		for (int32_t z = minCell[2]; z <= maxCell[2]; ++z) {
+			for (int32_t y = minCell[1]; y <= maxCell[1]; ++y) {
+				for (int32_t x = minCell[0]; x <= maxCell[0]; ++x) {
+					buckets.push_back(GetBucket(x, y, z));
+				}
+			}
+		}
+		std::ranges::sort(buckets);
+		buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+		for (const auto bucket : buckets) {
+			entries.emplace_back(bucket, lightIndex);
+		}
+	}
+
+	// counting sort, stable so lights stay in ascending order within a bucket
+	bucketStarts.assign(bucketCount + 1, 0);
+	for (const auto& [bucket, lightIndex] : entries) {
+		++bucketStarts[bucket + 1];
+	}
+	std::partial_sum(bucketStarts.begin(), bucketStarts.end(), bucketStarts.begin());
+	bucketLights.resize(entries.size());
+	auto offsets = bucketStarts;
+	for (const auto& [bucket, lightIndex] : entries) {
+		bucketLights[offsets[bucket]++] = lightIndex;
+	}
+}
+
+uint32_t ParticleLightGrid::GetBucket(int32_t a_x, int32_t a_y, int32_t a_z) const
+{
+	const uint32_t hash = (static_cast<uint32_t>(a_x) * 73856093u) ^ (static_cast<uint32_t>(a_y) * 19349663u) ^ (static_cast<uint32_t>(a_z) * 83492791u);
+	return hash & bucketMask;
+}
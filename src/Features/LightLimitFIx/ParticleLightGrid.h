@@ -0,0 +1,59 @@
+#pragma once
+
+/**
+ * Immutable snapshot of the particle lights of a frame, bucketed by a hashed uniform grid.
+ *
+ * UpdateLights builds one per frame and publishes it; AI threads evaluating light levels query
+ * whichever snapshot is current without locking. A point only visits the lights whose bounds
+ * overlap its cell, plus lights too large to bucket, in the order they were added so luminance
+ * sums match a linear scan exactly.
+ */
+class ParticleLightGrid
+{
+public:
+	struct Light
+	{
+		float grey;
+		RE::NiPoint3 position;
+		float radius;
+	};
+
+	static constexpr float CellSize = 1024.0f;        // particle lights rarely reach past one neighbouring cell
+	static constexpr uint32_t MaxCellsPerLight = 64;  // lights covering more cells are visited by every query
+
+	explicit ParticleLightGrid(std::span<const Light> a_lights);
+
+	/**
+	 * @brief Calls a_func for every light that can reach a_point, in the order the lights were added.
+	 */
+	template <class F>
+	void ForEachLight(const RE::NiPoint3& a_point, F&& a_func) const
+	{
+		if (lights.empty()) {
+			return;
+		}
+		const auto bucket = GetBucket(GetCell(a_point.x), GetCell(a_point.y), GetCell(a_point.z));
+		auto cellLight = bucketLights.begin() + bucketStarts[bucket];
+		const auto cellEnd = bucketLights.begin() + bucketStarts[bucket + 1];
+		auto largeLight = largeLights.begin();
+		while (cellLight != cellEnd || largeLight != largeLights.end()) {
+			if (largeLight == largeLights.end() || (cellLight != cellEnd && *cellLight < *largeLight)) {
+				a_func(lights[*cellLight++]);
+			} else {
+				a_func(lights[*largeLight++]);
+			}
+		}
+	}
+
+	size_t GetLightCount() const { return lights.size(); }
+
+private:
+	static int32_t GetCell(float a_coordinate) { return static_cast<int32_t>(std::floor(a_coordinate / CellSize)); }
+	uint32_t GetBucket(int32_t a_x, int32_t a_y, int32_t a_z) const;
+
+	std::vector<Light> lights;
+	uint32_t bucketMask = 0;
+	std::vector<uint32_t> bucketStarts;  // offsets into bucketLights, one past the last bucket included
+	std::vector<uint32_t> bucketLights;  // light indices, ascending within a bucket
+	std::vector<uint32_t> largeLights;   // ascending
+};
@@ -1,136 +1,376 @@
 #include "Features/LightLimitFix/ParticleLights.h"
 
+#include <charconv>
+#include <execution>
 #include <numbers>
 
-void ParticleLights::GetConfigs()
+namespace SParticleLights
 {
-	if (std::filesystem::exists("Data\\ParticleLights")) {
-		logger::info("[LLF] Loading particle lights configs");
+	constexpr uint32_t Magic = 0x4C504C43;  // "CLPL"
+	constexpr uint32_t FormatVersion = 1;
 
-		auto configs = clib_util::distribution::get_configs("Data\\ParticleLights", "", ".ini");
+	// Path, size and modification time of every ini; a snapshot is reused only when all of them match
+	struct FileStamp
+	{
+		std::string path;
+		uint64_t size = 0;
+		int64_t writeTime = 0;
 
-		if (configs.empty()) {
-			logger::warn("[LLF] No .ini files were found within the Data\\ParticleLights folder, aborting...");
-			return;
+		bool operator==(const FileStamp&) const = default;
+	};
+
+	template <class T>
+	struct ParseResult
+	{
+		std::optional<T> data;
+		std::string error;
+	};
+
+	static std::vector<FileStamp> GetFileStamps(const std::vector<std::string>& a_paths)
+	{
+		std::vector<FileStamp> stamps(a_paths.size());
+		std::for_each(std::execution::par, stamps.begin(), stamps.end(), [&](FileStamp& a_stamp) {
+			const auto& path = a_paths[&a_stamp - stamps.data()];
+			std::error_code ec;
+			a_stamp.path = path;
+			a_stamp.size = std::filesystem::file_size(path, ec);
+			a_stamp.writeTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+		});
+		return stamps;
+	}
+
+	// Lowercase file name without ".ini", empty if the path has none
+	static std::string GetStem(const std::string& a_path, std::string& o_error)
+	{
+		auto lastSeparatorPos = a_path.find_last_of("\\/");
+		if (lastSeparatorPos == std::string::npos) {
+			o_error = "Path incomplete";
+			return {};
 		}
 
-		logger::info("[LLF] {} matching inis found", configs.size());
+		std::string filename = a_path.substr(lastSeparatorPos + 1);
+		if (filename.size() < 4) {
+			o_error = "Path too short";
+			return {};
+		}
 
-		for (auto& path : configs) {
-			logger::info("[LLF] loading ini : {}", path);
+		filename.erase(filename.length() - 4);  // Remove ".ini"
+		std::transform(filename.begin(), filename.end(), filename.begin(), [](auto c) { return (char)::tolower(c); });
+		return filename;
+	}
 
-			CSimpleIniA ini;
-			ini.SetUnicode();
-			ini.SetMultiKey();
+	static ParseResult<ParticleLights::Config> ParseConfig(const std::string& a_path)
+	{
+		ParseResult<ParticleLights::Config> result;
 
-			if (const auto rc = ini.LoadFile(path.c_str()); rc < 0) {
-				logger::error("\t\t[LLF] couldn't read INI");
-				continue;
-			}
+		CSimpleIniA ini;
+		ini.SetUnicode();
+		ini.SetMultiKey();
 
-			Config data{};
-			particleLightConfigs.insert({ "default", data });
+		if (const auto rc = ini.LoadFile(a_path.c_str()); rc < 0) {
+			result.error = "couldn't read INI";
+			return result;
+		}
+
+		ParticleLights::Config data{};
+		data.cull = ini.GetBoolValue("Light", "Cull", false);
+		data.colorMult.red = (float)ini.GetDoubleValue("Light", "ColorMultRed", 1.0);
+		data.colorMult.green = (float)ini.GetDoubleValue("Light", "ColorMultGreen", 1.0);
+		data.colorMult.blue = (float)ini.GetDoubleValue("Light", "ColorMultBlue", 1.0);
+		data.radiusMult = (float)ini.GetDoubleValue("Light", "RadiusMult", 1.0);
+		data.saturationMult = (float)ini.GetDoubleValue("Light", "SaturationMult", 1.0);
+		result.data = data;
+		return result;
+	}
 
-			data.cull = ini.GetBoolValue("Light", "Cull", false);
-			data.colorMult.red = (float)ini.GetDoubleValue("Light", "ColorMultRed", 1.0);
-			data.colorMult.green = (float)ini.GetDoubleValue("Light", "ColorMultGreen", 1.0);
-			data.colorMult.blue = (float)ini.GetDoubleValue("Light", "ColorMultBlue", 1.0);
-			data.radiusMult = (float)ini.GetDoubleValue("Light", "RadiusMult", 1.0);
-			data.saturationMult = (float)ini.GetDoubleValue("Light", "SaturationMult", 1.0);
+	static ParseResult<ParticleLights::GradientConfig> ParseGradientConfig(const std::string& a_path)
+	{
+		ParseResult<ParticleLights::GradientConfig> result;
 
-			auto lastSeparatorPos = path.find_last_of("\\/");
-			if (lastSeparatorPos != std::string::npos) {
-				std::string filename = path.substr(lastSeparatorPos + 1);
-				if (filename.size() < 4) {
-					logger::error("[LLF] Path too short");
-					continue;
-				}
+		CSimpleIniA ini;
+		ini.SetUnicode();
+		ini.SetMultiKey();
 
-				filename.erase(filename.length() - 4);  // Remove ".ini"
-				std::transform(filename.begin(), filename.end(), filename.begin(), [](auto c) { return (char)::tolower(c); });
+		if (const auto rc = ini.LoadFile(a_path.c_str()); rc < 0) {
+			result.error = "couldn't read INI";
+			return result;
+		}
 
-				logger::debug("[LLF] Inserting {}", filename);
+		constexpr std::string_view prefix1 = "0x";
+		constexpr std::string_view prefix2 = "#";
 
-				particleLightConfigs.insert({ filename, data });
-			} else {
-				logger::error("[LLF] Path incomplete");
-			}
+		const char* value = ini.GetValue("Gradient", "Color");
+		if (!value || strcmp(value, "") == 0) {
+			result.error = "missing color";
+			return result;
 		}
-	}
 
-	if (std::filesystem::exists("Data\\ParticleLights\\Gradients")) {
-		logger::info("[LLF] Loading particle lights gradients configs");
+		std::string_view str = value;
 
-		auto configs = clib_util::distribution::get_configs("Data\\ParticleLights\\Gradients", "", ".ini");
+		if (str.starts_with(prefix1)) {
+			str.remove_prefix(prefix1.size());
+		}
 
-		if (configs.empty()) {
-			logger::warn("[LLF] No .ini files were found within the Data\\ParticleLights\\Gradients folder, aborting...");
-			return;
+		if (str.starts_with(prefix2)) {
+			str.remove_prefix(prefix2.size());
 		}
 
-		logger::info("[LLF] {} matching inis found", configs.size());
+		uint32_t color = 0;
+		auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), color, 16);
+		if (str.empty() || ec != std::errc() || end != str.data() + str.size()) {
+			result.error = "invalid color";
+			return result;
+		}
 
-		for (auto& path : configs) {
-			logger::info("[LLF] loading ini : {}", path);
+		ParticleLights::GradientConfig data{};
+		data.color = color;
+		result.data = data;
+		return result;
+	}
 
-			CSimpleIniA ini;
-			ini.SetUnicode();
-			ini.SetMultiKey();
+	// Parses every file in parallel, then inserts them in path order so the first of duplicate stems wins as before
+	template <class T, class Map>
+	static void LoadConfigs(const std::vector<std::string>& a_paths, ParseResult<T> (*a_parse)(const std::string&), Map& o_configs)
+	{
+		std::vector<ParseResult<T>> results(a_paths.size());
+		std::for_each(std::execution::par, results.begin(), results.end(), [&](ParseResult<T>& a_result) {
+			a_result = a_parse(a_paths[&a_result - results.data()]);
+		});
 
-			if (const auto rc = ini.LoadFile(path.c_str()); rc < 0) {
-				logger::error("\t\t[LLF] couldn't read INI");
+		for (size_t i = 0; i < a_paths.size(); i++) {
+			logger::debug("[LLF] loading ini : {}", a_paths[i]);
+			auto& result = results[i];
+			if (!result.data) {
+				logger::error("[LLF] {} : {}", a_paths[i], result.error);
 				continue;
 			}
 
-			GradientConfig data{};
-			const char* value = nullptr;
-			constexpr std::string_view prefix1 = "0x";
-			constexpr std::string_view prefix2 = "#";
-			constexpr std::string_view cset = "0123456789ABCDEFabcdef";
-
-			value = ini.GetValue("Gradient", "Color");
-			if (value && strcmp(value, "") != 0) {
-				std::string_view str = value;
-
-				if (str.starts_with(prefix1)) {
-					str.remove_prefix(prefix1.size());
-				}
-
-				if (str.starts_with(prefix2)) {
-					str.remove_prefix(prefix2.size());
-				}
-
-				bool matches = std::strspn(str.data(), cset.data()) == str.size();
-
-				if (matches) {
-					uint32_t color = std::stoi(str.data(), 0, 16);
-					data.color = color;
-				} else {
-					logger::error("[LLF] invalid color");
-					continue;
-				}
-			} else {
-				logger::error("[LLF] missing color");
+			auto filename = GetStem(a_paths[i], result.error);
+			if (filename.empty()) {
+				logger::error("[LLF] {} : {}", a_paths[i], result.error);
 				continue;
 			}
 
-			auto lastSeparatorPos = path.find_last_of("\\/");
-			if (lastSeparatorPos != std::string::npos) {
-				std::string filename = path.substr(lastSeparatorPos + 1);
-				if (filename.size() < 4) {
-					logger::error("[LLF] Path too short");
-					continue;
-				}
+			logger::debug("[LLF] Inserting {}", filename);
+			o_configs.insert({ filename, *result.data });
+		}
+	}
+
+	struct Writer
+	{
+		std::string data;
+
+		template <class T>
+		void Write(const T& a_value)
+		{
+			data.append(reinterpret_cast<const char*>(&a_value), sizeof(T));
+		}
+
+		void WriteString(std::string_view a_value)
+		{
+			Write(static_cast<uint16_t>(a_value.size()));
+			data.append(a_value);
+		}
+	};
 
-				filename.erase(filename.length() - 4);  // Remove ".ini"
-				std::transform(filename.begin(), filename.end(), filename.begin(), [](auto c) { return (char)::tolower(c); });
+	struct Reader
+	{
+		const std::vector<uint8_t>& data;
+		size_t offset = 0;
 
-				logger::debug("[LLF] Inserting {}", filename);
+		template <class T>
+		bool Read(T& o_value)
+		{
+			if (offset + sizeof(T) > data.size()) {
+				return false;
+			}
+			memcpy(&o_value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+
+		bool ReadString(std::string& o_value)
+		{
+			uint16_t size = 0;
+			if (!Read(size) || offset + size > data.size()) {
+				return false;
+			}
+			o_value.assign(reinterpret_cast<const char*>(data.data() + offset), size);
+			offset += size;
+			return true;
+		}
+	};
 
-				particleLightGradientConfigs.insert({ filename, data });
-			} else {
-				logger::error("[LLF] Path incomplete");
+	static void WriteStamps(Writer& a_writer, const std::vector<FileStamp>& a_stamps)
+	{
+		a_writer.Write((uint32_t)a_stamps.size());
+		for (const auto& stamp : a_stamps) {
+			a_writer.WriteString(stamp.path);
+			a_writer.Write(stamp.size);
+			a_writer.Write(stamp.writeTime);
+		}
+	}
+
+	static bool ReadStamps(Reader& a_reader, std::vector<FileStamp>& o_stamps)
+	{
+		uint32_t count = 0;
+		if (!a_reader.Read(count) || count > a_reader.data.size()) {
+			return false;
+		}
+		o_stamps.resize(count);
+		for (auto& stamp : o_stamps) {
+			if (!a_reader.ReadString(stamp.path) || !a_reader.Read(stamp.size) || !a_reader.Read(stamp.writeTime)) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	template <class Map>
+	static void WriteConfigs(Writer& a_writer, const Map& a_configs)
+	{
+		a_writer.Write((uint32_t)a_configs.size());
+		for (const auto& [stem, config] : a_configs) {
+			a_writer.WriteString(stem);
+			a_writer.Write(config);
+		}
+	}
+
+	template <class Map>
+	static bool ReadConfigs(Reader& a_reader, Map& o_configs)
+	{
+		uint32_t count = 0;
+		if (!a_reader.Read(count) || count > a_reader.data.size()) {
+			return false;
+		}
+		o_configs.reserve(count);
+		for (uint32_t i = 0; i < count; i++) {
+			std::string stem;
+			typename Map::mapped_type config{};
+			if (!a_reader.ReadString(stem) || !a_reader.Read(config)) {
+				return false;
 			}
+			o_configs.insert({ std::move(stem), config });
 		}
+		return true;
 	}
+
+	static std::vector<uint8_t> ReadFile(const std::filesystem::path& a_path)
+	{
+		std::vector<uint8_t> data;
+		std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return data;
+		}
+		data.resize((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(reinterpret_cast<char*>(data.data()), data.size());
+		return data;
+	}
+}
+
+bool ParticleLights::LoadSnapshot(const std::vector<std::string>& a_configPaths, const std::vector<std::string>& a_gradientPaths)
+{
+	const auto data = SParticleLights::ReadFile(SnapshotPath);
+	if (data.empty()) {
+		return false;
+	}
+
+	SParticleLights::Reader reader{ data };
+	uint32_t magic = 0, version = 0;
+	std::vector<SParticleLights::FileStamp> configStamps, gradientStamps;
+	if (!reader.Read(magic) || !reader.Read(version) || magic != SParticleLights::Magic || version != SParticleLights::FormatVersion ||
+		!SParticleLights::ReadStamps(reader, configStamps) || !SParticleLights::ReadStamps(reader, gradientStamps)) {
+		return false;
+	}
+
+	if (configStamps != SParticleLights::GetFileStamps(a_configPaths) || gradientStamps != SParticleLights::GetFileStamps(a_gradientPaths)) {
+		return false;
+	}
+
+	decltype(particleLightConfigs) configs;
+	decltype(particleLightGradientConfigs) gradientConfigs;
+	if (!SParticleLights::ReadConfigs(reader, configs) || !SParticleLights::ReadConfigs(reader, gradientConfigs)) {
+		logger::warn("[LLF] Particle lights snapshot {} is unreadable", SnapshotPath);
+		return false;
+	}
+
+	particleLightConfigs = std::move(configs);
+	particleLightGradientConfigs = std::move(gradientConfigs);
+	return true;
+}
+
+void ParticleLights::SaveSnapshot(const std::vector<std::string>& a_configPaths, const std::vector<std::string>& a_gradientPaths) const
+{
+	SParticleLights::Writer writer;
+	writer.Write(SParticleLights::Magic);
+	writer.Write(SParticleLights::FormatVersion);
+	SParticleLights::WriteStamps(writer, SParticleLights::GetFileStamps(a_configPaths));
+	SParticleLights::WriteStamps(writer, SParticleLights::GetFileStamps(a_gradientPaths));
+	SParticleLights::WriteConfigs(writer, particleLightConfigs);
+	SParticleLights::WriteConfigs(writer, particleLightGradientConfigs);
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(SnapshotPath).parent_path(), ec);
+	std::ofstream out(SnapshotPath, std::ios::binary | std::ios::trunc);
+	out.write(writer.data.data(), writer.data.size());
+	if (!out) {
+		logger::warn("[LLF] Failed to write particle lights snapshot {}", SnapshotPath);
+	}
+}
+
+void ParticleLights::GetConfigs()
+{
+	std::vector<std::string> configPaths;
+	std::vector<std::string> gradientPaths;
+
+	if (std::filesystem::exists("Data\\ParticleLights")) {
+		configPaths = clib_util::distribution::get_configs("Data\\ParticleLights", "", ".ini");
+		if (configPaths.empty()) {
+			logger::warn("[LLF] No .ini files were found within the Data\\ParticleLights folder, aborting...");
+			return;
+		}
+	}
+
+	if (std::filesystem::exists("Data\\ParticleLights\\Gradients")) {
+		gradientPaths = clib_util::distribution::get_configs("Data\\ParticleLights\\Gradients", "", ".ini");
+		if (gradientPaths.empty()) {
+			logger::warn("[LLF] No .ini files were found within the Data\\ParticleLights\\Gradients folder");
+		}
+	}
+
+	if (configPaths.empty() && gradientPaths.empty()) {
+		return;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (LoadSnapshot(configPaths, gradientPaths)) {
+		logger::info("[LLF] Loaded {} particle lights and {} gradients from {} ({} ms)", particleLightConfigs.size(), particleLightGradientConfigs.size(),
+			SnapshotPath, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+		return;
+	}
+
+	// Built aside and swapped in, so a reload does not mix old and new configs
+	decltype(particleLightConfigs) configs;
+	decltype(particleLightGradientConfigs) gradientConfigs;
+
+	if (!configPaths.empty()) {
+		logger::info("[LLF] Loading particle lights configs, {} matching inis found", configPaths.size());
+		configs.insert({ "default", Config{} });
+		SParticleLights::LoadConfigs(configPaths, &SParticleLights::ParseConfig, configs);
+	}
+
+	if (!gradientPaths.empty()) {
+		logger::info("[LLF] Loading particle lights gradients configs, {} matching inis found", gradientPaths.size());
+		SParticleLights::LoadConfigs(gradientPaths, &SParticleLights::ParseGradientConfig, gradientConfigs);
+	}
+
+	particleLightConfigs = std::move(configs);
+	particleLightGradientConfigs = std::move(gradientConfigs);
+
+	logger::info("[LLF] Loaded {} particle lights and {} gradients ({} ms)", particleLightConfigs.size(), particleLightGradientConfigs.size(),
+		std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+	SaveSnapshot(configPaths, gradientPaths);
 }
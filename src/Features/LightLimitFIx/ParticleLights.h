@@ -22,8 +22,41 @@ public:
 		RE::NiColor color;
 	};
 
-	ankerl::unordered_dense::map<std::string, Config> particleLightConfigs;
-	ankerl::unordered_dense::map<std::string, GradientConfig> particleLightGradientConfigs;
+	// Stems are stored lowercase and looked up case-insensitively by string_view, so no lowercase copy is made per lookup
+	struct StemHash
+	{
+		using is_transparent = void;
+
+		uint64_t operator()(std::string_view a_stem) const noexcept
+		{
+			uint64_t hash = 14695981039346656037ull;  // FNV-1a
+			for (const auto c : a_stem) {
+				hash = (hash ^ static_cast<uint8_t>(::tolower(static_cast<uint8_t>(c)))) * 1099511628211ull;
+			}
+			return hash;
+		}
+	};
+
+	struct StemEqual
+	{
+		using is_transparent = void;
+
+		bool operator()(std::string_view a_lhs, std::string_view a_rhs) const noexcept
+		{
+			return std::ranges::equal(a_lhs, a_rhs, [](char a, char b) { return ::tolower(static_cast<uint8_t>(a)) == ::tolower(static_cast<uint8_t>(b)); });
+		}
+	};
+
+	// replaced by GetConfigs, entries keep their address until the next reload
+	ankerl::unordered_dense::map<std::string, Config, StemHash, StemEqual> particleLightConfigs;
+	ankerl::unordered_dense::map<std::string, GradientConfig, StemHash, StemEqual> particleLightGradientConfigs;
+
+	// parsed configs, reused while the ini files keep their names, sizes and modification times
+	static constexpr const char* SnapshotPath = "Data\\SKSE\\Plugins\\CommunityShaders\\ParticleLights.bin";
 
 	void GetConfigs();
+
+private:
+	bool LoadSnapshot(const std::vector<std::string>& a_configPaths, const std::vector<std::string>& a_gradientPaths);
+	void SaveSnapshot(const std::vector<std::string>& a_configPaths, const std::vector<std::string>& a_gradientPaths) const;
 };
\ No newline at end of file
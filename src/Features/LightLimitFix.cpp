@@ -6,6 +6,8 @@
 #include "VariableCache.h"
 
 static constexpr uint CLUSTER_MAX_LIGHTS = 256;
+static constexpr uint CLUSTER_TILE_SIZE = 64;  // pixels
+static constexpr uint CLUSTER_SLICES = 32;
 static constexpr uint MAX_LIGHTS = 1024;
 
 NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
@@ -107,6 +109,53 @@ void LightLimitFix::DrawSettings()
 	if (ImGui::TreeNodeEx("Statistics", ImGuiTreeNodeFlags_DefaultOpen)) {
 		ImGui::Text(std::format("Clustered Light Count : {}", lightCount).c_str());
 		ImGui::Text(std::format("Particle Lights Count : {}", currentParticleLights.size()).c_str());
+		ImGui::Text(std::format("Geometry Room Cache : {} hits, {} misses", strictLightStatisticsPrevious.roomHits, strictLightStatisticsPrevious.roomMisses).c_str());
+		ImGui::Text(std::format("Strict Light Uploads : {}, {} skipped", strictLightStatisticsPrevious.uploads, strictLightStatisticsPrevious.skippedUploads).c_str());
+
+		if (ImGui::Button("Record Particle Lights")) {
+			recordParticleSamples = true;
+		}
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text("Saves the particle lights of the next frame to Data\\SKSE\\Plugins\\CommunityShaders\\ParticleLights for the clustering benchmark.");
+		}
+
+		if (ImGui::TreeNode("Cluster Analysis")) {
+			ImGui::TextWrapped("Runs cluster building and light culling on the CPU for the lights of the next frame.");
+			ImGui::SliderInt("Tile Size", &clusterAnalysis.tileSize, 16, 256);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text(std::format("Width and height of a cluster in pixels. In use: {}.", CLUSTER_TILE_SIZE).c_str());
+			}
+			ImGui::SliderInt("Depth Slices", &clusterAnalysis.slices, 1, 64);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text(std::format("In use: {}.", CLUSTER_SLICES).c_str());
+			}
+			ImGui::SliderInt("Max Lights Per Cluster", &clusterAnalysis.maxClusterLights, 1, 1024);
+			if (auto _tt = Util::HoverTooltipWrapper()) {
+				ImGui::Text(std::format("Lights past this are dropped from the cluster. In use: {}.", CLUSTER_MAX_LIGHTS).c_str());
+			}
+			if (ImGui::Button("Analyze")) {
+				clusterAnalysis.requested = true;
+			}
+
+			if (const auto& statistics = clusterAnalysis.statistics) {
+				ImGui::Text(std::format("Clusters : {} ({} empty)", statistics->clusterCount, statistics->emptyClusters).c_str());
+				ImGui::Text(std::format("Lights : {}", statistics->lightCount).c_str());
+				ImGui::Text(std::format("Lights Per Cluster : {:.2f} average, {} max", statistics->averageClusterLights, statistics->maxClusterLights).c_str());
+				ImGui::Text(std::format("Overflowed Clusters : {} ({:.2f}%), {} lights dropped", statistics->overflowedClusters,
+								100.0f * statistics->overflowedClusters / std::max(statistics->clusterCount, 1u), statistics->droppedLights)
+								.c_str());
+				ImGui::Text(std::format("CPU Cost : {:.2f} ms building, {:.2f} ms culling", statistics->buildMilliseconds, statistics->cullMilliseconds).c_str());
+
+				std::string histogram;
+				for (size_t i = 0; i < statistics->histogram.size(); i++) {
+					auto bucket = i < 2 ? std::format("{}", i) : std::format("{}+", 1u << (i - 1));
+					histogram += std::format("{}{}: {}", i ? ", " : "", bucket, statistics->histogram[i]);
+				}
+				ImGui::TextWrapped(std::format("Clusters By Light Count : {}", histogram).c_str());
+			}
+
+			ImGui::TreePop();
+		}
 
 		ImGui::TreePop();
 	}
@@ -132,9 +181,9 @@ void LightLimitFix::SetupResources()
 	auto screenSize = Util::ConvertToDynamic(State::GetSingleton()->screenSize);
 	if (REL::Module::IsVR())
 		screenSize.x *= .5;
-	clusterSize[0] = ((uint)screenSize.x + 63) / 64;
-	clusterSize[1] = ((uint)screenSize.y + 63) / 64;
-	clusterSize[2] = 32;
+	clusterSize[0] = ((uint)screenSize.x + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+	clusterSize[1] = ((uint)screenSize.y + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+	clusterSize[2] = CLUSTER_SLICES;
 	uint clusterCount = clusterSize[0] * clusterSize[1] * clusterSize[2];
 
 	{
@@ -213,12 +262,17 @@ void LightLimitFix::SetupResources()
 
 	{
 		D3D11_BUFFER_DESC sbDesc{};
-		sbDesc.Usage = D3D11_USAGE_DYNAMIC;
-		sbDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		// updated in place, only the ranges of lights that changed
+		sbDesc.Usage = D3D11_USAGE_DEFAULT;
+		sbDesc.CPUAccessFlags = 0;
 		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		sbDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
 		sbDesc.StructureByteStride = sizeof(LightData);
 		sbDesc.ByteWidth = sizeof(LightData) * MAX_LIGHTS;
+		lightSources = eastl::make_unique<Buffer>(sbDesc);
+
+		// written by the culling shader every frame
+		sbDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
 		lights = eastl::make_unique<Buffer>(sbDesc);
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
@@ -226,7 +280,16 @@ void LightLimitFix::SetupResources()
 		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
 		srvDesc.Buffer.FirstElement = 0;
 		srvDesc.Buffer.NumElements = MAX_LIGHTS;
+		lightSources->CreateSRV(srvDesc);
 		lights->CreateSRV(srvDesc);
+
+		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc{};
+		uavDesc.Format = DXGI_FORMAT_UNKNOWN;
+		uavDesc.ViewDimension = D3D11_UAV_DIMENSION_BUFFER;
+		uavDesc.Buffer.FirstElement = 0;
+		uavDesc.Buffer.Flags = 0;
+		uavDesc.Buffer.NumElements = MAX_LIGHTS;
+		lights->CreateUAV(uavDesc);
 	}
 
 	{
@@ -294,7 +357,7 @@ void LightLimitFix::BSLightingShader_SetupGeometry_Before(RE::BSRenderPass* a_pa
 
 	strictLightDataTemp.RoomIndex = -1;
 	if (!roomNodes.empty()) {
-		if (RE::NiNode* roomNode = GetParentRoomNode(a_pass->geometry)) {
+		if (RE::NiNode* roomNode = GetGeometryRoomNode(a_pass->geometry)) {
 			if (auto it = roomNodes.find(roomNode); it != roomNodes.cend()) {
 				strictLightDataTemp.RoomIndex = it->second;
 			}
@@ -302,6 +365,34 @@ void LightLimitFix::BSLightingShader_SetupGeometry_Before(RE::BSRenderPass* a_pa
 	}
 }
 
+RE::NiNode* LightLimitFix::GetGeometryRoomNode(RE::BSGeometry* a_geometry)
+{
+	if (a_geometry == nullptr) {
+		return nullptr;
+	}
+
+	// the entry holds while the parent chain still leads to its room, which catches a geometry or any node above it
+	// being moved, and a geometry freed and reallocated elsewhere, with pointer compares only; outside any room that
+	// check would walk to the root just like the lookup, and could not tell a move into a room, so those are not cached
+	if (auto it = geometryRooms.find(a_geometry); it != geometryRooms.end() && it->second.roomGraphVersion == roomGraphVersion) {
+		for (RE::NiNode* node = a_geometry->parent; node; node = node->parent) {
+			if (node == it->second.roomNode) {
+				strictLightStatistics.roomHits++;
+				return node;
+			}
+		}
+	}
+
+	strictLightStatistics.roomMisses++;
+	RE::NiNode* roomNode = GetParentRoomNode(a_geometry);
+	if (roomNode) {
+		geometryRooms.insert_or_assign(a_geometry, GeometryRoom{ roomNode, roomGraphVersion });
+	} else {
+		geometryRooms.erase(a_geometry);
+	}
+	return roomNode;
+}
+
 void LightLimitFix::BSLightingShader_SetupGeometry_GeometrySetupConstantPointLights(RE::BSRenderPass* a_pass, DirectX::XMMATRIX&, uint32_t, uint32_t, float, Space)
 {
 	auto variableCache = VariableCache::GetSingleton();
@@ -348,24 +439,19 @@ void LightLimitFix::BSLightingShader_SetupGeometry_After(RE::BSRenderPass*)
 	auto variableCache = VariableCache::GetSingleton();
 	auto shaderCache = variableCache->shaderCache;
 	auto context = variableCache->context;
-	auto smState = variableCache->smState;
 
 	if (!shaderCache->IsEnabled())
 		return;
 
-	auto accumulator = RE::BSGraphics::BSShaderAccumulator::GetCurrentAccumulator();
-
-	auto shadowSceneNode = smState->shadowSceneNode[0];
-
-	const bool isEmpty = strictLightDataTemp.NumStrictLights == 0;
-	const bool isWorld = accumulator->GetRuntimeData().activeShadowSceneNode == shadowSceneNode;
-	const int roomIndex = strictLightDataTemp.RoomIndex;
-
-	if (!isEmpty || (isEmpty && !wasEmpty) || isWorld != wasWorld || previousRoomIndex != roomIndex) {
+	// Consecutive draws mostly share their strict lights and room, skip the write when nothing differs from what the buffer holds
+	const auto numStrictLights = strictLightDataTemp.NumStrictLights;
+	if (!strictLightDataUploaded || strictLightDataUploaded->NumStrictLights != numStrictLights || strictLightDataUploaded->RoomIndex != strictLightDataTemp.RoomIndex ||
+		memcmp(strictLightDataUploaded->StrictLights, strictLightDataTemp.StrictLights, sizeof(LightData) * numStrictLights) != 0) {
 		strictLightDataCB->Update(strictLightDataTemp);
-		wasEmpty = isEmpty;
-		wasWorld = isWorld;
-		previousRoomIndex = roomIndex;
+		strictLightDataUploaded = strictLightDataTemp;
+		strictLightStatistics.uploads++;
+	} else {
+		strictLightStatistics.skippedUploads++;
 	}
 
 	if (frameChecker.IsNewFrame()) {
@@ -396,7 +482,13 @@ void LightLimitFix::SetLightPosition(LightLimitFix::LightData& a_light, RE::NiPo
 	}
 }
 
-float LightLimitFix::CalculateLuminance(CachedParticleLight& light, RE::NiPoint3& point)
+void LightLimitFix::SetLightSourcePosition(LightLimitFix::LightData& a_light, const RE::NiPoint3& a_position) const
+{
+	auto sourcePos = a_position - lightOrigin;
+	a_light.positionWS[0].data = { sourcePos.x, sourcePos.y, sourcePos.z };
+}
+
+float LightLimitFix::CalculateLuminance(const CachedParticleLight& light, const RE::NiPoint3& point)
 {
 	// See BSLight::CalculateLuminance_14131D3D0
 	// Performs lighting on the CPU which is identical to GPU code
@@ -417,14 +509,16 @@ void LightLimitFix::AddParticleLightLuminance(RE::NiPoint3& targetPosition, int&
 	if (!shaderCache->IsEnabled())
 		return;
 
-	std::lock_guard<std::shared_mutex> lk{ cachedParticleLightsMutex };
 	int particleLightsDetectionHits = 0;
 	if (settings.EnableParticleLightsDetection) {
-		for (auto& light : cachedParticleLights) {
-			auto luminance = CalculateLuminance(light, targetPosition);
-			lightLevel += luminance;
-			if (luminance > 0.0)
-				particleLightsDetectionHits++;
+		// lights out of reach contribute nothing, so visiting only nearby ones gives the same sum
+		if (const auto grid = particleLightGrid.load(std::memory_order_acquire)) {
+			grid->ForEachLight(targetPosition, [&](const CachedParticleLight& light) {
+				auto luminance = CalculateLuminance(light, targetPosition);
+				lightLevel += luminance;
+				if (luminance > 0.0)
+					particleLightsDetectionHits++;
+			});
 		}
 	}
 	numHits += particleLightsDetectionHits;
@@ -464,22 +558,58 @@ struct VertexPosition
 	std::uint8_t data[3];
 };
 
-std::string ExtractTextureStem(std::string_view a_path)
+// Stem of a texture path as a view into the path, matched case-insensitively by ParticleLights
+std::string_view ExtractTextureStem(std::string_view a_path)
 {
-	if (a_path.size() < 1)
-		return {};
-
 	auto lastSeparatorPos = a_path.find_last_of("\\/");
 	if (lastSeparatorPos == std::string::npos)
 		return {};
 
 	a_path = a_path.substr(lastSeparatorPos + 1);
+	if (a_path.size() < 4)
+		return {};
 	a_path.remove_suffix(4);  // Remove ".dds"
 
-	auto textureNameView = a_path | std::views::transform([](auto c) { return (char)::tolower(c); });
-	std::string textureName = { textureNameView.begin(), textureNameView.end() };
+	return a_path;
+}
+
+std::optional<RE::NiColorA> LightLimitFix::GetBillboardVertexColor(RE::BSGeometry* a_geometry)
+{
+	auto rendererData = a_geometry->GetGeometryRuntimeData().rendererData;
+	auto triShape = a_geometry->AsTriShape();
+	if (!rendererData || !triShape || !rendererData->vertexDesc.HasFlag(RE::BSGraphics::Vertex::Flags::VF_COLORS))
+		return std::nullopt;
+
+	// Billboards of one mesh share their vertex data, scan it once
+	const auto vertexCount = triShape->GetTrishapeRuntimeData().vertexCount;
+	if (auto it = billboardVertexColors.find(rendererData->rawVertexData); it != billboardVertexColors.end() && it->second.vertexCount == vertexCount)
+		return it->second.color;
+
+	uint32_t vertexSize = rendererData->vertexDesc.GetSize();
+	uint32_t offset = rendererData->vertexDesc.GetAttributeOffset(RE::BSGraphics::Vertex::Attribute::VA_COLOR);
+
+	uint8_t maxAlpha = 0u;
+	VertexColor* vertexColor = nullptr;
+
+	for (int v = 0; v < vertexCount; v++) {
+		if (VertexColor* vertex = reinterpret_cast<VertexColor*>(&rendererData->rawVertexData[vertexSize * v + offset])) {
+			uint8_t alpha = vertex->data[3];
+			if (alpha > maxAlpha) {
+				maxAlpha = alpha;
+				vertexColor = vertex;
+			}
+		}
+	}
+
+	std::optional<RE::NiColorA> color;
+	if (vertexColor)
+		color = RE::NiColorA{ vertexColor->data[0] / 255.f, vertexColor->data[1] / 255.f, vertexColor->data[2] / 255.f, vertexColor->data[3] / 255.f };
 
-	return textureName;
+	// vertex data is never reported as freed, start over once it holds many stale entries
+	if (billboardVertexColors.size() > 4096)
+		billboardVertexColors.clear();
+	billboardVertexColors.insert_or_assign(rendererData->rawVertexData, BillboardVertexColor{ vertexCount, color });
+	return color;
 }
 
 LightLimitFix::ParticleLightReference LightLimitFix::GetParticleLightConfigs(RE::BSRenderPass* a_pass)
@@ -516,7 +646,7 @@ LightLimitFix::ParticleLightReference LightLimitFix::GetParticleLightConfigs(RE:
 					// Not scanned, scan now
 
 					if (!material->sourceTexturePath.empty()) {
-						std::string textureName = ExtractTextureStem(material->sourceTexturePath.c_str());
+						std::string_view textureName = ExtractTextureStem(material->sourceTexturePath.c_str());
 						if (textureName.size() < 1) {
 							particleLightsReferences.insert({ (RE::NiNode*)a_pass->geometry, { false } });
 							return { false };
@@ -554,34 +684,12 @@ LightLimitFix::ParticleLightReference LightLimitFix::GetParticleLightConfigs(RE:
 						reference.baseColor = { 1, 1, 1, 1 };
 
 						if (billboard) {
-							if (auto rendererData = a_pass->geometry->GetGeometryRuntimeData().rendererData) {
-								if (auto triShape = a_pass->geometry->AsTriShape()) {
-									uint32_t vertexSize = rendererData->vertexDesc.GetSize();
-									if (rendererData->vertexDesc.HasFlag(RE::BSGraphics::Vertex::Flags::VF_COLORS)) {
-										uint32_t offset = rendererData->vertexDesc.GetAttributeOffset(RE::BSGraphics::Vertex::Attribute::VA_COLOR);
-
-										uint8_t maxAlpha = 0u;
-										VertexColor* vertexColor = nullptr;
-
-										for (int v = 0; v < triShape->GetTrishapeRuntimeData().vertexCount; v++) {
-											if (VertexColor* vertex = reinterpret_cast<VertexColor*>(&rendererData->rawVertexData[vertexSize * v + offset])) {
-												uint8_t alpha = vertex->data[3];
-												if (alpha > maxAlpha) {
-													maxAlpha = alpha;
-													vertexColor = vertex;
-												}
-											}
-										}
-
-										if (vertexColor) {
-											reference.baseColor.red *= vertexColor->data[0] / 255.f;
-											reference.baseColor.green *= vertexColor->data[1] / 255.f;
-											reference.baseColor.blue *= vertexColor->data[2] / 255.f;
-											if (shaderProperty->flags.any(RE::BSShaderProperty::EShaderPropertyFlag::kVertexAlpha)) {
-												reference.baseColor.alpha *= vertexColor->data[3] / 255.f;
-											}
-										}
-									}
+							if (auto vertexColor = GetBillboardVertexColor(a_pass->geometry)) {
+								reference.baseColor.red *= vertexColor->red;
+								reference.baseColor.green *= vertexColor->green;
+								reference.baseColor.blue *= vertexColor->blue;
+								if (shaderProperty->flags.any(RE::BSShaderProperty::EShaderPropertyFlag::kVertexAlpha)) {
+									reference.baseColor.alpha *= vertexColor->alpha;
 								}
 							}
 						}
@@ -682,7 +790,7 @@ float LightLimitFix::CalculateLightDistance(float3 a_lightPosition, float a_radi
 	return (a_lightPosition.x * a_lightPosition.x) + (a_lightPosition.y * a_lightPosition.y) + (a_lightPosition.z * a_lightPosition.z) - (a_radius * a_radius);
 }
 
-void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& lightsData, LightLimitFix::LightData& light)
+void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& a_lightsData, LightLimitFix::LightData& light)
 {
 	static float& lightFadeStart = *reinterpret_cast<float*>(REL::RelocationID(527668, 414582).address());
 	static float& lightFadeEnd = *reinterpret_cast<float*>(REL::RelocationID(527669, 414583).address());
@@ -702,15 +810,15 @@ void LightLimitFix::AddCachedParticleLights(eastl::vector<LightData>& lightsData
 	light.color *= dimmer;
 
 	if ((light.color.x + light.color.y + light.color.z) > 1e-4 && light.radius > 1e-4) {
-		for (int eyeIndex = 0; eyeIndex < eyeCount; eyeIndex++)
-			light.positionVS[eyeIndex].data = DirectX::SimpleMath::Vector3::Transform(light.positionWS[eyeIndex].data, viewMatrixCached[eyeIndex]);
+		const RE::NiPoint3 position = { light.positionWS[0].data.x + eyePositionCached[0].x, light.positionWS[0].data.y + eyePositionCached[0].y, light.positionWS[0].data.z + eyePositionCached[0].z };
+		SetLightSourcePosition(light, position);
 
-		lightsData.push_back(light);
+		a_lightsData.push_back(light);
 
 		CachedParticleLight cachedParticleLight{};
 		cachedParticleLight.grey = float3(light.color.x, light.color.y, light.color.z).Dot(float3(0.3f, 0.59f, 0.11f));
 		cachedParticleLight.radius = light.radius;
-		cachedParticleLight.position = { light.positionWS[0].data.x + eyePositionCached[0].x, light.positionWS[0].data.y + eyePositionCached[0].y, light.positionWS[0].data.z + eyePositionCached[0].z };
+		cachedParticleLight.position = position;
 
 		cachedParticleLights.push_back(cachedParticleLight);
 	}
@@ -749,22 +857,68 @@ void LightLimitFix::UpdateLights()
 		viewMatrixCached[eyeIndex].Invert(viewMatrixInverseCached[eyeIndex]);
 	}
 
-	eastl::vector<LightData> lightsData{};
-	lightsData.reserve(MAX_LIGHTS);
+	lightFrame++;
+
+	strictLightStatisticsPrevious = std::exchange(strictLightStatistics, {});
+
+	// geometry is never removed from the room cache, start over once it holds many stale entries
+	if (geometryRooms.size() > 65536)
+		geometryRooms.clear();
 
 	// Process point lights
 
-	roomNodes.empty();
+	// room indices are persistent, start over once they no longer fit in roomFlags; rooms that found no index last
+	// frame left their lights without PortalStrict until then
+	if (roomNodes.size() >= MaxRooms) {
+		roomNodes.clear();
+		roomGraphVersion++;
+	}
 
+	// false once every index is taken
 	auto addRoom = [&](RE::NiNode* node, LightData& light) {
 		uint8_t roomIndex = 0;
-		if (auto it = roomNodes.find(node); it == roomNodes.cend()) {
+		if (auto it = roomNodes.find(node); it != roomNodes.cend()) {
+			roomIndex = it->second;
+		} else if (roomNodes.size() < MaxRooms) {
 			roomIndex = static_cast<uint8_t>(roomNodes.size());
 			roomNodes.insert_or_assign(node, roomIndex);
 		} else {
-			roomIndex = it->second;
+			return false;
 		}
 		light.roomFlags.SetBit(roomIndex, 1);
+		return true;
+	};
+
+	// rooms and portals change without the light moving, as the cell attaches and detaches
+	auto getRoomsHash = [](RE::BSLight* bsLight) {
+		uint64_t hash = 0xCBF29CE484222325ull;
+		auto combine = [&](const void* a_ptr) {
+			hash = (hash ^ reinterpret_cast<uintptr_t>(a_ptr)) * 0x100000001B3ull;
+		};
+		for (const auto& roomPtr : bsLight->rooms) {
+			combine(roomPtr);
+		}
+		combine(nullptr);  // separates rooms from portals
+		for (const auto& portalPtr : bsLight->portals) {
+			combine(portalPtr->portalSharedNode.get());
+		}
+		return hash;
+	};
+
+	// follow the eye once it strays far from the origin, which moves every point light
+	if (!lightOriginValid || eyePositionCached[0].GetDistance(lightOrigin) > LightOriginRebaseDistance) {
+		lightOrigin = eyePositionCached[0];
+		lightOriginValid = true;
+		lightsData.resize(lightSlots.size());
+		for (uint32_t slot = 0; slot < lightSlots.size(); slot++) {
+			SetLightSourcePosition(lightsData[slot], lightTable[lightSlots[slot]].position);
+		}
+		dirtyLightSlots.assign(lightSlots.size(), true);
+	}
+
+	auto markDirty = [&](uint32_t slot) {
+		dirtyLightSlots.resize(std::max(dirtyLightSlots.size(), (size_t)slot + 1), false);
+		dirtyLightSlots[slot] = true;
 	};
 
 	auto addLight = [&](const RE::NiPointer<RE::BSLight>& e) {
@@ -773,47 +927,89 @@ void LightLimitFix::UpdateLights()
 				if (IsValidLight(bsLight)) {
 					auto& runtimeData = niLight->GetLightRuntimeData();
 
-					LightData light{};
-					light.color = { runtimeData.diffuse.red, runtimeData.diffuse.green, runtimeData.diffuse.blue };
-					light.color *= runtimeData.fade;
-					light.color *= bsLight->lodDimmer;
-
-					light.radius = runtimeData.radius.x;
-
-					light.lightFlags = static_cast<LightFlags>(runtimeData.ambient.red);
-
-					if (!IsGlobalLight(bsLight)) {
-						// List of BSMultiBoundRooms affected by a light
-						for (const auto& roomPtr : bsLight->rooms) {
-							addRoom(roomPtr, light);
-						}
-						// List of BSPortals affected by a light
-						for (const auto& portalPtr : bsLight->portals) {
-							addRoom(portalPtr->portalSharedNode.get(), light);
-						}
-						light.lightFlags.set(LightFlags::PortalStrict);
-					}
+					float3 color = { runtimeData.diffuse.red, runtimeData.diffuse.green, runtimeData.diffuse.blue };
+					color *= runtimeData.fade;
+					color *= bsLight->lodDimmer;
 
+					uint32_t shadowMaskIndex = 0;
 					if (bsLight->IsShadowLight()) {
 						auto* shadowLight = static_cast<RE::BSShadowLight*>(bsLight);
 						GET_INSTANCE_MEMBER(shadowLightIndex, shadowLight);
-						light.shadowMaskIndex = shadowLightIndex;
-						light.lightFlags.set(LightFlags::Shadow);
+						shadowMaskIndex = shadowLightIndex;
 					}
 
 					// Check for inactive shadow light
-					if (light.shadowMaskIndex != 255) {
-						SetLightPosition(light, niLight->world.translate);
+					if (shadowMaskIndex == 255 || (color.x + color.y + color.z) <= 1e-4 || runtimeData.radius.x <= 1e-4)
+						return;
+
+					auto [it, inserted] = lightTable.try_emplace(bsLight);
+					auto& cached = it->second;
+					if (cached.lastFrame == lightFrame)
+						return;
+					cached.lastFrame = lightFrame;
+
+					if (inserted) {
+						cached.slot = static_cast<uint32_t>(lightSlots.size());
+						lightSlots.push_back(bsLight);
+						lightsData.emplace_back();
+					}
+
+					const auto& position = niLight->world.translate;
+					const auto flags = static_cast<uint32_t>(runtimeData.ambient.red);
+					const bool global = IsGlobalLight(bsLight);
+					const bool moved = inserted || cached.position != position;
+					const uint64_t roomsHash = global ? 0 : getRoomsHash(bsLight);
+					const bool roomsChanged = moved || cached.global != global || cached.roomsHash != roomsHash || cached.roomGraphVersion != roomGraphVersion;
 
-						if ((light.color.x + light.color.y + light.color.z) > 1e-4 && light.radius > 1e-4) {
-							lightsData.push_back(light);
+					if (!roomsChanged && cached.color == color && cached.radius == runtimeData.radius.x && cached.flags == flags && cached.shadowMaskIndex == shadowMaskIndex)
+						return;
+
+					auto& light = lightsData[cached.slot];
+					light.color = color;
+					light.radius = runtimeData.radius.x;
+					light.lightFlags = static_cast<LightFlags>(flags);
+					light.shadowMaskIndex = shadowMaskIndex;
+
+					if (roomsChanged) {
+						light.roomFlags = uint32_t(0);
+						cached.portalStrict = !global;
+						if (!global) {
+							// List of BSMultiBoundRooms affected by a light
+							for (const auto& roomPtr : bsLight->rooms) {
+								cached.portalStrict &= addRoom(roomPtr, light);
+							}
+							// List of BSPortals affected by a light
+							for (const auto& portalPtr : bsLight->portals) {
+								cached.portalStrict &= addRoom(portalPtr->portalSharedNode.get(), light);
+							}
 						}
 					}
+					// a light missing one of its rooms could be culled where it shines
+					if (cached.portalStrict)
+						light.lightFlags.set(LightFlags::PortalStrict);
+
+					if (bsLight->IsShadowLight())
+						light.lightFlags.set(LightFlags::Shadow);
+
+					SetLightSourcePosition(light, position);
+
+					cached.position = position;
+					cached.color = color;
+					cached.radius = runtimeData.radius.x;
+					cached.flags = flags;
+					cached.shadowMaskIndex = shadowMaskIndex;
+					cached.global = global;
+					cached.roomsHash = roomsHash;
+					cached.roomGraphVersion = roomGraphVersion;
+					markDirty(cached.slot);
 				}
 			}
 		}
 	};
 
+	// particle lights from the previous frame follow the point lights
+	lightsData.resize(lightSlots.size());
+
 	for (auto& e : shadowSceneNode->GetRuntimeData().activeLights) {
 		addLight(e);
 	}
@@ -821,95 +1017,38 @@ void LightLimitFix::UpdateLights()
 		addLight(e);
 	}
 
+	// Lights that went away leave their slot to the last light
+	for (uint32_t slot = 0; slot < lightSlots.size();) {
+		auto it = lightTable.find(lightSlots[slot]);
+		if (it->second.lastFrame == lightFrame) {
+			slot++;
+			continue;
+		}
+		lightTable.erase(it);
+		if (slot != lightSlots.size() - 1) {
+			lightSlots[slot] = lightSlots.back();
+			lightsData[slot] = lightsData[lightSlots.size() - 1];
+			lightTable[lightSlots[slot]].slot = slot;
+		}
+		markDirty(slot);
+		lightSlots.pop_back();
+	}
+	lightsData.resize(lightSlots.size());
+	pointLightCount = static_cast<uint32_t>(lightSlots.size());
+
 	{
-		std::lock_guard<std::shared_mutex> lk{ cachedParticleLightsMutex };
 		cachedParticleLights.clear();
 
-		LightData clusteredLight{};
-		uint32_t clusteredLights = 0;
-
-		auto eyePositionOffset = eyePositionCached[0] - eyePositionCached[1];
+		// Billboards are lights of their own, particles are gathered to be clustered
+		std::vector<const ParticleLightInfo*> particleSystems;
+		std::vector<uint32_t> sampleOffsets{ 0 };
 
 		for (const auto& particleLight : currentParticleLights) {
 			if (!particleLight.billboard) {
 				auto particleSystem = static_cast<RE::NiParticleSystem*>(particleLight.node);
 				if (particleSystem && particleSystem->GetParticleRuntimeData().particleData.get()) {
-					// Process BSGeometry
-					auto particleData = particleSystem->GetParticleRuntimeData().particleData.get();
-					auto& particleSystemRuntimeData = particleSystem->GetParticleSystemRuntimeData();
-					auto& particleRuntimeData = particleData->GetParticlesRuntimeData();
-
-					auto numVertices = particleData->GetActiveVertexCount();
-					for (std::uint32_t p = 0; p < numVertices; p++) {
-						float radius = particleRuntimeData.radii[p] * particleRuntimeData.sizes[p];
-
-						auto initialPosition = particleRuntimeData.positions[p];
-						if (!particleSystemRuntimeData.isWorldspace) {
-							// Detect first-person meshes
-							if ((particleLight.node->GetModelData().modelBound.radius * particleLight.node->world.scale) != particleLight.node->worldBound.radius)
-								initialPosition += particleLight.node->worldBound.center;
-							else
-								initialPosition += particleLight.node->world.translate;
-						}
-
-						RE::NiPoint3 positionWS = initialPosition - eyePositionCached[0];
-
-						if (clusteredLights) {
-							auto averageRadius = clusteredLight.radius / (float)clusteredLights;
-							float radiusDiff = abs(averageRadius - radius);
-
-							auto averagePosition = clusteredLight.positionWS[0].data / (float)clusteredLights;
-							float positionDiff = positionWS.GetDistance({ averagePosition.x, averagePosition.y, averagePosition.z });
-
-							if ((radiusDiff + positionDiff) > 32.0f || !settings.EnableParticleLightsOptimization) {
-								clusteredLight.radius /= (float)clusteredLights;
-								clusteredLight.positionWS[0].data /= (float)clusteredLights;
-								clusteredLight.positionWS[1].data = clusteredLight.positionWS[0].data;
-								if (eyeCount == 2) {
-									clusteredLight.positionWS[1].data.x += eyePositionOffset.x / (float)clusteredLights;
-									clusteredLight.positionWS[1].data.y += eyePositionOffset.y / (float)clusteredLights;
-									clusteredLight.positionWS[1].data.z += eyePositionOffset.z / (float)clusteredLights;
-								}
-
-								clusteredLight.lightFlags.set(LightFlags::Simple);
-
-								AddCachedParticleLights(lightsData, clusteredLight);
-
-								clusteredLights = 0;
-								clusteredLight.color = { 0, 0, 0 };
-								clusteredLight.radius = 0;
-								clusteredLight.positionWS[0].data = { 0, 0, 0 };
-							}
-						}
-
-						if (particleRuntimeData.color) {
-							float alpha = particleLight.color.alpha * particleRuntimeData.color[p].alpha;
-
-							float3 color;
-							color.x = particleLight.color.red * particleRuntimeData.color[p].red;
-							color.y = particleLight.color.green * particleRuntimeData.color[p].green;
-							color.z = particleLight.color.blue * particleRuntimeData.color[p].blue;
-
-							clusteredLight.color += Saturation(color, settings.ParticleLightsSaturation) * alpha * settings.ParticleBrightness;
-						} else {
-							float alpha = particleLight.color.alpha;
-
-							float3 color;
-							color.x = particleLight.color.red;
-							color.y = particleLight.color.green;
-							color.z = particleLight.color.blue;
-
-							clusteredLight.color += Saturation(color, settings.ParticleLightsSaturation) * alpha * settings.ParticleBrightness;
-						}
-
-						clusteredLight.radius += radius * particleLight.color.alpha * settings.ParticleRadius;
-
-						clusteredLight.positionWS[0].data.x += positionWS.x;
-						clusteredLight.positionWS[0].data.y += positionWS.y;
-						clusteredLight.positionWS[0].data.z += positionWS.z;
-
-						clusteredLights++;
-					}
+					particleSystems.push_back(&particleLight);
+					sampleOffsets.push_back(sampleOffsets.back() + particleSystem->GetParticleRuntimeData().particleData->GetActiveVertexCount());
 				}
 			} else {
 				// Process billboard
@@ -926,7 +1065,8 @@ void LightLimitFix::UpdateLights()
 
 				auto position = particleLight.node->world.translate;
 
-				SetLightPosition(light, position);  // Light is complete for both eyes by now
+				auto positionWS = position - eyePositionCached[0];
+				light.positionWS[0].data = { positionWS.x, positionWS.y, positionWS.z };
 
 				light.lightFlags.set(LightFlags::Simple);
 
@@ -934,18 +1074,83 @@ void LightLimitFix::UpdateLights()
 			}
 		}
 
-		if (clusteredLights) {
-			clusteredLight.radius /= (float)clusteredLights;
-			clusteredLight.positionWS[0].data /= (float)clusteredLights;
-			clusteredLight.positionWS[1].data = clusteredLight.positionWS[0].data;
-			if (eyeCount == 2) {
-				clusteredLight.positionWS[1].data.x += eyePositionOffset.x / (float)clusteredLights;
-				clusteredLight.positionWS[1].data.y += eyePositionOffset.y / (float)clusteredLights;
-				clusteredLight.positionWS[1].data.z += eyePositionOffset.z / (float)clusteredLights;
+		// Process BSGeometry, every system fills its own range of samples
+		particleSamples.resize(sampleOffsets.back());
+		Util::ParallelFor(SIE::ShaderCache::Instance().compilationPool, particleSystems.size(), ParticleSystemsPerTask, [&](size_t index) {
+			const auto* particleLight = particleSystems[index];
+			auto sample = particleSamples.begin() + sampleOffsets[index];
+
+			auto particleSystem = static_cast<RE::NiParticleSystem*>(particleLight->node);
+			auto particleData = particleSystem->GetParticleRuntimeData().particleData.get();
+			auto& particleSystemRuntimeData = particleSystem->GetParticleSystemRuntimeData();
+			auto& particleRuntimeData = particleData->GetParticlesRuntimeData();
+
+			auto numVertices = particleData->GetActiveVertexCount();
+			for (std::uint32_t p = 0; p < numVertices; p++, sample++) {
+				float radius = particleRuntimeData.radii[p] * particleRuntimeData.sizes[p];
+
+				auto initialPosition = particleRuntimeData.positions[p];
+				if (!particleSystemRuntimeData.isWorldspace) {
+					// Detect first-person meshes
+					if ((particleLight->node->GetModelData().modelBound.radius * particleLight->node->world.scale) != particleLight->node->worldBound.radius)
+						initialPosition += particleLight->node->worldBound.center;
+					else
+						initialPosition += particleLight->node->world.translate;
+				}
+
+				RE::NiPoint3 positionWS = initialPosition - eyePositionCached[0];
+				sample->position = { positionWS.x, positionWS.y, positionWS.z };
+
+				float3 color;
+				color.x = particleLight->color.red;
+				color.y = particleLight->color.green;
+				color.z = particleLight->color.blue;
+				float alpha = particleLight->color.alpha;
+
+				if (particleRuntimeData.color) {
+					alpha *= particleRuntimeData.color[p].alpha;
+					color.x *= particleRuntimeData.color[p].red;
+					color.y *= particleRuntimeData.color[p].green;
+					color.z *= particleRuntimeData.color[p].blue;
+				}
+
+				sample->color = Saturation(color, settings.ParticleLightsSaturation) * alpha * settings.ParticleBrightness;
+				sample->radius = radius * particleLight->color.alpha * settings.ParticleRadius;
 			}
+		});
+
+		if (recordParticleSamples) {
+			recordParticleSamples = false;
+			const auto path = std::format("Data\\SKSE\\Plugins\\CommunityShaders\\ParticleLights\\{:%Y%m%d-%H%M%S}.bin", std::chrono::floor<std::chrono::seconds>(std::chrono::system_clock::now()));
+			if (ParticleLightClustering::SaveSamples(path, particleSamples)) {
+				logger::info("Saved {} particle light samples to {}", particleSamples.size(), path);
+			} else {
+				logger::warn("Failed to save particle light samples to {}", path);
+			}
+		}
+
+		if (settings.EnableParticleLightsOptimization) {
+			// tiles are independent and visit their samples in a canonical order, so the result does not depend on the pool
+			const size_t tileCount = particleClusterer.Partition(particleSamples, ParticleLightClusterThreshold);
+			Util::ParallelFor(SIE::ShaderCache::Instance().compilationPool, tileCount, 1, [&](size_t a_tile) { particleClusterer.BuildTile(a_tile); });
+			particleClusterer.Finish(particleClusters);
+		} else {
+			particleClusters.resize(particleSamples.size());
+			std::ranges::transform(particleSamples, particleClusters.begin(), [](const ParticleLightClustering::Sample& a_sample) {
+				return ParticleLightClustering::Cluster{ a_sample.position, a_sample.radius, a_sample.color, 1 };
+			});
+		}
+
+		for (const auto& cluster : particleClusters) {
+			LightData clusteredLight{};
+			clusteredLight.color = cluster.color;
+			clusteredLight.radius = cluster.radius;
+			clusteredLight.positionWS[0].data = cluster.position;
 			clusteredLight.lightFlags.set(LightFlags::Simple);
 			AddCachedParticleLights(lightsData, clusteredLight);
 		}
+
+		particleLightGrid.store(std::make_shared<const ParticleLightGrid>(std::span(cachedParticleLights.data(), cachedParticleLights.size())), std::memory_order_release);
 	}
 
 	auto context = variableCache->context;
@@ -988,14 +1193,33 @@ void LightLimitFix::UpdateLights()
 	{
 		lightCount = std::min((uint)lightsData.size(), MAX_LIGHTS);
 
-		D3D11_MAPPED_SUBRESOURCE mapped;
-		DX::ThrowIfFailed(context->Map(lights->resource.get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
-		size_t bytes = sizeof(LightData) * lightCount;
-		memcpy_s(mapped.pData, bytes, lightsData.data(), bytes);
-		context->Unmap(lights->resource.get(), 0);
+		// Particle lights are rebuilt every frame
+		dirtyLightSlots.resize(std::max(dirtyLightSlots.size(), (size_t)lightCount), false);
+		std::fill(dirtyLightSlots.begin() + std::min(pointLightCount, lightCount), dirtyLightSlots.begin() + lightCount, true);
+
+		for (uint begin = 0; begin < lightCount;) {
+			if (!dirtyLightSlots[begin]) {
+				begin++;
+				continue;
+			}
+			uint end = begin + 1;
+			while (end < lightCount && dirtyLightSlots[end])
+				end++;
+
+			D3D11_BOX box{ (UINT)(sizeof(LightData) * begin), 0, 0, (UINT)(sizeof(LightData) * end), 1, 1 };
+			context->UpdateSubresource(lightSources->resource.get(), 0, &box, lightsData.data() + begin, 0, 0);
+			begin = end;
+		}
+		dirtyLightSlots.assign(lightSlots.size(), false);
 
 		LightCullingCB updateData{};
 		updateData.LightCount = lightCount;
+		for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++) {
+			const int eye = eyeIndex < eyeCount ? eyeIndex : 0;
+			const auto eyeOffset = eyePositionCached[eye] - lightOrigin;
+			updateData.EyeOffset[eyeIndex] = { eyeOffset.x, eyeOffset.y, eyeOffset.z, 0.0f };
+			updateData.View[eyeIndex] = viewMatrixCached[eye];
+		}
 		lightCullingCB->Update(updateData);
 
 		UINT counterReset[4] = { 0, 0, 0, 0 };
@@ -1004,14 +1228,19 @@ void LightLimitFix::UpdateLights()
 		ID3D11Buffer* buffer = lightCullingCB->CB();
 		context->CSSetConstantBuffers(0, 1, &buffer);
 
-		ID3D11ShaderResourceView* srvs[] = { clusters->srv.get(), lights->srv.get() };
+		ID3D11ShaderResourceView* srvs[] = { clusters->srv.get(), lightSources->srv.get() };
 		context->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
 
-		ID3D11UnorderedAccessView* uavs[] = { lightIndexCounter->uav.get(), lightIndexList->uav.get(), lightGrid->uav.get() };
+		ID3D11UnorderedAccessView* uavs[] = { lightIndexCounter->uav.get(), lightIndexList->uav.get(), lightGrid->uav.get(), lights->uav.get() };
 		context->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
 
 		context->CSSetShader(clusterCullingCS, nullptr, 0);
 		context->Dispatch((clusterSize[0] + 15) / 16, (clusterSize[1] + 15) / 16, (clusterSize[2] + 3) / 4);
+
+		if (clusterAnalysis.requested) {
+			AnalyzeClusters(std::span(lightsData.data(), lightCount), updateData);
+			clusterAnalysis.requested = false;
+		}
 	}
 
 	context->CSSetShader(nullptr, nullptr, 0);
@@ -1022,8 +1251,47 @@ void LightLimitFix::UpdateLights()
 	ID3D11ShaderResourceView* null_srvs[2] = { nullptr };
 	context->CSSetShaderResources(0, 2, null_srvs);
 
-	ID3D11UnorderedAccessView* null_uavs[3] = { nullptr };
-	context->CSSetUnorderedAccessViews(0, 3, null_uavs, nullptr);
+	ID3D11UnorderedAccessView* null_uavs[4] = { nullptr };
+	context->CSSetUnorderedAccessViews(0, 4, null_uavs, nullptr);
+}
+
+void LightLimitFix::AnalyzeClusters(std::span<const LightData> a_lights, const LightCullingCB& a_culling)
+{
+	auto screenSize = Util::ConvertToDynamic(State::GetSingleton()->screenSize);
+	if (REL::Module::IsVR())
+		screenSize.x *= .5;
+
+	ClusterCulling::Config config{};
+	const auto tileSize = static_cast<uint>(clusterAnalysis.tileSize);
+	config.clusterSize = { ((uint)screenSize.x + tileSize - 1) / tileSize, ((uint)screenSize.y + tileSize - 1) / tileSize, static_cast<uint>(clusterAnalysis.slices) };
+	config.maxClusterLights = static_cast<uint>(clusterAnalysis.maxClusterLights);
+	config.stereo = eyeCount == 2;
+
+	ClusterCulling::Matrix invProjMatrix[2];
+	for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++) {
+		const float4x4 inverse = DirectX::XMMatrixInverse(nullptr, Util::GetCameraData(eyeIndex < eyeCount ? eyeIndex : 0).projMatrixUnjittered);
+		invProjMatrix[eyeIndex] = std::bit_cast<ClusterCulling::Matrix>(inverse);
+	}
+
+	std::vector<ClusterCulling::Light> cullingLights(a_lights.size());
+	// resolved for the view the way the culling shader does
+	std::ranges::transform(a_lights, cullingLights.begin(), [&](const LightData& a_light) {
+		ClusterCulling::Light light{ {}, a_light.radius };
+		for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++) {
+			const auto& eyeOffset = a_culling.EyeOffset[eyeIndex];
+			const float3 positionWS = a_light.positionWS[0].data - float3{ eyeOffset.x, eyeOffset.y, eyeOffset.z };
+			const float3 positionVS = float3::Transform(positionWS, a_culling.View[eyeIndex]);
+			light.positionVS[eyeIndex] = { positionVS.x, positionVS.y, positionVS.z };
+		}
+		return light;
+	});
+
+	clusterAnalysis.statistics = ClusterCulling::Analyze(config, invProjMatrix, lightsNear, lightsFar, cullingLights);
+
+	const auto& statistics = *clusterAnalysis.statistics;
+	logger::info("[LLF] Cluster analysis {}x{}x{}, limit {}: {} lights, {:.2f} average and {} max per cluster, {} overflowed clusters, {:.2f} ms culling",
+		config.clusterSize[0], config.clusterSize[1], config.clusterSize[2], config.maxClusterLights, statistics.lightCount,
+		statistics.averageClusterLights, statistics.maxClusterLights, statistics.overflowedClusters, statistics.cullMilliseconds);
 }
 
 void LightLimitFix::Hooks::BSBatchRenderer_RenderPassImmediately::thunk(RE::BSRenderPass* Pass, uint32_t Technique, bool AlphaTest, uint32_t RenderFlags)
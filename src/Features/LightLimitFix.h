@@ -1,13 +1,15 @@
 #pragma once
 #include <DirectXMath.h>
 #include <d3d11.h>
-#include <shared_mutex>
 
 #include "Buffer.h"
 #include "Feature.h"
 #include "ShaderCache.h"
 #include "Util.h"
 
+#include "Features/LightLimitFix/ClusterCulling.h"
+#include "Features/LightLimitFix/ParticleLightClustering.h"
+#include "Features/LightLimitFix/ParticleLightGrid.h"
 #include "Features/LightLimitFix/ParticleLights.h"
 
 struct LightLimitFix : Feature
@@ -75,6 +77,8 @@ public:
 	{
 		uint LightCount;
 		uint pad[3];
+		float4 EyeOffset[2];  // eye position relative to lightOrigin
+		float4x4 View[2];
 	};
 
 	struct alignas(16) PerFrame
@@ -98,12 +102,7 @@ public:
 
 	StrictLightDataCB strictLightDataTemp;
 
-	struct CachedParticleLight
-	{
-		float grey;
-		RE::NiPoint3 position;
-		float radius;
-	};
+	using CachedParticleLight = ParticleLightGrid::Light;
 
 	ConstantBuffer* strictLightDataCB = nullptr;
 
@@ -117,6 +116,7 @@ public:
 	ConstantBuffer* lightBuildingCB = nullptr;
 	ConstantBuffer* lightCullingCB = nullptr;
 
+	eastl::unique_ptr<Buffer> lightSources = nullptr;  // lightsData, resolved for the view into lights by the culling shader
 	eastl::unique_ptr<Buffer> lights = nullptr;
 	eastl::unique_ptr<Buffer> clusters = nullptr;
 	eastl::unique_ptr<Buffer> lightIndexCounter = nullptr;
@@ -143,19 +143,33 @@ public:
 		RE::NiColorA baseColor;
 	};
 
-	eastl::hash_map<RE::NiNode*, ParticleLightReference> particleLightsReferences;
+	ankerl::unordered_dense::map<RE::NiNode*, ParticleLightReference> particleLightsReferences;
+
+	struct BillboardVertexColor
+	{
+		uint32_t vertexCount;
+		std::optional<RE::NiColorA> color;  // of the most opaque vertex
+	};
+
+	ankerl::unordered_dense::map<const uint8_t*, BillboardVertexColor> billboardVertexColors;  // by shared vertex data
+	std::optional<RE::NiColorA> GetBillboardVertexColor(RE::BSGeometry* a_geometry);
 	eastl::vector<ParticleLightInfo> queuedParticleLights;
 	eastl::vector<ParticleLightInfo> currentParticleLights;
 
+	static constexpr float ParticleLightClusterThreshold = 32.0f;  // distance plus radius difference
+	static constexpr size_t ParticleSystemsPerTask = 16;
+	std::vector<ParticleLightClustering::Sample> particleSamples;
+	ParticleLightClustering::Clusterer particleClusterer;
+	std::vector<ParticleLightClustering::Cluster> particleClusters;
+	bool recordParticleSamples = false;  // save the next frame's samples for the clustering benchmark
+
 	void CleanupParticleLights(RE::NiNode* a_node);
 
 	RE::NiPoint3 eyePositionCached[2]{};
 	Matrix viewMatrixCached[2]{};
 	Matrix viewMatrixInverseCached[2]{};
 
-	bool wasEmpty = false;
-	bool wasWorld = false;
-	int previousRoomIndex = -1;
+	std::optional<StrictLightDataCB> strictLightDataUploaded;  // contents of strictLightDataCB
 	Util::FrameChecker frameChecker;
 
 	virtual void SetupResources() override;
@@ -172,8 +186,9 @@ public:
 	virtual void DataLoaded() override;
 
 	float CalculateLightDistance(float3 a_lightPosition, float a_radius);
-	void AddCachedParticleLights(eastl::vector<LightData>& lightsData, LightLimitFix::LightData& light);
+	void AddCachedParticleLights(eastl::vector<LightData>& a_lightsData, LightLimitFix::LightData& light);
 	void SetLightPosition(LightLimitFix::LightData& a_light, RE::NiPoint3 a_initialPosition, bool a_cached = true);
+	void SetLightSourcePosition(LightLimitFix::LightData& a_light, const RE::NiPoint3& a_position) const;  // relative to lightOrigin
 	void UpdateLights();
 	virtual void Prepass() override;
 
@@ -199,6 +214,18 @@ public:
 
 	uint clusterSize[3] = { 16 };
 
+	// CPU run of the cluster shaders with dimensions picked in the UI, to tune them from real frames
+	struct ClusterAnalysis
+	{
+		int tileSize = 64;
+		int slices = 32;
+		int maxClusterLights = 256;
+		bool requested = false;
+		std::optional<ClusterCulling::Statistics> statistics;
+	} clusterAnalysis;
+
+	void AnalyzeClusters(std::span<const LightData> a_lights, const LightCullingCB& a_culling);
+
 	Settings settings;
 
 	ParticleLightReference GetParticleLightConfigs(RE::BSRenderPass* a_pass);
@@ -217,12 +244,64 @@ public:
 
 	void BSLightingShader_SetupGeometry_After(RE::BSRenderPass* a_pass);
 
-	std::shared_mutex cachedParticleLightsMutex;
-	eastl::vector<CachedParticleLight> cachedParticleLights;
+	eastl::vector<CachedParticleLight> cachedParticleLights;                    // render thread only, built by UpdateLights
+	std::atomic<std::shared_ptr<const ParticleLightGrid>> particleLightGrid;  // published copy of cachedParticleLights
 
 	eastl::hash_map<RE::NiNode*, uint8_t> roomNodes;
 
-	float CalculateLuminance(CachedParticleLight& light, RE::NiPoint3& point);
+	// Room of a geometry, found by walking up to its BSMultiBoundRoom or BSPortalSharedNode; only geometry inside a room is cached
+	struct GeometryRoom
+	{
+		RE::NiNode* roomNode = nullptr;
+		uint32_t roomGraphVersion = 0;
+	};
+
+	ankerl::unordered_dense::map<RE::BSGeometry*, GeometryRoom> geometryRooms;
+	RE::NiNode* GetGeometryRoomNode(RE::BSGeometry* a_geometry);
+
+	struct StrictLightStatistics
+	{
+		uint32_t roomHits = 0;
+		uint32_t roomMisses = 0;
+		uint32_t uploads = 0;
+		uint32_t skippedUploads = 0;
+	};
+
+	StrictLightStatistics strictLightStatistics;
+	StrictLightStatistics strictLightStatisticsPrevious;  // last full frame, shown in the UI
+	uint32_t roomGraphVersion = 0;  // bumped when roomNodes starts over
+
+	// Point lights keep their slot in the light buffer across frames, only lights that changed are rebuilt and uploaded
+	struct CachedLight
+	{
+		RE::NiPoint3 position;
+		float3 color;
+		float radius = 0;
+		uint32_t flags = 0;
+		uint32_t shadowMaskIndex = 0;
+		bool global = false;
+		bool portalStrict = false;  // every room of the light has an index
+		uint64_t roomsHash = 0;     // rooms and portals the light was last seen in
+		uint32_t roomGraphVersion = 0;
+		uint32_t slot = 0;
+		uint32_t lastFrame = 0;
+	};
+
+	ankerl::unordered_dense::map<RE::BSLight*, CachedLight> lightTable;
+	eastl::vector<RE::BSLight*> lightSlots;
+	eastl::vector<LightData> lightsData;  // contents of lightSources, point lights by slot followed by particle lights
+	std::vector<bool> dirtyLightSlots;
+	uint32_t pointLightCount = 0;
+	uint32_t lightFrame = 0;
+
+	// lightsData positions are relative to this point rather than the eye, so the camera moving changes none of them;
+	// it follows the player only once float precision would start to suffer
+	RE::NiPoint3 lightOrigin{};
+	bool lightOriginValid = false;
+	static constexpr float LightOriginRebaseDistance = 16384.0f;
+	static constexpr uint32_t MaxRooms = 128;  // bits in LightData::roomFlags
+
+	static float CalculateLuminance(const CachedParticleLight& light, const RE::NiPoint3& point);
 	void AddParticleLightLuminance(RE::NiPoint3& targetPosition, int& numHits, float& lightLevel);
 
 	struct Hooks
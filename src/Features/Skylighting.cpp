@@ -85,7 +85,7 @@ void Skylighting::SetupResources()
 		D3D11_TEXTURE3D_DESC texDesc{
 			.Width = probeArrayDims[0],
 			.Height = probeArrayDims[1],
-			.Depth = probeArrayDims[2],
+			.Depth = probeArrayDims[2] * NumLevels,
 			.MipLevels = 1,
 			.Format = DXGI_FORMAT_R16G16B16A16_FLOAT,
 			.Usage = D3D11_USAGE_DEFAULT,
@@ -182,21 +182,7 @@ Skylighting::SkylightingCB Skylighting::GetCommonBufferData(bool a_inWorld)
 		if (ui->IsMenuOpen(RE::MapMenu::MENU_NAME))
 			return Skylighting::SkylightingCB{};
 
-	static float3 prevCellID = { 0, 0, 0 };
-
 	auto eyePosNI = Util::GetEyePosition(0);
-	auto eyePos = float3{ eyePosNI.x, eyePosNI.y, eyePosNI.z };
-
-	float3 cellSize = {
-		occlusionDistance / probeArrayDims[0],
-		occlusionDistance / probeArrayDims[1],
-		occlusionDistance * .5f / probeArrayDims[2]
-	};
-	auto cellID = eyePos / cellSize;
-	cellID = { round(cellID.x), round(cellID.y), round(cellID.z) };
-	auto cellOrigin = cellID * cellSize;
-	float3 cellIDDiff = prevCellID - cellID;
-	prevCellID = cellID;
 
 	auto ambientDimmer = 1.0f;
 
@@ -205,18 +191,29 @@ Skylighting::SkylightingCB Skylighting::GetCommonBufferData(bool a_inWorld)
 		if (ssgi->settings.Enabled && ssgi->settings.EnableGI && ssgi->settings.GIStrength > 0.0f)
 			ambientDimmer = settings.SSGIAmbientDimmer;
 
-	return {
+	SkylightingCB data = {
 		.OcclusionViewProj = OcclusionTransform,
 		.OcclusionDir = OcclusionDir,
-		.PosOffset = cellOrigin - eyePos,
-		.ArrayOrigin = {
-			((int)cellID.x - probeArrayDims[0] / 2) % probeArrayDims[0],
-			((int)cellID.y - probeArrayDims[1] / 2) % probeArrayDims[1],
-			((int)cellID.z - probeArrayDims[2] / 2) % probeArrayDims[2] },
-		.ValidMargin = { (int)cellIDDiff.x, (int)cellIDDiff.y, (int)cellIDDiff.z },
 		.MinDiffuseVisibility = settings.MinDiffuseVisibility * ambientDimmer,
 		.MinSpecularVisibility = settings.MinSpecularVisibility
 	};
+
+	// every level scrolls on its own cell grid
+	const SkylightingClipmap::Float3 extent = { occlusionDistance, occlusionDistance, occlusionDistance * .5f };
+	const SkylightingClipmap::Dims dims = { probeArrayDims[0], probeArrayDims[1], probeArrayDims[2] };
+	for (uint level = 0; level < NumLevels; ++level) {
+		const auto cellSize = SkylightingClipmap::GetCellSize(extent, dims, level, NumLevels);
+		const auto scroll = SkylightingClipmap::ScrollLevel({ eyePosNI.x, eyePosNI.y, eyePosNI.z }, cellSize, dims, clipmapCellIDs[level]);
+		clipmapCellIDs[level] = scroll.cellID;
+
+		data.PosOffset[level] = { scroll.posOffset[0], scroll.posOffset[1], scroll.posOffset[2], 0 };
+		for (int axis = 0; axis < 3; ++axis) {
+			data.ArrayOrigin[level][axis] = scroll.arrayOrigin[axis];
+			data.ValidMargin[level][axis] = scroll.validMargin[axis];
+		}
+	}
+
+	return data;
 }
 
 void Skylighting::Prepass()
@@ -248,7 +245,7 @@ void Skylighting::Prepass()
 			context->CSSetShaderResources(0, (uint)srvs.size(), srvs.data());
 			context->CSSetUnorderedAccessViews(0, (uint)uavs.size(), uavs.data(), nullptr);
 			context->CSSetShader(probeUpdateCompute.get(), nullptr, 0);
-			context->Dispatch((probeArrayDims[0] + 7u) >> 3, (probeArrayDims[1] + 7u) >> 3, probeArrayDims[2]);
+			context->Dispatch((probeArrayDims[0] + 7u) >> 3, (probeArrayDims[1] + 7u) >> 3, probeArrayDims[2] * NumLevels);
 		}
 
 		// Reset
@@ -2,6 +2,7 @@
 
 #include "Buffer.h"
 #include "Feature.h"
+#include "Features/Skylighting/Clipmap.h"
 #include "State.h"
 #include "Util.h"
 
@@ -44,22 +45,24 @@ struct Skylighting : Feature
 		float SSGIAmbientDimmer = 1.0f;
 	} settings;
 
+	// probe clipmap levels, each twice the cell size of the one before; keep in sync with SKYLIGHTING_NUM_LEVELS in SharedData.hlsli
+	static constexpr uint NumLevels = 2;
+
 	struct SkylightingCB
 	{
 		REX::W32::XMFLOAT4X4 OcclusionViewProj;
 		float4 OcclusionDir;
 
-		float3 PosOffset;  // cell origin in camera model space
-		uint _pad0;
-		uint ArrayOrigin[3];  // xyz: array origin, w: max accum frames
-		uint _pad1;
-		int ValidMargin[4];
+		float4 PosOffset[NumLevels];     // xyz: cell origin in camera model space
+		uint ArrayOrigin[NumLevels][4];  // xyz: array origin
+		int ValidMargin[NumLevels][4];
 
 		float MinDiffuseVisibility;
 		float MinSpecularVisibility;
 		uint _pad2[2];
 	};
 	static_assert(sizeof(SkylightingCB) % 16 == 0);
+	static_assert(sizeof(SkylightingCB) == 96 + 48 * NumLevels, "SkylightingCB must match SharedData::SkylightingSettings");
 
 	SkylightingCB GetCommonBufferData(bool a_inWorld);
 
@@ -73,8 +76,8 @@ struct Skylighting : Feature
 	winrt::com_ptr<ID3D11ShaderResourceView> stbn_vec3_2Dx1D_128x128x64;
 
 	// misc parameters
-	uint probeArrayDims[3] = { 256, 256, 128 };
-	float occlusionDistance = 4096.f * 2.5f;  // 5 ugrids
+	uint probeArrayDims[3] = { 128, 128, 64 };  // per level, levels are stacked along z
+	float occlusionDistance = 4096.f * 2.5f;    // 5 ugrids, extent of the coarsest level
 
 	// cached variables
 	bool queuedResetSkylighting = true;
@@ -82,6 +85,7 @@ struct Skylighting : Feature
 	REX::W32::XMFLOAT4X4 OcclusionTransform;
 	float4 OcclusionDir;
 	uint frameCount = 0;
+	std::optional<SkylightingClipmap::Int3> clipmapCellIDs[NumLevels];  // cellID of every level last frame
 
 	void ResetSkylighting();
 
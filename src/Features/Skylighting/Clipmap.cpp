@@ -0,0 +1,50 @@
+#include "Features/Skylighting/Clipmap.h"
+
+namespace SkylightingClipmap
+{
+	Float3 GetCellSize(const Float3& a_extent, const Dims& a_dims, uint a_level, uint a_levelCount)
+	{
+		const float levelScale = (float)(1u << a_level) / (float)(1u << (a_levelCount - 1));
+		return { a_extent[0] / a_dims[0] * levelScale, a_extent[1] / a_dims[1] * levelScale, a_extent[2] / a_dims[2] * levelScale };
+	}
+
+	Scroll ScrollLevel(const Float3& a_eyePos, const Float3& a_cellSize, const Dims& a_dims, const std::optional<Int3>& a_prevCellID)
+	{
+		Scroll scroll;
+		for (size_t axis = 0; axis < 3; ++axis) {
+			const auto dim = static_cast<int32_t>(a_dims[axis]);
+			const auto cellID = static_cast<int32_t>(std::round(a_eyePos[axis] / a_cellSize[axis]));
+			scroll.cellID[axis] = cellID;
+			scroll.posOffset[axis] = cellID * a_cellSize[axis] - a_eyePos[axis];
+
+			// the first cell of the level is dims / 2 below the eye's, wrapped into the array
+			const int32_t origin = (cellID - dim / 2) % dim;
+			scroll.arrayOrigin[axis] = static_cast<uint>(origin < 0 ? origin + dim : origin);
+
+			// a jump of a whole level or more leaves nothing valid, and must not overflow on the way
+			const int64_t moved = a_prevCellID ? (int64_t)(*a_prevCellID)[axis] - cellID : dim;
+			scroll.validMargin[axis] = static_cast<int32_t>(std::clamp<int64_t>(moved, -dim, dim));
+		}
+		return scroll;
+	}
+
+	Dims GetRelativeCell(const Scroll& a_scroll, const Dims& a_dims, const Dims& a_texel)
+	{
+		Dims cell;
+		for (size_t axis = 0; axis < 3; ++axis) {
+			cell[axis] = (a_texel[axis] + a_dims[axis] - a_scroll.arrayOrigin[axis]) % a_dims[axis];
+		}
+		return cell;
+	}
+
+	bool IsValid(const Scroll& a_scroll, const Dims& a_dims, const Dims& a_relativeCell)
+	{
+		for (size_t axis = 0; axis < 3; ++axis) {
+			const auto cell = static_cast<int32_t>(a_relativeCell[axis]);
+			const auto margin = a_scroll.validMargin[axis];
+			if (cell < std::max(0, margin) || cell > static_cast<int32_t>(a_dims[axis]) - 1 + std::min(0, margin))
+				return false;
+		}
+		return true;
+	}
+}
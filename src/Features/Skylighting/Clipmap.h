@@ -0,0 +1,42 @@
+#pragma once
+
+// Scrolling of the skylighting probe clipmap, the CPU side of UpdateProbesCS.hlsl's addressing. Free of game and
+// D3D types so tools/Tests can build it.
+namespace SkylightingClipmap
+{
+	using Int3 = std::array<int32_t, 3>;
+	using Float3 = std::array<float, 3>;
+	using Dims = std::array<uint, 3>;
+
+	/**
+	 * @brief Where one level sits this frame, as SkylightingCB carries it.
+	 */
+	struct Scroll
+	{
+		Int3 cellID{};          // cell under the eye, in cells of the level
+		Float3 posOffset{};     // cell origin relative to the eye
+		Dims arrayOrigin{};     // texel of the level's first cell, in [0, dims)
+		Int3 validMargin{};     // previous cellID - cellID, clamped to the level; cells on that side are new
+	};
+
+	/**
+	 * @brief Cell size of a level, each twice the size of the one before and the last spanning a_extent.
+	 */
+	Float3 GetCellSize(const Float3& a_extent, const Dims& a_dims, uint a_level, uint a_levelCount);
+
+	/**
+	 * @brief Scrolls a level to the eye.
+	 * @param a_prevCellID cellID of the previous frame, none to treat every cell as new.
+	 */
+	Scroll ScrollLevel(const Float3& a_eyePos, const Float3& a_cellSize, const Dims& a_dims, const std::optional<Int3>& a_prevCellID);
+
+	/**
+	 * @brief Cell of the level a texel holds, relative to the level's first cell, as UpdateProbesCS.hlsl finds it.
+	 */
+	Dims GetRelativeCell(const Scroll& a_scroll, const Dims& a_dims, const Dims& a_texel);
+
+	/**
+	 * @brief Mirrors UpdateProbesCS.hlsl: false for cells that scrolled in this frame and hold nothing yet.
+	 */
+	bool IsValid(const Scroll& a_scroll, const Dims& a_dims, const Dims& a_relativeCell);
+}
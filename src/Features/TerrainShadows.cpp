@@ -52,12 +52,27 @@ void TerrainShadows::DrawSettings()
 		}
 		ImGui::Unindent();
 
+		for (const auto& [name, level] : { std::pair{ "Coarse map", &coarseLevel }, std::pair{ "Window", &windowLevel } }) {
+			ImGui::BulletText(name);
+			ImGui::Indent();
+			{
+				ImGui::Text(fmt::format("Texels: {}x{} at ({}, {}) of {}x{}", level->window.size[0], level->window.size[1], level->window.origin[0], level->window.origin[1], level->mipSize[0], level->mipSize[1]).c_str());
+				ImGui::Text(fmt::format("Settled sweeps: {}", level->state.settledSweeps).c_str());
+				ImGui::Text(fmt::format("Sweep step: {} / {}", level->state.cursor.next, level->state.cursor.count).c_str());
+				ImGui::Text(fmt::format("Dispatches this frame: {}", level->state.budget).c_str());
+			}
+			ImGui::Unindent();
+		}
+
 		if (ImGui::TreeNode("Buffer Viewer")) {
 			static float debugRescale = .1f;
 			ImGui::SliderFloat("View Resize", &debugRescale, 0.f, 1.f);
 
-			if (texShadowHeight) {
-				BUFFER_VIEWER_NODE_BULLET(texShadowHeight, debugRescale)
+			if (coarseLevel.texShadowHeight) {
+				BUFFER_VIEWER_NODE_BULLET(coarseLevel.texShadowHeight, debugRescale)
+			}
+			if (windowLevel.texShadowHeight) {
+				BUFFER_VIEWER_NODE_BULLET(windowLevel.texShadowHeight, debugRescale)
 			}
 			ImGui::TreePop();
 		}
@@ -129,17 +144,108 @@ void TerrainShadows::ParseHeightmapPath(std::filesystem::path p, bool xlodgen_st
 		logger::debug("{} has unknown type ({})", filename.string(), splitstr[1]);
 }
 
-void TerrainShadows::SetupResources()
+namespace STerrainShadows
 {
+	constexpr uint32_t Magic = 0x4D485443;  // "CTHM"
+	constexpr uint32_t FormatVersion = 1;
+
+	static int64_t GetWriteTime(const std::filesystem::path& a_path)
+	{
+		std::error_code ec;
+		return std::filesystem::last_write_time(a_path, ec).time_since_epoch().count();
+	}
+
+	// offset of the top level's texels in a DDS file, or 0 where DirectXTex converts them on load so they cannot be read as stored
+	static size_t GetTopLevelOffset(const std::filesystem::path& a_path, const DirectX::TexMetadata& a_metadata)
+	{
+		// the magic and DDS_HEADER, whose DDS_PIXELFORMAT holds flags, FourCC and bit count at bytes 80, 84 and 88
+		std::array<uint32_t, 32> header{};
+		std::ifstream file(a_path, std::ios::binary);
+		if (!file.read(reinterpret_cast<char*>(header.data()), sizeof(header)))
+			return 0;
+		constexpr uint32_t FourCCFlag = 0x4;  // DDPF_FOURCC
+		const bool hasFourCC = (header[20] & FourCCFlag) != 0;
+		size_t offset = sizeof(header);
+		if (hasFourCC && header[21] == MAKEFOURCC('D', 'X', '1', '0'))
+			offset += 20;  // DDS_HEADER_DXT10
+		else if (!hasFourCC && header[22] != DirectX::BitsPerPixel(a_metadata.format))
+			return 0;  // expanded on load
+
+		size_t rowPitch = 0;
+		size_t slicePitch = 0;
+		std::error_code ec;
+		if (FAILED(DirectX::ComputePitch(a_metadata.format, a_metadata.width, a_metadata.height, rowPitch, slicePitch)) ||
+			std::filesystem::file_size(a_path, ec) < offset + slicePitch || ec)
+			return 0;
+		return offset;
+	}
+
+	struct Writer
+	{
+		std::string data;
+
+		template <class T>
+		void Write(const T& a_value)
+		{
+			data.append(reinterpret_cast<const char*>(&a_value), sizeof(T));
+		}
+
+		template <class Char>
+		void WriteString(std::basic_string_view<Char> a_value)
+		{
+			Write(static_cast<uint16_t>(a_value.size()));
+			data.append(reinterpret_cast<const char*>(a_value.data()), a_value.size() * sizeof(Char));
+		}
+	};
+
+	struct Reader
+	{
+		const std::string& data;
+		size_t offset = 0;
+
+		template <class T>
+		bool Read(T& o_value)
+		{
+			if (offset + sizeof(T) > data.size()) {
+				return false;
+			}
+			memcpy(&o_value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+
+		template <class Char>
+		bool ReadString(std::basic_string<Char>& o_value)
+		{
+			uint16_t size = 0;
+			if (!Read(size) || offset + size * sizeof(Char) > data.size()) {
+				return false;
+			}
+			o_value.resize(size);
+			memcpy(o_value.data(), data.data() + offset, size * sizeof(Char));
+			offset += size * sizeof(Char);
+			return true;
+		}
+	};
+}
+
+void TerrainShadows::ScanHeightmaps()
+{
+	heightmaps.clear();
+	heightmapDirectories.clear();
+
 	logger::debug("Listing xLODGen height maps...");
 	{
 		std::filesystem::path texture_dir{ L"Data\\textures\\Terrain\\" };
+		heightmapDirectories.push_back({ texture_dir.wstring(), STerrainShadows::GetWriteTime(texture_dir) });
+
 		std::error_code ec;
 		for (auto const& dir_entry : std::filesystem::directory_iterator{ texture_dir, ec }) {
 			auto dir_path = dir_entry.path();
 			if (!std::filesystem::is_directory(dir_path))
 				continue;
 
+			heightmapDirectories.push_back({ dir_path.wstring(), STerrainShadows::GetWriteTime(dir_path) });
 			for (auto const& sub_dir_entry : std::filesystem::directory_iterator{ dir_path })
 				ParseHeightmapPath(sub_dir_entry.path(), true);
 		}
@@ -148,10 +254,122 @@ void TerrainShadows::SetupResources()
 	logger::debug("Listing height maps...");
 	{
 		std::filesystem::path texture_dir{ L"Data\\textures\\heightmaps\\" };
+		heightmapDirectories.push_back({ texture_dir.wstring(), STerrainShadows::GetWriteTime(texture_dir) });
+
 		std::error_code ec;
 		for (auto const& dir_entry : std::filesystem::directory_iterator{ texture_dir, ec })
 			ParseHeightmapPath(dir_entry.path(), false);
 	}
+}
+
+bool TerrainShadows::LoadHeightmapIndex()
+{
+	std::string data;
+	{
+		std::ifstream stream(HeightmapIndexPath, std::ios::binary | std::ios::ate);
+		if (!stream)
+			return false;
+		data.resize((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(data.data(), data.size());
+	}
+
+	STerrainShadows::Reader reader{ data };
+	uint32_t magic = 0, formatVersion = 0, directoryCount = 0, heightmapCount = 0;
+	if (!reader.Read(magic) || !reader.Read(formatVersion) || magic != STerrainShadows::Magic || formatVersion != STerrainShadows::FormatVersion ||
+		!reader.Read(directoryCount) || directoryCount > data.size())
+		return false;
+
+	// an added, removed or renamed file changes the modification time of the directory holding it
+	std::vector<DirectoryStamp> directories(directoryCount);
+	for (auto& directory : directories) {
+		if (!reader.ReadString(directory.path) || !reader.Read(directory.writeTime))
+			return false;
+		if (directory.writeTime != STerrainShadows::GetWriteTime(directory.path))
+			return false;
+	}
+
+	decltype(heightmaps) indexed;
+	if (!reader.Read(heightmapCount) || heightmapCount > data.size())
+		return false;
+	for (uint32_t i = 0; i < heightmapCount; i++) {
+		HeightMapMetadata metadata;
+		if (!reader.ReadString(metadata.dir) || !reader.ReadString(metadata.filename) || !reader.ReadString(metadata.worldspace) ||
+			!reader.Read(metadata.pos0) || !reader.Read(metadata.pos1) || !reader.Read(metadata.zRange)) {
+			logger::warn("Height map index {} is unreadable", HeightmapIndexPath);
+			return false;
+		}
+		auto worldspace = metadata.worldspace;
+		indexed.insert_or_assign(std::move(worldspace), std::move(metadata));
+	}
+
+	heightmaps = std::move(indexed);
+	heightmapDirectories = std::move(directories);
+	return true;
+}
+
+void TerrainShadows::SaveHeightmapIndex() const
+{
+	STerrainShadows::Writer writer;
+	writer.Write(STerrainShadows::Magic);
+	writer.Write(STerrainShadows::FormatVersion);
+
+	writer.Write((uint32_t)heightmapDirectories.size());
+	for (const auto& directory : heightmapDirectories) {
+		writer.WriteString<wchar_t>(directory.path);
+		writer.Write(directory.writeTime);
+	}
+
+	writer.Write((uint32_t)heightmaps.size());
+	for (const auto& metadata : heightmaps | std::views::values) {
+		writer.WriteString<wchar_t>(metadata.dir);
+		writer.WriteString<char>(metadata.filename);
+		writer.WriteString<char>(metadata.worldspace);
+		writer.Write(metadata.pos0);
+		writer.Write(metadata.pos1);
+		writer.Write(metadata.zRange);
+	}
+
+	std::error_code ec;
+	std::filesystem::create_directories(std::filesystem::path(HeightmapIndexPath).parent_path(), ec);
+	std::ofstream out(HeightmapIndexPath, std::ios::binary | std::ios::trunc);
+	out.write(writer.data.data(), writer.data.size());
+	if (!out)
+		logger::warn("Failed to write height map index {}", HeightmapIndexPath);
+}
+
+bool TerrainShadows::RescanHeightmapsOnce()
+{
+	if (!heightmapIndexFromDisk)
+		return false;
+	heightmapIndexFromDisk = false;
+
+	logger::info("Height map index {} may be stale, rescanning", HeightmapIndexPath);
+	std::optional<std::string> cachedWorldspace;
+	if (cachedHeightmap)
+		cachedWorldspace = cachedHeightmap->worldspace;
+
+	ScanHeightmaps();
+	SaveHeightmapIndex();
+
+	// the scan rebuilt heightmaps, which cachedHeightmap points into
+	cachedHeightmap = nullptr;
+	if (cachedWorldspace) {
+		if (auto it = heightmaps.find(*cachedWorldspace); it != heightmaps.end())
+			cachedHeightmap = &it->second;
+	}
+	return true;
+}
+
+void TerrainShadows::SetupResources()
+{
+	if (LoadHeightmapIndex()) {
+		logger::info("{} height maps loaded from {}", heightmaps.size(), HeightmapIndexPath);
+		heightmapIndexFromDisk = true;
+	} else {
+		ScanHeightmaps();
+		SaveHeightmapIndex();
+	}
 
 	logger::debug("Creating constant buffers...");
 	{
@@ -179,12 +397,22 @@ bool TerrainShadows::IsHeightMapReady()
 	return false;
 }
 
+void TerrainShadows::GetLevelRect(const ShadowLevel& a_level, float2& o_pos0, float2& o_extent) const
+{
+	const float2 mapPos0 = { cachedHeightmap->pos0.x, cachedHeightmap->pos0.y };
+	const float2 mapExtent = { cachedHeightmap->pos1.x - cachedHeightmap->pos0.x, cachedHeightmap->pos1.y - cachedHeightmap->pos0.y };
+	const float2 mipSize = { (float)a_level.mipSize[0], (float)a_level.mipSize[1] };
+	o_pos0 = mapPos0 + mapExtent * float2{ (float)a_level.window.origin[0], (float)a_level.window.origin[1] } / mipSize;
+	o_extent = mapExtent * float2{ (float)a_level.window.size[0], (float)a_level.window.size[1] } / mipSize;
+}
+
 TerrainShadows::PerFrame TerrainShadows::GetCommonBufferData()
 {
 	bool isHeightmapReady = IsHeightMapReady();
 
 	PerFrame data = {
 		.EnableTerrainShadow = settings.EnableTerrainShadow && isHeightmapReady,
+		.WindowBounds = { 1.f, 1.f, 0.f, 0.f },
 	};
 
 	if (isHeightmapReady) {
@@ -192,6 +420,17 @@ TerrainShadows::PerFrame TerrainShadows::GetCommonBufferData()
 		data.Scale = float3(1.f, 1.f, 1.f) / invScale;
 		data.Offset = -cachedHeightmap->pos0 * float2{ data.Scale.x, data.Scale.y };
 		data.ZRange = cachedHeightmap->zRange;
+
+		// the window takes over once a sweep has filled it, keeping half a texel from its edge for the filter
+		if (windowLevel.texShadowHeight && windowLevel.keptRect == ShadowSweep::Rect{ 0, 0, windowLevel.window.size[0], windowLevel.window.size[1] }) {
+			float2 windowPos0, windowExtent;
+			GetLevelRect(windowLevel, windowPos0, windowExtent);
+			data.WindowScale = float2(1.f, 1.f) / windowExtent;
+			data.WindowOffset = -windowPos0 * data.WindowScale;
+
+			const float2 halfTexel = { .5f / windowLevel.window.size[0], .5f / windowLevel.window.size[1] };
+			data.WindowBounds = { halfTexel.x, halfTexel.y, 1.f - halfTexel.x, 1.f - halfTexel.y };
+		}
 	}
 
 	return data;
@@ -199,6 +438,18 @@ TerrainShadows::PerFrame TerrainShadows::GetCommonBufferData()
 
 void TerrainShadows::LoadHeightmap()
 {
+	if (pendingHeightmap.valid() && pendingHeightmap.wait_for(std::chrono::seconds::zero()) == std::future_status::ready) {
+		if (auto loaded = pendingHeightmap.get(); loaded.source) {
+			BindShadowHeights(false);
+			heightmapSource = std::move(loaded.source);
+			coarseLevel = std::move(loaded.coarse);
+			windowLevel = {};
+			cachedHeightmap = &heightmaps[pendingWorldspace];
+		} else if (!RescanHeightmapsOnce()) {
+			heightmaps.erase(pendingWorldspace);  // unreadable, don't retry every frame
+		}
+	}
+
 	auto tes = RE::TES::GetSingleton();
 	if (!tes)
 		return;
@@ -206,84 +457,128 @@ void TerrainShadows::LoadHeightmap()
 	if (!worldspace)
 		return;
 	std::string worldspace_name = worldspace->GetFormEditorID();
-	if (!heightmaps.contains(worldspace_name))  // no height map for that, but we don't remove cache
+	if (!heightmaps.contains(worldspace_name) && !(RescanHeightmapsOnce() && heightmaps.contains(worldspace_name)))  // no height map for that, but we don't remove cache
 		return;
 	if (cachedHeightmap && cachedHeightmap->worldspace == worldspace_name)  // already cached
 		return;
-
-	auto& device = State::GetSingleton()->device;
+	if (pendingHeightmap.valid())  // one load at a time, a stale result is swapped out once it lands
+		return;
 
 	logger::debug("Loading height map...");
-	{
-		auto& target_heightmap = heightmaps[worldspace_name];
-
-		DirectX::ScratchImage image;
-		try {
-			std::filesystem::path path{ target_heightmap.dir };
-			path /= target_heightmap.filename;
+	pendingWorldspace = worldspace_name;
+	pendingHeightmap = std::async(std::launch::async, &TerrainShadows::DecodeHeightmap, heightmaps[worldspace_name]);
+}
 
-			DX::ThrowIfFailed(LoadFromDDSFile(path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, image));
-		} catch (const DX::com_exception& e) {
-			logger::error("{}", e.what());
-			return;
+TerrainShadows::LoadedHeightmap TerrainShadows::DecodeHeightmap(HeightMapMetadata a_heightmap)
+{
+	try {
+		auto source = std::make_shared<HeightmapSource>();
+		source->path = std::filesystem::path{ a_heightmap.dir } / a_heightmap.filename;
+
+		// only the coarse mip is kept; the window is read from the file again whenever it moves
+		auto image = std::make_unique<DirectX::ScratchImage>();
+		DX::ThrowIfFailed(LoadFromDDSFile(source->path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, *image));
+		source->mapSize = { (uint)image->GetMetadata().width, (uint)image->GetMetadata().height };
+		source->format = image->GetMetadata().format;
+		source->dataOffset = STerrainShadows::GetTopLevelOffset(source->path, image->GetMetadata());
+
+		// mips are generated from, and windows cut from, single texels, which block compression does not allow
+		if (DirectX::IsCompressed(image->GetMetadata().format)) {
+			auto decompressed = std::make_unique<DirectX::ScratchImage>();
+			DX::ThrowIfFailed(DirectX::Decompress(image->GetImages(), image->GetImageCount(), image->GetMetadata(), DXGI_FORMAT_R32_FLOAT, *decompressed));
+			image = std::move(decompressed);
 		}
 
-		ID3D11Resource* pResource = nullptr;
-		try {
-			DX::ThrowIfFailed(CreateTexture(device,
-				image.GetImages(), image.GetImageCount(),
-				image.GetMetadata(), &pResource));
-		} catch (const DX::com_exception& e) {
-			logger::error("{}", e.what());
-			return;
+		const uint coarseMip = ShadowSweep::GetCoarseMip(source->mapSize, CoarseLength);
+		if (image->GetMetadata().mipLevels <= coarseMip) {
+			auto mipChain = std::make_unique<DirectX::ScratchImage>();
+			DX::ThrowIfFailed(DirectX::GenerateMipMaps(*image->GetImage(0, 0, 0), DirectX::TEX_FILTER_DEFAULT, coarseMip + 1, *mipChain));
+			image = std::move(mipChain);
 		}
 
-		texHeightMap.release();
-		texHeightMap = std::make_unique<Texture2D>(reinterpret_cast<ID3D11Texture2D*>(pResource));
-
-		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {
-			.Format = texHeightMap->desc.Format,
-			.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D,
-			.Texture2D = {
-				.MostDetailedMip = 0,
-				.MipLevels = 1 }
-		};
-		texHeightMap->CreateSRV(srvDesc);
-
-		cachedHeightmap = &heightmaps[worldspace_name];
+		const auto& mip = *image->GetImage(coarseMip, 0, 0);
+		const std::array<uint, 2> coarseSize = { (uint)mip.width, (uint)mip.height };
+		LoadedHeightmap loaded{ .coarse = CreateLevel(mip, {}, coarseSize, { .size = coarseSize }) };
+		if (!loaded.coarse.texHeight)
+			return {};
+
+		logger::debug("{} loaded, {}x{} resident outside the window", a_heightmap.filename, coarseSize[0], coarseSize[1]);
+		if (!source->dataOffset)
+			logger::debug("{} is converted on load, so every window move loads the whole map", a_heightmap.filename);
+		loaded.source = std::move(source);
+		return loaded;
+	} catch (const DX::com_exception& e) {
+		logger::error("{}", e.what());
+		return {};
 	}
-
-	shadowUpdateIdx = 0;
-	needPrecompute = true;
 }
 
-void TerrainShadows::Precompute()
+TerrainShadows::ShadowLevel TerrainShadows::LoadWindow(const HeightmapSource& a_source, ShadowSweep::Window a_window)
 {
-	if (!cachedHeightmap)
-		return;
-
-	logger::info("Creating shadow texture...");
-	{
-		if (texShadowHeight) {
-			auto context = State::GetSingleton()->context;
+	try {
+		DirectX::ScratchImage image;
+		std::array<uint, 2> imageOrigin = {};
+		if (a_source.dataOffset) {
+			// only the rows of the window, in whole blocks for a block compressed map
+			const bool compressed = DirectX::IsCompressed(a_source.format);
+			const uint blockLength = compressed ? 4 : 1;
+			const uint blockBytes = (uint)DirectX::BitsPerPixel(a_source.format) * blockLength * blockLength / 8;
+			const auto rows = ShadowSweep::GetWindowRows(a_window, a_source.mapSize, blockLength, blockBytes);
+			DX::ThrowIfFailed(image.Initialize2D(a_source.format, rows.blocks.size[0], rows.blocks.size[1], 1, 1));
+
+			const auto& region = *image.GetImage(0, 0, 0);
+			std::ifstream file(a_source.path, std::ios::binary);
+			for (uint row = 0; row < rows.rowCount && file; ++row) {
+				file.seekg((std::streamoff)(a_source.dataOffset + rows.firstByte + row * rows.rowStride));
+				file.read(reinterpret_cast<char*>(region.pixels + row * region.rowPitch), (std::streamsize)rows.rowBytes);
+			}
+			if (!file) {
+				logger::error("Failed to read the window of {}", a_source.path.string());
+				return {};
+			}
+			imageOrigin = rows.blocks.origin;
+		} else {
+			DX::ThrowIfFailed(LoadFromDDSFile(a_source.path.c_str(), DirectX::DDS_FLAGS_NONE, nullptr, image));
+		}
 
-			std::array<ID3D11ShaderResourceView*, 1> srvs = { nullptr };
-			context->PSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-			context->CSSetShaderResources(60, (uint)srvs.size(), srvs.data());
+		if (DirectX::IsCompressed(image.GetMetadata().format)) {
+			DirectX::ScratchImage decompressed;
+			DX::ThrowIfFailed(DirectX::Decompress(*image.GetImage(0, 0, 0), DXGI_FORMAT_R32_FLOAT, decompressed));
+			image = std::move(decompressed);
 		}
+		return CreateLevel(*image.GetImage(0, 0, 0), imageOrigin, a_source.mapSize, a_window);
+	} catch (const DX::com_exception& e) {
+		logger::error("{}", e.what());
+		return {};
+	}
+}
 
-		texShadowHeight.release();
+TerrainShadows::ShadowLevel TerrainShadows::CreateLevel(const DirectX::Image& a_image, std::array<uint, 2> a_imageOrigin, std::array<uint, 2> a_mipSize, ShadowSweep::Window a_window)
+{
+	auto& device = State::GetSingleton()->device;
 
+	ShadowLevel level;
+	level.mipSize = a_mipSize;
+	level.window = a_window;
+	try {
 		D3D11_TEXTURE2D_DESC texDesc = {
-			.Width = texHeightMap->desc.Width,
-			.Height = texHeightMap->desc.Height,
+			.Width = a_window.size[0],
+			.Height = a_window.size[1],
 			.MipLevels = 1,
 			.ArraySize = 1,
-			.Format = DXGI_FORMAT_R16G16_FLOAT,
+			.Format = a_image.format,
 			.SampleDesc = { .Count = 1 },
-			.Usage = D3D11_USAGE_DEFAULT,
-			.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS
+			.Usage = D3D11_USAGE_IMMUTABLE,
+			.BindFlags = D3D11_BIND_SHADER_RESOURCE
 		};
+		const D3D11_SUBRESOURCE_DATA initialData = {
+			.pSysMem = a_image.pixels + (a_window.origin[1] - a_imageOrigin[1]) * a_image.rowPitch + (a_window.origin[0] - a_imageOrigin[0]) * DirectX::BitsPerPixel(a_image.format) / 8,
+			.SysMemPitch = (UINT)a_image.rowPitch
+		};
+		ID3D11Texture2D* pTexture = nullptr;
+		DX::ThrowIfFailed(device->CreateTexture2D(&texDesc, &initialData, &pTexture));
+		level.texHeight = std::make_unique<Texture2D>(pTexture);
+
 		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {
 			.Format = texDesc.Format,
 			.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D,
@@ -291,139 +586,273 @@ void TerrainShadows::Precompute()
 				.MostDetailedMip = 0,
 				.MipLevels = 1 }
 		};
+		level.texHeight->CreateSRV(srvDesc);
+
+		texDesc.Format = DXGI_FORMAT_R16G16_FLOAT;
+		texDesc.Usage = D3D11_USAGE_DEFAULT;
+		texDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_UNORDERED_ACCESS;
+		srvDesc.Format = texDesc.Format;
 		D3D11_UNORDERED_ACCESS_VIEW_DESC uavDesc = {
 			.Format = texDesc.Format,
 			.ViewDimension = D3D11_UAV_DIMENSION_TEXTURE2D,
 			.Texture2D = { .MipSlice = 0 }
 		};
 
-		texShadowHeight = std::make_unique<Texture2D>(texDesc);
-		texShadowHeight->CreateSRV(srvDesc);
-		texShadowHeight->CreateUAV(uavDesc);
+		level.texShadowHeight = std::make_unique<Texture2D>(texDesc);
+		level.texShadowHeight->CreateSRV(srvDesc);
+		level.texShadowHeight->CreateUAV(uavDesc);
+		return level;
+	} catch (const DX::com_exception& e) {
+		logger::error("{}", e.what());
+		return {};
 	}
-
-	needPrecompute = false;
 }
 
-void TerrainShadows::UpdateShadow()
+void TerrainShadows::UpdateWindow()
 {
-	if (!IsHeightMapReady())
+	if (pendingWindow.valid() && pendingWindow.wait_for(std::chrono::seconds::zero()) == std::future_status::ready) {
+		auto level = pendingWindow.get();
+		// a window cut from the map of the previous worldspace is dropped
+		if (level.texHeight && pendingWindowSource == heightmapSource) {
+			// heights both windows cover carry over, the first sweep fills in the rest
+			if (windowLevel.texShadowHeight) {
+				level.keptRect = ShadowSweep::GetOverlap(windowLevel.window, level.window);
+				if (level.keptRect[2] > level.keptRect[0]) {
+					const D3D11_BOX box = {
+						.left = level.keptRect[0] + level.window.origin[0] - windowLevel.window.origin[0],
+						.top = level.keptRect[1] + level.window.origin[1] - windowLevel.window.origin[1],
+						.front = 0,
+						.right = level.keptRect[2] + level.window.origin[0] - windowLevel.window.origin[0],
+						.bottom = level.keptRect[3] + level.window.origin[1] - windowLevel.window.origin[1],
+						.back = 1
+					};
+					State::GetSingleton()->context->CopySubresourceRegion(level.texShadowHeight->resource.get(), 0, level.keptRect[0], level.keptRect[1], 0,
+						windowLevel.texShadowHeight->resource.get(), 0, &box);
+				}
+			}
+			BindShadowHeights(false);
+			windowLevel = std::move(level);
+		}
+		pendingWindowSource.reset();
+	}
+
+	if (!heightmapSource || pendingWindow.valid())
 		return;
 
-	// don't forget to change NTHREADS in shader!
-	constexpr uint updateLength = 128u;
-	constexpr uint logUpdateLength = std::bit_width(128u) - 1;  // integer log2, https://stackoverflow.com/questions/994593/how-to-do-an-integer-log2-in-c
+	const auto mapSize = heightmapSource->mapSize;
+	if (coarseLevel.mipSize == mapSize)  // the coarse map is the full resolution one
+		return;
 
-	auto& context = State::GetSingleton()->context;
+	const auto eyePosition = Util::GetEyePosition(0);
+	const std::array<float, 2> eyePxCoord = {
+		(eyePosition.x - cachedHeightmap->pos0.x) / (cachedHeightmap->pos1.x - cachedHeightmap->pos0.x) * mapSize[0],
+		(eyePosition.y - cachedHeightmap->pos0.y) / (cachedHeightmap->pos1.y - cachedHeightmap->pos0.y) * mapSize[1]
+	};
+	if (windowLevel.texHeight && !ShadowSweep::IsOffCentre(windowLevel.window, eyePxCoord))
+		return;
+	const auto window = ShadowSweep::PlaceWindow(eyePxCoord, mapSize, WindowLength);
+	if (windowLevel.texHeight && window == windowLevel.window)  // held at the edge of the map
+		return;
+
+	pendingWindowSource = heightmapSource;
+	pendingWindow = std::async(std::launch::async, [source = heightmapSource, window]() {
+		return LoadWindow(*source, window);
+	});
+}
+
+void TerrainShadows::BindShadowHeights(bool a_bind)
+{
+	auto context = State::GetSingleton()->context;
 
-	if (texShadowHeight) {
-		std::array<ID3D11ShaderResourceView*, 1> srvs = { nullptr };
-		context->PSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-		context->CSSetShaderResources(60, (uint)srvs.size(), srvs.data());
+	std::array<ID3D11ShaderResourceView*, 2> srvs = { nullptr, nullptr };
+	if (a_bind) {
+		srvs[0] = coarseLevel.texShadowHeight ? coarseLevel.texShadowHeight->srv.get() : nullptr;
+		srvs[1] = windowLevel.texShadowHeight ? windowLevel.texShadowHeight->srv.get() : nullptr;
 	}
+	context->PSSetShaderResources(60, (uint)srvs.size(), srvs.data());
+	context->CSSetShaderResources(60, (uint)srvs.size(), srvs.data());
+}
+
+void TerrainShadows::UpdateShadow()
+{
+	if (!IsHeightMapReady() || !coarseLevel.texShadowHeight)
+		return;
 
 	auto accumulator = RE::BSGraphics::BSShaderAccumulator::GetCurrentAccumulator();
 	auto sunLight = skyrim_cast<RE::NiDirectionalLight*>(accumulator->GetRuntimeData().activeShadowSceneNode->GetRuntimeData().sunLight->light.get());
 	if (!sunLight)
 		return;
 
+	auto direction = sunLight->GetWorldDirection();
+	float3 dirLightDir = { direction.x, direction.y, direction.z };
+	if (dirLightDir.z > 0)
+		dirLightDir = -dirLightDir;
+	dirLightDir.Normalize();
+
+	BindShadowHeights(false);
+
 	ZoneScoped;
 	TracyD3D11Zone(State::GetSingleton()->tracyCtx, "Terrain Occlusion - Update Shadows");
 
+	/* ---- BACKUP ---- */
+	struct ShaderState
+	{
+		ID3D11ShaderResourceView* srvs[2] = { nullptr };
+		ID3D11ComputeShader* shader = nullptr;
+		ID3D11UnorderedAccessView* uavs[1] = { nullptr };
+		ID3D11Buffer* buffer = nullptr;
+	} old;
+
+	// the window continues the rays of the coarse map, so the coarse map goes first
+	UpdateShadow(coarseLevel, dirLightDir, nullptr);
+	if (windowLevel.texShadowHeight)
+		UpdateShadow(windowLevel, dirLightDir, &coarseLevel);
+
+	/* ---- RESTORE ---- */
+	auto& context = State::GetSingleton()->context;
+	context->CSSetShaderResources(0, ARRAYSIZE(old.srvs), old.srvs);
+	context->CSSetShader(old.shader, nullptr, 0);
+	context->CSSetUnorderedAccessViews(0, ARRAYSIZE(old.uavs), old.uavs, nullptr);
+	context->CSSetConstantBuffers(0, 1, &old.buffer);
+}
+
+void TerrainShadows::UpdateShadow(ShadowLevel& a_level, const float3& a_dirLightDir, const ShadowLevel* a_outer)
+{
+	auto& state = a_level.state;
+	auto angleBetween = [](const float3& a, const float3& b) { return std::acos(std::clamp(a.Dot(b), -1.f, 1.f)); };
+
+	// a jump (time skip, wait, weather script) abandons the running sweep rather than finishing it with a stale direction
+	if (state.sweepRunning && angleBetween(a_dirLightDir, state.cycleLightDir) > RestartSunAngle) {
+		state.cursor.Reset();
+		state.sweepRunning = false;
+		state.settledSweeps = 0;
+	}
+
+	const float pendingAngle = angleBetween(a_dirLightDir, state.shadowLightDir);
+	if (!state.sweepRunning) {
+		if (pendingAngle > RestartSunAngle)
+			state.settledSweeps = 0;
+
+		if (state.settledSweeps >= ConvergedSweeps && pendingAngle < StableSunAngle) {
+			state.budget = 0;
+			return;
+		}
+	}
+
+	// each sweep only blends half of its result in, so catch up at full budget after a jump, then scale with how far the sun has moved
+	state.budget = state.settledSweeps < ConvergedSweeps ? MaxSweepStepsPerFrame : std::clamp((uint)std::ceil(pendingAngle / BudgetSunAngle), 1u, MaxSweepStepsPerFrame);
+
+	auto& context = State::GetSingleton()->context;
+
 	/* ---- UPDATE CB ---- */
-	uint width = texHeightMap->desc.Width;
-	uint height = texHeightMap->desc.Height;
+	uint width = a_level.window.size[0];
+	uint height = a_level.window.size[1];
+	const ShadowSweep::Rect wholeRect = { 0, 0, width, height };
+
+	float2 levelPos0, levelExtent;
+	GetLevelRect(a_level, levelPos0, levelExtent);
 
 	// only update direction at the start of each cycle
-	static uint edgePxCoord;
-	static int signDir;
-	static uint maxUpdates;
-	if (shadowUpdateIdx == 0) {
-		auto direction = sunLight->GetWorldDirection();
-		float3 dirLightDir = { direction.x, direction.y, direction.z };
-		if (dirLightDir.z > 0)
-			dirLightDir = -dirLightDir;
+	if (!state.sweepRunning) {
+		state.sweepRunning = true;
+		state.cycleLightDir = a_dirLightDir;
 
 		// in UV
-		float3 invScale = cachedHeightmap->pos1 - cachedHeightmap->pos0;
-		invScale.z = cachedHeightmap->zRange.y - cachedHeightmap->zRange.x;
-		float3 dirLightPxDir = dirLightDir / invScale;
+		float3 invScale = { levelExtent.x, levelExtent.y, cachedHeightmap->zRange.y - cachedHeightmap->zRange.x };
+		float3 dirLightPxDir = a_dirLightDir / invScale;
 		dirLightPxDir.x *= width;
 		dirLightPxDir.y *= height;
 
+		auto eyePosNI = Util::GetEyePosition(0);
+		float2 eyeUV = { (eyePosNI.x - levelPos0.x) / invScale.x, (eyePosNI.y - levelPos0.y) / invScale.y };
+
 		float stepMult;
+		float eyePxCoord;
+		uint sweepStrips;
 		if (abs(dirLightPxDir.x) >= abs(dirLightPxDir.y)) {
 			stepMult = 1.f / abs(dirLightPxDir.x);
-			edgePxCoord = dirLightPxDir.x > 0 ? 0 : (width - 1);
-			signDir = dirLightPxDir.x > 0 ? 1 : -1;
-			maxUpdates = (width + updateLength - 1) >> logUpdateLength;
+			state.edgePxCoord = dirLightPxDir.x > 0 ? 0 : (width - 1);
+			state.signDir = dirLightPxDir.x > 0 ? 1 : -1;
+			sweepStrips = (width + SweepStepLength - 1) / SweepStepLength;
+			eyePxCoord = eyeUV.x * (float)width;
 		} else {
 			stepMult = 1.f / abs(dirLightPxDir.y);
-			edgePxCoord = dirLightPxDir.y > 0 ? 0 : height - 1;
-			signDir = dirLightPxDir.y > 0 ? 1 : -1;
-			maxUpdates = (height + updateLength - 1) >> logUpdateLength;
+			state.edgePxCoord = dirLightPxDir.y > 0 ? 0 : height - 1;
+			state.signDir = dirLightPxDir.y > 0 ? 1 : -1;
+			sweepStrips = (height + SweepStepLength - 1) / SweepStepLength;
+			eyePxCoord = eyeUV.y * (float)height;
 		}
 		dirLightPxDir *= stepMult;
 
-		shadowUpdateCBData.LightPxDir = { dirLightPxDir.x, dirLightPxDir.y };
+		state.lightPxDir = { dirLightPxDir.x, dirLightPxDir.y };
 
 		// soft shadow angles
-		float lenUV = float2{ dirLightDir.x, dirLightDir.y }.Length();
-		float dirLightAngle = atan2(-dirLightDir.z, lenUV);
+		float lenUV = float2{ a_dirLightDir.x, a_dirLightDir.y }.Length();
+		float dirLightAngle = atan2(-a_dirLightDir.z, lenUV);
 		float shadowSofteningRadiusAngle = 4.f * RE::NI_PI / 180.f;
 		float upperAngle = std::max(0.f, dirLightAngle - shadowSofteningRadiusAngle);
 		float lowerAngle = std::min(RE::NI_HALF_PI - 1e-2f, dirLightAngle + shadowSofteningRadiusAngle);
 
-		shadowUpdateCBData.LightDeltaZ = -(lenUV / invScale.z * stepMult) * float2{ std::tan(upperAngle), std::tan(lowerAngle) };
+		state.lightDeltaZ = -(lenUV / invScale.z * stepMult) * float2{ std::tan(upperAngle), std::tan(lowerAngle) };
+
+		// refine the strip under the eye first; it reads its neighbour's previous heights, which the ordered sweep then corrects.
+		// a moved window sweeps in order first, as the strip would blend in heights of texels not swept yet
+		std::optional<uint> eyeStrip;
+		const float eyeStep = (eyePxCoord - (float)state.edgePxCoord) * (float)state.signDir / (float)SweepStepLength;
+		if (eyeStep >= 1.f && eyeStep < (float)sweepStrips && a_level.keptRect == wholeRect)
+			eyeStrip = (uint)eyeStep;
+		state.cursor.Start(sweepStrips, eyeStrip);
 	}
 
-	shadowUpdateCBData.StartPxCoord = edgePxCoord + signDir * shadowUpdateIdx * updateLength;
-	shadowUpdateCBData.PxSize = { 1.f / texHeightMap->desc.Width, 1.f / texHeightMap->desc.Height };
+	shadowUpdateCBData.LightPxDir = state.lightPxDir;
+	shadowUpdateCBData.LightDeltaZ = state.lightDeltaZ;
+	shadowUpdateCBData.PxSize = { 1.f / width, 1.f / height };
 
 	shadowUpdateCBData.PosRange = { cachedHeightmap->pos0.z, cachedHeightmap->pos1.z };
 	shadowUpdateCBData.ZRange = cachedHeightmap->zRange;
 
-	shadowUpdateCB->Update(shadowUpdateCBData);
-
-	shadowUpdateIdx = (shadowUpdateIdx + 1) % maxUpdates;
-
-	/* ---- BACKUP ---- */
-	struct ShaderState
-	{
-		ID3D11ShaderResourceView* srvs[1] = { nullptr };
-		ID3D11ComputeShader* shader = nullptr;
-		ID3D11UnorderedAccessView* uavs[1] = { nullptr };
-		ID3D11Buffer* buffer = nullptr;
-	} old, newer;
+	shadowUpdateCBData.HasOuterMap = a_outer != nullptr;
+	shadowUpdateCBData.KeptRect = a_level.keptRect;
+	if (a_outer) {
+		// window texels are texels of the full resolution map, whose UV is the coarse map's
+		const float2 mapSize = { (float)a_level.mipSize[0], (float)a_level.mipSize[1] };
+		shadowUpdateCBData.OuterTransform = { width / mapSize.x, height / mapSize.y, a_level.window.origin[0] / mapSize.x, a_level.window.origin[1] / mapSize.y };
+	}
 
 	/* ---- DISPATCH ---- */
 
-	newer.srvs[0] = texHeightMap->srv.get();
-	newer.uavs[0] = texShadowHeight->uav.get();
-	newer.buffer = shadowUpdateCB->CB();
+	// the UAV first, a resource still bound as one would not bind as a shader resource
+	ID3D11UnorderedAccessView* uavs[1] = { a_level.texShadowHeight->uav.get() };
+	ID3D11ShaderResourceView* srvs[2] = { a_level.texHeight->srv.get(), a_outer ? a_outer->texShadowHeight->srv.get() : nullptr };
+	ID3D11Buffer* buffer = shadowUpdateCB->CB();
 
-	context->CSSetShaderResources(0, ARRAYSIZE(newer.srvs), newer.srvs);
-	context->CSSetUnorderedAccessViews(0, ARRAYSIZE(newer.uavs), newer.uavs, nullptr);
-	context->CSSetConstantBuffers(0, 1, &newer.buffer);
+	context->CSSetUnorderedAccessViews(0, ARRAYSIZE(uavs), uavs, nullptr);
+	context->CSSetShaderResources(0, ARRAYSIZE(srvs), srvs);
+	context->CSSetConstantBuffers(0, 1, &buffer);
 	context->CSSetShader(shadowUpdateProgram.get(), nullptr, 0);
-	context->Dispatch(abs(shadowUpdateCBData.LightPxDir.x) >= abs(shadowUpdateCBData.LightPxDir.y) ? height : width, 1, 1);
 
-	/* ---- RESTORE ---- */
-	context->CSSetShaderResources(0, ARRAYSIZE(old.srvs), old.srvs);
-	context->CSSetShader(old.shader, nullptr, 0);
-	context->CSSetUnorderedAccessViews(0, ARRAYSIZE(old.uavs), old.uavs, nullptr);
-	context->CSSetConstantBuffers(0, 1, &old.buffer);
+	for (uint step = 0; step < state.budget; ++step) {
+		const auto sweepStep = state.cursor.Advance();
+
+		shadowUpdateCBData.StartPxCoord = state.edgePxCoord + state.signDir * sweepStep.strip * SweepStepLength;
+		shadowUpdateCB->Update(shadowUpdateCBData);
+
+		context->Dispatch(abs(shadowUpdateCBData.LightPxDir.x) >= abs(shadowUpdateCBData.LightPxDir.y) ? height : width, 1, 1);
+
+		if (sweepStep.finishesSweep) {  // a sweep finished, the next one starts over with the then current sun
+			state.shadowLightDir = state.settledSweeps == 0 ? state.cycleLightDir : state.shadowLightDir + state.cycleLightDir;
+			state.shadowLightDir.Normalize();
+			state.settledSweeps++;
+			state.sweepRunning = false;
+			a_level.keptRect = wholeRect;
+			break;
+		}
+	}
 }
 
 void TerrainShadows::ReflectionsPrepass()
 {
-	if (texShadowHeight) {
-		auto context = State::GetSingleton()->context;
-
-		std::array<ID3D11ShaderResourceView*, 1> srvs = { texShadowHeight->srv.get() };
-		context->PSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-		context->CSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-	}
+	BindShadowHeights(true);
 }
 
 void TerrainShadows::EarlyPrepass()
@@ -433,16 +862,10 @@ void TerrainShadows::EarlyPrepass()
 	if (!settings.EnableTerrainShadow)
 		return;
 
-	if (needPrecompute)
-		Precompute();
+	if (IsHeightMapReady())
+		UpdateWindow();
 
 	UpdateShadow();
 
-	if (texShadowHeight) {
-		auto context = State::GetSingleton()->context;
-
-		std::array<ID3D11ShaderResourceView*, 1> srvs = { texShadowHeight->srv.get() };
-		context->PSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-		context->CSSetShaderResources(60, (uint)srvs.size(), srvs.data());
-	}
+	BindShadowHeights(true);
 }
@@ -2,8 +2,15 @@
 
 #include "Buffer.h"
 #include "Feature.h"
+#include "Features/TerrainShadows/ShadowSweep.h"
 
 #include <filesystem>
+#include <future>
+
+namespace DirectX
+{
+	struct Image;
+}
 
 struct TerrainShadows : public Feature
 {
@@ -23,8 +30,43 @@ struct TerrainShadows : public Feature
 		bool EnableTerrainShadow = true;
 	} settings;
 
-	bool needPrecompute = false;
-	uint shadowUpdateIdx = 0;
+	static constexpr uint SweepStepLength = ShadowSweep::StepLength;
+	static constexpr uint MaxSweepStepsPerFrame = 8u;  // dispatch budget while catching up with the sun
+	static constexpr uint ConvergedSweeps = 4u;        // sweeps after a jump before updates may stop
+	static constexpr float StableSunAngle = 0.001f;    // radians the sun may drift before another sweep runs
+	static constexpr float BudgetSunAngle = 0.002f;    // radians of pending sun movement per dispatch
+	static constexpr float RestartSunAngle = 0.035f;   // radians of sun jump that restarts a running sweep
+
+	struct ShadowUpdateState
+	{
+		float3 cycleLightDir;              // sun direction the running sweep was set up with
+		float3 shadowLightDir;             // sun direction the shadow heights approximate
+		uint settledSweeps = 0;            // sweeps finished since the last jump
+		bool sweepRunning = false;
+		uint budget = 0;                   // dispatches spent this frame
+		uint edgePxCoord = 0;
+		int signDir = 1;
+		float2 lightPxDir;                 // LightPxDir and LightDeltaZ of the running sweep
+		float2 lightDeltaZ;
+		ShadowSweep::Cursor cursor;
+	};
+
+	// the whole worldspace is resident at a coarse mip, the full resolution only in a window around the player
+	static constexpr uint CoarseLength = 1024u;  // texels along the longer side of the coarse map
+	static constexpr uint WindowLength = 1024u;  // full resolution texels along each side of the window
+
+	// one resident part of the height map and the shadow heights swept over it
+	struct ShadowLevel
+	{
+		std::unique_ptr<Texture2D> texHeight = nullptr;
+		std::unique_ptr<Texture2D> texShadowHeight = nullptr;
+		std::array<uint, 2> mipSize = {};  // texels of the whole map at the level's mip
+		ShadowSweep::Window window;        // texels of that mip the textures cover
+		ShadowSweep::Rect keptRect = {};   // texels swept before the window moved, only blended in until the next sweep ends
+		ShadowUpdateState state;
+	};
+	ShadowLevel coarseLevel;
+	ShadowLevel windowLevel;  // no textures while the coarse map is the full resolution one
 
 	struct HeightMapMetadata
 	{
@@ -37,15 +79,48 @@ struct TerrainShadows : public Feature
 	std::unordered_map<std::string, HeightMapMetadata> heightmaps;
 	HeightMapMetadata* cachedHeightmap;
 
+	struct DirectoryStamp
+	{
+		std::wstring path;
+		int64_t writeTime = 0;
+	};
+	std::vector<DirectoryStamp> heightmapDirectories;  // every directory the scan listed
+
+	// where the full resolution heights are read from whenever the window moves; none of them stay in memory
+	struct HeightmapSource
+	{
+		std::filesystem::path path;
+		std::array<uint, 2> mapSize = {};
+		DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN;  // of the top level in the file
+		size_t dataOffset = 0;                     // of the top level in the file, 0 if it is converted on load and only the whole map can be read
+	};
+
+	struct LoadedHeightmap
+	{
+		std::shared_ptr<const HeightmapSource> source;
+		ShadowLevel coarse;
+	};
+
+	// decoded and created off the render thread; the previous map stays bound (and shadows off) until it lands
+	std::future<LoadedHeightmap> pendingHeightmap;
+	std::string pendingWorldspace;
+	std::shared_ptr<const HeightmapSource> heightmapSource;
+
+	// read from heightmapSource off the render thread; the coarse map is sampled around the player until it lands
+	std::future<ShadowLevel> pendingWindow;
+	std::shared_ptr<const HeightmapSource> pendingWindowSource;
+
 	struct ShadowUpdateCB
 	{
 		float2 LightPxDir;   // direction on which light descends, from one pixel to next via dda
 		float2 LightDeltaZ;  // per LightUVDir, upper penumbra and lower, should be negative
 		uint StartPxCoord;
 		float2 PxSize;
-		uint pad0[1];
+		uint HasOuterMap;
 		float2 PosRange;
 		float2 ZRange;
+		float4 OuterTransform;  // window UV to coarse map UV, scale in xy and offset in zw
+		ShadowSweep::Rect KeptRect;
 	} shadowUpdateCBData;
 	static_assert(sizeof(ShadowUpdateCB) % 16 == 0);
 	std::unique_ptr<ConstantBuffer> shadowUpdateCB = nullptr;
@@ -56,18 +131,28 @@ struct TerrainShadows : public Feature
 		float3 Scale;
 		float2 ZRange;
 		float2 Offset;
+		float2 WindowScale;
+		float2 WindowOffset;
+		float4 WindowBounds;
 	};
 
 	PerFrame GetCommonBufferData();
 
 	winrt::com_ptr<ID3D11ComputeShader> shadowUpdateProgram = nullptr;
 
-	std::unique_ptr<Texture2D> texHeightMap = nullptr;
-	std::unique_ptr<Texture2D> texShadowHeight = nullptr;
-
 	bool IsHeightMapReady();
 
+	// heightmaps found by the last directory scan, reused while the scanned directories keep their modification times
+	static constexpr const char* HeightmapIndexPath = "Data\\SKSE\\Plugins\\CommunityShaders\\TerrainHeightmaps.bin";
+	// directory times are not reliable under a virtual file system (MO2), so an index read from disk is
+	// checked by one rescan the first time it misses a worldspace or names a map that fails to load
+	bool heightmapIndexFromDisk = false;
+
 	virtual void SetupResources() override;
+	void ScanHeightmaps();
+	bool LoadHeightmapIndex();
+	void SaveHeightmapIndex() const;
+	bool RescanHeightmapsOnce();
 	void ParseHeightmapPath(std::filesystem::path p, bool xlodgen_style);
 	void CompileComputeShaders();
 
@@ -75,8 +160,14 @@ struct TerrainShadows : public Feature
 
 	virtual void EarlyPrepass() override;
 	void LoadHeightmap();
-	void Precompute();
+	static LoadedHeightmap DecodeHeightmap(HeightMapMetadata a_heightmap);
+	static ShadowLevel LoadWindow(const HeightmapSource& a_source, ShadowSweep::Window a_window);
+	static ShadowLevel CreateLevel(const DirectX::Image& a_image, std::array<uint, 2> a_imageOrigin, std::array<uint, 2> a_mipSize, ShadowSweep::Window a_window);
+	void UpdateWindow();
+	void GetLevelRect(const ShadowLevel& a_level, float2& o_pos0, float2& o_extent) const;
 	void UpdateShadow();
+	void UpdateShadow(ShadowLevel& a_level, const float3& a_dirLightDir, const ShadowLevel* a_outer);
+	void BindShadowHeights(bool a_bind);
 
 	virtual void ReflectionsPrepass() override;
 
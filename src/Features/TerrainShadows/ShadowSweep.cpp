@@ -0,0 +1,307 @@
+#include "Features/TerrainShadows/ShadowSweep.h"
+
+namespace ShadowSweep
+{
+	void Cursor::Start(uint a_count, std::optional<uint> a_priority)
+	{
+		next = 0;
+		count = std::max(a_count, 1u);
+		priority = a_priority;
+	}
+
+	Cursor::Step Cursor::Advance()
+	{
+		if (priority) {
+			Step step{ .strip = *priority };
+			priority.reset();
+			return step;
+		}
+
+		Step step{ .strip = next, .finishesSweep = next + 1 >= count };
+		next = step.finishesSweep ? 0 : next + 1;
+		return step;
+	}
+
+	void Cursor::Reset()
+	{
+		next = 0;
+		priority.reset();
+	}
+
+	Window PlaceWindow(std::array<float, 2> a_centerPx, std::array<uint, 2> a_mapSize, uint a_length)
+	{
+		Window window;
+		for (size_t axis = 0; axis < 2; ++axis) {
+			window.size[axis] = std::min(a_length, a_mapSize[axis]);
+			const float snapped = std::round((a_centerPx[axis] - window.size[axis] * .5f) / TileLength) * TileLength;
+			window.origin[axis] = (uint)std::clamp(snapped, 0.f, (float)(a_mapSize[axis] - window.size[axis]));
+		}
+		return window;
+	}
+
+	bool IsOffCentre(const Window& a_window, std::array<float, 2> a_centerPx)
+	{
+		for (size_t axis = 0; axis < 2; ++axis) {
+			if (std::abs(a_centerPx[axis] - (a_window.origin[axis] + a_window.size[axis] * .5f)) > (float)TileLength)
+				return true;
+		}
+		return false;
+	}
+
+	Rect GetOverlap(const Window& a_previous, const Window& a_window)
+	{
+		Rect overlap;
+		for (size_t axis = 0; axis < 2; ++axis) {
+			const uint low = std::max(a_previous.origin[axis], a_window.origin[axis]);
+			const uint high = std::min(a_previous.origin[axis] + a_previous.size[axis], a_window.origin[axis] + a_window.size[axis]);
+			if (high <= low)
+				return {};
+			overlap[axis] = low - a_window.origin[axis];
+			overlap[axis + 2] = high - a_window.origin[axis];
+		}
+		return overlap;
+	}
+
+	uint GetCoarseMip(std::array<uint, 2> a_mapSize, uint a_maxLength)
+	{
+		uint mip = 0;
+		while (std::max(a_mapSize[0] >> mip, a_mapSize[1] >> mip) > a_maxLength)
+			++mip;
+		return mip;
+	}
+
+	WindowRows GetWindowRows(const Window& a_window, std::array<uint, 2> a_mapSize, uint a_blockLength, uint a_blockBytes)
+	{
+		WindowRows rows;
+		std::array<uint, 2> firstBlock;
+		std::array<uint, 2> blockCount;
+		for (size_t axis = 0; axis < 2; ++axis) {
+			firstBlock[axis] = a_window.origin[axis] / a_blockLength;
+			blockCount[axis] = (a_window.origin[axis] + a_window.size[axis] + a_blockLength - 1) / a_blockLength - firstBlock[axis];
+			rows.blocks.origin[axis] = firstBlock[axis] * a_blockLength;
+			rows.blocks.size[axis] = blockCount[axis] * a_blockLength;
+		}
+		rows.rowStride = (size_t)(a_mapSize[0] + a_blockLength - 1) / a_blockLength * a_blockBytes;
+		rows.firstByte = firstBlock[1] * rows.rowStride + (size_t)firstBlock[0] * a_blockBytes;
+		rows.rowBytes = (size_t)blockCount[0] * a_blockBytes;
+		rows.rowCount = blockCount[1];
+		return rows;
+	}
+
+	namespace
+	{
+		float Frac(float a_value)
+		{
+			return a_value - std::floor(a_value);
+		}
+
+		// texture loads out of bounds read zero
+		template <class T>
+		T Load(const std::vector<T>& a_texels, const Maps& a_maps, std::array<int, 2> a_pxCoord)
+		{
+			if (a_pxCoord[0] < 0 || a_pxCoord[1] < 0 || a_pxCoord[0] >= (int)a_maps.width || a_pxCoord[1] >= (int)a_maps.height)
+				return T{};
+			return a_texels[(size_t)a_pxCoord[1] * a_maps.width + a_pxCoord[0]];
+		}
+
+		// the lerp pair GetInterpolatedHeight and GetInterpolatedHeightRW fetch, and how to blend it
+		struct LerpPair
+		{
+			std::array<int, 2> a;
+			std::array<int, 2> b;
+			bool inBoundA;
+			bool inBoundB;
+			float t;
+		};
+
+		LerpPair GetLerpPair(const Maps& a_maps, std::array<float, 2> a_pxCoord, bool a_isVertical)
+		{
+			const float offsetX = a_isVertical ? .5f : 0.f;
+			const float offsetY = a_isVertical ? 0.f : .5f;
+			LerpPair pair{
+				.a = { (int)(a_pxCoord[0] - offsetX), (int)(a_pxCoord[1] - offsetY) },
+				.b = { (int)(a_pxCoord[0] + offsetX), (int)(a_pxCoord[1] + offsetY) },
+				.t = Frac((a_isVertical ? a_pxCoord[0] : a_pxCoord[1]) - .5f)
+			};
+			pair.inBoundA = pair.a[0] > 0 && pair.a[1] > 0;
+			pair.inBoundB = pair.b[0] < (int)a_maps.width && pair.b[1] < (int)a_maps.height;
+			return pair;
+		}
+
+		bool IsVertical(const Params& a_params)
+		{
+			return std::abs(a_params.lightPxDir[1]) > std::abs(a_params.lightPxDir[0]);
+		}
+
+		float NormalisedHeight(const Maps& a_maps, const Params& a_params, std::array<int, 2> a_pxCoord)
+		{
+			const float height = std::lerp(a_params.posRange[0], a_params.posRange[1], Load(a_maps.heightTexels, a_maps, a_pxCoord));
+			return (height - a_params.zRange[0]) / (a_params.zRange[1] - a_params.zRange[0]);
+		}
+
+		Heights InterpolatedShadowHeights(const Maps& a_maps, std::array<float, 2> a_pxCoord, bool a_isVertical)
+		{
+			const auto pair = GetLerpPair(a_maps, a_pxCoord, a_isVertical);
+			const auto heightA = Load(a_maps.shadowHeights, a_maps, pair.a);
+			const auto heightB = Load(a_maps.shadowHeights, a_maps, pair.b);
+			if (pair.inBoundA && pair.inBoundB)
+				return { std::lerp(heightA[0], heightB[0], pair.t), std::lerp(heightA[1], heightB[1], pair.t) };
+			return pair.inBoundA ? heightA : heightB;
+		}
+
+		// keeps whichever pair has the higher upper height, as the shader does
+		Heights Higher(const Heights& a_current, const Heights& a_sample)
+		{
+			return a_current[0] > a_sample[0] ? a_current : a_sample;
+		}
+	}
+
+	Heights SampleOuter(const OuterMap& a_outer, std::array<float, 2> a_uv)
+	{
+		const std::array<float, 2> uv = { a_uv[0] * a_outer.transform[0] + a_outer.transform[2], a_uv[1] * a_outer.transform[1] + a_outer.transform[3] };
+		const std::array<float, 2> pos = { uv[0] * a_outer.width - .5f, uv[1] * a_outer.height - .5f };
+		const std::array<float, 2> base = { std::floor(pos[0]), std::floor(pos[1]) };
+		auto load = [&](float a_x, float a_y) {
+			const auto x = (size_t)std::clamp((int)a_x, 0, (int)a_outer.width - 1);
+			const auto y = (size_t)std::clamp((int)a_y, 0, (int)a_outer.height - 1);
+			return a_outer.shadowHeights[y * a_outer.width + x];
+		};
+		const auto h00 = load(base[0], base[1]);
+		const auto h10 = load(base[0] + 1.f, base[1]);
+		const auto h01 = load(base[0], base[1] + 1.f);
+		const auto h11 = load(base[0] + 1.f, base[1] + 1.f);
+
+		const std::array<float, 2> t = { pos[0] - base[0], pos[1] - base[1] };
+		Heights result;
+		for (size_t i = 0; i < 2; ++i)
+			result[i] = std::lerp(std::lerp(h00[i], h10[i], t[0]), std::lerp(h01[i], h11[i], t[0]), t[1]);
+		return result;
+	}
+
+	float InterpolatedHeight(const Maps& a_maps, const Params& a_params, std::array<float, 2> a_pxCoord)
+	{
+		const auto pair = GetLerpPair(a_maps, a_pxCoord, IsVertical(a_params));
+		const float heightA = NormalisedHeight(a_maps, a_params, pair.a);
+		const float heightB = NormalisedHeight(a_maps, a_params, pair.b);
+		if (pair.inBoundA && pair.inBoundB)
+			return std::lerp(heightA, heightB, pair.t);
+		return pair.inBoundA ? heightA : heightB;
+	}
+
+	void Dispatch(Maps& a_maps, const Params& a_params, uint a_startPxCoord)
+	{
+		const bool isVertical = IsVertical(a_params);
+		const std::array<float, 2> dims = { (float)a_maps.width, (float)a_maps.height };
+		const std::array<float, 2> lightUVDir = { a_params.lightPxDir[0] / dims[0], a_params.lightPxDir[1] / dims[1] };
+		const uint groups = isVertical ? a_maps.width : a_maps.height;
+
+		struct Thread
+		{
+			bool valid;
+			std::array<float, 2> rawUV;
+			std::array<int, 2> px;
+			Heights past;
+		};
+		std::array<Thread, StepLength> threads;
+		std::array<Heights, StepLength> shared;
+		std::array<Heights, StepLength> scanned;
+
+		auto sameTile = [&](const std::array<float, 2>& a_uv, float a_steps) {
+			return std::floor(a_uv[0] - lightUVDir[0] * a_steps) == std::floor(a_uv[0]) &&
+			       std::floor(a_uv[1] - lightUVDir[1] * a_steps) == std::floor(a_uv[1]);
+		};
+
+		for (uint gid = 0; gid < groups; ++gid) {
+			const std::array<uint, 2> rayStartPxCoord = isVertical ? std::array<uint, 2>{ gid, a_startPxCoord } : std::array<uint, 2>{ a_startPxCoord, gid };
+			const std::array<float, 2> rayStartUV = { (rayStartPxCoord[0] + .5f) / dims[0], (rayStartPxCoord[1] + .5f) / dims[1] };
+
+			for (uint gtid = 0; gtid < StepLength; ++gtid) {
+				auto& thread = threads[gtid];
+				thread.rawUV = { rayStartUV[0] + gtid * lightUVDir[0], rayStartUV[1] + gtid * lightUVDir[1] };
+
+				const float majorUV = thread.rawUV[isVertical ? 1 : 0];
+				thread.valid = majorUV > 0 && majorUV < 1;
+				if (!thread.valid) {
+					shared[gtid] = {};
+					continue;
+				}
+
+				// wraparound
+				const std::array<float, 2> threadPxCoord = { Frac(thread.rawUV[0]) * dims[0], Frac(thread.rawUV[1]) * dims[1] };
+				thread.px = { (int)threadPxCoord[0], (int)threadPxCoord[1] };
+				thread.past = Load(a_maps.shadowHeights, a_maps, thread.px);
+
+				const float height = InterpolatedHeight(a_maps, a_params, threadPxCoord);
+				Heights heights = { height, height };
+
+				if (sameTile(thread.rawUV, 1.f)) {
+					// fetch last dispatch
+					if (gtid == 0) {
+						auto sampleHeights = InterpolatedShadowHeights(a_maps, { threadPxCoord[0] - a_params.lightPxDir[0], threadPxCoord[1] - a_params.lightPxDir[1] }, isVertical);
+						sampleHeights = { sampleHeights[0] + a_params.lightDeltaZ[0], sampleHeights[1] + a_params.lightDeltaZ[1] };
+						heights = Higher(heights, sampleHeights);
+					}
+				} else if (a_maps.outer) {
+					// the ray enters the window here, it continues from the outer map
+					auto sampleHeights = SampleOuter(*a_maps.outer, { Frac(thread.rawUV[0]) - lightUVDir[0], Frac(thread.rawUV[1]) - lightUVDir[1] });
+					sampleHeights = { sampleHeights[0] + a_params.lightDeltaZ[0], sampleHeights[1] + a_params.lightDeltaZ[1] };
+					heights = Higher(heights, sampleHeights);
+				}
+
+				shared[gtid] = heights;
+			}
+
+			// the same scan, reading the previous pass like the barriers between passes allow
+			for (uint offset = 1; offset < StepLength; offset <<= 1) {
+				scanned = shared;
+				for (uint gtid = offset; gtid < StepLength; ++gtid) {
+					if (threads[gtid].valid && sameTile(threads[gtid].rawUV, (float)offset)) {
+						const Heights sampleHeights = { shared[gtid - offset][0] + a_params.lightDeltaZ[0] * offset, shared[gtid - offset][1] + a_params.lightDeltaZ[1] * offset };
+						scanned[gtid] = Higher(shared[gtid], sampleHeights);
+					}
+				}
+				shared = scanned;
+			}
+
+			for (uint gtid = 0; gtid < StepLength; ++gtid) {
+				const auto& thread = threads[gtid];
+				if (thread.valid) {
+					const auto& kept = a_params.keptRect;
+					const float blend = (uint)thread.px[0] >= kept[0] && (uint)thread.px[1] >= kept[1] && (uint)thread.px[0] < kept[2] && (uint)thread.px[1] < kept[3] ? .5f : 1.f;
+					auto& texel = a_maps.shadowHeights[(size_t)thread.px[1] * a_maps.width + thread.px[0]];
+					texel = { std::lerp(thread.past[0], shared[gtid][0], blend), std::lerp(thread.past[1], shared[gtid][1], blend) };
+				}
+			}
+		}
+	}
+
+	std::vector<Heights> Converged(const Maps& a_maps, const Params& a_params)
+	{
+		const bool isVertical = IsVertical(a_params);
+		const uint majorDim = isVertical ? a_maps.height : a_maps.width;
+		const uint minorDim = isVertical ? a_maps.width : a_maps.height;
+		const bool forward = a_params.lightPxDir[isVertical ? 1 : 0] > 0;
+
+		std::vector<Heights> result(a_maps.shadowHeights.size());
+		for (uint ray = 0; ray < minorDim; ++ray) {
+			Heights carried = {};
+			for (uint i = 0; i < majorDim; ++i) {
+				const uint major = forward ? i : majorDim - 1 - i;
+				const std::array<uint, 2> px = isVertical ? std::array<uint, 2>{ ray, major } : std::array<uint, 2>{ major, ray };
+
+				const float height = InterpolatedHeight(a_maps, a_params, { px[0] + .5f, px[1] + .5f });
+				Heights heights = { height, height };
+				if (i > 0) {
+					heights = Higher(heights, { carried[0] + a_params.lightDeltaZ[0], carried[1] + a_params.lightDeltaZ[1] });
+				} else if (a_maps.outer) {
+					const auto entry = SampleOuter(*a_maps.outer, { (px[0] + .5f - a_params.lightPxDir[0]) / a_maps.width, (px[1] + .5f - a_params.lightPxDir[1]) / a_maps.height });
+					heights = Higher(heights, { entry[0] + a_params.lightDeltaZ[0], entry[1] + a_params.lightDeltaZ[1] });
+				}
+
+				result[(size_t)px[1] * a_maps.width + px[0]] = heights;
+				carried = heights;
+			}
+		}
+		return result;
+	}
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+// Sweep scheduling, placement of the full resolution window and a CPU reference of ShadowUpdate.cs.hlsl.
+// Free of game and D3D types so tools/Tests can build it.
+namespace ShadowSweep
+{
+	static constexpr uint StepLength = 128u;  // pixels along the light covered by one dispatch, NTHREADS in ShadowUpdate.cs.hlsl
+	static constexpr uint TileLength = 128u;  // the window moves in whole tiles of this many texels
+
+	using Rect = std::array<uint, 4>;  // texels from xy up to, not including, zw
+
+	/**
+	 * @brief Part of a map resident at full resolution, in texels of that map.
+	 */
+	struct Window
+	{
+		std::array<uint, 2> origin = {};
+		std::array<uint, 2> size = {};
+
+		bool operator==(const Window&) const = default;
+	};
+
+	/**
+	 * @brief Window of at most a_length texels per side around a_centerPx, on the tile grid and inside the map.
+	 */
+	Window PlaceWindow(std::array<float, 2> a_centerPx, std::array<uint, 2> a_mapSize, uint a_length);
+
+	/**
+	 * @brief Whether a_centerPx is more than a tile from the centre of a_window, so a move is due.
+	 */
+	bool IsOffCentre(const Window& a_window, std::array<float, 2> a_centerPx);
+
+	/**
+	 * @brief Texels of a_window that a_previous covered too, in texels of a_window; empty if they are disjoint.
+	 */
+	Rect GetOverlap(const Window& a_previous, const Window& a_window);
+
+	/**
+	 * @brief First mip of a map whose longer side is at most a_maxLength texels.
+	 */
+	uint GetCoarseMip(std::array<uint, 2> a_mapSize, uint a_maxLength);
+
+	/**
+	 * @brief Bytes of a map stored row by row that hold a window, so only those are read from its file.
+	 */
+	struct WindowRows
+	{
+		Window blocks;          // texels read: the window grown to whole blocks, which may reach into the padding of the last
+		size_t firstByte = 0;   // of the first row read, from the first texel of the map
+		size_t rowStride = 0;   // bytes from one row of blocks of the map to the next
+		size_t rowBytes = 0;    // bytes read from each row of blocks
+		uint rowCount = 0;
+	};
+
+	/**
+	 * @param a_blockLength Texels per side of a block: 4 for block compressed maps, 1 otherwise.
+	 * @param a_blockBytes Bytes per block.
+	 */
+	WindowRows GetWindowRows(const Window& a_window, std::array<uint, 2> a_mapSize, uint a_blockLength, uint a_blockBytes);
+
+	/**
+	 * @brief Order of the dispatches of one sweep: the strip under the eye first, then every strip from the lit edge.
+	 */
+	struct Cursor
+	{
+		struct Step
+		{
+			uint strip = 0;
+			bool finishesSweep = false;  // only the last strip of the ordered sweep, never the priority strip
+		};
+
+		uint next = 0;                 // next strip of the ordered sweep
+		uint count = 1;                // strips in one sweep
+		std::optional<uint> priority;  // strip under the eye, refined ahead of the ordered sweep
+
+		void Start(uint a_count, std::optional<uint> a_priority);
+		Step Advance();
+		void Reset();
+	};
+
+	using Heights = std::array<float, 2>;  // [upper, lower] penumbra
+
+	// ShadowUpdateCB without StartPxCoord, the derived PxSize and the outer map's part
+	struct Params
+	{
+		std::array<float, 2> lightPxDir;
+		std::array<float, 2> lightDeltaZ;
+		std::array<float, 2> posRange;
+		std::array<float, 2> zRange;
+		Rect keptRect = { 0, 0, UINT32_MAX, UINT32_MAX };  // texels blended with what they held, the rest are replaced
+	};
+
+	// coarse map of the whole worldspace a window continues its rays from where they enter it
+	struct OuterMap
+	{
+		uint width = 0;
+		uint height = 0;
+		std::vector<Heights> shadowHeights;   // TexOuterShadowHeights
+		std::array<float, 4> transform = {};  // OuterTransform: window UV to outer UV, scale in xy and offset in zw
+	};
+
+	struct Maps
+	{
+		uint width = 0;
+		uint height = 0;
+		std::vector<float> heightTexels;     // TexHeight
+		std::vector<Heights> shadowHeights;  // RWTexShadowHeights
+		const OuterMap* outer = nullptr;     // HasOuterMap
+	};
+
+	/**
+	 * @brief Runs one dispatch of ShadowUpdate.cs.hlsl over every ray of the strip starting at a_startPxCoord.
+	 */
+	void Dispatch(Maps& a_maps, const Params& a_params, uint a_startPxCoord);
+
+	/**
+	 * @brief Normalised, interpolated terrain height the shader reads at a_pxCoord.
+	 */
+	float InterpolatedHeight(const Maps& a_maps, const Params& a_params, std::array<float, 2> a_pxCoord);
+
+	/**
+	 * @brief Bilinear, edge clamped shadow heights of the outer map at window UV a_uv, as the shader filters them.
+	 */
+	Heights SampleOuter(const OuterMap& a_outer, std::array<float, 2> a_uv);
+
+	/**
+	 * @brief Converged shadow heights for an axis-aligned light, walking each full ray in one pass.
+	 * @details The sweep blends half of every result in, so repeated sweeps approach this from any start.
+	 */
+	std::vector<Heights> Converged(const Maps& a_maps, const Params& a_params);
+}
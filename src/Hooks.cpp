@@ -85,7 +85,7 @@ struct BSShader_LoadShaders
 				auto vertexShaderDesriptor = entry->id;
 				auto pixelShaderDescriptor = entry->id;
 				state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-				shaderCache->GetVertexShader(*shader, vertexShaderDesriptor);
+				shaderCache->QueuePrewarm(SIE::ShaderClass::Vertex, *shader, vertexShaderDesriptor);
 			}
 			for (const auto& entry : shader->pixelShaders) {
 				if (entry->shader && shaderCache->IsDump()) {
@@ -95,10 +95,11 @@ struct BSShader_LoadShaders
 				auto vertexShaderDesriptor = entry->id;
 				auto pixelShaderDescriptor = entry->id;
 				state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-				shaderCache->GetPixelShader(*shader, pixelShaderDescriptor);
+				shaderCache->QueuePrewarm(SIE::ShaderClass::Pixel, *shader, pixelShaderDescriptor);
 				state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor, true);
-				shaderCache->GetPixelShader(*shader, pixelShaderDescriptor);
+				shaderCache->QueuePrewarm(SIE::ShaderClass::Pixel, *shader, pixelShaderDescriptor);
 			}
+			shaderCache->SubmitPrewarm();
 		}
 		BSShaderHooks::hk_LoadShaders((REX::BSShader*)shader, stream);
 	};
@@ -122,6 +123,13 @@ bool Hooks::BSShader_BeginTechnique::thunk(RE::BSShader* shader, uint32_t vertex
 
 	state->ModifyShaderLookup(*shader, state->modifiedVertexDescriptor, state->modifiedPixelDescriptor);
 
+	if (shaderCache->IsEnabled()) {
+		shaderCache->RecordShaderUsage(SIE::ShaderClass::Vertex, *shader, state->modifiedVertexDescriptor);
+		if (!skipPixelShader) {
+			shaderCache->RecordShaderUsage(SIE::ShaderClass::Pixel, *shader, state->modifiedPixelDescriptor);
+		}
+	}
+
 	bool shaderFound = func(shader, vertexDescriptor, pixelDescriptor, skipPixelShader);
 
 	if (!shaderFound && shader->shaderType.get() != RE::BSShader::Type::Effect) {
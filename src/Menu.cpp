@@ -15,6 +15,7 @@
 #include "State.h"
 
 #include "Feature.h"
+#include "Features/LightLimitFix.h"
 #include "Features/LightLimitFix/ParticleLights.h"
 
 #include "Deferred.h"
@@ -284,6 +285,8 @@ void Menu::DrawSettings()
 			if (ImGui::Button("Load Settings", { -1, 0 })) {
 				State::GetSingleton()->Load();
 				ParticleLights::GetSingleton()->GetConfigs();
+				// cached references point into the replaced configs
+				LightLimitFix::GetSingleton()->particleLightsReferences.clear();
 			}
 
 			ImGui::TableNextColumn();
@@ -837,6 +840,13 @@ void Menu::DrawAdvancedSettings()
 				"Automatically recompile shaders on file change. "
 				"Intended for developing.");
 		}
+		ImGui::Checkbox("Prewarm Working Set Only", &shaderCache.prewarmWorkingSetOnly);
+		if (auto _tt = Util::HoverTooltipWrapper()) {
+			ImGui::Text(
+				"Only compile shaders at startup that previous sessions actually drew. "
+				"Other shaders compile the first time they are needed instead of in the background after loading. "
+				"Has no effect until a session has been played.");
+		}
 
 		if (ImGui::Button("Dump Ini Settings", { -1, 0 })) {
 			Util::DumpSettingsOptions();
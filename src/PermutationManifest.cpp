@@ -0,0 +1,297 @@
+#include "PermutationManifest.h"
+
+#include <fstream>
+
+namespace SIE
+{
+	namespace SPermutationManifest
+	{
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t stringCount;
+			uint32_t permutationCount;
+			uint32_t infoCount;
+			uint32_t context;  // ContextFlags
+		};
+		static_assert(sizeof(Header) == 24);
+
+		enum ContextFlags : uint32_t
+		{
+			DeveloperMode = 1 << 0,
+			VR = 1 << 1,
+		};
+
+		struct Writer
+		{
+			std::string data;
+
+			template <class T>
+			void Write(const T& a_value)
+			{
+				data.append(reinterpret_cast<const char*>(&a_value), sizeof(T));
+			}
+
+			void WriteString(std::string_view a_value)
+			{
+				Write(static_cast<uint16_t>(a_value.size()));
+				data.append(a_value);
+			}
+		};
+
+		struct Reader
+		{
+			const std::vector<char>& data;
+			size_t offset = 0;
+
+			template <class T>
+			bool Read(T& o_value)
+			{
+				if (offset + sizeof(T) > data.size()) {
+					return false;
+				}
+				memcpy(&o_value, data.data() + offset, sizeof(T));
+				offset += sizeof(T);
+				return true;
+			}
+
+			bool ReadString(std::string& o_value)
+			{
+				uint16_t size = 0;
+				if (!Read(size) || offset + size > data.size()) {
+					return false;
+				}
+				o_value.assign(data.data() + offset, size);
+				offset += size;
+				return true;
+			}
+		};
+	}
+
+	uint32_t PermutationManifest::Intern(std::string_view a_string)
+	{
+		auto [it, inserted] = stringIds.try_emplace(std::string(a_string), (uint32_t)strings.size());
+		if (inserted) {
+			strings.emplace_back(a_string);
+		}
+		return it->second;
+	}
+
+	void PermutationManifest::Add(std::string_view a_archive, std::string_view a_source, ShaderType a_type, ShaderClass a_class, uint32_t a_descriptor,
+		const D3D_SHADER_MACRO* a_gameDefines)
+	{
+		std::scoped_lock lock{ manifestMutex };
+		const auto archive = Intern(a_archive);
+		if (!keys[archive].insert(GetArchiveKey(static_cast<uint32_t>(a_class), a_descriptor)).second) {
+			return;
+		}
+
+		Permutation permutation{ archive, Intern(a_source), a_type, a_class, a_descriptor, {} };
+		for (auto define = a_gameDefines; define && define->Name; ++define) {
+			permutation.gameDefines.emplace_back(Intern(define->Name), define->Definition ? Intern(define->Definition) : NoDefinition);
+		}
+		permutations.push_back(std::move(permutation));
+	}
+
+	void PermutationManifest::SetCompileContext(const CompileContext& a_context)
+	{
+		std::scoped_lock lock{ manifestMutex };
+		developerMode = a_context.developerMode;
+		vr = a_context.vr;
+		globalDefines.clear();
+		for (const auto& [name, definition] : a_context.globalDefines) {
+			globalDefines.emplace_back(Intern(name), Intern(definition));
+		}
+		for (size_t type = 0; type < featureDefines.size(); ++type) {
+			featureDefines[type].clear();
+			for (const auto& name : a_context.featureDefines[type]) {
+				featureDefines[type].push_back(Intern(name));
+			}
+		}
+	}
+
+	void PermutationManifest::SetCacheInfo(std::vector<InfoValue> a_info)
+	{
+		std::scoped_lock lock{ manifestMutex };
+		info = std::move(a_info);
+	}
+
+	uint32_t PermutationManifest::GetFlags() const
+	{
+		return ShaderPermutations::GetCompileFlags(developerMode);
+	}
+
+	std::vector<D3D_SHADER_MACRO> PermutationManifest::GetDefines(const Permutation& a_permutation) const
+	{
+		auto toMacro = [&](const Define& a_define) -> D3D_SHADER_MACRO {
+			return { strings[a_define.first].c_str(), a_define.second != NoDefinition ? strings[a_define.second].c_str() : nullptr };
+		};
+
+		// same order as SShaderCache::GetCompileDefines
+		std::array<D3D_SHADER_MACRO, 64> built{};
+		std::vector<D3D_SHADER_MACRO> defines;
+		const auto classCount = ShaderPermutations::GetClassDefines(a_permutation.shaderClass, developerMode, vr, built);
+		defines.insert(defines.end(), built.begin(), built.begin() + classCount);
+		std::ranges::transform(globalDefines, std::back_inserter(defines), toMacro);
+		std::ranges::transform(a_permutation.gameDefines, std::back_inserter(defines), toMacro);
+		const auto descriptorCount = ShaderPermutations::GetDescriptorDefines(a_permutation.type, a_permutation.descriptor, built);
+		defines.insert(defines.end(), built.begin(), built.begin() + descriptorCount);
+		if (ShaderPermutations::HasFeatureDefines(a_permutation.type)) {
+			for (auto name : featureDefines[static_cast<size_t>(a_permutation.type)]) {
+				defines.push_back({ strings[name].c_str(), nullptr });
+			}
+		}
+		defines.push_back({ nullptr, nullptr });
+		return defines;
+	}
+
+	bool PermutationManifest::Load(const std::filesystem::path& a_path)
+	{
+		std::vector<char> data;
+		{
+			std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+			if (!stream) {
+				logger::error("Failed to open permutation manifest {}", a_path.string());
+				return false;
+			}
+			data.resize((size_t)stream.tellg());
+			stream.seekg(0);
+			stream.read(data.data(), data.size());
+		}
+
+		SPermutationManifest::Reader reader{ data };
+		SPermutationManifest::Header header{};
+		if (!reader.Read(header) || header.magic != Magic || header.version != FormatVersion) {
+			logger::error("Permutation manifest {} has an unknown format", a_path.string());
+			return false;
+		}
+
+		std::scoped_lock lock{ manifestMutex };
+		strings.clear();
+		stringIds.clear();
+		permutations.clear();
+		keys.clear();
+		info.clear();
+		globalDefines.clear();
+		developerMode = header.context & SPermutationManifest::DeveloperMode;
+		vr = header.context & SPermutationManifest::VR;
+
+		bool valid = true;
+		for (uint32_t i = 0; valid && i < header.stringCount; ++i) {
+			std::string string;
+			valid = reader.ReadString(string);
+			stringIds.try_emplace(string, i);
+			strings.push_back(std::move(string));
+		}
+		auto isString = [&](uint32_t a_id) { return a_id < strings.size(); };
+		auto readDefines = [&](std::vector<Define>& o_defines) {
+			uint32_t count = 0;
+			bool result = reader.Read(count);
+			for (uint32_t j = 0; result && j < count; ++j) {
+				Define define;
+				result = reader.Read(define.first) && reader.Read(define.second) && isString(define.first) &&
+				         (define.second == NoDefinition || isString(define.second));
+				o_defines.push_back(define);
+			}
+			return result;
+		};
+		valid = valid && readDefines(globalDefines);
+		for (auto& names : featureDefines) {
+			names.clear();
+			uint32_t count = 0;
+			valid = valid && reader.Read(count);
+			for (uint32_t j = 0; valid && j < count; ++j) {
+				uint32_t name = 0;
+				valid = reader.Read(name) && isString(name);
+				names.push_back(name);
+			}
+		}
+		for (uint32_t i = 0; valid && i < header.permutationCount; ++i) {
+			Permutation permutation{};
+			valid = reader.Read(permutation.archive) && reader.Read(permutation.source) && reader.Read(permutation.type) &&
+			        reader.Read(permutation.shaderClass) && reader.Read(permutation.descriptor) && readDefines(permutation.gameDefines) &&
+			        isString(permutation.archive) && isString(permutation.source) &&
+			        permutation.type < ShaderType::Total && permutation.shaderClass < ShaderClass::Total;
+			if (valid) {
+				keys[permutation.archive].insert(GetArchiveKey(static_cast<uint32_t>(permutation.shaderClass), permutation.descriptor));
+				permutations.push_back(std::move(permutation));
+			}
+		}
+		for (uint32_t i = 0; valid && i < header.infoCount; ++i) {
+			InfoValue value;
+			valid = reader.ReadString(value.section) && reader.ReadString(value.key) && reader.ReadString(value.value);
+			info.push_back(std::move(value));
+		}
+		if (!valid) {
+			logger::error("Permutation manifest {} is truncated", a_path.string());
+			return false;
+		}
+		logger::info("Loaded {} shader permutations from {}", permutations.size(), a_path.string());
+		return true;
+	}
+
+	bool PermutationManifest::Save(const std::filesystem::path& a_path)
+	{
+		SPermutationManifest::Writer writer;
+		size_t count = 0;
+		{
+			std::scoped_lock lock{ manifestMutex };
+			count = permutations.size();
+			const uint32_t context = (developerMode ? SPermutationManifest::DeveloperMode : 0) | (vr ? SPermutationManifest::VR : 0);
+			writer.Write(SPermutationManifest::Header{ Magic, FormatVersion, (uint32_t)strings.size(), (uint32_t)permutations.size(), (uint32_t)info.size(), context });
+			for (const auto& string : strings) {
+				writer.WriteString(string);
+			}
+			auto writeDefines = [&](const std::vector<Define>& a_defines) {
+				writer.Write((uint32_t)a_defines.size());
+				for (const auto& [name, definition] : a_defines) {
+					writer.Write(name);
+					writer.Write(definition);
+				}
+			};
+			writeDefines(globalDefines);
+			for (const auto& names : featureDefines) {
+				writer.Write((uint32_t)names.size());
+				for (auto name : names) {
+					writer.Write(name);
+				}
+			}
+			for (const auto& permutation : permutations) {
+				writer.Write(permutation.archive);
+				writer.Write(permutation.source);
+				writer.Write(permutation.type);
+				writer.Write(permutation.shaderClass);
+				writer.Write(permutation.descriptor);
+				writeDefines(permutation.gameDefines);
+			}
+			for (const auto& value : info) {
+				writer.WriteString(value.section);
+				writer.WriteString(value.key);
+				writer.WriteString(value.value);
+			}
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(a_path.parent_path(), ec);
+		const auto tempPath = std::filesystem::path(a_path).concat(".tmp");
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			out.write(writer.data.data(), writer.data.size());
+			if (!out) {
+				logger::error("Failed to write {}", tempPath.string());
+				out.close();
+				std::filesystem::remove(tempPath, ec);
+				return false;
+			}
+		}
+		std::filesystem::rename(tempPath, a_path, ec);
+		if (ec) {
+			logger::error("Failed to replace {}: {}", a_path.string(), ec.message());
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		logger::info("Saved {} shader permutations to {}", count, a_path.string());
+		return true;
+	}
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <d3dcommon.h>
+#include <deque>
+#include <mutex>
+
+#include "ShaderPermutations.h"
+
+namespace SIE
+{
+	/**
+	 * @brief Compile inputs of every shader permutation a session enumerated.
+	 *
+	 * The shader cache writes it next to Info.ini so the offline cache builder can rebuild the
+	 * disk cache without the game. Everything a permutation's class, type and descriptor
+	 * determine is rebuilt with ShaderPermutations; a permutation only keeps the defines the game
+	 * alone provides (the vanilla Lighting list and ImageSpace macros). The session's global and
+	 * feature defines are stored once. Strings are interned; permutations refer to them by id.
+	 */
+	class PermutationManifest
+	{
+	public:
+		static constexpr uint32_t Magic = 0x50535343;  // "CSSP"
+		static constexpr uint32_t FormatVersion = 2;
+		static constexpr uint32_t NoDefinition = UINT32_MAX;
+
+		using Define = std::pair<uint32_t, uint32_t>;  // name, definition or NoDefinition
+
+		struct Permutation
+		{
+			uint32_t archive;  // fxp filename, also the disk archive name
+			uint32_t source;   // shader file under Data/Shaders without extension
+			ShaderType type;
+			ShaderClass shaderClass;
+			uint32_t descriptor;
+			std::vector<Define> gameDefines;
+		};
+
+		/**
+		 * @brief Defines and flags shared by every permutation of a session.
+		 */
+		struct CompileContext
+		{
+			bool developerMode = false;
+			bool vr = false;
+			std::vector<std::pair<std::string, std::string>> globalDefines;                            // State::GetDefines()
+			std::array<std::vector<std::string>, static_cast<size_t>(ShaderType::Total)> featureDefines;  // per type, in feature order
+		};
+
+		struct InfoValue
+		{
+			std::string section;
+			std::string key;
+			std::string value;
+		};
+
+		/**
+		 * @brief Returns the key of a permutation within its disk archive.
+		 */
+		static uint64_t GetArchiveKey(uint32_t a_shaderClass, uint32_t a_descriptor)
+		{
+			return (static_cast<uint64_t>(a_shaderClass) << 32) | a_descriptor;
+		}
+
+		/**
+		 * @brief Adds a permutation unless its archive already has one with the same key.
+		 * @param a_gameDefines Null terminated macros only the game provides, or nullptr.
+		 */
+		void Add(std::string_view a_archive, std::string_view a_source, ShaderType a_type, ShaderClass a_class, uint32_t a_descriptor,
+			const D3D_SHADER_MACRO* a_gameDefines = nullptr);
+		/**
+		 * @brief Sets the defines and flags every permutation is compiled with.
+		 */
+		void SetCompileContext(const CompileContext& a_context);
+		/**
+		 * @brief Sets the values Info.ini is written with, so a rebuilt cache validates like one built in game.
+		 */
+		void SetCacheInfo(std::vector<InfoValue> a_info);
+
+		bool Load(const std::filesystem::path& a_path);
+		bool Save(const std::filesystem::path& a_path);
+
+		const std::vector<Permutation>& GetPermutations() const { return permutations; }
+		const std::vector<InfoValue>& GetCacheInfo() const { return info; }
+		const std::string& GetString(uint32_t a_id) const { return strings[a_id]; }
+		uint32_t GetFlags() const;
+		/**
+		 * @brief Builds the null terminated macro list of a permutation, in the order the plugin compiles it with.
+		 * @return Macros pointing into the manifest's strings or static storage.
+		 */
+		std::vector<D3D_SHADER_MACRO> GetDefines(const Permutation& a_permutation) const;
+
+	private:
+		uint32_t Intern(std::string_view a_string);
+
+		std::deque<std::string> strings;  // deque so macro lists handed out stay valid
+		ankerl::unordered_dense::map<std::string, uint32_t> stringIds;
+		std::vector<Permutation> permutations;
+		bool developerMode = false;
+		bool vr = false;
+		std::vector<Define> globalDefines;
+		std::array<std::vector<uint32_t>, static_cast<size_t>(ShaderType::Total)> featureDefines;
+		ankerl::unordered_dense::map<uint32_t, ankerl::unordered_dense::set<uint64_t>> keys;  // archive to keys already added
+		std::vector<InfoValue> info;
+		std::mutex manifestMutex;
+	};
+}
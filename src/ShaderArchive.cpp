@@ -0,0 +1,405 @@
+#include "ShaderArchive.h"
+
+#include <d3dcompiler.h>
+
+#include "Utils/Format.h"
+
+namespace SIE
+{
+	static int64_t ToArchiveTime(std::chrono::system_clock::time_point a_time)
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(a_time.time_since_epoch()).count();
+	}
+
+	static std::chrono::system_clock::time_point FromArchiveTime(int64_t a_time)
+	{
+		return std::chrono::system_clock::time_point(std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::milliseconds(a_time)));
+	}
+
+	static ID3DBlob* CreateBlob(const void* a_data, size_t a_size)
+	{
+		ID3DBlob* blob = nullptr;
+		if (FAILED(D3DCreateBlob(a_size, &blob))) {
+			return nullptr;
+		}
+		memcpy(blob->GetBufferPointer(), a_data, a_size);
+		return blob;
+	}
+
+	ShaderArchive::ShaderArchive(const std::wstring& a_basePath) :
+		archivePath(a_basePath + L".cache"),
+		journalPath(a_basePath + L".journal")
+	{}
+
+	ShaderArchive::~ShaderArchive()
+	{
+		Close();
+	}
+
+	bool ShaderArchive::Open()
+	{
+		std::scoped_lock lock{ archiveMutex };
+		closed = false;
+		Unmap();
+		journalEntries.clear();
+		journalSize = 0;
+		const bool mapped = Map();
+
+		// leftover journal from a previous session; fold it in so lookups only hit the mapping
+		std::error_code ec;
+		if (std::filesystem::exists(journalPath, ec) && !CompactLocked()) {
+			auto journalData = ReadJournalFile();
+			ParseJournal(journalData, journalEntries);
+			journalSize = journalData.size();
+		}
+		return mapped || entries;
+	}
+
+	void ShaderArchive::Close()
+	{
+		std::scoped_lock lock{ archiveMutex };
+		closed = true;
+		if (journal.is_open()) {
+			journal.close();
+		}
+		Unmap();
+	}
+
+	bool ShaderArchive::IsClosed()
+	{
+		std::scoped_lock lock{ archiveMutex };
+		return closed;
+	}
+
+	bool ShaderArchive::Map()
+	{
+		std::error_code ec;
+		if (!std::filesystem::exists(archivePath, ec)) {
+			return true;  // nothing cached yet
+		}
+
+#ifdef _WIN32
+		file = CreateFileW(archivePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			logger::error("Failed to open shader archive {}", Util::WStringToString(archivePath));
+			return false;
+		}
+
+		LARGE_INTEGER fileSize{};
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < (LONGLONG)sizeof(Header)) {
+			logger::warn("Shader archive {} is truncated; ignoring", Util::WStringToString(archivePath));
+			Unmap();
+			return false;
+		}
+
+		mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!mapping) {
+			logger::error("Failed to map shader archive {}", Util::WStringToString(archivePath));
+			Unmap();
+			return false;
+		}
+
+		view = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!view) {
+			logger::error("Failed to map view of shader archive {}", Util::WStringToString(archivePath));
+			Unmap();
+			return false;
+		}
+		viewSize = (size_t)fileSize.QuadPart;
+#else
+		std::ifstream stream(std::filesystem::path(archivePath), std::ios::binary | std::ios::ate);
+		if (!stream) {
+			logger::error("Failed to open shader archive {}", Util::WStringToString(archivePath));
+			return false;
+		}
+		contents.resize((size_t)stream.tellg());
+		stream.seekg(0);
+		if (contents.size() < sizeof(Header) || !stream.read(reinterpret_cast<char*>(contents.data()), contents.size())) {
+			logger::warn("Shader archive {} is truncated; ignoring", Util::WStringToString(archivePath));
+			Unmap();
+			return false;
+		}
+		view = contents.data();
+		viewSize = contents.size();
+#endif
+
+		const auto* header = reinterpret_cast<const Header*>(view);
+		if (header->magic != Magic || header->version != FormatVersion ||
+			sizeof(Header) + (size_t)header->entryCount * sizeof(Entry) > viewSize) {
+			logger::warn("Shader archive {} has an unknown format; ignoring", Util::WStringToString(archivePath));
+			Unmap();
+			return false;
+		}
+
+		entries = reinterpret_cast<const Entry*>(view + sizeof(Header));
+		entryCount = header->entryCount;
+		logger::debug("Mapped {} shaders from {}", entryCount, Util::WStringToString(archivePath));
+		return true;
+	}
+
+	void ShaderArchive::Unmap()
+	{
+#ifdef _WIN32
+		if (view) {
+			UnmapViewOfFile(view);
+			view = nullptr;
+		}
+		if (mapping) {
+			CloseHandle(mapping);
+			mapping = nullptr;
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+			file = INVALID_HANDLE_VALUE;
+		}
+#else
+		view = nullptr;
+		contents = {};
+#endif
+		viewSize = 0;
+		entries = nullptr;
+		entryCount = 0;
+	}
+
+	const ShaderArchive::Entry* ShaderArchive::FindMapped(uint64_t a_key) const
+	{
+		if (!entries) {
+			return nullptr;
+		}
+		const auto* end = entries + entryCount;
+		const auto* it = std::lower_bound(entries, end, a_key, [](const Entry& entry, uint64_t key) { return entry.key < key; });
+		if (it == end || it->key != a_key || it->offset + it->size > viewSize) {
+			return nullptr;
+		}
+		return it;
+	}
+
+	ID3DBlob* ShaderArchive::Read(uint64_t a_key, std::chrono::system_clock::time_point& o_writeTime)
+	{
+		std::scoped_lock lock{ archiveMutex };
+		if (auto it = journalEntries.find(a_key); it != journalEntries.end()) {
+			const auto& entry = it->second;
+			if (entry.size == 0) {
+				return nullptr;  // removed
+			}
+			// only written this session, so it is not part of the mapping yet
+			if (journal.is_open()) {
+				journal.flush();
+			}
+			std::ifstream stream(std::filesystem::path(journalPath), std::ios::binary);
+			std::vector<uint8_t> data(entry.size);
+			stream.seekg((std::streamoff)entry.offset);
+			if (!stream.read(reinterpret_cast<char*>(data.data()), entry.size)) {
+				return nullptr;
+			}
+			o_writeTime = FromArchiveTime(entry.writeTime);
+			return CreateBlob(data.data(), data.size());
+		}
+
+		if (const auto* entry = FindMapped(a_key)) {
+			o_writeTime = FromArchiveTime(entry->writeTime);
+			return CreateBlob(view + entry->offset, entry->size);
+		}
+		return nullptr;
+	}
+
+	bool ShaderArchive::AppendJournal(const JournalRecord& a_record, const void* a_data)
+	{
+		if (!journal.is_open()) {
+			std::error_code ec;
+			std::filesystem::create_directories(std::filesystem::path(journalPath).parent_path(), ec);
+			journal.open(std::filesystem::path(journalPath), std::ios::binary | std::ios::app);
+			if (!journal.is_open()) {
+				logger::error("Failed to open shader journal {}", Util::WStringToString(journalPath));
+				return false;
+			}
+		}
+		journal.write(reinterpret_cast<const char*>(&a_record), sizeof(a_record));
+		if (a_record.size) {
+			journal.write(static_cast<const char*>(a_data), a_record.size);
+		}
+		journal.flush();
+		if (!journal) {
+			logger::error("Failed to write shader journal {}", Util::WStringToString(journalPath));
+			journal.close();
+			return false;
+		}
+		journalEntries.insert_or_assign(a_record.key, JournalEntry{ journalSize + sizeof(a_record), a_record.size, a_record.writeTime });
+		journalSize += sizeof(a_record) + a_record.size;
+		return true;
+	}
+
+	bool ShaderArchive::Write(uint64_t a_key, ID3DBlob* a_blob)
+	{
+		if (!a_blob) {
+			return false;
+		}
+		std::scoped_lock lock{ archiveMutex };
+		if (closed) {
+			return false;
+		}
+		JournalRecord record{ JournalMagic, (uint32_t)a_blob->GetBufferSize(), a_key, ToArchiveTime(std::chrono::system_clock::now()) };
+		return AppendJournal(record, a_blob->GetBufferPointer());
+	}
+
+	void ShaderArchive::Erase(uint64_t a_key)
+	{
+		std::scoped_lock lock{ archiveMutex };
+		if (closed || (!FindMapped(a_key) && !journalEntries.contains(a_key))) {
+			return;
+		}
+		JournalRecord record{ JournalMagic, 0, a_key, ToArchiveTime(std::chrono::system_clock::now()) };
+		AppendJournal(record, nullptr);
+	}
+
+	std::vector<uint8_t> ShaderArchive::ReadJournalFile() const
+	{
+		std::vector<uint8_t> data;
+		std::ifstream stream(std::filesystem::path(journalPath), std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return data;
+		}
+		data.resize((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(reinterpret_cast<char*>(data.data()), data.size());
+		return data;
+	}
+
+	void ShaderArchive::ParseJournal(const std::vector<uint8_t>& a_journal, ankerl::unordered_dense::map<uint64_t, JournalEntry>& o_entries)
+	{
+		size_t offset = 0;
+		while (offset + sizeof(JournalRecord) <= a_journal.size()) {
+			JournalRecord record;
+			memcpy(&record, a_journal.data() + offset, sizeof(record));
+			if (record.magic != JournalMagic || offset + sizeof(record) + record.size > a_journal.size()) {
+				break;  // torn write at the end of the previous session
+			}
+			o_entries.insert_or_assign(record.key, JournalEntry{ offset + sizeof(record), record.size, record.writeTime });
+			offset += sizeof(record) + record.size;
+		}
+	}
+
+	bool ShaderArchive::Compact()
+	{
+		std::scoped_lock lock{ archiveMutex };
+		return !closed && CompactLocked();
+	}
+
+	bool ShaderArchive::CompactLocked()
+	{
+		if (journal.is_open()) {
+			journal.close();
+		}
+
+		std::error_code ec;
+		if (!std::filesystem::exists(journalPath, ec)) {
+			return false;
+		}
+
+		auto journalData = ReadJournalFile();
+		ankerl::unordered_dense::map<uint64_t, JournalEntry> pending;
+		ParseJournal(journalData, pending);
+
+		struct Source
+		{
+			uint64_t key;
+			const uint8_t* data;
+			uint32_t size;
+			int64_t writeTime;
+		};
+		std::vector<Source> merged;
+		merged.reserve(entryCount + pending.size());
+		for (uint32_t i = 0; i < entryCount; ++i) {
+			const auto& entry = entries[i];
+			if (!pending.contains(entry.key) && entry.offset + entry.size <= viewSize) {
+				merged.push_back({ entry.key, view + entry.offset, entry.size, entry.writeTime });
+			}
+		}
+		for (const auto& [key, entry] : pending) {
+			if (entry.size) {
+				merged.push_back({ key, journalData.data() + entry.offset, entry.size, entry.writeTime });
+			}
+		}
+		std::ranges::sort(merged, {}, &Source::key);
+
+		const auto tempPath = archivePath + L".tmp";
+		size_t uniqueCount = 0;
+		{
+			std::ofstream out(std::filesystem::path(tempPath), std::ios::binary | std::ios::trunc);
+			if (!out) {
+				logger::error("Failed to create {}", Util::WStringToString(tempPath));
+				return false;
+			}
+
+			Header header{ Magic, FormatVersion, (uint32_t)merged.size(), 0 };
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+			// permutations that compile to the same bytecode share one blob
+			ankerl::unordered_dense::map<uint64_t, std::vector<uint32_t>> blobsByHash;
+			std::vector<uint32_t> unique;
+			std::vector<uint64_t> offsets(merged.size());
+			uint64_t offset = sizeof(Header) + merged.size() * sizeof(Entry);
+			for (uint32_t i = 0; i < merged.size(); ++i) {
+				const auto& source = merged[i];
+				auto& candidates = blobsByHash[ankerl::unordered_dense::hash<std::string_view>{}(
+					std::string_view(reinterpret_cast<const char*>(source.data), source.size))];
+				auto it = std::ranges::find_if(candidates, [&](uint32_t a_index) {
+					return merged[a_index].size == source.size && std::memcmp(merged[a_index].data, source.data, source.size) == 0;
+				});
+				if (it != candidates.end()) {
+					offsets[i] = offsets[*it];
+					continue;
+				}
+				candidates.push_back(i);
+				unique.push_back(i);
+				offsets[i] = offset;
+				offset += source.size;
+			}
+			for (uint32_t i = 0; i < merged.size(); ++i) {
+				const auto& source = merged[i];
+				Entry entry{ source.key, offsets[i], source.size, 0, source.writeTime };
+				out.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+			}
+			for (auto index : unique) {
+				out.write(reinterpret_cast<const char*>(merged[index].data), merged[index].size);
+			}
+			uniqueCount = unique.size();
+			if (!out) {
+				logger::error("Failed to write {}", Util::WStringToString(tempPath));
+				out.close();
+				std::filesystem::remove(tempPath, ec);
+				return false;
+			}
+		}
+
+		// the old mapping is still referenced by merged until the new archive is written
+		Unmap();
+		std::filesystem::rename(tempPath, archivePath, ec);
+		if (ec) {
+			logger::error("Failed to replace {}: {}", Util::WStringToString(archivePath), ec.message());
+			std::filesystem::remove(tempPath, ec);
+			Map();
+			return false;
+		}
+		std::filesystem::remove(journalPath, ec);
+		journalEntries.clear();
+		journalSize = 0;
+		logger::debug("Compacted {} shaders ({} unique) into {}", merged.size(), uniqueCount, Util::WStringToString(archivePath));
+		return Map();
+	}
+
+	size_t ShaderArchive::GetEntryCount()
+	{
+		std::scoped_lock lock{ archiveMutex };
+		size_t count = entryCount;
+		for (const auto& [key, entry] : journalEntries) {
+			const bool mapped = FindMapped(key) != nullptr;
+			if (entry.size && !mapped) {
+				++count;
+			} else if (!entry.size && mapped) {
+				--count;
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <chrono>
+#include <d3dcommon.h>
+#include <fstream>
+#include <mutex>
+
+namespace SIE
+{
+	/**
+	 * @brief Packed on-disk store for the compiled permutations of a single shader file.
+	 *
+	 * The archive (`<name>.cache`) holds a header, a table of entries sorted by key and the
+	 * bytecode blobs. It is mapped read-only so lookups never touch the filesystem. Newly
+	 * compiled blobs and removals are appended to `<name>.journal` and merged into the
+	 * archive by Compact(), which stores identical blobs once and points their entries at it.
+	 */
+	class ShaderArchive
+	{
+	public:
+		static constexpr uint32_t Magic = 0x41535343;         // "CSSA"
+		static constexpr uint32_t JournalMagic = 0x4A535343;  // "CSSJ"
+		static constexpr uint32_t FormatVersion = 1;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t pad;
+		};
+		static_assert(sizeof(Header) == 16);
+
+		struct Entry
+		{
+			uint64_t key;
+			uint64_t offset;  // from start of file
+			uint32_t size;
+			uint32_t pad;
+			int64_t writeTime;  // milliseconds since system_clock epoch
+		};
+		static_assert(sizeof(Entry) == 32);
+
+		struct JournalRecord
+		{
+			uint32_t magic;
+			uint32_t size;  // 0 marks a removed entry
+			uint64_t key;
+			int64_t writeTime;
+		};
+		static_assert(sizeof(JournalRecord) == 24);
+
+		explicit ShaderArchive(const std::wstring& a_basePath);
+		~ShaderArchive();
+
+		ShaderArchive(const ShaderArchive&) = delete;
+		ShaderArchive& operator=(const ShaderArchive&) = delete;
+
+		/**
+		 * @brief Compacts any leftover journal and maps the archive.
+		 * @return true if the archive is usable (an empty cache counts as usable).
+		 */
+		bool Open();
+
+		/**
+		 * @brief Unmaps the archive and closes the journal. Until the next Open() the archive refuses
+		 * writes, erases and compaction, so compiles still holding it cannot recreate deleted files.
+		 */
+		void Close();
+		bool IsClosed();
+
+		/**
+		 * @brief Creates a blob for the given key.
+		 * @param a_key The permutation key.
+		 * @param o_writeTime Receives when the blob was stored.
+		 * @return The new blob (owned by caller) or nullptr if the key is absent.
+		 */
+		ID3DBlob* Read(uint64_t a_key, std::chrono::system_clock::time_point& o_writeTime);
+		bool Write(uint64_t a_key, ID3DBlob* a_blob);
+		void Erase(uint64_t a_key);
+
+		/**
+		 * @brief Merges the journal into a fresh archive and remaps it.
+		 * @return true if the archive was rewritten.
+		 */
+		bool Compact();
+
+		size_t GetEntryCount();
+
+	private:
+		struct JournalEntry
+		{
+			uint64_t offset;  // of the blob data within the journal
+			uint32_t size;
+			int64_t writeTime;
+		};
+
+		bool Map();
+		bool CompactLocked();
+		void Unmap();
+		const Entry* FindMapped(uint64_t a_key) const;
+		bool AppendJournal(const JournalRecord& a_record, const void* a_data);
+		std::vector<uint8_t> ReadJournalFile() const;
+		static void ParseJournal(const std::vector<uint8_t>& a_journal, ankerl::unordered_dense::map<uint64_t, JournalEntry>& o_entries);
+
+		std::wstring archivePath;
+		std::wstring journalPath;
+
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		std::vector<uint8_t> contents;  // read into memory where the archive cannot be mapped
+#endif
+		const uint8_t* view = nullptr;
+		size_t viewSize = 0;
+		const Entry* entries = nullptr;
+		uint32_t entryCount = 0;
+
+		std::ofstream journal;
+		uint64_t journalSize = 0;
+		ankerl::unordered_dense::map<uint64_t, JournalEntry> journalEntries;
+		bool closed = false;
+		std::mutex archiveMutex;
+	};
+}
@@ -20,555 +20,27 @@ namespace SIE
 	{
 		static void GetShaderDefines(const RE::BSShader&, uint32_t, D3D_SHADER_MACRO*);
 		static std::string GetShaderString(ShaderClass, const RE::BSShader&, uint32_t, bool = false);
-		/**
-		@brief Get the BSShader::Type from the ShaderString
-		@param a_key The key generated from GetShaderString
-		@return A string with a valid BSShader::Type
-		*/
-		static std::string GetTypeFromShaderString(const std::string&);
-		constexpr const char* VertexShaderProfile = "vs_5_0";
-		constexpr const char* PixelShaderProfile = "ps_5_0";
-		constexpr const char* ComputeShaderProfile = "cs_5_0";
+
+		// set while ShaderCache::RequestShaders collects tasks on this thread
+		static thread_local std::vector<ShaderCompilationTask>* pendingBatch = nullptr;
 
 		static std::wstring GetShaderPath(const std::string_view& name)
 		{
 			return std::format(L"Data/Shaders/{}.hlsl", std::wstring(name.begin(), name.end()));
 		}
 
-		static const char* GetShaderProfile(ShaderClass shaderClass)
-		{
-			switch (shaderClass) {
-			case ShaderClass::Vertex:
-				return VertexShaderProfile;
-			case ShaderClass::Pixel:
-				return PixelShaderProfile;
-			case ShaderClass::Compute:
-				return ComputeShaderProfile;
-			}
-			return nullptr;
-		}
-
 		uint32_t GetTechnique(uint32_t descriptor)
 		{
 			return 0x3F & (descriptor >> 24);
 		}
 
-		static void GetLightingShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		// vanilla writes the Lighting defines the descriptor's flags and technique select
+		static size_t GetVanillaLightingShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
 		{
 			static REL::Relocation<void(uint32_t, D3D_SHADER_MACRO*)> VanillaGetLightingShaderDefines(RELOCATION_ID(101631, 108698));
 			VanillaGetLightingShaderDefines(descriptor, defines.data());
 
-			size_t lastIndex = std::ranges::find_if(defines, [](const D3D_SHADER_MACRO& macro) { return macro.Name == nullptr; }) - defines.begin();
-
-			if (descriptor & static_cast<uint32_t>(ShaderCache::LightingShaderFlags::Deferred)) {
-				defines[lastIndex++] = { "DEFERRED", nullptr };
-			}
-			if ((descriptor & static_cast<uint32_t>(ShaderCache::LightingShaderFlags::TruePbr)) != 0) {
-				defines[lastIndex++] = { "TRUE_PBR", nullptr };
-				if ((descriptor & static_cast<uint32_t>(ShaderCache::LightingShaderFlags::AnisoLighting)) != 0) {
-					defines[lastIndex++] = { "GLINT", nullptr };
-				}
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Lighting)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetBloodSplaterShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			size_t lastIndex = 0;
-			if (descriptor == static_cast<uint32_t>(ShaderCache::BloodSplatterShaderTechniques::Splatter)) {
-				defines[lastIndex++] = { "SPLATTER", nullptr };
-			} else if (descriptor == static_cast<uint32_t>(ShaderCache::BloodSplatterShaderTechniques::Flare)) {
-				defines[lastIndex++] = { "FLARE", nullptr };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::BloodSplatter)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetDistantTreeShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			const auto technique = descriptor & 1;
-			size_t lastIndex = 0;
-			if (technique == static_cast<uint32_t>(ShaderCache::DistantTreeShaderTechniques::Depth)) {
-				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::DistantTreeShaderFlags::AlphaTest)) {
-				defines[lastIndex++] = { "DO_ALPHA_TEST", nullptr };
-			}
-
-			if (descriptor & static_cast<uint32_t>(ShaderCache::DistantTreeShaderFlags::Deferred)) {
-				defines[lastIndex++] = { "DEFERRED", nullptr };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::DistantTree)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetSkyShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			using enum ShaderCache::SkyShaderTechniques;
-
-			const auto technique = static_cast<ShaderCache::SkyShaderTechniques>(descriptor & 255);
-			size_t lastIndex = 0;
-			switch (technique) {
-			case SunOcclude:
-				{
-					defines[lastIndex++] = { "OCCLUSION", nullptr };
-					break;
-				}
-			case SunGlare:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					defines[lastIndex++] = { "DITHER", nullptr };
-					break;
-				}
-			case MoonAndStarsMask:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					defines[lastIndex++] = { "MOONMASK", nullptr };
-					break;
-				}
-			case Stars:
-				{
-					defines[lastIndex++] = { "HORIZFADE", nullptr };
-					break;
-				}
-			case Clouds:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					defines[lastIndex++] = { "CLOUDS", nullptr };
-					break;
-				}
-			case CloudsLerp:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					defines[lastIndex++] = { "CLOUDS", nullptr };
-					defines[lastIndex++] = { "TEXLERP", nullptr };
-					break;
-				}
-			case CloudsFade:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					defines[lastIndex++] = { "CLOUDS", nullptr };
-					defines[lastIndex++] = { "TEXFADE", nullptr };
-					break;
-				}
-			case Texture:
-				{
-					defines[lastIndex++] = { "TEX", nullptr };
-					break;
-				}
-			case Sky:
-				{
-					defines[lastIndex++] = { "DITHER", nullptr };
-					break;
-				}
-			}
-
-			uint32_t flags = descriptor >> 8;
-
-			if (flags) {
-				defines[lastIndex++] = { "DEFERRED", nullptr };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Sky)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetGrassShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			const auto technique = descriptor & 0b1111;
-			size_t lastIndex = 0;
-			if (technique == static_cast<uint32_t>(ShaderCache::GrassShaderTechniques::RenderDepth)) {
-				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
-			} else if (technique == static_cast<uint32_t>(ShaderCache::GrassShaderTechniques::TruePbr)) {
-				defines[lastIndex++] = { "TRUE_PBR", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::GrassShaderFlags::AlphaTest)) {
-				defines[lastIndex++] = { "DO_ALPHA_TEST", nullptr };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Grass)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetParticleShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			using enum ShaderCache::ParticleShaderTechniques;
-
-			const auto technique = static_cast<ShaderCache::ParticleShaderTechniques>(descriptor);
-			size_t lastIndex = 0;
-			switch (technique) {
-			case ParticlesGryColor:
-				{
-					defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
-					break;
-				}
-			case ParticlesGryAlpha:
-				{
-					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
-					break;
-				}
-			case ParticlesGryColorAlpha:
-				{
-					defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
-					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
-					break;
-				}
-			case EnvCubeSnow:
-				{
-					defines[lastIndex++] = { "ENVCUBE", nullptr };
-					defines[lastIndex++] = { "SNOW", nullptr };
-					break;
-				}
-			case EnvCubeRain:
-				{
-					defines[lastIndex++] = { "ENVCUBE", nullptr };
-					defines[lastIndex++] = { "RAIN", nullptr };
-					break;
-				}
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Particle)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetEffectShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			size_t lastIndex = 0;
-
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Vc)) {
-				defines[lastIndex++] = { "VC", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::TexCoord)) {
-				defines[lastIndex++] = { "TEXCOORD", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::TexCoordIndex)) {
-				defines[lastIndex++] = { "TEXCOORD_INDEX", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Skinned)) {
-				defines[lastIndex++] = { "SKINNED", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Normals)) {
-				defines[lastIndex++] = { "NORMALS", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::BinormalTangent)) {
-				defines[lastIndex++] = { "BINORMAL_TANGENT", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Texture)) {
-				defines[lastIndex++] = { "TEXTURE", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::IndexedTexture)) {
-				defines[lastIndex++] = { "INDEXED_TEXTURE", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Falloff)) {
-				defines[lastIndex++] = { "FALLOFF", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::AddBlend)) {
-				defines[lastIndex++] = { "ADDBLEND", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::MultBlend)) {
-				defines[lastIndex++] = { "MULTBLEND", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Particles)) {
-				defines[lastIndex++] = { "PARTICLES", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::StripParticles)) {
-				defines[lastIndex++] = { "STRIP_PARTICLES", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Blood)) {
-				defines[lastIndex++] = { "BLOOD", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Membrane)) {
-				defines[lastIndex++] = { "MEMBRANE", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Lighting)) {
-				defines[lastIndex++] = { "LIGHTING", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::ProjectedUv)) {
-				defines[lastIndex++] = { "PROJECTED_UV", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Soft)) {
-				defines[lastIndex++] = { "SOFT", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::GrayscaleToColor)) {
-				defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::GrayscaleToAlpha)) {
-				defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::IgnoreTexAlpha)) {
-				defines[lastIndex++] = { "IGNORE_TEX_ALPHA", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::MultBlendDecal)) {
-				defines[lastIndex++] = { "MULTBLEND_DECAL", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::AlphaTest)) {
-				defines[lastIndex++] = { "ALPHA_TEST", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::SkyObject)) {
-				defines[lastIndex++] = { "SKY_OBJECT", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::MsnSpuSkinned)) {
-				defines[lastIndex++] = { "MSN_SPU_SKINNED", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::MotionVectorsNormals)) {
-				defines[lastIndex++] = { "MOTIONVECTORS_NORMALS", nullptr };
-			}
-
-			if (descriptor & static_cast<uint32_t>(ShaderCache::EffectShaderFlags::Deferred)) {
-				defines[lastIndex++] = { "DEFERRED", nullptr };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Effect)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetWaterShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			size_t lastIndex = 0;
-			defines[lastIndex++] = { "WATER", nullptr };
-			defines[lastIndex++] = { "FOG", nullptr };
-
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Vc)) {
-				defines[lastIndex++] = { "VC", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::NormalTexCoord)) {
-				defines[lastIndex++] = { "NORMAL_TEXCOORD", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Reflections)) {
-				defines[lastIndex++] = { "REFLECTIONS", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Refractions)) {
-				defines[lastIndex++] = { "REFRACTIONS", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Depth)) {
-				defines[lastIndex++] = { "DEPTH", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Interior)) {
-				defines[lastIndex++] = { "INTERIOR", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Wading)) {
-				defines[lastIndex++] = { "WADING", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::VertexAlphaDepth)) {
-				defines[lastIndex++] = { "VERTEX_ALPHA_DEPTH", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Cubemap)) {
-				defines[lastIndex++] = { "CUBEMAP", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::Flowmap)) {
-				defines[lastIndex++] = { "FLOWMAP", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(ShaderCache::WaterShaderFlags::BlendNormals)) {
-				defines[lastIndex++] = { "BLEND_NORMALS", nullptr };
-			}
-
-			const auto technique = (descriptor >> 11) & 0xF;
-			if (technique == static_cast<uint32_t>(ShaderCache::WaterShaderTechniques::Underwater)) {
-				defines[lastIndex++] = { "UNDERWATER", nullptr };
-			} else if (technique == static_cast<uint32_t>(ShaderCache::WaterShaderTechniques::Lod)) {
-				defines[lastIndex++] = { "LOD", nullptr };
-			} else if (technique == static_cast<uint32_t>(ShaderCache::WaterShaderTechniques::Stencil)) {
-				defines[lastIndex++] = { "STENCIL", nullptr };
-			} else if (technique == static_cast<uint32_t>(ShaderCache::WaterShaderTechniques::Simple)) {
-				defines[lastIndex++] = { "SIMPLE", nullptr };
-			} else if (technique < 8) {
-				static constexpr std::array<const char*, 8> numLightDefines = { { "0", "1", "2", "3", "4",
-					"5", "6", "7" } };
-				defines[lastIndex++] = { "SPECULAR", nullptr };
-				defines[lastIndex++] = { "NUM_SPECULAR_LIGHTS", numLightDefines[technique] };
-			}
-
-			for (auto* feature : Feature::GetFeatureList()) {
-				if (feature->loaded && feature->HasShaderDefine(RE::BSShader::Type::Water)) {
-					defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
-				}
-			}
-
-			defines[lastIndex] = { nullptr, nullptr };
-		}
-
-		static void GetUtilityShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
-		{
-			using enum ShaderCache::UtilityShaderFlags;
-
-			size_t lastIndex = 0;
-
-			if (descriptor & static_cast<uint32_t>(Vc)) {
-				defines[lastIndex++] = { "VC", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(Texture)) {
-				defines[lastIndex++] = { "TEXTURE", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(Skinned)) {
-				defines[lastIndex++] = { "SKINNED", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(Normals)) {
-				defines[lastIndex++] = { "NORMALS", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(AlphaTest)) {
-				defines[lastIndex++] = { "ALPHA_TEST", nullptr };
-			}
-
-			if (descriptor & static_cast<uint32_t>(LodLandscape)) {
-				if (descriptor &
-					(static_cast<uint32_t>(RenderShadowmask) |
-						static_cast<uint32_t>(RenderShadowmaskSpot))) {
-					defines[lastIndex++] = { "FOCUS_SHADOW", nullptr };
-				} else {
-					defines[lastIndex++] = { "LOD_LANDSCAPE", nullptr };
-				}
-			}
-
-			if ((descriptor & static_cast<uint32_t>(RenderNormal)) &&
-				!(descriptor & static_cast<uint32_t>(RenderNormalClear))) {
-				defines[lastIndex++] = { "RENDER_NORMAL", nullptr };
-
-			} else if (!(descriptor & static_cast<uint32_t>(RenderNormal)) &&
-					   (descriptor & static_cast<uint32_t>(RenderNormalClear))) {
-				defines[lastIndex++] = { "RENDER_NORMAL_CLEAR", nullptr };
-
-			} else if ((descriptor & static_cast<uint32_t>(RenderNormal)) &&
-					   (descriptor & static_cast<uint32_t>(RenderNormalClear))) {
-				defines[lastIndex++] = { "STENCIL_ABOVE_WATER", nullptr };
-			}
-
-			if (descriptor & static_cast<uint32_t>(RenderNormalFalloff)) {
-				defines[lastIndex++] = { "RENDER_NORMAL_FALLOFF", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderNormalClamp)) {
-				defines[lastIndex++] = { "RENDER_NORMAL_CLAMP", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderDepth)) {
-				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
-			}
-
-			if (descriptor & static_cast<uint32_t>(OpaqueEffect)) {
-				defines[lastIndex++] = { "OPAQUE_EFFECT", nullptr };
-
-				if (!(descriptor & static_cast<uint32_t>(RenderShadowmap)) &&
-					(descriptor & static_cast<uint32_t>(AdditionalAlphaMask))) {
-					defines[lastIndex++] = { "ADDITIONAL_ALPHA_MASK", nullptr };
-				}
-				if (descriptor & static_cast<uint32_t>(GrayscaleToAlpha)) {
-					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
-				}
-			} else {
-				if (descriptor & static_cast<uint32_t>(RenderShadowmap)) {
-					defines[lastIndex++] = { "RENDER_SHADOWMAP", nullptr };
-
-					if (descriptor & static_cast<uint32_t>(RenderShadowmapPb)) {
-						defines[lastIndex++] = { "RENDER_SHADOWMAP_PB", nullptr };
-					}
-				} else if (descriptor &
-						   static_cast<uint32_t>(AdditionalAlphaMask)) {
-					defines[lastIndex++] = { "ADDITIONAL_ALPHA_MASK", nullptr };
-				}
-				if (descriptor & static_cast<uint32_t>(RenderShadowmapClamped)) {
-					defines[lastIndex++] = { "RENDER_SHADOWMAP_CLAMPED", nullptr };
-				}
-			}
-
-			if (descriptor & static_cast<uint32_t>(GrayscaleMask)) {
-				defines[lastIndex++] = { "GRAYSCALE_MASK", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderShadowmask)) {
-				defines[lastIndex++] = { "RENDER_SHADOWMASK", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderShadowmaskSpot)) {
-				defines[lastIndex++] = { "RENDER_SHADOWMASKSPOT", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderShadowmaskPb)) {
-				defines[lastIndex++] = { "RENDER_SHADOWMASKPB", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderShadowmaskDpb)) {
-				defines[lastIndex++] = { "RENDER_SHADOWMASKDPB", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(RenderBaseTexture)) {
-				defines[lastIndex++] = { "RENDER_BASE_TEXTURE", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(TreeAnim)) {
-				defines[lastIndex++] = { "TREE_ANIM", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(LodObject)) {
-				defines[lastIndex++] = { "LOD_OBJECT", nullptr };
-			}
-			if (descriptor & static_cast<uint32_t>(LocalMapFogOfWar)) {
-				defines[lastIndex++] = { "LOCALMAP_FOGOFWAR", nullptr };
-			}
-
-			if (descriptor & (static_cast<uint32_t>(RenderShadowmask) |
-								 static_cast<uint32_t>(RenderShadowmaskDpb) |
-								 static_cast<uint32_t>(RenderShadowmaskPb) |
-								 static_cast<uint32_t>(RenderShadowmaskSpot))) {
-				static constexpr std::array<const char*, 5> shadowFilters = { { "0", "1", "2",
-					"3", "4" } };
-				const size_t shadowFilterIndex = std::clamp((descriptor >> 17) & 0b111, 0u, 4u);
-				defines[lastIndex++] = { "SHADOWFILTER", shadowFilters[shadowFilterIndex] };
-			} else if ((!(descriptor & static_cast<uint32_t>(OpaqueEffect)) &&
-						   (descriptor &
-							   static_cast<uint32_t>(RenderShadowmap))) ||
-					   (descriptor & static_cast<uint32_t>(RenderDepth))) {
-				if (descriptor & static_cast<uint32_t>(DepthWriteDecals)) {
-					defines[lastIndex++] = { "DEPTH_WRITE_DECALS", nullptr };
-				}
-			} else {
-				if (descriptor & (static_cast<uint32_t>(DepthWriteDecals) |
-									 static_cast<uint32_t>(DebugColor))) {
-					defines[lastIndex++] = { "DEBUG_COLOR", nullptr };
-				}
-				if (descriptor & static_cast<uint32_t>(DebugShadowSplit)) {
-					defines[lastIndex++] = { "DEBUG_SHADOWSPLIT", nullptr };
-				}
-			}
-
-			defines[lastIndex++] = { "SHADOWSPLITCOUNT", "3" };
-
-			if ((descriptor & 0x14000) != 0x14000 &&
-				((descriptor & 0x20004000) == 0x4000 || (descriptor & 0x1E02000) == 0x2000) &&
-				!(descriptor & 0x80) && (descriptor & 0x14000) != 0x10000) {
-				defines[lastIndex++] = { "NO_PIXEL_SHADER", nullptr };
-			}
-
-			defines[lastIndex++] = { nullptr, nullptr };
+			return std::ranges::find_if(defines, [](const D3D_SHADER_MACRO& macro) { return macro.Name == nullptr; }) - defines.begin();
 		}
 
 		static void GetImagespaceShaderDefines(const RE::BSShader& shader, std::span<D3D_SHADER_MACRO> defines)
@@ -593,42 +65,42 @@ namespace SIE
 			return;
 		}
 
-		static void GetShaderDefines(const RE::BSShader& shader, uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		/**
+		 * @brief Writes the defines only the game can provide, null terminated: the vanilla Lighting
+		 * list, or the ImageSpace macros with their feature defines. Nothing for other types.
+		 * @return Number of macros written, without the terminator.
+		 */
+		static size_t GetGameShaderDefines(const RE::BSShader& shader, uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
 		{
+			defines[0] = { nullptr, nullptr };
 			switch (shader.shaderType.get()) {
-			case RE::BSShader::Type::Grass:
-				GetGrassShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::Sky:
-				GetSkyShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::Water:
-				GetWaterShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::BloodSplatter:
-				GetBloodSplaterShaderDefines(descriptor, defines);
-				break;
 			case RE::BSShader::Type::ImageSpace:
 				GetImagespaceShaderDefines(shader, defines);
-				break;
+				return std::ranges::find_if(defines, [](const D3D_SHADER_MACRO& macro) { return macro.Name == nullptr; }) - defines.begin();
 			case RE::BSShader::Type::Lighting:
-				GetLightingShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::DistantTree:
-				GetDistantTreeShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::Particle:
-				GetParticleShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::Effect:
-				GetEffectShaderDefines(descriptor, defines);
-				break;
-			case RE::BSShader::Type::Utility:
-				GetUtilityShaderDefines(descriptor, defines);
-				break;
+				return GetVanillaLightingShaderDefines(descriptor, defines);
+			default:
+				return 0;
 			}
 		}
 
+		static void GetShaderDefines(const RE::BSShader& shader, uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			const auto type = shader.shaderType.get();
+			size_t lastIndex = GetGameShaderDefines(shader, descriptor, defines);
+			lastIndex += ShaderPermutations::GetDescriptorDefines(ToShaderType(type), descriptor, defines.subspan(lastIndex));
+
+			if (ShaderPermutations::HasFeatureDefines(ToShaderType(type))) {
+				for (auto* feature : Feature::GetFeatureList()) {
+					if (feature->loaded && feature->HasShaderDefine(type)) {
+						defines[lastIndex++] = { feature->GetShaderDefineName().data(), nullptr };
+					}
+				}
+			}
+
+			defines[lastIndex] = { nullptr, nullptr };
+		}
+
 		static std::array<std::array<std::unordered_map<std::string, int32_t>,
 							  static_cast<size_t>(ShaderClass::Total)>,
 			static_cast<size_t>(RE::BSShader::Type::Total)>
@@ -1061,11 +533,7 @@ namespace SIE
 					 (0b1111ull << (4 * attribute + 4)));
 		}
 
-		template <size_t MaxOffsetsSize>
-		static void ReflectConstantBuffers(ID3D11ShaderReflection& reflector,
-			std::array<size_t, 3>& bufferSizes,
-			std::array<int8_t, MaxOffsetsSize>& constantOffsets,
-			uint64_t& vertexDesc,
+		static void ReflectConstantBuffers(ID3D11ShaderReflection& reflector, ShaderReflection& reflection,
 			ShaderClass shaderClass, uint32_t descriptor, const RE::BSShader& shader)
 		{
 			D3D11_SHADER_DESC desc;
@@ -1077,6 +545,7 @@ namespace SIE
 			}
 
 			if (shaderClass == ShaderClass::Vertex) {
+				auto& vertexDesc = reflection.vertexDesc;
 				vertexDesc = 0b1111;
 				bool hasTexcoord2 = false;
 				bool hasTexcoord3 = false;
@@ -1132,7 +601,7 @@ namespace SIE
 			}
 
 			auto mapBufferConsts =
-				[&](const char* bufferName, size_t& bufferSize) {
+				[&](const char* bufferName, size_t buffer) {
 					auto bufferReflector = reflector.GetConstantBufferByName(bufferName);
 					if (bufferReflector == nullptr) {
 						logger::trace("Buffer {} not found for {} shader {}::{:X}",
@@ -1162,77 +631,82 @@ namespace SIE
 							continue;
 						}
 
-						const auto variableIndex =
-							GetVariableIndex(shaderClass, shader, varDesc.Name);
-						const bool variableFound = variableIndex != -1;
-						if (variableFound) {
-							constantOffsets[variableIndex] = (int8_t)(varDesc.StartOffset / 4);
-						} else {
-							logger::trace("Unknown variable name {} in {} shader {}::{:X}",
-								varDesc.Name, magic_enum::enum_name(shaderClass),
-								magic_enum::enum_name(shader.shaderType.get()),
-								descriptor);
-						}
-
+						ShaderReflection::Variable variable{ varDesc.Name, varDesc.StartOffset, varDesc.Size, 0 };
 						if (shader.shaderType == RE::BSShader::Type::ImageSpace) {
 							D3D11_SHADER_TYPE_DESC varTypeDesc;
 							var->GetType()->GetDesc(&varTypeDesc);
-							if (varTypeDesc.Elements > 0) {
-								if (!variableFound) {
-									const std::string arrayName =
-										std::format("{}[{}]", varDesc.Name, varTypeDesc.Elements);
-									const auto variableArrayIndex =
-										GetVariableIndex(shaderClass, shader, arrayName.c_str());
-									if (variableArrayIndex != -1) {
-										constantOffsets[variableArrayIndex] = static_cast<int8_t>(varDesc.StartOffset / 4);
-									} else {
-										logger::debug("Unknown variable name {} in {} shader {}::{:X}",
-											arrayName, magic_enum::enum_name(shaderClass),
-											magic_enum::enum_name(shader.shaderType.get()), descriptor);
-									}
+							variable.elements = varTypeDesc.Elements;
+						}
+						reflection.MapVariable(
+							variable, [&](const char* a_name) { return GetVariableIndex(shaderClass, shader, a_name); },
+							[&](std::string_view a_name, bool a_array) {
+								if (a_array) {
+									logger::debug("Unknown variable name {} in {} shader {}::{:X}", a_name, magic_enum::enum_name(shaderClass),
+										magic_enum::enum_name(shader.shaderType.get()), descriptor);
 								} else {
-									const auto elementSize = varDesc.Size / varTypeDesc.Elements;
-									for (uint32_t arrayIndex = 1; arrayIndex < varTypeDesc.Elements;
-										 ++arrayIndex) {
-										const std::string varName =
-											std::format("{}[{}]", varDesc.Name, arrayIndex);
-										const auto variableArrayElementIndex =
-											GetVariableIndex(shaderClass, shader, varName.c_str());
-										if (variableArrayElementIndex != -1) {
-											constantOffsets[variableArrayElementIndex] =
-												static_cast<int8_t>((varDesc.StartOffset + elementSize * arrayIndex) / 4);
-										} else {
-											logger::debug(
-												"Unknown variable name {} in {} shader {}::{:X}", varName,
-												magic_enum::enum_name(shaderClass),
-												magic_enum::enum_name(shader.shaderType.get()),
-												descriptor);
-										}
-									}
+									logger::trace("Unknown variable name {} in {} shader {}::{:X}", a_name, magic_enum::enum_name(shaderClass),
+										magic_enum::enum_name(shader.shaderType.get()), descriptor);
 								}
-							}
-						}
+							});
 					}
 
-					bufferSize = ((bufferDesc.Size + 15) & ~15) / 16;
+					reflection.SetBufferSize(buffer, bufferDesc.Size);
 				};
 
-			mapBufferConsts("PerTechnique", bufferSizes[0]);
-			mapBufferConsts("PerMaterial", bufferSizes[1]);
-			mapBufferConsts("PerGeometry", bufferSizes[2]);
+			mapBufferConsts("PerTechnique", 0);
+			mapBufferConsts("PerMaterial", 1);
+			mapBufferConsts("PerGeometry", 2);
 		}
 
-		std::wstring GetDiskPath(const std::string_view& name, uint32_t descriptor, ShaderClass shaderClass)
+		static ShaderReflection ReflectShader(ID3DBlob& shaderData, ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor)
 		{
-			switch (shaderClass) {
-			case ShaderClass::Pixel:
-				return std::format(L"Data/ShaderCache/{}/{:X}.pso", std::wstring(name.begin(), name.end()), descriptor);
-			case ShaderClass::Vertex:
-				return std::format(L"Data/ShaderCache/{}/{:X}.vso", std::wstring(name.begin(), name.end()), descriptor);
-			case ShaderClass::Compute:
-				return std::format(L"Data/ShaderCache/{}/{:X}.cso", std::wstring(name.begin(), name.end()), descriptor);
+			ShaderReflection reflection;
+			winrt::com_ptr<ID3D11ShaderReflection> reflector;
+			const auto reflectionResult = D3DReflect(shaderData.GetBufferPointer(), shaderData.GetBufferSize(),
+				IID_PPV_ARGS(&reflector));
+			if (FAILED(reflectionResult)) {
+				logger::error("Failed to reflect {} shader {}::{:X}", magic_enum::enum_name(shaderClass),
+					magic_enum::enum_name(shader.shaderType.get()), descriptor);
+				return reflection;
 			}
-			return {};
+
+			ReflectConstantBuffers(*reflector.get(), reflection, shaderClass, descriptor, shader);
+			reflection.reflected = 1;
+			return reflection;
+		}
+
+		template <class T>
+		static void ApplyReflection(T& newShader, const ShaderReflection& reflection, ID3D11Buffer** perTechniqueBuffersArray,
+			ID3D11Buffer** perMaterialBuffersArray, ID3D11Buffer** perGeometryBuffersArray, void* bufferData)
+		{
+			static_assert(std::tuple_size_v<decltype(newShader.constantTable)> <= ShaderReflection::MaxConstants);
+			std::copy_n(reflection.constantTable.begin(), newShader.constantTable.size(), newShader.constantTable.begin());
+
+			const std::array buffersArrays{ perTechniqueBuffersArray, perMaterialBuffersArray, perGeometryBuffersArray };
+			for (size_t i = 0; i < buffersArrays.size(); ++i) {
+				if (reflection.bufferSizes[i] != 0) {
+					newShader.constantBuffers[i].buffer =
+						(REX::W32::ID3D11Buffer*)buffersArrays[i][reflection.bufferSizes[i]];
+				} else {
+					newShader.constantBuffers[i].buffer = nullptr;
+					newShader.constantBuffers[i].data = bufferData;
+				}
+			}
+		}
+
+		static std::wstring GetArchivePath(const std::string_view& name)
+		{
+			return std::format(L"Data/ShaderCache/{}", std::wstring(name.begin(), name.end()));
+		}
+
+		static uint64_t GetArchiveKey(ShaderClass shaderClass, uint32_t descriptor)
+		{
+			return PermutationManifest::GetArchiveKey(static_cast<uint32_t>(shaderClass), descriptor);
+		}
+
+		static uint64_t GetReflectionKey(ShaderClass shaderClass, uint32_t descriptor)
+		{
+			return ShaderReflection::GetArchiveKey(GetArchiveKey(shaderClass, descriptor));
 		}
 
 		static std::string GetShaderString(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, bool hashkey)
@@ -1248,15 +722,87 @@ namespace SIE
 			return result;
 		}
 
-		std::string GetTypeFromShaderString(const std::string& a_key)
+		static uint32_t GetCompileFlags()
+		{
+			return ShaderPermutations::GetCompileFlags(State::GetSingleton()->IsDeveloperMode());
+		}
+
+		/**
+		 * @brief Builds the full macro list a permutation is compiled with.
+		 */
+		static void GetCompileDefines(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, std::array<D3D_SHADER_MACRO, 64>& defines)
 		{
-			std::string type = "";
-			std::string::size_type pos = a_key.find(':');
-			if (pos != std::string::npos)
-				type = a_key.substr(0, pos);
-			if (type.starts_with("IS") || type == "ReflectionsRayTracing")
-				type = "ImageSpace";  // fix type for image space shaders
-			return type;
+			auto lastIndex = ShaderPermutations::GetClassDefines(shaderClass, State::GetSingleton()->IsDeveloperMode(), REL::Module::IsVR(), defines);
+			auto shaderDefines = State::GetSingleton()->GetDefines();
+			if (!shaderDefines->empty()) {
+				for (unsigned int i = 0; i < shaderDefines->size(); i++)
+					defines[lastIndex++] = { shaderDefines->at(i).first.c_str(), shaderDefines->at(i).second.c_str() };
+			}
+			defines[lastIndex] = { nullptr, nullptr };  // do final entry
+			GetShaderDefines(shader, descriptor, std::span{ defines }.subspan(lastIndex));
+		}
+
+		static std::string_view GetShaderSourceName(const RE::BSShader& shader)
+		{
+			return shader.shaderType == RE::BSShader::Type::ImageSpace ?
+			           static_cast<const RE::BSImagespaceShader&>(shader).originalShaderName :
+			           shader.fxpFilename;
+		}
+
+		static uint64_t GetContentHash(std::string_view a_preprocessed, ShaderClass a_shaderClass, uint32_t a_flags)
+		{
+			// the same source still compiles differently per profile and flags
+			return ShaderDependencies::HashContent(a_preprocessed) ^
+			       (ShaderDependencies::HashContent(fmt::format("{}:{}", ShaderPermutations::GetProfile(a_shaderClass), a_flags)) * 0x9E3779B97F4A7C15ull);
+		}
+
+		/**
+		 * @brief Compiles and strips a shader source, logging any errors.
+		 * @return The blob (owned by caller) or nullptr if compilation failed.
+		 */
+		static ID3DBlob* CompileSource(std::string_view a_source, const std::string& a_name, const D3D_SHADER_MACRO* a_defines, ID3DInclude* a_include,
+			ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, uint32_t a_flags)
+		{
+			const auto type = shader.shaderType.get();
+			ID3DBlob* shaderBlob = nullptr;
+			ID3DBlob* errorBlob = nullptr;
+			const HRESULT compileResult = D3DCompile(a_source.data(), a_source.size(), a_name.c_str(), a_defines, a_include, "main",
+				ShaderPermutations::GetProfile(shaderClass), a_flags, 0, &shaderBlob, &errorBlob);
+
+			if (FAILED(compileResult)) {
+				if (errorBlob != nullptr) {
+					logger::error("Failed to compile {} shader {}::{:X}:\n{}",
+						magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor,
+						static_cast<char*>(errorBlob->GetBufferPointer()));
+					errorBlob->Release();
+				} else {
+					logger::error("Failed to compile {} shader {}::{:X}",
+						magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor);
+				}
+				if (shaderBlob != nullptr) {
+					shaderBlob->Release();
+				}
+				return nullptr;
+			}
+			if (errorBlob) {
+				logger::debug("Shader logs:\n{}", static_cast<char*>(errorBlob->GetBufferPointer()));
+				errorBlob->Release();
+			}
+			logger::debug("Compiled shader {}:{}:{:X}", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
+
+			// strip debug info
+			if (!State::GetSingleton()->IsDeveloperMode()) {
+				ID3DBlob* strippedShaderBlob = nullptr;
+
+				const uint32_t stripFlags = D3DCOMPILER_STRIP_DEBUG_INFO |
+				                            D3DCOMPILER_STRIP_TEST_BLOBS |
+				                            D3DCOMPILER_STRIP_PRIVATE_DATA;
+
+				D3DStripShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), stripFlags, &strippedShaderBlob);
+				std::swap(shaderBlob, strippedShaderBlob);
+				strippedShaderBlob->Release();
+			}
+			return shaderBlob;
 		}
 
 		static ID3DBlob* CompileShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, bool useDiskCache)
@@ -1267,132 +813,108 @@ namespace SIE
 
 			if (shaderBlob) {
 				// already compiled before
-				logger::debug("Shader already compiled; using cache: {}", SShaderCache::GetShaderString(shaderClass, shader, descriptor));
+				logger::debug("Shader already compiled; using cache: {}", GetShaderKey(shaderClass, shader, descriptor));
 				cache.IncCacheHitTasks();
 				return shaderBlob;
 			}
 			const auto type = shader.shaderType.get();
 
+			// prepare preprocessor defines
+			std::array<D3D_SHADER_MACRO, 64> defines{};
+			GetCompileDefines(shaderClass, shader, descriptor, defines);
+
+			const uint32_t flags = GetCompileFlags();
+			const auto definesHash = ShaderDependencies::HashDefines(defines.data(), flags);
+
 			// check diskcache
-			auto diskPath = GetDiskPath(shader.fxpFilename, descriptor, shaderClass);
+			const auto diskKey = GetArchiveKey(shaderClass, descriptor);
+			auto archive = useDiskCache ? cache.GetDiskArchive(shader.fxpFilename) : nullptr;
+			auto& dependencies = cache.GetDependencies();
 
-			if (useDiskCache && std::filesystem::exists(diskPath)) {
+			if (archive) {
 				// check build time of cache
-				auto diskCacheTime = cache.UseFileWatcher() ? std::chrono::clock_cast<std::chrono::system_clock>(std::filesystem::last_write_time(diskPath)) : system_clock::now();
-				if (cache.ShaderModifiedSince(shader.fxpFilename, diskCacheTime)) {
-					logger::debug("Diskcached shader {} older than {}", SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true), std::format("{:%Y%m%d%H%M}", diskCacheTime));
-				} else if (FAILED(D3DReadFileToBlob(diskPath.c_str(), &shaderBlob))) {
-					logger::error("Failed to load {} shader {}::{:X}", magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor);
-
-					if (shaderBlob != nullptr) {
-						shaderBlob->Release();
+				system_clock::time_point diskCacheTime;
+				if (auto diskBlob = archive->Read(diskKey, diskCacheTime)) {
+					if (cache.ShaderModifiedSince(shader.fxpFilename, diskCacheTime)) {
+						logger::debug("Diskcached shader {} older than {}", SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true), std::format("{:%Y%m%d%H%M}", diskCacheTime));
+						diskBlob->Release();
+					} else if (!dependencies.IsCurrent(shader.fxpFilename, diskKey, definesHash)) {
+						logger::debug("Diskcached shader {}:{}:{:X} depends on changed sources or defines", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
+						diskBlob->Release();
+					} else {
+						logger::debug("Loaded shader {}:{}:{:X} from disk cache", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
+						cache.AddCompletedShader(shaderClass, shader, descriptor, diskBlob, dependencies.GetFiles(shader.fxpFilename, diskKey));
+						return diskBlob;
 					}
-				} else {
-					logger::debug("Loaded shader from {}", Util::WStringToString(diskPath));
-					cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob);
-					return shaderBlob;
 				}
 			}
 
-			// prepare preprocessor defines
-			std::array<D3D_SHADER_MACRO, 64> defines{};
-			auto lastIndex = 0;
-			if (shaderClass == ShaderClass::Vertex) {
-				defines[lastIndex++] = { "VSHADER", nullptr };
-			} else if (shaderClass == ShaderClass::Pixel) {
-				defines[lastIndex++] = { "PSHADER", nullptr };
-			} else if (shaderClass == ShaderClass::Compute) {
-				defines[lastIndex++] = { "CSHADER", nullptr };
-			}
-			if (State::GetSingleton()->IsDeveloperMode()) {
-				defines[lastIndex++] = { "D3DCOMPILE_SKIP_OPTIMIZATION", nullptr };
-				defines[lastIndex++] = { "D3DCOMPILE_DEBUG", nullptr };
-			}
-			if (REL::Module::IsVR())
-				defines[lastIndex++] = { "VR", nullptr };
-			auto shaderDefines = State::GetSingleton()->GetDefines();
-			if (!shaderDefines->empty()) {
-				for (unsigned int i = 0; i < shaderDefines->size(); i++)
-					defines[lastIndex++] = { shaderDefines->at(i).first.c_str(), shaderDefines->at(i).second.c_str() };
-			}
-			defines[lastIndex] = { nullptr, nullptr };  // do final entry
-			GetShaderDefines(shader, descriptor, std::span{ defines }.subspan(lastIndex));
-
-			const std::wstring path = GetShaderPath(
-				shader.shaderType == RE::BSShader::Type::ImageSpace ?
-					static_cast<const RE::BSImagespaceShader&>(shader).originalShaderName :
-					shader.fxpFilename);
+			const std::wstring path = GetShaderPath(GetShaderSourceName(shader));
 			auto pathString = Util::WStringToString(path);
-			if (!std::filesystem::exists(path)) {
+			ShaderIncludeHandler includeHandler(path);
+			std::string source;
+			if (!includeHandler.ReadRoot(source)) {
 				logger::error("Failed to compile {} shader {}::{:X}: {} does not exist", magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor, pathString);
 				return nullptr;
 			}
 			logger::debug("Compiling {} {}:{}:{:X} to {}", pathString, magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor, MergeDefinesString(defines));
 
 			// compile shaders
+			bool deduplicated = false;
+			ID3DBlob* preprocessedBlob = nullptr;
 			ID3DBlob* errorBlob = nullptr;
-			const uint32_t flags = !State::GetSingleton()->IsDeveloperMode() ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_DEBUG;
-			const HRESULT compileResult = D3DCompileFromFile(path.c_str(), defines.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-				GetShaderProfile(shaderClass), flags, 0, &shaderBlob, &errorBlob);
-
-			if (FAILED(compileResult)) {
-				if (errorBlob != nullptr) {
-					logger::error("Failed to compile {} shader {}::{:X}:\n{}",
-						magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor,
-						static_cast<char*>(errorBlob->GetBufferPointer()));
-					errorBlob->Release();
-				} else {
-					logger::error("Failed to compile {} shader {}::{:X}",
-						magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor);
-				}
-				if (shaderBlob != nullptr) {
-					shaderBlob->Release();
+			// debug builds keep the original sources for shader debuggers, so only release builds are deduplicated
+			if (!State::GetSingleton()->IsDeveloperMode() &&
+				SUCCEEDED(D3DPreprocess(source.data(), source.size(), pathString.c_str(), defines.data(), &includeHandler, &preprocessedBlob, &errorBlob))) {
+				const std::string_view preprocessed(static_cast<const char*>(preprocessedBlob->GetBufferPointer()), preprocessedBlob->GetBufferSize());
+				auto compile = [&]() {
+					return CompileSource(preprocessed, pathString, nullptr, nullptr, shaderClass, shader, descriptor, flags);
+				};
+				shaderBlob = cache.CompileContent(GetContentHash(preprocessed, shaderClass, flags), compile, deduplicated);
+				preprocessedBlob->Release();
+				if (!shaderBlob && deduplicated) {
+					logger::error("Failed to compile {} shader {}::{:X}: preprocesses to the source of a failed permutation",
+						magic_enum::enum_name(shaderClass), magic_enum::enum_name(type), descriptor);
 				}
+			} else {
+				// let the compiler report preprocessing errors
+				shaderBlob = CompileSource(source, pathString, defines.data(), &includeHandler, shaderClass, shader, descriptor, flags);
+			}
+			if (errorBlob) {
+				errorBlob->Release();
+			}
 
+			if (!shaderBlob) {
 				cache.AddCompletedShader(shaderClass, shader, descriptor, nullptr);
 				return nullptr;
 			}
-			if (errorBlob)
-				logger::debug("Shader logs:\n{}", static_cast<char*>(errorBlob->GetBufferPointer()));
-			logger::debug("Compiled shader {}:{}:{:X}", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
-
-			// strip debug info
-			if (!State::GetSingleton()->IsDeveloperMode()) {
-				ID3DBlob* strippedShaderBlob = nullptr;
-
-				const uint32_t stripFlags = D3DCOMPILER_STRIP_DEBUG_INFO |
-				                            D3DCOMPILER_STRIP_TEST_BLOBS |
-				                            D3DCOMPILER_STRIP_PRIVATE_DATA;
-
-				D3DStripShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), stripFlags, &strippedShaderBlob);
-				std::swap(shaderBlob, strippedShaderBlob);
-				strippedShaderBlob->Release();
+			if (deduplicated) {
+				logger::debug("Shader {}:{}:{:X} shares the bytecode of an identical source", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
 			}
 
 			// save shader to disk
-			if (useDiskCache) {
-				auto directoryPath = std::format("Data/ShaderCache/{}", shader.fxpFilename);
-				if (!std::filesystem::is_directory(directoryPath)) {
-					try {
-						std::filesystem::create_directories(directoryPath);
-					} catch (std::filesystem::filesystem_error const& ex) {
-						logger::error("Failed to create folder: {}", ex.what());
-					}
-				}
-
-				const HRESULT saveResult = D3DWriteBlobToFile(shaderBlob, diskPath.c_str(), true);
-				if (FAILED(saveResult)) {
-					logger::error("Failed to save shader to {}", Util::WStringToString(diskPath));
+			const auto& includedFiles = includeHandler.GetFiles();
+			if (archive) {
+				if (archive->Write(diskKey, shaderBlob)) {
+					dependencies.Record(shader.fxpFilename, diskKey, definesHash, includedFiles);
+					logger::debug("Saved shader {}:{}:{:X} to disk cache", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
+				} else if (archive->IsClosed()) {
+					logger::debug("Dropped shader {}:{}:{:X}, the disk cache was deleted while it compiled", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
 				} else {
-					logger::debug("Saved shader to {}", Util::WStringToString(diskPath));
+					logger::error("Failed to save shader {}:{}:{:X} to disk cache", magic_enum::enum_name(type), magic_enum::enum_name(shaderClass), descriptor);
 				}
 			}
-			cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob);
+			std::vector<std::string> dependencyPaths;
+			dependencyPaths.reserve(includedFiles.size());
+			for (const auto& file : includedFiles) {
+				dependencyPaths.push_back(file.path);
+			}
+			cache.AddCompletedShader(shaderClass, shader, descriptor, shaderBlob, dependencyPaths);
 			return shaderBlob;
 		}
 
 		std::unique_ptr<RE::BSGraphics::VertexShader> CreateVertexShader(ID3DBlob& shaderData,
-			const RE::BSShader& shader, uint32_t descriptor)
+			uint32_t descriptor, const ShaderReflection& reflection)
 		{
 			static const auto perTechniqueBuffersArray =
 				REL::Relocation<ID3D11Buffer**>(RELOCATION_ID(524755, 411371));
@@ -1412,45 +934,16 @@ namespace SIE
 			newShader->id = descriptor;
 			newShader->shaderDesc = 0;
 
-			winrt::com_ptr<ID3D11ShaderReflection> reflector;
-			const auto reflectionResult = D3DReflect(shaderData.GetBufferPointer(), shaderData.GetBufferSize(),
-				IID_PPV_ARGS(&reflector));
-			if (FAILED(reflectionResult)) {
-				logger::error("Failed to reflect vertex shader {}::{:X}", magic_enum::enum_name(shader.shaderType.get()),
-					descriptor);
-			} else {
-				std::array<size_t, 3> bufferSizes = { 0, 0, 0 };
-				std::fill(newShader->constantTable.begin(), newShader->constantTable.end(), static_cast<uint8_t>(0));
-				ReflectConstantBuffers(*reflector.get(), bufferSizes, newShader->constantTable, newShader->shaderDesc,
-					ShaderClass::Vertex, descriptor, shader);
-				if (bufferSizes[0] != 0) {
-					newShader->constantBuffers[0].buffer =
-						(REX::W32::ID3D11Buffer*)perTechniqueBuffersArray.get()[bufferSizes[0]];
-				} else {
-					newShader->constantBuffers[0].buffer = nullptr;
-					newShader->constantBuffers[0].data = bufferData.get();
-				}
-				if (bufferSizes[1] != 0) {
-					newShader->constantBuffers[1].buffer =
-						(REX::W32::ID3D11Buffer*)perMaterialBuffersArray.get()[bufferSizes[1]];
-				} else {
-					newShader->constantBuffers[1].buffer = nullptr;
-					newShader->constantBuffers[1].data = bufferData.get();
-				}
-				if (bufferSizes[2] != 0) {
-					newShader->constantBuffers[2].buffer =
-						(REX::W32::ID3D11Buffer*)perGeometryBuffersArray.get()[bufferSizes[2]];
-				} else {
-					newShader->constantBuffers[2].buffer = nullptr;
-					newShader->constantBuffers[2].data = bufferData.get();
-				}
+			if (reflection.reflected) {
+				newShader->shaderDesc = reflection.vertexDesc;
+				ApplyReflection(*newShader, reflection, perTechniqueBuffersArray.get(), perMaterialBuffersArray.get(),
+					perGeometryBuffersArray.get(), bufferData.get());
 			}
 
 			return newShader;
 		}
 
-		std::unique_ptr<RE::BSGraphics::PixelShader> CreatePixelShader(ID3DBlob& shaderData,
-			const RE::BSShader& shader, uint32_t descriptor)
+		std::unique_ptr<RE::BSGraphics::PixelShader> CreatePixelShader(uint32_t descriptor, const ShaderReflection& reflection)
 		{
 			static const auto perTechniqueBuffersArray =
 				REL::Relocation<ID3D11Buffer**>(RELOCATION_ID(524761, 411377));
@@ -1463,40 +956,9 @@ namespace SIE
 			auto newShader = std::make_unique<RE::BSGraphics::PixelShader>();
 			newShader->id = descriptor;
 
-			winrt::com_ptr<ID3D11ShaderReflection> reflector;
-			const auto reflectionResult = D3DReflect(shaderData.GetBufferPointer(),
-				shaderData.GetBufferSize(), IID_PPV_ARGS(&reflector));
-			if (FAILED(reflectionResult)) {
-				logger::error("Failed to reflect vertex shader {}::{:X}", magic_enum::enum_name(shader.shaderType.get()),
-					descriptor);
-			} else {
-				std::array<size_t, 3> bufferSizes = { 0, 0, 0 };
-				std::ranges::fill(newShader->constantTable, (int8_t)0);
-				uint64_t dummy;
-				ReflectConstantBuffers(*reflector.get(), bufferSizes, newShader->constantTable,
-					dummy,
-					ShaderClass::Pixel, descriptor, shader);
-				if (bufferSizes[0] != 0) {
-					newShader->constantBuffers[0].buffer =
-						(REX::W32::ID3D11Buffer*)perTechniqueBuffersArray.get()[bufferSizes[0]];
-				} else {
-					newShader->constantBuffers[0].buffer = nullptr;
-					newShader->constantBuffers[0].data = bufferData.get();
-				}
-				if (bufferSizes[1] != 0) {
-					newShader->constantBuffers[1].buffer =
-						(REX::W32::ID3D11Buffer*)perMaterialBuffersArray.get()[bufferSizes[1]];
-				} else {
-					newShader->constantBuffers[1].buffer = nullptr;
-					newShader->constantBuffers[1].data = bufferData.get();
-				}
-				if (bufferSizes[2] != 0) {
-					newShader->constantBuffers[2].buffer =
-						(REX::W32::ID3D11Buffer*)perGeometryBuffersArray.get()[bufferSizes[2]];
-				} else {
-					newShader->constantBuffers[2].buffer = nullptr;
-					newShader->constantBuffers[2].data = bufferData.get();
-				}
+			if (reflection.reflected) {
+				ApplyReflection(*newShader, reflection, perTechniqueBuffersArray.get(), perMaterialBuffersArray.get(),
+					perGeometryBuffersArray.get(), bufferData.get());
 			}
 
 			return newShader;
@@ -1666,7 +1128,7 @@ namespace SIE
 	}
 
 	RE::BSGraphics::VertexShader* ShaderCache::GetVertexShader(const RE::BSShader& shader,
-		uint32_t descriptor)
+		uint32_t descriptor, CompilationPriority a_priority)
 	{
 		if (shader.shaderType == RE::BSShader::Type::ImageSpace) {
 			const auto& isShader = static_cast<const RE::BSImagespaceShader&>(shader);
@@ -1684,9 +1146,10 @@ namespace SIE
 			return nullptr;
 		}
 
-		if (state->IsDeveloperMode()) {
+		if (state->IsDeveloperMode() && blockedKeyIndex != -1 && !blockedKey.empty()) {
+			// only build the defines string while a shader is actually being blocked
 			auto key = SIE::SShaderCache::GetShaderString(ShaderClass::Vertex, shader, descriptor, true);
-			if (blockedKeyIndex != -1 && !blockedKey.empty() && key == blockedKey) {
+			if (key == blockedKey) {
 				if (std::find(blockedIDs.begin(), blockedIDs.end(), descriptor) == blockedIDs.end()) {
 					blockedIDs.push_back(descriptor);
 					logger::debug("Skipping blocked shader {:X}:{} total: {}", descriptor, blockedKey, blockedIDs.size());
@@ -1695,17 +1158,12 @@ namespace SIE
 			}
 		}
 
-		{
-			std::lock_guard lockGuard(vertexShadersMutex);
-			auto& typeCache = vertexShaders[static_cast<size_t>(shader.shaderType.underlying())];
-			auto it = typeCache.find(descriptor);
-			if (it != typeCache.end()) {
-				return it->second.get();
-			}
+		if (auto cached = vertexShaders[static_cast<size_t>(shader.shaderType.underlying())].Find(descriptor)) {
+			return cached;
 		}
 
 		if (IsAsync()) {
-			compilationSet.Add({ ShaderClass::Vertex, shader, descriptor });
+			EnqueueCompilation({ ShaderClass::Vertex, shader, descriptor }, a_priority);
 		} else {
 			return MakeAndAddVertexShader(shader, descriptor);
 		}
@@ -1714,7 +1172,7 @@ namespace SIE
 	}
 
 	RE::BSGraphics::PixelShader* ShaderCache::GetPixelShader(const RE::BSShader& shader,
-		uint32_t descriptor)
+		uint32_t descriptor, CompilationPriority a_priority)
 	{
 		auto state = VariableCache::GetSingleton()->state;
 		if (state->isVR && strcmp(shader.fxpFilename, "OBBOcclusionTesting") == 0)
@@ -1732,9 +1190,10 @@ namespace SIE
 			}
 		}
 
-		if (state->IsDeveloperMode()) {
+		if (state->IsDeveloperMode() && blockedKeyIndex != -1 && !blockedKey.empty()) {
+			// only build the defines string while a shader is actually being blocked
 			auto key = SIE::SShaderCache::GetShaderString(ShaderClass::Pixel, shader, descriptor, true);
-			if (blockedKeyIndex != -1 && !blockedKey.empty() && key == blockedKey) {
+			if (key == blockedKey) {
 				if (std::find(blockedIDs.begin(), blockedIDs.end(), descriptor) == blockedIDs.end()) {
 					blockedIDs.push_back(descriptor);
 					logger::debug("Skipping blocked shader {:X}:{} total: {}", descriptor, blockedKey, blockedIDs.size());
@@ -1743,17 +1202,12 @@ namespace SIE
 			}
 		}
 
-		{
-			std::lock_guard lockGuard(pixelShadersMutex);
-			auto& typeCache = pixelShaders[static_cast<size_t>(shader.shaderType.underlying())];
-			auto it = typeCache.find(descriptor);
-			if (it != typeCache.end()) {
-				return it->second.get();
-			}
+		if (auto cached = pixelShaders[static_cast<size_t>(shader.shaderType.underlying())].Find(descriptor)) {
+			return cached;
 		}
 
 		if (IsAsync()) {
-			compilationSet.Add({ ShaderClass::Pixel, shader, descriptor });
+			EnqueueCompilation({ ShaderClass::Pixel, shader, descriptor }, a_priority);
 		} else {
 			return MakeAndAddPixelShader(shader, descriptor);
 		}
@@ -1762,7 +1216,7 @@ namespace SIE
 	}
 
 	RE::BSGraphics::ComputeShader* ShaderCache::GetComputeShader(const RE::BSShader& shader,
-		uint32_t descriptor)
+		uint32_t descriptor, CompilationPriority a_priority)
 	{
 		auto state = State::GetSingleton();
 		if (!((ShaderCache::IsSupportedShader(shader) || state->IsDeveloperMode() && state->IsShaderEnabled(shader)) && state->enableCShaders)) {
@@ -1776,9 +1230,10 @@ namespace SIE
 			}
 		}
 
-		if (state->IsDeveloperMode()) {
+		if (state->IsDeveloperMode() && blockedKeyIndex != -1 && !blockedKey.empty()) {
+			// only build the defines string while a shader is actually being blocked
 			auto key = SIE::SShaderCache::GetShaderString(ShaderClass::Compute, shader, descriptor, true);
-			if (blockedKeyIndex != -1 && !blockedKey.empty() && key == blockedKey) {
+			if (key == blockedKey) {
 				if (std::find(blockedIDs.begin(), blockedIDs.end(), descriptor) == blockedIDs.end()) {
 					blockedIDs.push_back(descriptor);
 					logger::debug("Skipping blocked shader {:X}:{} total: {}", descriptor, blockedKey, blockedIDs.size());
@@ -1787,17 +1242,12 @@ namespace SIE
 			}
 		}
 
-		{
-			std::lock_guard lockGuard(computeShadersMutex);
-			auto& typeCache = computeShaders[static_cast<size_t>(shader.shaderType.underlying())];
-			auto it = typeCache.find(descriptor);
-			if (it != typeCache.end()) {
-				return it->second.get();
-			}
+		if (auto cached = computeShaders[static_cast<size_t>(shader.shaderType.underlying())].Find(descriptor)) {
+			return cached;
 		}
 
 		if (IsAsync()) {
-			compilationSet.Add({ ShaderClass::Compute, shader, descriptor });
+			EnqueueCompilation({ ShaderClass::Compute, shader, descriptor }, a_priority);
 		} else {
 			return MakeAndAddComputeShader(shader, descriptor);
 		}
@@ -1819,32 +1269,14 @@ namespace SIE
 
 	void ShaderCache::Clear()
 	{
-		{
-			std::lock_guard lockGuardV(vertexShadersMutex);
-			for (auto& shaders : vertexShaders) {
-				for (auto& [id, shader] : shaders) {
-					shader->shader->Release();
-				}
-				shaders.clear();
-			}
+		for (auto& shaders : vertexShaders) {
+			shaders.Clear([](auto& shader) { shader.shader->Release(); });
 		}
-		{
-			std::lock_guard lockGuardP(pixelShadersMutex);
-			for (auto& shaders : pixelShaders) {
-				for (auto& [id, shader] : shaders) {
-					shader->shader->Release();
-				}
-				shaders.clear();
-			}
+		for (auto& shaders : pixelShaders) {
+			shaders.Clear([](auto& shader) { shader.shader->Release(); });
 		}
-		{
-			std::lock_guard lockGuardC(computeShadersMutex);
-			for (auto& shaders : computeShaders) {
-				for (auto& [id, shader] : shaders) {
-					shader->shader->Release();
-				}
-				shaders.clear();
-			}
+		for (auto& shaders : computeShaders) {
+			shaders.Clear([](auto& shader) { shader.shader->Release(); });
 		}
 		{
 			std::unique_lock lockM{ mapMutex };
@@ -1854,7 +1286,10 @@ namespace SIE
 			std::unique_lock lockH{ hlslMapMutex };
 			hlslToShaderMap.clear();
 		}
+		ReleaseSharedShaders();
 		compilationSet.Clear();
+		// sources may have been edited with the file watcher off; hash them again before reusing any cached blob
+		dependencies.InvalidateAll();
 		Deferred::GetSingleton()->ClearShaderCache();
 		for (auto* feature : Feature::GetFeatureList()) {
 			if (feature->loaded) {
@@ -1863,22 +1298,15 @@ namespace SIE
 		}
 	}
 
-	template <typename ShaderType, typename MutexType>
-	void ReleaseShader(ShaderType& shaders,
-		MutexType& mutex, RE::BSShader::Type type, uint32_t descriptor)
+	template <typename ShaderType>
+	void ReleaseShader(ShaderType& shaders, RE::BSShader::Type type, uint32_t descriptor)
 	{
-		std::lock_guard<MutexType> lockGuard(mutex);
-
 		if (static_cast<size_t>(type) < shaders.size()) {
-			auto& shaderMap = shaders[static_cast<size_t>(type)];
-			auto shaderIt = shaderMap.find(descriptor);
-			if (shaderIt != shaderMap.end()) {
-				auto& shaderPtr = shaderIt->second;
-				if (shaderPtr && shaderPtr->shader) {
-					shaderPtr->shader->Release();
+			shaders[static_cast<size_t>(type)].Erase(descriptor, [](auto& shader) {
+				if (shader.shader) {
+					shader.shader->Release();
 				}
-				shaderMap.erase(shaderIt);
-			}
+			});
 		}
 	}
 	bool ShaderCache::Clear(const std::string& a_path)
@@ -1910,34 +1338,24 @@ namespace SIE
 			// Handle vertex, pixel, and compute shaders (each will lock)
 			switch (entry.shaderClass) {
 			case SIE::ShaderClass::Vertex:
-				ReleaseShader(vertexShaders, vertexShadersMutex, entry.type, entry.descriptor);
+				ReleaseShader(vertexShaders, entry.type, entry.descriptor);
 				break;
 			case SIE::ShaderClass::Pixel:
-				ReleaseShader(pixelShaders, pixelShadersMutex, entry.type, entry.descriptor);
+				ReleaseShader(pixelShaders, entry.type, entry.descriptor);
 				break;
 			case SIE::ShaderClass::Compute:
-				ReleaseShader(computeShaders, computeShadersMutex, entry.type, entry.descriptor);
+				ReleaseShader(computeShaders, entry.type, entry.descriptor);
 				break;
 			default:
 				logger::warn("Unexpected shader class: {}", static_cast<int>(entry.shaderClass));
 				break;
 			}
 
-			// Delete the associated file
-			const auto& filePath = entry.diskPath;
-			const auto& filePathString = Util::WStringToString(filePath);
-			{
-				std::scoped_lock lockD{ compilationSet.compilationMutex };
-				try {
-					if (std::filesystem::exists(filePath)) {
-						std::filesystem::remove(filePath);
-						logger::debug("Deleted {}", filePathString);
-					}
-				} catch (const std::exception& e) {
-					logger::warn("Failed to delete file {}: {}", filePathString, e.what());
-				} catch (...) {
-					logger::warn("An unknown error occurred while trying to delete file '{}'", filePathString);
-				}
+			// Drop the associated disk cache entry
+			if (auto archive = isDiskCache ? GetDiskArchive(entry.archiveName) : nullptr) {
+				archive->Erase(SIE::SShaderCache::GetArchiveKey(entry.shaderClass, entry.descriptor));
+				archive->Erase(SIE::SShaderCache::GetReflectionKey(entry.shaderClass, entry.descriptor));
+				logger::debug("Removed {:X} from disk cache of {}", entry.descriptor, entry.archiveName);
 			}
 
 			logger::debug("Marking recompile for shader: {}", entry.key);
@@ -1954,52 +1372,28 @@ namespace SIE
 	void ShaderCache::Clear(RE::BSShader::Type a_type)
 	{
 		logger::debug("Clearing cache for {}", magic_enum::enum_name(a_type));
-		std::lock_guard lockGuardV(vertexShadersMutex);
-		{
-			for (auto& [id, shader] : vertexShaders[static_cast<size_t>(a_type)]) {
-				shader->shader->Release();
-			}
-			vertexShaders[static_cast<size_t>(a_type)].clear();
-		}
-		std::lock_guard lockGuardP(pixelShadersMutex);
-		{
-			for (auto& [id, shader] : pixelShaders[static_cast<size_t>(a_type)]) {
-				shader->shader->Release();
-			}
-			pixelShaders[static_cast<size_t>(a_type)].clear();
-		}
-		std::lock_guard lockGuardC(computeShadersMutex);
-		{
-			for (auto& [id, shader] : computeShaders[static_cast<size_t>(a_type)]) {
-				shader->shader->Release();
-			}
-			computeShaders[static_cast<size_t>(a_type)].clear();
-		}
+		vertexShaders[static_cast<size_t>(a_type)].Clear([](auto& shader) { shader.shader->Release(); });
+		pixelShaders[static_cast<size_t>(a_type)].Clear([](auto& shader) { shader.shader->Release(); });
+		computeShaders[static_cast<size_t>(a_type)].Clear([](auto& shader) { shader.shader->Release(); });
 		ClearShaderMap(a_type);
 		compilationSet.Clear();
 	}
 
-	bool ShaderCache::AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob)
+	bool ShaderCache::AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob, const std::vector<std::string>& a_dependencies)
 	{
-		auto key = SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true);
-		auto keyWithDescriptor = SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, false);
+		const ShaderKey key = GetShaderKey(shaderClass, shader, descriptor);
 		auto status = a_blob ? ShaderCompilationTask::Status::Completed : ShaderCompilationTask::Status::Failed;
-		logger::debug("Adding {} shader to map: {}", magic_enum ::enum_name(status), keyWithDescriptor);
+		logger::debug("Adding {} shader to map: {}", magic_enum ::enum_name(status), key);
 		{
 			std::unique_lock lockM{ mapMutex };
-			shaderMap.insert_or_assign(key, ShaderCacheResult{ a_blob, status, system_clock::now() });
+			shaderMap.insert_or_assign(key, ShaderCacheResult{ a_blob, status, system_clock::now(), &shader });
 		}
-		const std::wstring path = SIE::SShaderCache::GetShaderPath(
-			shader.shaderType == RE::BSShader::Type::ImageSpace ?
-				static_cast<const RE::BSImagespaceShader&>(shader).originalShaderName :
-				shader.fxpFilename);
+		const std::wstring path = SIE::SShaderCache::GetShaderPath(SIE::SShaderCache::GetShaderSourceName(shader));
 		auto pathString = Util::WStringToString(path);
 		if (a_blob) {  // only create hlsl record if successful
-			std::string lowerFilePath = Util::FixFilePath(pathString);
-			{
-				std::unique_lock lockH{ hlslMapMutex };
+			hlslRecord newRecord{ key, shader.shaderType.get(), descriptor, shaderClass, shader.fxpFilename };
+			auto addRecord = [&](const std::string& lowerFilePath) {
 				auto it = hlslToShaderMap.find(lowerFilePath);
-				hlslRecord newRecord{ key, shader.shaderType.get(), descriptor, shaderClass, SIE::SShaderCache::GetDiskPath(shader.fxpFilename, descriptor, shaderClass) };
 
 				if (it != hlslToShaderMap.end()) {
 					auto& entries = it->second;
@@ -2018,28 +1412,39 @@ namespace SIE
 					// Create a new entry in hlslToShaderMap for this file path
 					hlslToShaderMap.emplace(lowerFilePath, std::set<hlslRecord>{ newRecord });
 				}
+			};
+
+			std::string lowerFilePath = Util::FixFilePath(pathString);
+			{
+				std::unique_lock lockH{ hlslMapMutex };
+				addRecord(lowerFilePath);
+				// includes too, so editing a shared header only recompiles the shaders using it
+				for (const auto& dependency : a_dependencies) {
+					if (dependency != lowerFilePath) {
+						addRecord(dependency);
+					}
+				}
 			}
 		}
 
 		return a_blob != nullptr;
 	}
 
-	ID3DBlob* ShaderCache::GetCompletedShader(const std::string& a_key)
+	ID3DBlob* ShaderCache::GetCompletedShader(const ShaderKey& a_key)
 	{
-		std::string type = SIE::SShaderCache::GetTypeFromShaderString(a_key);
+		const std::string type{ magic_enum::enum_name(a_key.GetType()) };
 		UpdateShaderModifiedTime(type);
 		std::scoped_lock lockM{ mapMutex };
-		if (!shaderMap.empty() && shaderMap.contains(a_key)) {
-			if (ShaderModifiedSince(type, shaderMap.at(a_key).compileTime)) {
+		if (auto it = shaderMap.find(a_key); it != shaderMap.end()) {
+			if (ShaderModifiedSince(type, it->second.compileTime)) {
 				logger::debug("Shader {} compiled {} before changes at {}",
 					a_key,
-					std::format("{:%H:%M:%S}", shaderMap.at(a_key).compileTime),
+					std::format("{:%H:%M:%S}", it->second.compileTime),
 					std::format("{:%H:%M:%S}", GetModifiedShaderMapTime(type)));
 				return nullptr;
 			}
-			auto status = shaderMap.at(a_key).status;
-			if (status != ShaderCompilationTask::Status::Pending)
-				return shaderMap.at(a_key).blob;
+			if (it->second.status != ShaderCompilationTask::Status::Pending)
+				return it->second.blob;
 		}
 		return nullptr;
 	}
@@ -2047,21 +1452,19 @@ namespace SIE
 	ID3DBlob* ShaderCache::GetCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader,
 		uint32_t descriptor)
 	{
-		auto key = SIE::SShaderCache::GetShaderString(shaderClass, shader, descriptor, true);
-		return GetCompletedShader(key);
+		return GetCompletedShader(GetShaderKey(shaderClass, shader, descriptor));
 	}
 
 	ID3DBlob* ShaderCache::GetCompletedShader(const ShaderCompilationTask& a_task)
 	{
-		auto key = a_task.GetString();
-		return GetCompletedShader(key);
+		return GetCompletedShader(a_task.GetKey());
 	}
 
-	ShaderCompilationTask::Status ShaderCache::GetShaderStatus(const std::string& a_key)
+	ShaderCompilationTask::Status ShaderCache::GetShaderStatus(const ShaderKey& a_key)
 	{
 		std::scoped_lock lockM{ mapMutex };
-		if (!shaderMap.empty() && shaderMap.contains(a_key)) {
-			return shaderMap.at(a_key).status;
+		if (auto it = shaderMap.find(a_key); it != shaderMap.end()) {
+			return it->second.status;
 		}
 		return ShaderCompilationTask::Status::Pending;
 	}
@@ -2135,6 +1538,15 @@ namespace SIE
 	void ShaderCache::DeleteDiskCache()
 	{
 		std::scoped_lock lock{ compilationSet.compilationMutex };
+		{
+			// mapped archives cannot be deleted; closed ones also refuse the writes of compiles still holding them
+			std::scoped_lock lockA{ diskArchivesMutex };
+			for (auto& [name, archive] : diskArchives) {
+				archive->Close();
+			}
+			diskArchives.clear();
+		}
+		dependencies.Clear();
 		try {
 			std::filesystem::remove_all(L"Data/ShaderCache");
 			logger::info("Deleted disk cache");
@@ -2149,11 +1561,20 @@ namespace SIE
 		ini.SetUnicode();
 		ini.LoadFile(L"Data\\ShaderCache\\Info.ini");
 		bool valid = true;
+		const bool hasGraph = dependencies.Load();
 
 		if (auto version = ini.GetValue("Cache", "Version")) {
-			if (strcmp(SHADER_CACHE_VERSION.string().c_str(), version) != 0 || !(State::GetSingleton()->ValidateCache(ini))) {
+			if (strcmp(SHADER_CACHE_VERSION.string().c_str(), version) != 0) {
 				logger::info("Disk cache outdated or invalid");
 				valid = false;
+			} else if (!(State::GetSingleton()->ValidateCache(ini))) {
+				if (hasGraph) {
+					// feature changes show up as changed sources or defines, which the include graph checks per shader
+					logger::info("Installed features changed; only affected shaders will be recompiled");
+				} else {
+					logger::info("Disk cache outdated or invalid");
+					valid = false;
+				}
 			}
 		} else {
 			logger::info("Disk cache outdated or invalid");
@@ -2167,19 +1588,210 @@ namespace SIE
 		}
 	}
 
+	std::shared_ptr<ShaderArchive> ShaderCache::GetDiskArchive(const std::string& a_name)
+	{
+		std::scoped_lock lock{ diskArchivesMutex };
+		auto it = diskArchives.find(a_name);
+		if (it == diskArchives.end()) {
+			auto archive = std::make_shared<ShaderArchive>(SIE::SShaderCache::GetArchivePath(a_name));
+			if (!archive->Open()) {
+				logger::warn("Disk cache for {} is unreadable and will be rebuilt", a_name);
+			}
+			it = diskArchives.emplace(a_name, std::move(archive)).first;
+		}
+		return it->second;
+	}
+
+	void ShaderCache::CompactDiskCache()
+	{
+		std::vector<std::shared_ptr<ShaderArchive>> archives;
+		{
+			std::scoped_lock lock{ diskArchivesMutex };
+			for (auto& [name, archive] : diskArchives) {
+				archives.push_back(archive);
+			}
+		}
+		for (auto& archive : archives) {
+			archive->Compact();
+		}
+		dependencies.Save();
+	}
+
 	void ShaderCache::WriteDiskCacheInfo()
 	{
+		CompactDiskCache();
 		CSimpleIniA ini;
 		ini.SetUnicode();
 		ini.SetValue("Cache", "Version", SHADER_CACHE_VERSION.string().c_str());
 		State::GetSingleton()->WriteDiskCacheInfo(ini);
 		ini.SaveFile(L"Data\\ShaderCache\\Info.ini");
 		logger::info("Saved disk cache info");
+
+		// the offline cache builder writes the same Info.ini from the manifest
+		std::vector<PermutationManifest::InfoValue> info;
+		CSimpleIniA::TNamesDepend sections;
+		ini.GetAllSections(sections);
+		sections.sort(CSimpleIniA::Entry::LoadOrder());
+		for (const auto& section : sections) {
+			CSimpleIniA::TNamesDepend keys;
+			ini.GetAllKeys(section.pItem, keys);
+			keys.sort(CSimpleIniA::Entry::LoadOrder());
+			for (const auto& key : keys) {
+				info.push_back({ section.pItem, key.pItem, ini.GetValue(section.pItem, key.pItem, "") });
+			}
+		}
+		permutationManifest.SetCacheInfo(std::move(info));
+
+		const auto state = State::GetSingleton();
+		PermutationManifest::CompileContext context{ .developerMode = state->IsDeveloperMode(), .vr = REL::Module::IsVR() };
+		context.globalDefines = *state->GetDefines();
+		for (size_t type = 0; type < context.featureDefines.size(); ++type) {
+			for (auto* feature : Feature::GetFeatureList()) {
+				if (feature->loaded && feature->HasShaderDefine(static_cast<RE::BSShader::Type>(type))) {
+					context.featureDefines[type].emplace_back(feature->GetShaderDefineName());
+				}
+			}
+		}
+		permutationManifest.SetCompileContext(context);
+
+		std::vector<PrewarmRequest> requests;
+		{
+			std::scoped_lock lock{ prewarmMutex };
+			requests.swap(manifestRequests);
+		}
+		for (const auto& request : requests) {
+			std::array<D3D_SHADER_MACRO, 64> gameDefines{};
+			SIE::SShaderCache::GetGameShaderDefines(*request.shader, request.descriptor, gameDefines);
+			permutationManifest.Add(request.shader->fxpFilename, SIE::SShaderCache::GetShaderSourceName(*request.shader), ToShaderType(request.shader->shaderType.get()),
+				request.shaderClass, request.descriptor, gameDefines.data());
+		}
+		permutationManifest.Save(L"Data\\ShaderCache\\Permutations.bin");
+	}
+
+	void ShaderCache::UpdateUsageLocation()
+	{
+		uint32_t location = 0;
+		if (auto player = RE::PlayerCharacter::GetSingleton()) {
+			if (auto cell = player->GetParentCell()) {
+				if (cell->IsInteriorCell()) {
+					location = cell->GetFormID();
+				} else if (auto worldspace = player->GetWorldspace()) {
+					location = worldspace->GetFormID();
+				}
+			}
+		}
+		// no cell while loading or in the main menu; the visit continues until the next location
+		if (location && usageLog.SetLocation(location)) {
+			compilationPool.push_task([this]() { usageLog.Save(); });
+		}
+	}
+
+	void ShaderCache::QueuePrewarm(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor)
+	{
+		std::scoped_lock lock{ prewarmMutex };
+		prewarmQueue.push_back({ &a_shader, a_class, a_descriptor });
+		if (isDiskCache) {
+			// the manifest is filled in when the disk cache info is saved
+			manifestRequests.push_back(prewarmQueue.back());
+		}
+	}
+
+	void ShaderCache::RequestShader(const PrewarmRequest& a_request, CompilationPriority a_priority)
+	{
+		if (a_request.shaderClass == ShaderClass::Vertex) {
+			std::ignore = GetVertexShader(*a_request.shader, a_request.descriptor, a_priority);
+		} else if (a_request.shaderClass == ShaderClass::Pixel) {
+			std::ignore = GetPixelShader(*a_request.shader, a_request.descriptor, a_priority);
+		} else if (a_request.shaderClass == ShaderClass::Compute) {
+			std::ignore = GetComputeShader(*a_request.shader, a_request.descriptor, a_priority);
+		}
+	}
+
+	void ShaderCache::RequestShaders(const std::vector<PrewarmRequest>& a_requests, CompilationPriority a_priority)
+	{
+		// collect what the lookups would queue so the whole batch takes the compilation lock once
+		std::vector<ShaderCompilationTask> batch;
+		batch.reserve(a_requests.size());
+		SShaderCache::pendingBatch = &batch;
+		for (const auto& request : a_requests) {
+			RequestShader(request, a_priority);
+		}
+		SShaderCache::pendingBatch = nullptr;
+		compilationSet.Add(batch, a_priority);
+	}
+
+	void ShaderCache::EnqueueCompilation(const ShaderCompilationTask& a_task, CompilationPriority a_priority)
+	{
+		if (SShaderCache::pendingBatch) {
+			SShaderCache::pendingBatch->push_back(a_task);
+		} else {
+			compilationSet.Add(a_task, a_priority);
+		}
+	}
+
+	void ShaderCache::SubmitPrewarm()
+	{
+		std::vector<PrewarmRequest> requests;
+		{
+			std::scoped_lock lock{ prewarmMutex };
+			requests.swap(prewarmQueue);
+		}
+		if (requests.empty()) {
+			return;
+		}
+
+		if (usageLog.IsEmpty()) {
+			// nothing recorded yet, so everything is the working set
+			RequestShaders(requests, CompilationPriority::Prewarm);
+			return;
+		}
+
+		std::vector<std::pair<uint64_t, PrewarmRequest>> ranked;
+		std::vector<PrewarmRequest> rest;
+		for (const auto& request : requests) {
+			auto key = ShaderKey(request.shaderClass, ToShaderType(request.shader->shaderType.get()), request.descriptor, 0);
+			if (auto order = usageLog.GetPrewarmOrder(key.value)) {
+				ranked.emplace_back(*order, request);
+			} else {
+				rest.push_back(request);
+			}
+		}
+		std::ranges::stable_sort(ranked, {}, &std::pair<uint64_t, PrewarmRequest>::first);
+		std::vector<PrewarmRequest> workingSet;
+		workingSet.reserve(ranked.size());
+		for (const auto& [order, request] : ranked) {
+			workingSet.push_back(request);
+		}
+
+		logger::info("Prewarming {} of {} {} permutations from the usage log{}",
+			workingSet.size(), requests.size(), requests.front().shader->fxpFilename,
+			prewarmWorkingSetOnly ? "" : "; the rest compile after loading");
+		RequestShaders(workingSet, CompilationPriority::Recent);
+		if (!prewarmWorkingSetOnly) {
+			std::scoped_lock lock{ prewarmMutex };
+			deferredPrewarm.insert(deferredPrewarm.end(), rest.begin(), rest.end());
+		}
+	}
+
+	void ShaderCache::SubmitDeferredPrewarm()
+	{
+		std::vector<PrewarmRequest> requests;
+		{
+			std::scoped_lock lock{ prewarmMutex };
+			requests.swap(deferredPrewarm);
+		}
+		if (requests.empty()) {
+			return;
+		}
+		logger::info("Compiling {} permutations outside the usage log's working set in the background", requests.size());
+		backgroundCompilation = true;
+		RequestShaders(requests, CompilationPriority::Prewarm);
 	}
 
 	ShaderCache::ShaderCache()
 	{
 		logger::debug("ShaderCache initialized with {} compiler threads", (int)compilationThreadCount);
+		usageLog.Load();
 		compilationPool.push_task(&ShaderCache::ManageCompilationSet, this, ssource.get_token());
 	}
 
@@ -2287,13 +1899,13 @@ namespace SIE
 				SShaderCache::CompileShader(ShaderClass::Vertex, shader, descriptor, isDiskCache)) {
 			auto device = VariableCache::GetSingleton()->device;
 
-			auto newShader = SShaderCache::CreateVertexShader(*shaderBlob, shader,
-				descriptor);
-
-			std::lock_guard lockGuard(vertexShadersMutex);
+			const auto reflection = GetShaderReflection(ShaderClass::Vertex, shader, descriptor, *shaderBlob);
+			auto newShader = SShaderCache::CreateVertexShader(*shaderBlob, descriptor, reflection);
 
-			const auto result = device->CreateVertexShader(shaderBlob->GetBufferPointer(),
-				newShader->byteCodeSize, nullptr, reinterpret_cast<ID3D11VertexShader**>(&newShader->shader));
+			const auto result = GetDeviceShader(shaderBlob, reinterpret_cast<ID3D11DeviceChild**>(&newShader->shader), [&](ID3D11DeviceChild** o_shader) {
+				return device->CreateVertexShader(shaderBlob->GetBufferPointer(),
+					newShader->byteCodeSize, nullptr, reinterpret_cast<ID3D11VertexShader**>(o_shader));
+			});
 			if (FAILED(result)) {
 				logger::error("Failed to create vertex shader {}::{:X}",
 					magic_enum::enum_name(shader.shaderType.get()), descriptor);
@@ -2301,9 +1913,7 @@ namespace SIE
 					newShader->shader->Release();
 				}
 			} else {
-				return vertexShaders[static_cast<size_t>(shader.shaderType.get())]
-				    .insert_or_assign(descriptor, std::move(newShader))
-				    .first->second.get();
+				return vertexShaders[static_cast<size_t>(shader.shaderType.get())].Insert(descriptor, std::move(newShader));
 			}
 		}
 		return nullptr;
@@ -2316,12 +1926,13 @@ namespace SIE
 				SShaderCache::CompileShader(ShaderClass::Pixel, shader, descriptor, isDiskCache)) {
 			auto device = VariableCache::GetSingleton()->device;
 
-			auto newShader = SShaderCache::CreatePixelShader(*shaderBlob, shader,
-				descriptor);
+			const auto reflection = GetShaderReflection(ShaderClass::Pixel, shader, descriptor, *shaderBlob);
+			auto newShader = SShaderCache::CreatePixelShader(descriptor, reflection);
 
-			std::lock_guard lockGuard(pixelShadersMutex);
-			const auto result = device->CreatePixelShader(shaderBlob->GetBufferPointer(),
-				shaderBlob->GetBufferSize(), nullptr, reinterpret_cast<ID3D11PixelShader**>(&newShader->shader));
+			const auto result = GetDeviceShader(shaderBlob, reinterpret_cast<ID3D11DeviceChild**>(&newShader->shader), [&](ID3D11DeviceChild** o_shader) {
+				return device->CreatePixelShader(shaderBlob->GetBufferPointer(),
+					shaderBlob->GetBufferSize(), nullptr, reinterpret_cast<ID3D11PixelShader**>(o_shader));
+			});
 			if (FAILED(result)) {
 				logger::error("Failed to create pixel shader {}::{:X}",
 					magic_enum::enum_name(shader.shaderType.get()),
@@ -2330,9 +1941,7 @@ namespace SIE
 					newShader->shader->Release();
 				}
 			} else {
-				return pixelShaders[static_cast<size_t>(shader.shaderType.get())]
-				    .insert_or_assign(descriptor, std::move(newShader))
-				    .first->second.get();
+				return pixelShaders[static_cast<size_t>(shader.shaderType.get())].Insert(descriptor, std::move(newShader));
 			}
 		}
 		return nullptr;
@@ -2348,9 +1957,10 @@ namespace SIE
 			auto newShader = SShaderCache::CreateComputeShader(*shaderBlob, shader,
 				descriptor);
 
-			std::lock_guard lockGuard(computeShadersMutex);
-			const auto result = device->CreateComputeShader(shaderBlob->GetBufferPointer(),
-				shaderBlob->GetBufferSize(), nullptr, reinterpret_cast<ID3D11ComputeShader**>(&newShader->shader));
+			const auto result = GetDeviceShader(shaderBlob, reinterpret_cast<ID3D11DeviceChild**>(&newShader->shader), [&](ID3D11DeviceChild** o_shader) {
+				return device->CreateComputeShader(shaderBlob->GetBufferPointer(),
+					shaderBlob->GetBufferSize(), nullptr, reinterpret_cast<ID3D11ComputeShader**>(o_shader));
+			});
 			if (FAILED(result)) {
 				logger::error("Failed to create pixel shader {}::{:X}",
 					magic_enum::enum_name(shader.shaderType.get()),
@@ -2359,14 +1969,165 @@ namespace SIE
 					newShader->shader->Release();
 				}
 			} else {
-				return computeShaders[static_cast<size_t>(shader.shaderType.get())]
-				    .insert_or_assign(descriptor, std::move(newShader))
-				    .first->second.get();
+				return computeShaders[static_cast<size_t>(shader.shaderType.get())].Insert(descriptor, std::move(newShader));
 			}
 		}
 		return nullptr;
 	}
 
+	ShaderReflection ShaderCache::GetShaderReflection(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor, ID3DBlob& a_blob)
+	{
+		const auto start = high_resolution_clock::now();
+		const auto bytecodeHash = ShaderDependencies::HashContent({ static_cast<const char*>(a_blob.GetBufferPointer()), a_blob.GetBufferSize() });
+		const auto key = SShaderCache::GetReflectionKey(a_class, a_descriptor);
+		auto archive = isDiskCache ? GetDiskArchive(a_shader.fxpFilename) : nullptr;
+
+		ShaderReflection reflection;
+		bool cached = false;
+		if (archive) {
+			system_clock::time_point writeTime;
+			if (auto storedBlob = archive->Read(key, writeTime)) {
+				cached = ShaderReflection::Load({ static_cast<const uint8_t*>(storedBlob->GetBufferPointer()), storedBlob->GetBufferSize() }, bytecodeHash, reflection);
+				storedBlob->Release();
+			}
+		}
+
+		if (!cached) {
+			reflection = SShaderCache::ReflectShader(a_blob, a_class, a_shader, a_descriptor);
+			reflection.bytecodeHash = bytecodeHash;
+			ID3DBlob* reflectionBlob = nullptr;
+			if (archive && reflection.reflected && SUCCEEDED(D3DCreateBlob(sizeof(ShaderReflection), &reflectionBlob))) {
+				memcpy(reflectionBlob->GetBufferPointer(), &reflection, sizeof(ShaderReflection));
+				if (!archive->Write(key, reflectionBlob) && !archive->IsClosed()) {
+					logger::warn("Failed to save reflection of {} shader {}::{:X} to disk cache", magic_enum::enum_name(a_class),
+						magic_enum::enum_name(a_shader.shaderType.get()), a_descriptor);
+				}
+				reflectionBlob->Release();
+			}
+		}
+
+		(cached ? compilationSet.cachedReflections : compilationSet.reflectedShaders)++;
+		compilationSet.reflectionMicroseconds += duration_cast<microseconds>(high_resolution_clock::now() - start).count();
+		return reflection;
+	}
+
+	ID3DBlob* ShaderCache::CompileContent(uint64_t a_contentHash, const std::function<ID3DBlob*()>& a_compile, bool& o_deduplicated)
+	{
+		std::promise<ID3DBlob*> promise;
+		std::shared_future<ID3DBlob*> pending;
+		uint64_t generation = 0;
+		{
+			std::scoped_lock lock{ contentMutex };
+			generation = contentGeneration;
+			auto [it, inserted] = contentCompiles.try_emplace(a_contentHash);
+			if (inserted) {
+				it->second = promise.get_future().share();
+			} else {
+				pending = it->second;
+			}
+		}
+
+		if (pending.valid()) {
+			auto blob = pending.get();
+			if (blob) {
+				blob->AddRef();
+			}
+			o_deduplicated = true;
+			compilationSet.dedupedTasks++;
+			return blob;
+		}
+
+		o_deduplicated = false;
+		auto blob = a_compile();
+		{
+			// published under the lock, so ReleaseSharedShaders either sees the result and releases the map's
+			// reference or has already dropped the entry, and then the map takes none
+			std::scoped_lock lock{ contentMutex };
+			if (blob && generation == contentGeneration) {
+				blob->AddRef();  // reference held by contentCompiles
+			}
+			promise.set_value(blob);
+		}
+		return blob;
+	}
+
+	std::optional<BytecodeKey> BytecodeKey::FromBlob(ID3DBlob* a_blob)
+	{
+		// "DXBC", 128-bit checksum of the rest, version, total size
+		constexpr uint32_t DXBCMagic = 0x43425844;
+		struct Header
+		{
+			uint32_t magic;
+			std::array<uint32_t, 4> checksum;
+			uint32_t version;
+			uint32_t size;
+		} header;
+
+		if (a_blob->GetBufferSize() < sizeof(Header)) {
+			return std::nullopt;
+		}
+		memcpy(&header, a_blob->GetBufferPointer(), sizeof(Header));
+		if (header.magic != DXBCMagic || header.size != a_blob->GetBufferSize()) {
+			return std::nullopt;
+		}
+		return BytecodeKey{ header.checksum, header.size };
+	}
+
+	HRESULT ShaderCache::GetDeviceShader(ID3DBlob* a_blob, ID3D11DeviceChild** o_shader, const std::function<HRESULT(ID3D11DeviceChild**)>& a_create)
+	{
+		// a 64-bit content hash could pair two shaders, the DXBC checksum and size cannot in practice
+		const auto key = BytecodeKey::FromBlob(a_blob);
+		if (!key) {
+			return a_create(o_shader);
+		}
+		{
+			std::scoped_lock lock{ deviceShaderMutex };
+			if (auto it = deviceShaders.find(*key); it != deviceShaders.end()) {
+				it->second->AddRef();
+				*o_shader = it->second;
+				return S_OK;
+			}
+		}
+
+		const auto result = a_create(o_shader);
+		if (SUCCEEDED(result)) {
+			std::scoped_lock lock{ deviceShaderMutex };
+			auto [it, inserted] = deviceShaders.try_emplace(*key, *o_shader);
+			if (!inserted) {
+				// another thread created the same bytecode first
+				(*o_shader)->Release();
+				*o_shader = it->second;
+			}
+			it->second->AddRef();
+		}
+		return result;
+	}
+
+	void ShaderCache::ReleaseSharedShaders()
+	{
+		decltype(contentCompiles) compiles;
+		{
+			std::scoped_lock lock{ contentMutex };
+			std::swap(compiles, contentCompiles);
+			contentGeneration++;
+		}
+		// compiles still running are left to finish on their own and keep no reference for the map
+		for (auto& [hash, compile] : compiles) {
+			if (compile.wait_for(std::chrono::seconds::zero()) != std::future_status::ready) {
+				continue;
+			}
+			if (auto blob = compile.get()) {
+				blob->Release();
+			}
+		}
+
+		std::scoped_lock lock{ deviceShaderMutex };
+		for (auto& [key, shader] : deviceShaders) {
+			shader->Release();
+		}
+		deviceShaders.clear();
+	}
+
 	std::string ShaderCache::GetDefinesString(const RE::BSShader& shader, uint32_t descriptor)
 	{
 		std::array<D3D_SHADER_MACRO, 64> defines{};
@@ -2409,8 +2170,7 @@ namespace SIE
 		std::unique_lock lockM{ SIE::ShaderCache::mapMutex };
 		logger::debug("Clearing shaderMap of {}", shaderTypeStr);
 		for (auto it = shaderMap.begin(); it != shaderMap.end();) {
-			auto typeInKey = SIE::SShaderCache::GetTypeFromShaderString(it->first);
-			if (typeInKey == shaderTypeStr) {
+			if (it->first.GetType() == ToShaderType(a_type)) {
 				it = shaderMap.erase(it);
 			} else {
 				++it;
@@ -2445,7 +2205,7 @@ namespace SIE
 		auto index = 0;
 		for (auto& [key, value] : shaderMap) {
 			if (index++ == targetIndex) {
-				blockedKey = key;
+				blockedKey = SIE::SShaderCache::GetShaderString(key.GetClass(), *value.shader, key.GetDescriptor(), true);
 				blockedKeyIndex = (uint)targetIndex;
 				blockedIDs.clear();
 				logger::debug("Blocking shader ({}/{}) {}", blockedKeyIndex + 1, shaderMap.size(), blockedKey);
@@ -2467,10 +2227,12 @@ namespace SIE
 		managementThread = GetCurrentThread();
 		SetThreadPriority(managementThread, THREAD_PRIORITY_BELOW_NORMAL);
 		while (!stoken.stop_requested()) {
-			const auto& task = compilationSet.WaitTake(stoken);
-			if (!task.has_value())
+			const auto tasks = compilationSet.WaitTake(stoken);
+			if (tasks.empty())
 				break;  // exit because thread told to end
-			compilationPool.push_task(&ShaderCache::ProcessCompilationSet, this, stoken, task.value());
+			for (const auto& task : tasks) {
+				compilationPool.push_task(&ShaderCache::ProcessCompilationSet, this, stoken, task);
+			}
 		}
 	}
 
@@ -2481,11 +2243,16 @@ namespace SIE
 		compilationSet.Complete(task);
 	}
 
+	ShaderKey GetShaderKey(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor)
+	{
+		return ShaderKey(a_class, ToShaderType(a_shader.shaderType.get()), a_descriptor, State::GetSingleton()->shaderDefinesEpoch.load(std::memory_order_relaxed));
+	}
+
 	ShaderCompilationTask::ShaderCompilationTask(ShaderClass aShaderClass,
 		const RE::BSShader& aShader,
 		uint32_t aDescriptor) :
 		shaderClass(aShaderClass),
-		shader(aShader), descriptor(aDescriptor)
+		shader(aShader), descriptor(aDescriptor), key(GetShaderKey(aShaderClass, aShader, aDescriptor))
 	{}
 
 	void ShaderCompilationTask::Perform() const
@@ -2501,8 +2268,12 @@ namespace SIE
 
 	size_t ShaderCompilationTask::GetId() const
 	{
-		return descriptor + (static_cast<size_t>(shader.shaderType.underlying()) << 32) +
-		       (static_cast<size_t>(shaderClass) << 60);
+		return key.value;
+	}
+
+	ShaderKey ShaderCompilationTask::GetKey() const
+	{
+		return key;
 	}
 
 	std::string ShaderCompilationTask::GetString() const
@@ -2515,47 +2286,108 @@ namespace SIE
 		return GetId() == other.GetId();
 	}
 
-	std::optional<ShaderCompilationTask> CompilationSet::WaitTake(std::stop_token stoken)
+	std::unique_lock<std::mutex> CompilationSet::Lock()
+	{
+		std::unique_lock lock(compilationMutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			contendedLocks++;
+			lock.lock();
+		}
+		return lock;
+	}
+
+	std::vector<ShaderCompilationTask> CompilationSet::WaitTake(std::stop_token stoken)
 	{
-		std::unique_lock lock(compilationMutex);
 		auto& shaderCache = ShaderCache::Instance();
+		auto getLimit = [&shaderCache]() {
+			return !shaderCache.backgroundCompilation ? shaderCache.compilationThreadCount : shaderCache.backgroundCompilationThreadCount;
+		};
+		auto lock = Lock();
 		if (!conditionVariable.wait(
 				lock, stoken,
-				[this, &shaderCache]() { return !availableTasks.empty() &&
-			                                    // check against all tasks in queue to trickle the work. It cannot be the active tasks count because the thread pool itself is maximum.
-			                                    (int)shaderCache.compilationPool.get_tasks_total() <=
-			                                        (!shaderCache.backgroundCompilation ? shaderCache.compilationThreadCount : shaderCache.backgroundCompilationThreadCount); })) {
+				[this, &shaderCache, &getLimit]() { return !availableTasks.empty() &&
+			                                               // check against all tasks in queue to trickle the work. It cannot be the active tasks count because the thread pool itself is maximum.
+			                                               (int)shaderCache.compilationPool.get_tasks_total() <= getLimit(); })) {
 			/*Woke up because of a stop request. */
-			return std::nullopt;
+			return {};
 		}
 		if (!ShaderCache::Instance().IsCompiling()) {  // we just got woken up because there's a task, start clock
 			lastCalculation = lastReset = high_resolution_clock::now();
 		}
-		auto node = availableTasks.extract(availableTasks.begin());
-		auto& task = node.value();
-		tasksInProgress.insert(std::move(node));
-		return task;
+
+		// fill the free pool slots in one go; taking more would queue work in the pool where a draw request cannot overtake it
+		const auto room = (size_t)std::max(getLimit() - (int)shaderCache.compilationPool.get_tasks_total(), 1);
+		std::vector<ShaderCompilationTask> tasks;
+		tasks.reserve(std::min(room, availableTasks.size()));
+		for (size_t priority = 0; priority < queues.size() && tasks.size() < room; ++priority) {
+			auto& queue = queues[priority];
+			while (!queue.empty() && tasks.size() < room) {
+				auto task = queue.front();
+				queue.pop_front();
+				auto it = availableTasks.find(task.GetKey());
+				if (it == availableTasks.end() || static_cast<size_t>(it->second) != priority) {
+					continue;  // promoted to a higher queue
+				}
+				availableTasks.erase(it);
+				tasksInProgress.insert(task);
+				tasks.push_back(task);
+			}
+		}
+		return tasks;
 	}
 
-	void CompilationSet::Add(const ShaderCompilationTask& task)
+	bool CompilationSet::AddLocked(const ShaderCompilationTask& task, CompilationPriority a_priority)
 	{
-		std::unique_lock lock(compilationMutex);
-		auto inProgressIt = tasksInProgress.find(task);
-		auto processedIt = processedTasks.find(task);
-		if (inProgressIt == tasksInProgress.end() && processedIt == processedTasks.end() && !ShaderCache::Instance().GetCompletedShader(task)) {
-			auto [availableIt, wasAdded] = availableTasks.insert(task);
-			lock.unlock();
-			if (wasAdded) {
-				conditionVariable.notify_one();
-				totalTasks++;
+		if (auto it = availableTasks.find(task.GetKey()); it != availableTasks.end()) {
+			if (a_priority < it->second) {
+				// leave the old entry behind as stale; WaitTake skips it
+				it->second = a_priority;
+				queues[static_cast<size_t>(a_priority)].push_back(task);
+				promotedTasks++;
+			}
+			return false;
+		}
+		if (tasksInProgress.contains(task) || processedTasks.contains(task) || ShaderCache::Instance().GetCompletedShader(task)) {
+			return false;
+		}
+		availableTasks.emplace(task.GetKey(), a_priority);
+		queues[static_cast<size_t>(a_priority)].push_back(task);
+		return true;
+	}
+
+	void CompilationSet::Add(const ShaderCompilationTask& task, CompilationPriority a_priority)
+	{
+		auto lock = Lock();
+		const bool wasAdded = AddLocked(task, a_priority);
+		lock.unlock();
+		if (wasAdded) {
+			totalTasks++;
+			conditionVariable.notify_one();
+		}
+	}
+
+	void CompilationSet::Add(const std::vector<ShaderCompilationTask>& a_tasks, CompilationPriority a_priority)
+	{
+		if (a_tasks.empty()) {
+			return;
+		}
+		uint64_t added = 0;
+		{
+			auto lock = Lock();
+			for (const auto& task : a_tasks) {
+				added += AddLocked(task, a_priority);
 			}
 		}
+		if (added) {
+			totalTasks += added;
+			conditionVariable.notify_one();
+		}
 	}
 
 	void CompilationSet::Complete(const ShaderCompilationTask& task)
 	{
 		auto& cache = ShaderCache::Instance();
-		auto key = task.GetString();
+		auto key = task.GetKey();
 		auto shaderBlob = cache.GetCompletedShader(task);
 		if (shaderBlob) {
 			logger::debug("Compiling Task succeeded: {}", key);
@@ -2567,15 +2399,20 @@ namespace SIE
 		auto now = high_resolution_clock::now();
 		totalMs += duration_cast<milliseconds>(now - lastCalculation).count();
 		lastCalculation = now;
-		std::scoped_lock lock(compilationMutex);
-		processedTasks.insert(task);
-		tasksInProgress.erase(task);
+		{
+			auto lock = Lock();
+			processedTasks.insert(task);
+			tasksInProgress.erase(task);
+		}
 		conditionVariable.notify_one();
 	}
 
 	void CompilationSet::Clear()
 	{
-		std::scoped_lock lock(compilationMutex);
+		auto lock = Lock();
+		for (auto& queue : queues) {
+			queue.clear();
+		}
 		availableTasks.clear();
 		tasksInProgress.clear();
 		processedTasks.clear();
@@ -2583,6 +2420,12 @@ namespace SIE
 		completedTasks = 0;
 		failedTasks = 0;
 		cacheHitTasks = 0;
+		contendedLocks = 0;
+		promotedTasks = 0;
+		dedupedTasks = 0;
+		cachedReflections = 0;
+		reflectedShaders = 0;
+		reflectionMicroseconds = 0;
 		lastReset = high_resolution_clock::now();
 		lastCalculation = high_resolution_clock::now();
 		totalMs = (double)duration_cast<std::chrono::milliseconds>(lastReset - lastReset).count();
@@ -2613,11 +2456,19 @@ namespace SIE
 			return fmt::format("{}/{}",
 				GetHumanTime(totalMs),
 				GetHumanTime(GetEta() + totalMs));
-		return fmt::format("{}/{} (successful/total)\tfailed: {}\tcachehits: {}\nElapsed/Estimated Time: {}/{}",
+		const auto compiled = completedTasks + failedTasks;
+		return fmt::format("{}/{} (successful/total)\tfailed: {}\tcachehits: {}\tdedup: {} ({:.1f}%)\tpromoted: {}\tlock waits: {}\treflections: {}/{} cached ({:.1f} ms)\nElapsed/Estimated Time: {}/{}",
 			(std::uint64_t)completedTasks,
 			(std::uint64_t)totalTasks,
 			(std::uint64_t)failedTasks,
 			(std::uint64_t)cacheHitTasks,
+			(std::uint64_t)dedupedTasks,
+			compiled ? 100.0 * dedupedTasks / compiled : 0.0,
+			(std::uint64_t)promotedTasks,
+			(std::uint64_t)contendedLocks,
+			(std::uint64_t)cachedReflections,
+			cachedReflections + reflectedShaders,
+			reflectionMicroseconds / 1000.0,
 			GetHumanTime(totalMs),
 			GetHumanTime(GetEta() + totalMs));
 	}
@@ -2638,18 +2489,23 @@ namespace SIE
 			return;
 		}
 
-		// Ensure the file is not a directory and is a valid shader file (.hlsl)
+		// Ensure the file is not a directory and is a valid shader file (.hlsl) or include (.hlsli)
 		std::string lowerExtension = extension;
 		std::transform(lowerExtension.begin(), lowerExtension.end(), lowerExtension.begin(),
 			[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-		if (!std::filesystem::is_directory(filePath) && lowerExtension == ".hlsl") {
+		if (!std::filesystem::is_directory(filePath) && (lowerExtension == ".hlsl" || lowerExtension == ".hlsli")) {
 			// Update cache with the modified shader
-			cache.InsertModifiedShaderMap(shaderTypeString, modifiedTime);
+			if (lowerExtension == ".hlsl")
+				cache.InsertModifiedShaderMap(shaderTypeString, modifiedTime);
+			cache.GetDependencies().InvalidateFile(ShaderDependencies::NormalizePath(filePath));
 
-			// Attempt to mark the shader for recompilation
+			// Attempt to mark the shader and every shader including it for recompilation
 			bool foundPath = cache.Clear(filePath.string());
 
-			if (!foundPath) {
+			if (!foundPath && lowerExtension == ".hlsli") {
+				// no loaded shader includes it; cached ones are checked against the include graph when loaded
+				logger::debug("No loaded shader includes {}", filePath.string());
+			} else if (!foundPath) {
 				// File was not found in the the map so check its shader type
 				std::string parentDirName = filePath.parent_path().filename().string();
 				std::transform(parentDirName.begin(), parentDirName.end(), parentDirName.begin(),
@@ -3,13 +3,23 @@
 #include <RE/B/BSShader.h>
 
 #include "BS_thread_pool.hpp"
+#include "PermutationManifest.h"
+#include "ShaderArchive.h"
+#include "ShaderDependencies.h"
+#include "ShaderPermutations.h"
+#include "ShaderReflection.h"
+#include "ShaderTable.h"
+#include "ShaderUsageLog.h"
 #include "efsw/efsw.hpp"
 #include <chrono>
 #include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
 #include <unordered_map>
 #include <unordered_set>
 
-static constexpr REL::Version SHADER_CACHE_VERSION = { 0, 0, 0, 28 };
+static constexpr REL::Version SHADER_CACHE_VERSION = { 0, 0, 0, 29 };
 
 using namespace std::chrono;
 
@@ -201,14 +211,55 @@ namespace ShaderConstants
 
 namespace SIE
 {
-	enum class ShaderClass
+	static_assert(static_cast<uint32_t>(ShaderType::Lighting) == static_cast<uint32_t>(RE::BSShader::Type::Lighting));
+	static_assert(static_cast<uint32_t>(ShaderType::Total) == static_cast<uint32_t>(RE::BSShader::Type::Total));
+
+	inline ShaderType ToShaderType(RE::BSShader::Type a_type)
 	{
-		Vertex,
-		Pixel,
-		Compute,
-		Total,
+		return static_cast<ShaderType>(a_type);
+	}
+
+	/**
+	 * @brief Builds the key of a permutation for the current global defines epoch.
+	 */
+	ShaderKey GetShaderKey(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor);
+
+	/**
+	 * @brief Identity of compiled bytecode: the checksum fxc writes into the DXBC header, and the size.
+	 */
+	struct BytecodeKey
+	{
+		std::array<uint32_t, 4> checksum{};
+		uint32_t size = 0;
+
+		/**
+		 * @return None if the blob does not start with a DXBC header.
+		 */
+		static std::optional<BytecodeKey> FromBlob(ID3DBlob* a_blob);
+
+		bool operator==(const BytecodeKey&) const = default;
+
+		struct Hash
+		{
+			std::size_t operator()(const BytecodeKey& a_key) const noexcept
+			{
+				return ankerl::unordered_dense::hash<uint64_t>{}((uint64_t(a_key.checksum[0]) | (uint64_t(a_key.checksum[1]) << 32)) ^ a_key.size);
+			}
+		};
 	};
+}
+
+template <>
+struct std::hash<SIE::ShaderKey>
+{
+	std::size_t operator()(const SIE::ShaderKey& key) const noexcept
+	{
+		return ankerl::unordered_dense::hash<uint64_t>{}(key.value);
+	}
+};
 
+namespace SIE
+{
 	class ShaderCompilationTask
 	{
 	public:
@@ -223,6 +274,7 @@ namespace SIE
 		void Perform() const;
 
 		size_t GetId() const;
+		ShaderKey GetKey() const;
 		std::string GetString() const;
 
 		bool operator==(const ShaderCompilationTask& other) const;
@@ -231,6 +283,7 @@ namespace SIE
 		ShaderClass shaderClass;
 		const RE::BSShader& shader;
 		uint32_t descriptor;
+		ShaderKey key;
 	};
 }
 
@@ -245,11 +298,33 @@ struct std::hash<SIE::ShaderCompilationTask>
 
 namespace SIE
 {
+	/**
+	 * @brief Order in which queued permutations are compiled; lower values compile first.
+	 */
+	enum class CompilationPriority
+	{
+		Draw,     // requested by a live draw
+		Recent,   // drawn in a previous session according to the usage log
+		Prewarm,  // everything else requested at load
+		Total,
+	};
+
 	class CompilationSet
 	{
 	public:
-		std::optional<ShaderCompilationTask> WaitTake(std::stop_token stoken);
-		void Add(const ShaderCompilationTask& task);
+		/**
+		 * @brief Waits for queued tasks and takes as many as the compilation pool has room for.
+		 * @return The tasks in priority order, or an empty vector if a stop was requested.
+		 */
+		std::vector<ShaderCompilationTask> WaitTake(std::stop_token stoken);
+		/**
+		 * @brief Queues a task, or promotes it if it is already queued at a lower priority.
+		 */
+		void Add(const ShaderCompilationTask& task, CompilationPriority a_priority = CompilationPriority::Draw);
+		/**
+		 * @brief Queues many tasks under a single lock.
+		 */
+		void Add(const std::vector<ShaderCompilationTask>& a_tasks, CompilationPriority a_priority);
 		void Complete(const ShaderCompilationTask& task);
 		void Clear();
 		std::string GetHumanTime(double a_totalms);
@@ -258,11 +333,21 @@ namespace SIE
 		std::atomic<uint64_t> completedTasks = 0;
 		std::atomic<uint64_t> totalTasks = 0;
 		std::atomic<uint64_t> failedTasks = 0;
-		std::atomic<uint64_t> cacheHitTasks = 0;  // number of compiles of a previously seen shader combo
+		std::atomic<uint64_t> cacheHitTasks = 0;           // number of compiles of a previously seen shader combo
+		std::atomic<uint64_t> contendedLocks = 0;          // compilationMutex acquisitions that had to wait
+		std::atomic<uint64_t> promotedTasks = 0;           // queued tasks moved up by a higher priority request
+		std::atomic<uint64_t> dedupedTasks = 0;            // compiles answered by an identical preprocessed source
+		std::atomic<uint64_t> cachedReflections = 0;       // shaders created from a stored reflection
+		std::atomic<uint64_t> reflectedShaders = 0;        // shaders that had to be reflected
+		std::atomic<uint64_t> reflectionMicroseconds = 0;  // spent getting reflections either way
 		std::mutex compilationMutex;
 
 	private:
-		std::unordered_set<ShaderCompilationTask> availableTasks;
+		std::unique_lock<std::mutex> Lock();
+		bool AddLocked(const ShaderCompilationTask& task, CompilationPriority a_priority);
+
+		std::array<std::deque<ShaderCompilationTask>, static_cast<size_t>(CompilationPriority::Total)> queues;
+		std::unordered_map<ShaderKey, CompilationPriority> availableTasks;  // queued tasks; entries in a lower queue than their priority are stale
 		std::unordered_set<ShaderCompilationTask> tasksInProgress;
 		std::unordered_set<ShaderCompilationTask> processedTasks;  // completed or failed
 		std::condition_variable_any conditionVariable;
@@ -276,6 +361,7 @@ namespace SIE
 		ID3DBlob* blob;
 		ShaderCompilationTask::Status status;
 		system_clock::time_point compileTime = system_clock::now();
+		const RE::BSShader* shader = nullptr;  // for building key strings on demand
 	};
 
 	class UpdateListener;
@@ -333,10 +419,62 @@ namespace SIE
 		void SetDiskCache(bool value);
 		void DeleteDiskCache();
 		void ValidateDiskCache();
+		/**
+		 * @brief Compacts the disk cache and writes Info.ini and the permutation manifest next to it.
+		 */
 		void WriteDiskCacheInfo();
+		/**
+		 * @brief Returns the disk archive for a shader file, opening it on first use.
+		 * @param a_name The fxp filename of the shader.
+		 */
+		std::shared_ptr<ShaderArchive> GetDiskArchive(const std::string& a_name);
+		/**
+		 * @brief Merges the journals of all open disk archives and of the dependency graph.
+		 */
+		void CompactDiskCache();
+		ShaderDependencies& GetDependencies() { return dependencies; }
+		/**
+		 * @brief Compiles a preprocessed source once per content hash.
+		 *
+		 * Permutations whose defines preprocess to the same source share one compile. Later callers
+		 * wait for the first one and receive another reference to its blob.
+		 * @param a_contentHash Hash of the preprocessed source, profile and flags.
+		 * @param a_compile Compiles the source; called only by the first caller.
+		 * @param o_deduplicated Set if the blob came from another permutation.
+		 * @return The blob (owned by caller) or nullptr if compilation failed.
+		 */
+		ID3DBlob* CompileContent(uint64_t a_contentHash, const std::function<ID3DBlob*()>& a_compile, bool& o_deduplicated);
 		bool UseFileWatcher() const;
 		void SetFileWatcher(bool value);
 
+		/**
+		 * @brief Notes that a permutation was drawn, for ordering the next launch's prewarm.
+		 */
+		void RecordShaderUsage(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor)
+		{
+			usageLog.Record(ShaderKey(a_class, ToShaderType(a_shader.shaderType.get()), a_descriptor, 0).value);
+		}
+		/**
+		 * @brief Tracks the worldspace or interior cell the player is in and saves the usage log when it changes.
+		 */
+		void UpdateUsageLocation();
+		/**
+		 * @brief Adds a permutation to the pending prewarm batch of the shader being loaded.
+		 */
+		void QueuePrewarm(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor);
+		/**
+		 * @brief Requests the pending prewarm batch.
+		 *
+		 * Permutations found in the usage log are requested first, ordered by the log. The rest are
+		 * held back until SubmitDeferredPrewarm(), or dropped if prewarmWorkingSetOnly is set, in
+		 * which case they compile when first drawn.
+		 */
+		void SubmitPrewarm();
+		/**
+		 * @brief Requests the permutations held back by SubmitPrewarm() as background compilation.
+		 */
+		void SubmitDeferredPrewarm();
+
 		void StartFileWatcher();
 		void StopFileWatcher();
 
@@ -369,7 +507,8 @@ namespace SIE
 		/**
    		* @brief Clears and marks shaders for recompilation based on the given path.
  		*
- 		* This function looks up the provided `a_path` in the `hlslToShaderMap`. 
+ 		* This function looks up the provided `a_path` in the `hlslToShaderMap`, which links both shader 
+		* files and every file they include to the shaders built from them. 
 		* If the path exists in the map, it iterates through all the shader entries associated 
 		* with that path, clears the shaders, and marks them for recompilation by updating their 
 		* modified times, and logs the operation.
@@ -388,18 +527,24 @@ namespace SIE
 		*/
 		bool Clear(const std::string& a_path);
 
-		bool AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob);
-		ID3DBlob* GetCompletedShader(const std::string& a_key);
+		/**
+		 * @brief Stores a finished compile and links it to the files it was built from.
+		 * @param a_dependencies Normalized paths of every file the shader included, so a change to any
+		 * of them marks the shader for recompilation.
+		 */
+		bool AddCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor, ID3DBlob* a_blob, const std::vector<std::string>& a_dependencies = {});
+		ID3DBlob* GetCompletedShader(const ShaderKey& a_key);
 		ID3DBlob* GetCompletedShader(const SIE::ShaderCompilationTask& a_task);
 		ID3DBlob* GetCompletedShader(ShaderClass shaderClass, const RE::BSShader& shader, uint32_t descriptor);
-		ShaderCompilationTask::Status GetShaderStatus(const std::string& a_key);
+		ShaderCompilationTask::Status GetShaderStatus(const ShaderKey& a_key);
 		std::string GetShaderStatsString(bool a_timeOnly = false);
 
-		RE::BSGraphics::VertexShader* GetVertexShader(const RE::BSShader& shader, uint32_t descriptor);
+		RE::BSGraphics::VertexShader* GetVertexShader(const RE::BSShader& shader,
+			uint32_t descriptor, CompilationPriority a_priority = CompilationPriority::Draw);
 		RE::BSGraphics::PixelShader* GetPixelShader(const RE::BSShader& shader,
-			uint32_t descriptor);
+			uint32_t descriptor, CompilationPriority a_priority = CompilationPriority::Draw);
 		RE::BSGraphics::ComputeShader* GetComputeShader(const RE::BSShader& shader,
-			uint32_t descriptor);
+			uint32_t descriptor, CompilationPriority a_priority = CompilationPriority::Draw);
 
 		RE::BSGraphics::VertexShader* MakeAndAddVertexShader(const RE::BSShader& shader,
 			uint32_t descriptor);
@@ -436,197 +581,21 @@ namespace SIE
 		BS::thread_pool compilationPool{};
 		bool backgroundCompilation = false;
 		bool menuLoaded = false;
-
-		enum class LightingShaderTechniques
-		{
-			None = 0,
-			Envmap = 1,
-			Glowmap = 2,
-			Parallax = 3,
-			Facegen = 4,
-			FacegenRGBTint = 5,
-			Hair = 6,
-			ParallaxOcc = 7,
-			MTLand = 8,
-			LODLand = 9,
-			Snow = 10,  // unused
-			MultilayerParallax = 11,
-			TreeAnim = 12,
-			LODObjects = 13,
-			MultiIndexSparkle = 14,
-			LODObjectHD = 15,
-			Eye = 16,
-			Cloud = 17,  // unused
-			LODLandNoise = 18,
-			MTLandLODBlend = 19,
-		};
-
-		enum class LightingShaderFlags
-		{
-			VC = 1 << 0,
-			Skinned = 1 << 1,
-			ModelSpaceNormals = 1 << 2,
-			// flags 3 to 8 are unused by vanilla
-			// Community Shaders start
-			TruePbr = 1 << 3,
-			Deferred = 1 << 4,
-			// Community Shaders end
-			Specular = 1 << 9,
-			SoftLighting = 1 << 10,
-			RimLighting = 1 << 11,
-			BackLighting = 1 << 12,
-			ShadowDir = 1 << 13,
-			DefShadow = 1 << 14,
-			ProjectedUV = 1 << 15,
-			AnisoLighting = 1 << 16,  // Reused for glint with PBR
-			AmbientSpecular = 1 << 17,
-			WorldMap = 1 << 18,
-			BaseObjectIsSnow = 1 << 19,
-			DoAlphaTest = 1 << 20,
-			Snow = 1 << 21,
-			CharacterLight = 1 << 22,
-			AdditionalAlphaMask = 1 << 23
-		};
-
-		enum class BloodSplatterShaderTechniques
-		{
-			Splatter = 0,
-			Flare = 1,
-		};
-
-		enum class DistantTreeShaderTechniques
-		{
-			DistantTreeBlock = 0,
-			Depth = 1,
-		};
-
-		enum class DistantTreeShaderFlags
-		{
-			Deferred = 1 << 8,
-			AlphaTest = 1 << 16,
-		};
-
-		enum class SkyShaderTechniques
-		{
-			SunOcclude = 0,
-			SunGlare = 1,
-			MoonAndStarsMask = 2,
-			Stars = 3,
-			Clouds = 4,
-			CloudsLerp = 5,
-			CloudsFade = 6,
-			Texture = 7,
-			Sky = 8,
-		};
-
-		enum class GrassShaderTechniques
-		{
-			RenderDepth = 8,
-			TruePbr = 9,
-		};
-
-		enum class GrassShaderFlags
-		{
-			AlphaTest = 0x10000,
-		};
-
-		enum class ParticleShaderTechniques
-		{
-			Particles = 0,
-			ParticlesGryColor = 1,
-			ParticlesGryAlpha = 2,
-			ParticlesGryColorAlpha = 3,
-			EnvCubeSnow = 4,
-			EnvCubeRain = 5,
-		};
-
-		enum class WaterShaderTechniques
-		{
-			Underwater = 8,
-			Lod = 9,
-			Stencil = 10,
-			Simple = 11,
-		};
-
-		enum class WaterShaderFlags
-		{
-			Vc = 1 << 0,
-			NormalTexCoord = 1 << 1,
-			Reflections = 1 << 2,
-			Refractions = 1 << 3,
-			Depth = 1 << 4,
-			Interior = 1 << 5,
-			Wading = 1 << 6,
-			VertexAlphaDepth = 1 << 7,
-			Cubemap = 1 << 8,
-			Flowmap = 1 << 9,
-			BlendNormals = 1 << 10,
-		};
-
-		enum class EffectShaderFlags
-		{
-			Vc = 1 << 0,
-			TexCoord = 1 << 1,
-			TexCoordIndex = 1 << 2,
-			Skinned = 1 << 3,
-			Normals = 1 << 4,
-			BinormalTangent = 1 << 5,
-			Texture = 1 << 6,
-			IndexedTexture = 1 << 7,
-			Falloff = 1 << 8,
-			AddBlend = 1 << 10,
-			MultBlend = 1 << 11,
-			Particles = 1 << 12,
-			StripParticles = 1 << 13,
-			Blood = 1 << 14,
-			Membrane = 1 << 15,
-			Lighting = 1 << 16,
-			ProjectedUv = 1 << 17,
-			Soft = 1 << 18,
-			GrayscaleToColor = 1 << 19,
-			GrayscaleToAlpha = 1 << 20,
-			IgnoreTexAlpha = 1 << 21,
-			MultBlendDecal = 1 << 22,
-			AlphaTest = 1 << 23,
-			SkyObject = 1 << 24,
-			MsnSpuSkinned = 1 << 25,
-			MotionVectorsNormals = 1 << 26,
-			Deferred = 1 << 27
-		};
-
-		enum class UtilityShaderFlags : uint64_t
-		{
-			Vc = 1 << 0,
-			Texture = 1 << 1,
-			Skinned = 1 << 2,
-			Normals = 1 << 3,
-			BinormalTangent = 1 << 4,
-			AlphaTest = 1 << 7,
-			LodLandscape = 1 << 8,
-			RenderNormal = 1 << 9,
-			RenderNormalFalloff = 1 << 10,
-			RenderNormalClamp = 1 << 11,
-			RenderNormalClear = 1 << 12,
-			RenderDepth = 1 << 13,
-			RenderShadowmap = 1 << 14,
-			RenderShadowmapClamped = 1 << 15,
-			GrayscaleToAlpha = 1 << 15,
-			RenderShadowmapPb = 1 << 16,
-			AdditionalAlphaMask = 1 << 16,
-			DepthWriteDecals = 1 << 17,
-			DebugShadowSplit = 1 << 18,
-			DebugColor = 1 << 19,
-			GrayscaleMask = 1 << 20,
-			RenderShadowmask = 1 << 21,
-			RenderShadowmaskSpot = 1 << 22,
-			RenderShadowmaskPb = 1 << 23,
-			RenderShadowmaskDpb = 1 << 24,
-			RenderBaseTexture = 1 << 25,
-			TreeAnim = 1 << 26,
-			LodObject = 1 << 27,
-			LocalMapFogOfWar = 1 << 28,
-			OpaqueEffect = 1 << 29,
-		};
+		bool prewarmWorkingSetOnly = false;  // skip prewarming permutations the usage log has never seen drawn
+
+		using LightingShaderTechniques = SIE::LightingShaderTechniques;
+		using LightingShaderFlags = SIE::LightingShaderFlags;
+		using BloodSplatterShaderTechniques = SIE::BloodSplatterShaderTechniques;
+		using DistantTreeShaderTechniques = SIE::DistantTreeShaderTechniques;
+		using DistantTreeShaderFlags = SIE::DistantTreeShaderFlags;
+		using SkyShaderTechniques = SIE::SkyShaderTechniques;
+		using GrassShaderTechniques = SIE::GrassShaderTechniques;
+		using GrassShaderFlags = SIE::GrassShaderFlags;
+		using ParticleShaderTechniques = SIE::ParticleShaderTechniques;
+		using WaterShaderTechniques = SIE::WaterShaderTechniques;
+		using WaterShaderFlags = SIE::WaterShaderFlags;
+		using EffectShaderFlags = SIE::EffectShaderFlags;
+		using UtilityShaderFlags = SIE::UtilityShaderFlags;
 
 		uint blockedKeyIndex = (uint)-1;  // index in shaderMap; negative value indicates disabled
 		std::string blockedKey = "";
@@ -636,32 +605,45 @@ namespace SIE
 	private:
 		struct hlslRecord
 		{
-			std::string key;
+			ShaderKey key;
 			RE::BSShader::Type type;
 			std::uint32_t descriptor;
 			SIE::ShaderClass shaderClass;
-			std::wstring diskPath;
+			std::string archiveName;
 
 			bool operator<(const hlslRecord& other) const
 			{
 				return key < other.key;
 			}
 		};
+		struct PrewarmRequest
+		{
+			const RE::BSShader* shader;
+			ShaderClass shaderClass;
+			uint32_t descriptor;
+		};
 		ShaderCache();
+		/**
+		 * @brief Loads the reflection of a shader from its disk archive, or reflects the blob and stores it there.
+		 */
+		ShaderReflection GetShaderReflection(ShaderClass a_class, const RE::BSShader& a_shader, uint32_t a_descriptor, ID3DBlob& a_blob);
+		void RequestShader(const PrewarmRequest& a_request, CompilationPriority a_priority);
+		void RequestShaders(const std::vector<PrewarmRequest>& a_requests, CompilationPriority a_priority);
+		void EnqueueCompilation(const ShaderCompilationTask& a_task, CompilationPriority a_priority);
 		void ManageCompilationSet(std::stop_token stoken);
+		/**
+		 * @brief Returns the D3D object already created for identical bytecode, or creates it.
+		 * @param o_shader Receives a new reference to the object.
+		 */
+		HRESULT GetDeviceShader(ID3DBlob* a_blob, ID3D11DeviceChild** o_shader, const std::function<HRESULT(ID3D11DeviceChild**)>& a_create);
+		void ReleaseSharedShaders();
 		void ProcessCompilationSet(std::stop_token stoken, SIE::ShaderCompilationTask task);
 
 		~ShaderCache();
 
-		std::array<eastl::unordered_map<uint32_t, std::unique_ptr<RE::BSGraphics::VertexShader>>,
-			static_cast<size_t>(RE::BSShader::Type::Total)>
-			vertexShaders;
-		std::array<eastl::unordered_map<uint32_t, std::unique_ptr<RE::BSGraphics::PixelShader>>,
-			static_cast<size_t>(RE::BSShader::Type::Total)>
-			pixelShaders;
-		std::array<eastl::unordered_map<uint32_t, std::unique_ptr<RE::BSGraphics::ComputeShader>>,
-			static_cast<size_t>(RE::BSShader::Type::Total)>
-			computeShaders;
+		std::array<ShaderTable<RE::BSGraphics::VertexShader>, static_cast<size_t>(RE::BSShader::Type::Total)> vertexShaders;
+		std::array<ShaderTable<RE::BSGraphics::PixelShader>, static_cast<size_t>(RE::BSShader::Type::Total)> pixelShaders;
+		std::array<ShaderTable<RE::BSGraphics::ComputeShader>, static_cast<size_t>(RE::BSShader::Type::Total)> computeShaders;
 
 		bool isEnabled = true;
 		bool isDiskCache = true;
@@ -671,16 +653,27 @@ namespace SIE
 		bool useFileWatcher = false;
 
 		std::stop_source ssource;
-		std::mutex vertexShadersMutex;
-		std::mutex pixelShadersMutex;
-		std::mutex computeShadersMutex;
 		CompilationSet compilationSet;
-		std::unordered_map<std::string, ShaderCacheResult> shaderMap{};
+		std::unordered_map<ShaderKey, ShaderCacheResult> shaderMap{};
 		std::mutex mapMutex;                                                            // guard for shaderMap
 		std::unordered_map<std::string, system_clock::time_point> modifiedShaderMap{};  // hashmap when a shader source file last modified
 		std::mutex modifiedMapMutex;                                                    // guard for modifiedShaderMap
 		std::unordered_map<std::string, std::set<hlslRecord>> hlslToShaderMap{};        // hashmap linking specific hlsl files to shader keys in shaderMap
 		std::mutex hlslMapMutex;                                                        // guard for hlslToShaderMap
+		std::unordered_map<std::string, std::shared_ptr<ShaderArchive>> diskArchives{};  // disk cache archive per fxp filename
+		std::mutex diskArchivesMutex;                                                   // guard for diskArchives
+		std::unordered_map<uint64_t, std::shared_future<ID3DBlob*>> contentCompiles{};   // blob per preprocessed source hash, pending while compiling
+		std::mutex contentMutex;                                                        // guard for contentCompiles
+		uint64_t contentGeneration = 0;                                                 // bumped when contentCompiles is released
+		std::unordered_map<BytecodeKey, ID3D11DeviceChild*, BytecodeKey::Hash> deviceShaders{};  // D3D object per bytecode
+		std::mutex deviceShaderMutex;                                                   // guard for deviceShaders
+		ShaderDependencies dependencies{ L"Data/ShaderCache/Dependencies" };           // include graph of the disk cache
+		ShaderUsageLog usageLog{ "Data\\SKSE\\Plugins\\CommunityShaders\\ShaderUsage.bin" };
+		PermutationManifest permutationManifest;         // written with Info.ini for the offline cache builder
+		std::vector<PrewarmRequest> prewarmQueue{};      // requests of the shader being loaded
+		std::vector<PrewarmRequest> deferredPrewarm{};   // requests outside the usage log's working set
+		std::vector<PrewarmRequest> manifestRequests{};  // requests not yet added to permutationManifest
+		std::mutex prewarmMutex;                         // guard for prewarmQueue, deferredPrewarm and manifestRequests
 
 		// efsw file watcher
 		efsw::FileWatcher* fileWatcher = nullptr;
@@ -727,3 +720,20 @@ namespace SIE
 		size_t lastQueueSize = queue.size();
 	};
 }
+
+template <>
+struct fmt::formatter<SIE::ShaderKey>
+{
+	constexpr auto parse(format_parse_context& ctx) -> format_parse_context::iterator
+	{
+		return ctx.begin();
+	}
+
+	auto format(const SIE::ShaderKey& key, format_context& ctx) const -> format_context::iterator
+	{
+		return fmt::format_to(ctx.out(), "{}:{}:{:X}",
+			magic_enum::enum_name(key.GetType()),
+			magic_enum::enum_name(key.GetClass()),
+			key.GetDescriptor());
+	}
+};
@@ -0,0 +1,495 @@
+#include "ShaderDependencies.h"
+
+#include "Utils/Format.h"
+
+namespace SIE
+{
+	namespace SShaderDependencies
+	{
+		struct Writer
+		{
+			std::string data;
+
+			template <class T>
+			void Write(const T& a_value)
+			{
+				data.append(reinterpret_cast<const char*>(&a_value), sizeof(T));
+			}
+
+			void WriteString(std::string_view a_value)
+			{
+				Write(static_cast<uint16_t>(a_value.size()));
+				data.append(a_value);
+			}
+		};
+
+		struct Reader
+		{
+			const std::vector<uint8_t>& data;
+			size_t offset = 0;
+
+			template <class T>
+			bool Read(T& o_value)
+			{
+				if (offset + sizeof(T) > data.size()) {
+					return false;
+				}
+				memcpy(&o_value, data.data() + offset, sizeof(T));
+				offset += sizeof(T);
+				return true;
+			}
+
+			bool ReadString(std::string& o_value)
+			{
+				uint16_t size = 0;
+				if (!Read(size) || offset + size > data.size()) {
+					return false;
+				}
+				o_value.assign(reinterpret_cast<const char*>(data.data() + offset), size);
+				offset += size;
+				return true;
+			}
+		};
+
+		static std::vector<uint8_t> ReadFile(const std::filesystem::path& a_path)
+		{
+			std::vector<uint8_t> data;
+			std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+			if (!stream) {
+				return data;
+			}
+			data.resize((size_t)stream.tellg());
+			stream.seekg(0);
+			stream.read(reinterpret_cast<char*>(data.data()), data.size());
+			return data;
+		}
+
+		static bool ReadText(const std::filesystem::path& a_path, std::string& o_content)
+		{
+			std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+			if (!stream) {
+				return false;
+			}
+			o_content.resize((size_t)stream.tellg());
+			stream.seekg(0);
+			return (bool)stream.read(o_content.data(), o_content.size());
+		}
+	}
+
+	ShaderDependencies::ShaderDependencies(const std::filesystem::path& a_basePath) :
+		snapshotPath(std::filesystem::path(a_basePath).concat(".bin")),
+		journalPath(std::filesystem::path(a_basePath).concat(".journal"))
+	{}
+
+	std::string ShaderDependencies::NormalizePath(const std::filesystem::path& a_path)
+	{
+		return Util::FixFilePath(a_path.lexically_normal().string());
+	}
+
+	uint64_t ShaderDependencies::HashContent(std::string_view a_content)
+	{
+		return ankerl::unordered_dense::hash<std::string_view>{}(a_content);
+	}
+
+	uint64_t ShaderDependencies::HashDefines(const D3D_SHADER_MACRO* a_defines, uint32_t a_flags)
+	{
+		// order matters to the preprocessor, so hash the list as given
+		std::string merged = std::to_string(a_flags);
+		for (auto define = a_defines; define && define->Name; ++define) {
+			merged += ' ';
+			merged += define->Name;
+			if (define->Definition) {
+				merged += '=';
+				merged += define->Definition;
+			}
+		}
+		return HashContent(merged);
+	}
+
+	uint64_t ShaderDependencies::HashFileSet(const std::vector<Dependency>& a_files)
+	{
+		uint64_t hash = a_files.size();
+		for (const auto& file : a_files) {
+			hash = (hash ^ file.hash ^ file.path) * 0x9E3779B97F4A7C15ull;
+		}
+		return hash;
+	}
+
+	uint32_t ShaderDependencies::GetPathId(const std::string& a_path)
+	{
+		auto [it, inserted] = pathIds.try_emplace(a_path, (uint32_t)paths.size());
+		if (inserted) {
+			paths.push_back(a_path);
+		}
+		return it->second;
+	}
+
+	uint32_t ShaderDependencies::GetFileSetId(std::vector<Dependency>&& a_files)
+	{
+		std::ranges::sort(a_files, {}, &Dependency::path);
+		auto& candidates = fileSetIds[HashFileSet(a_files)];
+		for (auto id : candidates) {
+			if (fileSets[id] == a_files) {
+				return id;
+			}
+		}
+		const auto id = (uint32_t)fileSets.size();
+		fileSets.push_back(std::move(a_files));
+		fileSetValidity.push_back(Validity::Unknown);
+		candidates.push_back(id);
+		return id;
+	}
+
+	void ShaderDependencies::AddLocked(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files)
+	{
+		std::vector<Dependency> dependencies;
+		dependencies.reserve(a_files.size());
+		for (const auto& file : a_files) {
+			dependencies.push_back({ GetPathId(file.path), file.hash });
+		}
+		entries[a_archive].insert_or_assign(a_key, Entry{ a_definesHash, GetFileSetId(std::move(dependencies)) });
+	}
+
+	bool ShaderDependencies::Load()
+	{
+		std::scoped_lock lock{ graphMutex };
+		paths.clear();
+		pathIds.clear();
+		fileSets.clear();
+		fileSetIds.clear();
+		fileSetValidity.clear();
+		entries.clear();
+		currentHashes.clear();
+
+		std::error_code ec;
+		loaded = std::filesystem::exists(snapshotPath, ec) || std::filesystem::exists(journalPath, ec);
+
+		const auto data = SShaderDependencies::ReadFile(snapshotPath);
+		SShaderDependencies::Reader reader{ data };
+		uint32_t magic = 0, version = 0, pathCount = 0, fileSetCount = 0, archiveCount = 0, pad = 0;
+		if (!data.empty()) {
+			bool valid = reader.Read(magic) && reader.Read(version) && magic == Magic && version == FormatVersion &&
+			             reader.Read(pathCount) && reader.Read(fileSetCount) && reader.Read(archiveCount) && reader.Read(pad);
+			for (uint32_t i = 0; valid && i < pathCount; ++i) {
+				std::string path;
+				valid = reader.ReadString(path);
+				GetPathId(path);
+			}
+			for (uint32_t i = 0; valid && i < fileSetCount; ++i) {
+				uint32_t count = 0;
+				valid = reader.Read(count);
+				std::vector<Dependency> files(valid ? count : 0);
+				for (auto& file : files) {
+					valid = valid && reader.Read(file.path) && reader.Read(file.hash) && file.path < paths.size();
+				}
+				fileSets.push_back(std::move(files));
+				fileSetValidity.push_back(Validity::Unknown);
+			}
+			for (uint32_t i = 0; valid && i < archiveCount; ++i) {
+				std::string archive;
+				uint32_t count = 0;
+				valid = reader.ReadString(archive) && reader.Read(count);
+				auto& archiveEntries = entries[archive];
+				for (uint32_t j = 0; valid && j < count; ++j) {
+					uint64_t key = 0;
+					Entry entry{};
+					valid = reader.Read(key) && reader.Read(entry.definesHash) && reader.Read(entry.fileSet) && entry.fileSet < fileSets.size();
+					archiveEntries.emplace(key, entry);
+				}
+			}
+			if (!valid) {
+				logger::warn("Shader dependency graph {} is unreadable; cached shaders will be rebuilt", snapshotPath.string());
+				paths.clear();
+				pathIds.clear();
+				fileSets.clear();
+				fileSetValidity.clear();
+				entries.clear();
+			}
+			// rebuild the lookup for deduplicating new file sets
+			for (uint32_t id = 0; id < fileSets.size(); ++id) {
+				fileSetIds[HashFileSet(fileSets[id])].push_back(id);
+			}
+		}
+
+		ReplayJournal();
+		size_t count = 0;
+		for (const auto& [archive, archiveEntries] : entries) {
+			count += archiveEntries.size();
+		}
+		logger::debug("Loaded dependencies of {} shaders on {} files", count, paths.size());
+		return loaded;
+	}
+
+	void ShaderDependencies::ReplayJournal()
+	{
+		const auto data = SShaderDependencies::ReadFile(journalPath);
+		SShaderDependencies::Reader reader{ data };
+		while (reader.offset < data.size()) {
+			uint32_t magic = 0;
+			uint16_t archiveSize = 0, fileCount = 0;
+			uint64_t key = 0, definesHash = 0;
+			if (!reader.Read(magic) || magic != JournalMagic || !reader.Read(archiveSize) || !reader.Read(fileCount) ||
+				!reader.Read(key) || !reader.Read(definesHash) || reader.offset + archiveSize > data.size()) {
+				break;  // torn write at the end of the previous session
+			}
+			std::string archive(reinterpret_cast<const char*>(data.data() + reader.offset), archiveSize);
+			reader.offset += archiveSize;
+			std::vector<File> files(fileCount);
+			bool valid = true;
+			for (auto& file : files) {
+				valid = valid && reader.Read(file.hash) && reader.ReadString(file.path);
+			}
+			if (!valid) {
+				break;
+			}
+			AddLocked(archive, key, definesHash, files);
+		}
+	}
+
+	bool ShaderDependencies::Save()
+	{
+		std::scoped_lock lock{ graphMutex };
+		if (journal.is_open()) {
+			journal.close();
+		}
+		std::error_code ec;
+		if (!std::filesystem::exists(journalPath, ec)) {
+			return true;  // nothing new since the snapshot
+		}
+
+		SShaderDependencies::Writer writer;
+		writer.Write(Magic);
+		writer.Write(FormatVersion);
+		writer.Write((uint32_t)paths.size());
+		writer.Write((uint32_t)fileSets.size());
+		writer.Write((uint32_t)entries.size());
+		writer.Write(0u);
+		for (const auto& path : paths) {
+			writer.WriteString(path);
+		}
+		for (const auto& files : fileSets) {
+			writer.Write((uint32_t)files.size());
+			for (const auto& file : files) {
+				writer.Write(file.path);
+				writer.Write(file.hash);
+			}
+		}
+		for (const auto& [archive, archiveEntries] : entries) {
+			writer.WriteString(archive);
+			writer.Write((uint32_t)archiveEntries.size());
+			for (const auto& [key, entry] : archiveEntries) {
+				writer.Write(key);
+				writer.Write(entry.definesHash);
+				writer.Write(entry.fileSet);
+			}
+		}
+
+		const auto tempPath = std::filesystem::path(snapshotPath).concat(".tmp");
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			out.write(writer.data.data(), writer.data.size());
+			if (!out) {
+				logger::error("Failed to write {}", tempPath.string());
+				out.close();
+				std::filesystem::remove(tempPath, ec);
+				return false;
+			}
+		}
+		std::filesystem::rename(tempPath, snapshotPath, ec);
+		if (ec) {
+			logger::error("Failed to replace {}: {}", snapshotPath.string(), ec.message());
+			std::filesystem::remove(tempPath, ec);
+			return false;
+		}
+		std::filesystem::remove(journalPath, ec);
+		loaded = true;
+		logger::debug("Saved shader dependency graph with {} files and {} include sets", paths.size(), fileSets.size());
+		return true;
+	}
+
+	void ShaderDependencies::Clear()
+	{
+		std::scoped_lock lock{ graphMutex };
+		if (journal.is_open()) {
+			journal.close();
+		}
+		paths.clear();
+		pathIds.clear();
+		fileSets.clear();
+		fileSetIds.clear();
+		fileSetValidity.clear();
+		entries.clear();
+		currentHashes.clear();
+		loaded = false;
+	}
+
+	bool ShaderDependencies::HasGraph()
+	{
+		std::scoped_lock lock{ graphMutex };
+		return loaded;
+	}
+
+	bool ShaderDependencies::AppendJournal(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files)
+	{
+		if (!journal.is_open()) {
+			std::error_code ec;
+			std::filesystem::create_directories(journalPath.parent_path(), ec);
+			journal.open(journalPath, std::ios::binary | std::ios::app);
+			if (!journal.is_open()) {
+				logger::error("Failed to open {}", journalPath.string());
+				return false;
+			}
+		}
+		SShaderDependencies::Writer writer;
+		writer.Write(JournalMagic);
+		writer.Write((uint16_t)a_archive.size());
+		writer.Write((uint16_t)a_files.size());
+		writer.Write(a_key);
+		writer.Write(a_definesHash);
+		writer.data.append(a_archive);
+		for (const auto& file : a_files) {
+			writer.Write(file.hash);
+			writer.WriteString(file.path);
+		}
+		journal.write(writer.data.data(), writer.data.size());
+		journal.flush();
+		if (!journal) {
+			logger::error("Failed to write {}", journalPath.string());
+			journal.close();
+			return false;
+		}
+		return true;
+	}
+
+	void ShaderDependencies::Record(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files)
+	{
+		std::scoped_lock lock{ graphMutex };
+		AddLocked(a_archive, a_key, a_definesHash, a_files);
+		for (const auto& file : a_files) {
+			// the compiler just read it, so it is current unless the watcher says otherwise
+			currentHashes.try_emplace(GetPathId(file.path), file.hash);
+		}
+		AppendJournal(a_archive, a_key, a_definesHash, a_files);
+	}
+
+	uint64_t ShaderDependencies::GetCurrentHash(uint32_t a_path)
+	{
+		if (auto it = currentHashes.find(a_path); it != currentHashes.end()) {
+			return it->second;
+		}
+		std::string content;
+		const uint64_t hash = SShaderDependencies::ReadText(paths[a_path], content) ? HashContent(content) : 0;
+		currentHashes.emplace(a_path, hash);
+		return hash;
+	}
+
+	bool ShaderDependencies::IsCurrent(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash)
+	{
+		std::scoped_lock lock{ graphMutex };
+		auto archiveIt = entries.find(a_archive);
+		if (archiveIt == entries.end()) {
+			return false;
+		}
+		auto it = archiveIt->second.find(a_key);
+		if (it == archiveIt->second.end() || it->second.definesHash != a_definesHash) {
+			return false;
+		}
+
+		auto& validity = fileSetValidity[it->second.fileSet];
+		if (validity == Validity::Unknown) {
+			validity = Validity::Current;
+			for (const auto& file : fileSets[it->second.fileSet]) {
+				if (GetCurrentHash(file.path) != file.hash) {
+					logger::debug("{} changed since {} was cached", paths[file.path], a_archive);
+					validity = Validity::Stale;
+					break;
+				}
+			}
+		}
+		return validity == Validity::Current;
+	}
+
+	std::vector<std::string> ShaderDependencies::GetFiles(const std::string& a_archive, uint64_t a_key)
+	{
+		std::vector<std::string> result;
+		std::scoped_lock lock{ graphMutex };
+		if (auto archiveIt = entries.find(a_archive); archiveIt != entries.end()) {
+			if (auto it = archiveIt->second.find(a_key); it != archiveIt->second.end()) {
+				for (const auto& file : fileSets[it->second.fileSet]) {
+					result.push_back(paths[file.path]);
+				}
+			}
+		}
+		return result;
+	}
+
+	void ShaderDependencies::InvalidateFile(const std::string& a_path)
+	{
+		std::scoped_lock lock{ graphMutex };
+		if (auto it = pathIds.find(a_path); it != pathIds.end()) {
+			currentHashes.erase(it->second);
+			std::ranges::fill(fileSetValidity, Validity::Unknown);
+		}
+	}
+
+	void ShaderDependencies::InvalidateAll()
+	{
+		std::scoped_lock lock{ graphMutex };
+		currentHashes.clear();
+		std::ranges::fill(fileSetValidity, Validity::Unknown);
+	}
+
+	ShaderIncludeHandler::ShaderIncludeHandler(const std::filesystem::path& a_root, const std::filesystem::path& a_includeDirectory) :
+		root(a_root),
+		rootDirectory(a_root.parent_path()),
+		includeDirectory(a_includeDirectory)
+	{}
+
+	void ShaderIncludeHandler::AddFile(const std::filesystem::path& a_path, std::string_view a_content)
+	{
+		auto path = ShaderDependencies::NormalizePath(a_path);
+		if (std::ranges::find(files, path, &ShaderDependencies::File::path) == files.end()) {
+			files.push_back({ std::move(path), ShaderDependencies::HashContent(a_content) });
+		}
+	}
+
+	bool ShaderIncludeHandler::ReadRoot(std::string& o_source)
+	{
+		if (!SShaderDependencies::ReadText(root, o_source)) {
+			return false;
+		}
+		AddFile(root, o_source);
+		return true;
+	}
+
+	HRESULT __stdcall ShaderIncludeHandler::Open(D3D_INCLUDE_TYPE a_includeType, LPCSTR a_fileName, LPCVOID a_parentData, LPCVOID* o_data, UINT* o_bytes)
+	{
+		std::filesystem::path parentDirectory = includeDirectory.empty() ? rootDirectory : includeDirectory;
+		if (includeDirectory.empty() && a_includeType == D3D_INCLUDE_LOCAL && a_parentData) {
+			if (auto it = openFiles.find(a_parentData); it != openFiles.end()) {
+				parentDirectory = it->second->directory;
+			}
+		}
+
+		for (const auto& directory : { parentDirectory, includeDirectory.empty() ? rootDirectory : includeDirectory }) {
+			const auto path = (directory / a_fileName).lexically_normal();
+			auto file = std::make_unique<OpenFile>();
+			if (!SShaderDependencies::ReadText(path, file->content)) {
+				continue;
+			}
+			file->directory = path.parent_path();
+			AddFile(path, file->content);
+			*o_data = file->content.data();
+			*o_bytes = (UINT)file->content.size();
+			openFiles.emplace(file->content.data(), std::move(file));
+			return S_OK;
+		}
+		return E_FAIL;
+	}
+
+	HRESULT __stdcall ShaderIncludeHandler::Close(LPCVOID a_data)
+	{
+		openFiles.erase(a_data);
+		return S_OK;
+	}
+}
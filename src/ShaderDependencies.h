@@ -0,0 +1,166 @@
+#pragma once
+
+#include <d3dcommon.h>
+#include <fstream>
+#include <mutex>
+
+namespace SIE
+{
+	/**
+	 * @brief Include graph of the permutations stored in the disk cache.
+	 *
+	 * For every cached permutation the graph keeps a hash of its macro list and the files it was
+	 * built from (the shader and everything it transitively included) with their content hashes at
+	 * compile time. A cached blob is only used while all of those still match, so an edited include
+	 * or a changed define only invalidates the permutations that depend on it.
+	 *
+	 * The graph is stored as `<name>.bin` next to the shader archives. Records added during a
+	 * session are appended to `<name>.journal` and folded into the snapshot by Save().
+	 */
+	class ShaderDependencies
+	{
+	public:
+		static constexpr uint32_t Magic = 0x44535343;         // "CSSD"
+		static constexpr uint32_t JournalMagic = 0x4B535343;  // "CSSK"
+		static constexpr uint32_t FormatVersion = 1;
+
+		struct File
+		{
+			std::string path;  // normalized with NormalizePath()
+			uint64_t hash;
+		};
+
+		explicit ShaderDependencies(const std::filesystem::path& a_basePath);
+
+		ShaderDependencies(const ShaderDependencies&) = delete;
+		ShaderDependencies& operator=(const ShaderDependencies&) = delete;
+
+		/**
+		 * @brief Loads the snapshot and replays any journal left by the previous session.
+		 * @return true if a graph was found on disk.
+		 */
+		bool Load();
+		/**
+		 * @brief Writes a fresh snapshot and removes the journal.
+		 */
+		bool Save();
+		/**
+		 * @brief Forgets the whole graph and closes the journal so the cache folder can be deleted.
+		 */
+		void Clear();
+		bool HasGraph();
+
+		void Record(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files);
+		/**
+		 * @brief Checks that a cached permutation was built from the current sources and defines.
+		 * @return false if it is unknown or any of its inputs changed.
+		 */
+		bool IsCurrent(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash);
+		/**
+		 * @brief Returns the normalized paths a cached permutation was built from.
+		 */
+		std::vector<std::string> GetFiles(const std::string& a_archive, uint64_t a_key);
+		/**
+		 * @brief Drops the cached content hash of a file after it changed on disk.
+		 * @param a_path Path normalized with NormalizePath().
+		 */
+		void InvalidateFile(const std::string& a_path);
+		/**
+		 * @brief Drops every cached content hash, so sources edited without the file watcher are hashed again.
+		 */
+		void InvalidateAll();
+
+		/**
+		 * @brief Normalizes a path the same way as hlslToShaderMap and the file watcher.
+		 */
+		static std::string NormalizePath(const std::filesystem::path& a_path);
+		static uint64_t HashContent(std::string_view a_content);
+		static uint64_t HashDefines(const D3D_SHADER_MACRO* a_defines, uint32_t a_flags);
+
+	private:
+		struct Dependency
+		{
+			uint32_t path;
+			uint64_t hash;
+
+			bool operator==(const Dependency&) const = default;
+		};
+
+		struct Entry
+		{
+			uint64_t definesHash;
+			uint32_t fileSet;
+		};
+
+		enum class Validity : int8_t
+		{
+			Unknown,
+			Stale,
+			Current,
+		};
+
+		static uint64_t HashFileSet(const std::vector<Dependency>& a_files);
+		uint32_t GetPathId(const std::string& a_path);
+		uint32_t GetFileSetId(std::vector<Dependency>&& a_files);
+		void AddLocked(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files);
+		uint64_t GetCurrentHash(uint32_t a_path);
+		bool AppendJournal(const std::string& a_archive, uint64_t a_key, uint64_t a_definesHash, const std::vector<File>& a_files);
+		void ReplayJournal();
+
+		std::filesystem::path snapshotPath;
+		std::filesystem::path journalPath;
+
+		std::vector<std::string> paths;
+		ankerl::unordered_dense::map<std::string, uint32_t> pathIds;
+		std::vector<std::vector<Dependency>> fileSets;                           // deduplicated, most permutations of a shader share one
+		ankerl::unordered_dense::map<uint64_t, std::vector<uint32_t>> fileSetIds;  // hash of a file set to candidates
+		ankerl::unordered_dense::map<std::string, ankerl::unordered_dense::map<uint64_t, Entry>> entries;  // archive to key to entry
+
+		// session state
+		ankerl::unordered_dense::map<uint32_t, uint64_t> currentHashes;  // path id to content hash on disk
+		std::vector<Validity> fileSetValidity;
+
+		bool loaded = false;
+		std::ofstream journal;
+		std::mutex graphMutex;
+	};
+
+	/**
+	 * @brief Include handler that resolves includes like D3D_COMPILE_STANDARD_FILE_INCLUDE and
+	 * records every file it opens along with its content hash.
+	 *
+	 * Local includes are looked up next to the including file first and then next to the root
+	 * shader, which is how shaders include Common/ and feature folders from anywhere. With an
+	 * include directory, every include is looked up in that directory only.
+	 */
+	class ShaderIncludeHandler : public ID3DInclude
+	{
+	public:
+		explicit ShaderIncludeHandler(const std::filesystem::path& a_root, const std::filesystem::path& a_includeDirectory = {});
+
+		/**
+		 * @brief Reads the root shader and records it as the first dependency.
+		 */
+		bool ReadRoot(std::string& o_source);
+
+		HRESULT __stdcall Open(D3D_INCLUDE_TYPE a_includeType, LPCSTR a_fileName, LPCVOID a_parentData, LPCVOID* o_data, UINT* o_bytes) override;
+		HRESULT __stdcall Close(LPCVOID a_data) override;
+
+		const std::vector<ShaderDependencies::File>& GetFiles() const { return files; }
+
+	private:
+		struct OpenFile
+		{
+			std::string content;
+			std::filesystem::path directory;
+		};
+
+		void AddFile(const std::filesystem::path& a_path, std::string_view a_content);
+
+		std::filesystem::path root;
+		std::filesystem::path rootDirectory;
+		std::filesystem::path includeDirectory;
+		ankerl::unordered_dense::map<const void*, std::unique_ptr<OpenFile>> openFiles;
+		std::vector<ShaderDependencies::File> files;
+	};
+}
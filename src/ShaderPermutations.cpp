@@ -0,0 +1,638 @@
+#include "ShaderPermutations.h"
+
+#include <d3dcompiler.h>
+
+namespace SIE
+{
+	namespace SShaderPermutations
+	{
+		constexpr const char* VertexShaderProfile = "vs_5_0";
+		constexpr const char* PixelShaderProfile = "ps_5_0";
+		constexpr const char* ComputeShaderProfile = "cs_5_0";
+
+		// vanilla writes its Lighting defines first; these follow them
+		static size_t GetLightingShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			size_t lastIndex = 0;
+			if (descriptor & static_cast<uint32_t>(LightingShaderFlags::Deferred)) {
+				defines[lastIndex++] = { "DEFERRED", nullptr };
+			}
+			if ((descriptor & static_cast<uint32_t>(LightingShaderFlags::TruePbr)) != 0) {
+				defines[lastIndex++] = { "TRUE_PBR", nullptr };
+				if ((descriptor & static_cast<uint32_t>(LightingShaderFlags::AnisoLighting)) != 0) {
+					defines[lastIndex++] = { "GLINT", nullptr };
+				}
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetBloodSplaterShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			size_t lastIndex = 0;
+			if (descriptor == static_cast<uint32_t>(BloodSplatterShaderTechniques::Splatter)) {
+				defines[lastIndex++] = { "SPLATTER", nullptr };
+			} else if (descriptor == static_cast<uint32_t>(BloodSplatterShaderTechniques::Flare)) {
+				defines[lastIndex++] = { "FLARE", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetDistantTreeShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			const auto technique = descriptor & 1;
+			size_t lastIndex = 0;
+			if (technique == static_cast<uint32_t>(DistantTreeShaderTechniques::Depth)) {
+				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(DistantTreeShaderFlags::AlphaTest)) {
+				defines[lastIndex++] = { "DO_ALPHA_TEST", nullptr };
+			}
+
+			if (descriptor & static_cast<uint32_t>(DistantTreeShaderFlags::Deferred)) {
+				defines[lastIndex++] = { "DEFERRED", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetSkyShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			using enum SkyShaderTechniques;
+
+			const auto technique = static_cast<SkyShaderTechniques>(descriptor & 255);
+			size_t lastIndex = 0;
+			switch (technique) {
+			case SunOcclude:
+				{
+					defines[lastIndex++] = { "OCCLUSION", nullptr };
+					break;
+				}
+			case SunGlare:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					defines[lastIndex++] = { "DITHER", nullptr };
+					break;
+				}
+			case MoonAndStarsMask:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					defines[lastIndex++] = { "MOONMASK", nullptr };
+					break;
+				}
+			case Stars:
+				{
+					defines[lastIndex++] = { "HORIZFADE", nullptr };
+					break;
+				}
+			case Clouds:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					defines[lastIndex++] = { "CLOUDS", nullptr };
+					break;
+				}
+			case CloudsLerp:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					defines[lastIndex++] = { "CLOUDS", nullptr };
+					defines[lastIndex++] = { "TEXLERP", nullptr };
+					break;
+				}
+			case CloudsFade:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					defines[lastIndex++] = { "CLOUDS", nullptr };
+					defines[lastIndex++] = { "TEXFADE", nullptr };
+					break;
+				}
+			case Texture:
+				{
+					defines[lastIndex++] = { "TEX", nullptr };
+					break;
+				}
+			case Sky:
+				{
+					defines[lastIndex++] = { "DITHER", nullptr };
+					break;
+				}
+			}
+
+			uint32_t flags = descriptor >> 8;
+
+			if (flags) {
+				defines[lastIndex++] = { "DEFERRED", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetGrassShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			const auto technique = descriptor & 0b1111;
+			size_t lastIndex = 0;
+			if (technique == static_cast<uint32_t>(GrassShaderTechniques::RenderDepth)) {
+				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
+			} else if (technique == static_cast<uint32_t>(GrassShaderTechniques::TruePbr)) {
+				defines[lastIndex++] = { "TRUE_PBR", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(GrassShaderFlags::AlphaTest)) {
+				defines[lastIndex++] = { "DO_ALPHA_TEST", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetParticleShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			using enum ParticleShaderTechniques;
+
+			const auto technique = static_cast<ParticleShaderTechniques>(descriptor);
+			size_t lastIndex = 0;
+			switch (technique) {
+			case ParticlesGryColor:
+				{
+					defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
+					break;
+				}
+			case ParticlesGryAlpha:
+				{
+					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
+					break;
+				}
+			case ParticlesGryColorAlpha:
+				{
+					defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
+					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
+					break;
+				}
+			case EnvCubeSnow:
+				{
+					defines[lastIndex++] = { "ENVCUBE", nullptr };
+					defines[lastIndex++] = { "SNOW", nullptr };
+					break;
+				}
+			case EnvCubeRain:
+				{
+					defines[lastIndex++] = { "ENVCUBE", nullptr };
+					defines[lastIndex++] = { "RAIN", nullptr };
+					break;
+				}
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetEffectShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			size_t lastIndex = 0;
+
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Vc)) {
+				defines[lastIndex++] = { "VC", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::TexCoord)) {
+				defines[lastIndex++] = { "TEXCOORD", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::TexCoordIndex)) {
+				defines[lastIndex++] = { "TEXCOORD_INDEX", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Skinned)) {
+				defines[lastIndex++] = { "SKINNED", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Normals)) {
+				defines[lastIndex++] = { "NORMALS", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::BinormalTangent)) {
+				defines[lastIndex++] = { "BINORMAL_TANGENT", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Texture)) {
+				defines[lastIndex++] = { "TEXTURE", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::IndexedTexture)) {
+				defines[lastIndex++] = { "INDEXED_TEXTURE", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Falloff)) {
+				defines[lastIndex++] = { "FALLOFF", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::AddBlend)) {
+				defines[lastIndex++] = { "ADDBLEND", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::MultBlend)) {
+				defines[lastIndex++] = { "MULTBLEND", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Particles)) {
+				defines[lastIndex++] = { "PARTICLES", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::StripParticles)) {
+				defines[lastIndex++] = { "STRIP_PARTICLES", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Blood)) {
+				defines[lastIndex++] = { "BLOOD", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Membrane)) {
+				defines[lastIndex++] = { "MEMBRANE", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Lighting)) {
+				defines[lastIndex++] = { "LIGHTING", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::ProjectedUv)) {
+				defines[lastIndex++] = { "PROJECTED_UV", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Soft)) {
+				defines[lastIndex++] = { "SOFT", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::GrayscaleToColor)) {
+				defines[lastIndex++] = { "GRAYSCALE_TO_COLOR", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::GrayscaleToAlpha)) {
+				defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::IgnoreTexAlpha)) {
+				defines[lastIndex++] = { "IGNORE_TEX_ALPHA", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::MultBlendDecal)) {
+				defines[lastIndex++] = { "MULTBLEND_DECAL", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::AlphaTest)) {
+				defines[lastIndex++] = { "ALPHA_TEST", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::SkyObject)) {
+				defines[lastIndex++] = { "SKY_OBJECT", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::MsnSpuSkinned)) {
+				defines[lastIndex++] = { "MSN_SPU_SKINNED", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::MotionVectorsNormals)) {
+				defines[lastIndex++] = { "MOTIONVECTORS_NORMALS", nullptr };
+			}
+
+			if (descriptor & static_cast<uint32_t>(EffectShaderFlags::Deferred)) {
+				defines[lastIndex++] = { "DEFERRED", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetWaterShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			size_t lastIndex = 0;
+			defines[lastIndex++] = { "WATER", nullptr };
+			defines[lastIndex++] = { "FOG", nullptr };
+
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Vc)) {
+				defines[lastIndex++] = { "VC", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::NormalTexCoord)) {
+				defines[lastIndex++] = { "NORMAL_TEXCOORD", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Reflections)) {
+				defines[lastIndex++] = { "REFLECTIONS", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Refractions)) {
+				defines[lastIndex++] = { "REFRACTIONS", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Depth)) {
+				defines[lastIndex++] = { "DEPTH", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Interior)) {
+				defines[lastIndex++] = { "INTERIOR", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Wading)) {
+				defines[lastIndex++] = { "WADING", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::VertexAlphaDepth)) {
+				defines[lastIndex++] = { "VERTEX_ALPHA_DEPTH", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Cubemap)) {
+				defines[lastIndex++] = { "CUBEMAP", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::Flowmap)) {
+				defines[lastIndex++] = { "FLOWMAP", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(WaterShaderFlags::BlendNormals)) {
+				defines[lastIndex++] = { "BLEND_NORMALS", nullptr };
+			}
+
+			const auto technique = (descriptor >> 11) & 0xF;
+			if (technique == static_cast<uint32_t>(WaterShaderTechniques::Underwater)) {
+				defines[lastIndex++] = { "UNDERWATER", nullptr };
+			} else if (technique == static_cast<uint32_t>(WaterShaderTechniques::Lod)) {
+				defines[lastIndex++] = { "LOD", nullptr };
+			} else if (technique == static_cast<uint32_t>(WaterShaderTechniques::Stencil)) {
+				defines[lastIndex++] = { "STENCIL", nullptr };
+			} else if (technique == static_cast<uint32_t>(WaterShaderTechniques::Simple)) {
+				defines[lastIndex++] = { "SIMPLE", nullptr };
+			} else if (technique < 8) {
+				static constexpr std::array<const char*, 8> numLightDefines = { { "0", "1", "2", "3", "4",
+					"5", "6", "7" } };
+				defines[lastIndex++] = { "SPECULAR", nullptr };
+				defines[lastIndex++] = { "NUM_SPECULAR_LIGHTS", numLightDefines[technique] };
+			}
+
+			return lastIndex;
+		}
+
+		static size_t GetUtilityShaderDefines(uint32_t descriptor, std::span<D3D_SHADER_MACRO> defines)
+		{
+			using enum UtilityShaderFlags;
+
+			size_t lastIndex = 0;
+
+			if (descriptor & static_cast<uint32_t>(Vc)) {
+				defines[lastIndex++] = { "VC", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(Texture)) {
+				defines[lastIndex++] = { "TEXTURE", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(Skinned)) {
+				defines[lastIndex++] = { "SKINNED", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(Normals)) {
+				defines[lastIndex++] = { "NORMALS", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(AlphaTest)) {
+				defines[lastIndex++] = { "ALPHA_TEST", nullptr };
+			}
+
+			if (descriptor & static_cast<uint32_t>(LodLandscape)) {
+				if (descriptor &
+					(static_cast<uint32_t>(RenderShadowmask) |
+						static_cast<uint32_t>(RenderShadowmaskSpot))) {
+					defines[lastIndex++] = { "FOCUS_SHADOW", nullptr };
+				} else {
+					defines[lastIndex++] = { "LOD_LANDSCAPE", nullptr };
+				}
+			}
+
+			if ((descriptor & static_cast<uint32_t>(RenderNormal)) &&
+				!(descriptor & static_cast<uint32_t>(RenderNormalClear))) {
+				defines[lastIndex++] = { "RENDER_NORMAL", nullptr };
+
+			} else if (!(descriptor & static_cast<uint32_t>(RenderNormal)) &&
+					   (descriptor & static_cast<uint32_t>(RenderNormalClear))) {
+				defines[lastIndex++] = { "RENDER_NORMAL_CLEAR", nullptr };
+
+			} else if ((descriptor & static_cast<uint32_t>(RenderNormal)) &&
+					   (descriptor & static_cast<uint32_t>(RenderNormalClear))) {
+				defines[lastIndex++] = { "STENCIL_ABOVE_WATER", nullptr };
+			}
+
+			if (descriptor & static_cast<uint32_t>(RenderNormalFalloff)) {
+				defines[lastIndex++] = { "RENDER_NORMAL_FALLOFF", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderNormalClamp)) {
+				defines[lastIndex++] = { "RENDER_NORMAL_CLAMP", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderDepth)) {
+				defines[lastIndex++] = { "RENDER_DEPTH", nullptr };
+			}
+
+			if (descriptor & static_cast<uint32_t>(OpaqueEffect)) {
+				defines[lastIndex++] = { "OPAQUE_EFFECT", nullptr };
+
+				if (!(descriptor & static_cast<uint32_t>(RenderShadowmap)) &&
+					(descriptor & static_cast<uint32_t>(AdditionalAlphaMask))) {
+					defines[lastIndex++] = { "ADDITIONAL_ALPHA_MASK", nullptr };
+				}
+				if (descriptor & static_cast<uint32_t>(GrayscaleToAlpha)) {
+					defines[lastIndex++] = { "GRAYSCALE_TO_ALPHA", nullptr };
+				}
+			} else {
+				if (descriptor & static_cast<uint32_t>(RenderShadowmap)) {
+					defines[lastIndex++] = { "RENDER_SHADOWMAP", nullptr };
+
+					if (descriptor & static_cast<uint32_t>(RenderShadowmapPb)) {
+						defines[lastIndex++] = { "RENDER_SHADOWMAP_PB", nullptr };
+					}
+				} else if (descriptor &
+						   static_cast<uint32_t>(AdditionalAlphaMask)) {
+					defines[lastIndex++] = { "ADDITIONAL_ALPHA_MASK", nullptr };
+				}
+				if (descriptor & static_cast<uint32_t>(RenderShadowmapClamped)) {
+					defines[lastIndex++] = { "RENDER_SHADOWMAP_CLAMPED", nullptr };
+				}
+			}
+
+			if (descriptor & static_cast<uint32_t>(GrayscaleMask)) {
+				defines[lastIndex++] = { "GRAYSCALE_MASK", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderShadowmask)) {
+				defines[lastIndex++] = { "RENDER_SHADOWMASK", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderShadowmaskSpot)) {
+				defines[lastIndex++] = { "RENDER_SHADOWMASKSPOT", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderShadowmaskPb)) {
+				defines[lastIndex++] = { "RENDER_SHADOWMASKPB", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderShadowmaskDpb)) {
+				defines[lastIndex++] = { "RENDER_SHADOWMASKDPB", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(RenderBaseTexture)) {
+				defines[lastIndex++] = { "RENDER_BASE_TEXTURE", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(TreeAnim)) {
+				defines[lastIndex++] = { "TREE_ANIM", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(LodObject)) {
+				defines[lastIndex++] = { "LOD_OBJECT", nullptr };
+			}
+			if (descriptor & static_cast<uint32_t>(LocalMapFogOfWar)) {
+				defines[lastIndex++] = { "LOCALMAP_FOGOFWAR", nullptr };
+			}
+
+			if (descriptor & (static_cast<uint32_t>(RenderShadowmask) |
+								 static_cast<uint32_t>(RenderShadowmaskDpb) |
+								 static_cast<uint32_t>(RenderShadowmaskPb) |
+								 static_cast<uint32_t>(RenderShadowmaskSpot))) {
+				static constexpr std::array<const char*, 5> shadowFilters = { { "0", "1", "2",
+					"3", "4" } };
+				const size_t shadowFilterIndex = std::clamp((descriptor >> 17) & 0b111, 0u, 4u);
+				defines[lastIndex++] = { "SHADOWFILTER", shadowFilters[shadowFilterIndex] };
+			} else if ((!(descriptor & static_cast<uint32_t>(OpaqueEffect)) &&
+						   (descriptor &
+							   static_cast<uint32_t>(RenderShadowmap))) ||
+					   (descriptor & static_cast<uint32_t>(RenderDepth))) {
+				if (descriptor & static_cast<uint32_t>(DepthWriteDecals)) {
+					defines[lastIndex++] = { "DEPTH_WRITE_DECALS", nullptr };
+				}
+			} else {
+				if (descriptor & (static_cast<uint32_t>(DepthWriteDecals) |
+									 static_cast<uint32_t>(DebugColor))) {
+					defines[lastIndex++] = { "DEBUG_COLOR", nullptr };
+				}
+				if (descriptor & static_cast<uint32_t>(DebugShadowSplit)) {
+					defines[lastIndex++] = { "DEBUG_SHADOWSPLIT", nullptr };
+				}
+			}
+
+			defines[lastIndex++] = { "SHADOWSPLITCOUNT", "3" };
+
+			if ((descriptor & 0x14000) != 0x14000 &&
+				((descriptor & 0x20004000) == 0x4000 || (descriptor & 0x1E02000) == 0x2000) &&
+				!(descriptor & 0x80) && (descriptor & 0x14000) != 0x10000) {
+				defines[lastIndex++] = { "NO_PIXEL_SHADER", nullptr };
+			}
+
+			return lastIndex;
+		}
+
+		template <typename RangeType>
+		static std::vector<uint32_t> GenerateFlagPermutations(const RangeType& flags, uint32_t constantFlags)
+		{
+			std::vector<uint32_t> flagValues;
+			std::ranges::transform(flags, std::back_inserter(flagValues), [](auto flag) { return static_cast<uint32_t>(flag); });
+			const uint32_t size = static_cast<uint32_t>(flagValues.size());
+
+			std::vector<uint32_t> result;
+			for (uint32_t mask = 0; mask < (1u << size); ++mask) {
+				uint32_t flag = constantFlags;
+				for (size_t index = 0; index < size; ++index) {
+					if (mask & (1 << index)) {
+						flag |= flagValues[index];
+					}
+				}
+				result.push_back(flag);
+			}
+
+			return result;
+		}
+
+		static uint32_t GetLightingShaderDescriptor(LightingShaderTechniques technique, uint32_t flags)
+		{
+			return ((static_cast<uint32_t>(technique) & 0x3F) << 24) | flags;
+		}
+
+		static void AddLightingShaderDescriptors(LightingShaderTechniques technique, const std::vector<uint32_t>& flags, std::vector<uint32_t>& result)
+		{
+			for (uint32_t flag : flags) {
+				result.push_back(GetLightingShaderDescriptor(technique, flag));
+			}
+		}
+
+		static std::vector<uint32_t> GeneratePBRLightingPixelPermutations()
+		{
+			using enum LightingShaderFlags;
+
+			constexpr std::array defaultFlags{ Deferred, AnisoLighting, Skinned, DoAlphaTest };
+			constexpr std::array projectedUvFlags{ Deferred, AnisoLighting, DoAlphaTest, Snow };
+			constexpr std::array lodObjectsFlags{ Deferred, WorldMap, DoAlphaTest, ProjectedUV };
+			constexpr std::array treeFlags{ Deferred, AnisoLighting, Skinned, DoAlphaTest };
+			constexpr std::array landFlags{ Deferred, AnisoLighting };
+
+			constexpr uint32_t defaultConstantFlags = static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(VC);
+			constexpr uint32_t projectedUvConstantFlags = static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(VC) | static_cast<uint32_t>(ProjectedUV);
+
+			const auto defaultFlagValues = GenerateFlagPermutations(defaultFlags, defaultConstantFlags);
+			const auto projectedUvFlagValues = GenerateFlagPermutations(projectedUvFlags, projectedUvConstantFlags);
+			const auto lodObjectsFlagValues = GenerateFlagPermutations(lodObjectsFlags, defaultConstantFlags);
+			const auto treeFlagValues = GenerateFlagPermutations(treeFlags, defaultConstantFlags);
+			const auto landFlagValues = GenerateFlagPermutations(landFlags, defaultConstantFlags);
+
+			std::vector<uint32_t> result;
+			AddLightingShaderDescriptors(LightingShaderTechniques::None, defaultFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::None, projectedUvFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::LODObjects, lodObjectsFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::LODObjectHD, lodObjectsFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::TreeAnim, treeFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::MTLand, landFlagValues, result);
+			AddLightingShaderDescriptors(LightingShaderTechniques::MTLandLODBlend, landFlagValues, result);
+			return result;
+		}
+
+		static std::vector<uint32_t> GeneratePBRGrassPixelPermutations()
+		{
+			using enum GrassShaderTechniques;
+			using enum GrassShaderFlags;
+
+			return { static_cast<uint32_t>(TruePbr),
+				static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(AlphaTest) };
+		}
+	}
+
+	namespace ShaderPermutations
+	{
+		const char* GetProfile(ShaderClass a_class)
+		{
+			switch (a_class) {
+			case ShaderClass::Vertex:
+				return SShaderPermutations::VertexShaderProfile;
+			case ShaderClass::Pixel:
+				return SShaderPermutations::PixelShaderProfile;
+			case ShaderClass::Compute:
+				return SShaderPermutations::ComputeShaderProfile;
+			}
+			return nullptr;
+		}
+
+		uint32_t GetCompileFlags(bool a_developerMode)
+		{
+			return !a_developerMode ? D3DCOMPILE_OPTIMIZATION_LEVEL3 : D3DCOMPILE_DEBUG;
+		}
+
+		size_t GetClassDefines(ShaderClass a_class, bool a_developerMode, bool a_vr, std::span<D3D_SHADER_MACRO> o_defines)
+		{
+			size_t lastIndex = 0;
+			if (a_class == ShaderClass::Vertex) {
+				o_defines[lastIndex++] = { "VSHADER", nullptr };
+			} else if (a_class == ShaderClass::Pixel) {
+				o_defines[lastIndex++] = { "PSHADER", nullptr };
+			} else if (a_class == ShaderClass::Compute) {
+				o_defines[lastIndex++] = { "CSHADER", nullptr };
+			}
+			if (a_developerMode) {
+				o_defines[lastIndex++] = { "D3DCOMPILE_SKIP_OPTIMIZATION", nullptr };
+				o_defines[lastIndex++] = { "D3DCOMPILE_DEBUG", nullptr };
+			}
+			if (a_vr) {
+				o_defines[lastIndex++] = { "VR", nullptr };
+			}
+			return lastIndex;
+		}
+
+		size_t GetDescriptorDefines(ShaderType a_type, uint32_t a_descriptor, std::span<D3D_SHADER_MACRO> o_defines)
+		{
+			switch (a_type) {
+			case ShaderType::Grass:
+				return SShaderPermutations::GetGrassShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Sky:
+				return SShaderPermutations::GetSkyShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Water:
+				return SShaderPermutations::GetWaterShaderDefines(a_descriptor, o_defines);
+			case ShaderType::BloodSplatter:
+				return SShaderPermutations::GetBloodSplaterShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Lighting:
+				return SShaderPermutations::GetLightingShaderDefines(a_descriptor, o_defines);
+			case ShaderType::DistantTree:
+				return SShaderPermutations::GetDistantTreeShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Particle:
+				return SShaderPermutations::GetParticleShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Effect:
+				return SShaderPermutations::GetEffectShaderDefines(a_descriptor, o_defines);
+			case ShaderType::Utility:
+				return SShaderPermutations::GetUtilityShaderDefines(a_descriptor, o_defines);
+			default:
+				return 0;
+			}
+		}
+
+		bool HasFeatureDefines(ShaderType a_type)
+		{
+			// Utility never took feature defines; ImageSpace adds them with their options from the game
+			return a_type != ShaderType::Utility && a_type != ShaderType::ImageSpace;
+		}
+
+		std::vector<uint32_t> GetTruePBRPixelDescriptors(ShaderType a_type)
+		{
+			std::vector<uint32_t> result;
+			if (a_type == ShaderType::Lighting) {
+				result = SShaderPermutations::GeneratePBRLightingPixelPermutations();
+			} else if (a_type == ShaderType::Grass) {
+				result = SShaderPermutations::GeneratePBRGrassPixelPermutations();
+			}
+			std::ranges::sort(result);
+			result.erase(std::ranges::unique(result).begin(), result.end());
+			return result;
+		}
+	}
+}
@@ -0,0 +1,285 @@
+#pragma once
+
+#include <d3dcommon.h>
+
+namespace SIE
+{
+	enum class ShaderClass
+	{
+		Vertex,
+		Pixel,
+		Compute,
+		Total,
+	};
+
+	// same values as RE::BSShader::Type, so keys match in and out of the game
+	enum class ShaderType : uint32_t
+	{
+		None,
+		Grass,
+		Sky,
+		Water,
+		BloodSplatter,
+		ImageSpace,
+		Lighting,
+		Effect,
+		Utility,
+		DistantTree,
+		Particle,
+		Total,
+	};
+
+	/**
+	 * @brief Compact identity of a shader permutation.
+	 *
+	 * Packs the descriptor, shader type, shader class and global defines epoch into 64 bits so
+	 * lookups never build strings. Formatting a key prints type:class:descriptor; the full
+	 * defines string is only built on demand for logging and the UI.
+	 */
+	struct ShaderKey
+	{
+		uint64_t value = 0;
+
+		ShaderKey() = default;
+		ShaderKey(ShaderClass a_class, ShaderType a_type, uint32_t a_descriptor, uint16_t a_epoch) :
+			value(static_cast<uint64_t>(a_descriptor) |
+				  (static_cast<uint64_t>(a_type) << 32) |
+				  (static_cast<uint64_t>(a_class) << 40) |
+				  (static_cast<uint64_t>(a_epoch) << 48))
+		{}
+
+		uint32_t GetDescriptor() const { return static_cast<uint32_t>(value); }
+		ShaderType GetType() const { return static_cast<ShaderType>((value >> 32) & 0xFF); }
+		ShaderClass GetClass() const { return static_cast<ShaderClass>((value >> 40) & 0xFF); }
+		uint16_t GetEpoch() const { return static_cast<uint16_t>(value >> 48); }
+
+		auto operator<=>(const ShaderKey&) const = default;
+	};
+
+	enum class LightingShaderTechniques
+	{
+		None = 0,
+		Envmap = 1,
+		Glowmap = 2,
+		Parallax = 3,
+		Facegen = 4,
+		FacegenRGBTint = 5,
+		Hair = 6,
+		ParallaxOcc = 7,
+		MTLand = 8,
+		LODLand = 9,
+		Snow = 10,  // unused
+		MultilayerParallax = 11,
+		TreeAnim = 12,
+		LODObjects = 13,
+		MultiIndexSparkle = 14,
+		LODObjectHD = 15,
+		Eye = 16,
+		Cloud = 17,  // unused
+		LODLandNoise = 18,
+		MTLandLODBlend = 19,
+	};
+
+	enum class LightingShaderFlags
+	{
+		VC = 1 << 0,
+		Skinned = 1 << 1,
+		ModelSpaceNormals = 1 << 2,
+		// flags 3 to 8 are unused by vanilla
+		// Community Shaders start
+		TruePbr = 1 << 3,
+		Deferred = 1 << 4,
+		// Community Shaders end
+		Specular = 1 << 9,
+		SoftLighting = 1 << 10,
+		RimLighting = 1 << 11,
+		BackLighting = 1 << 12,
+		ShadowDir = 1 << 13,
+		DefShadow = 1 << 14,
+		ProjectedUV = 1 << 15,
+		AnisoLighting = 1 << 16,  // Reused for glint with PBR
+		AmbientSpecular = 1 << 17,
+		WorldMap = 1 << 18,
+		BaseObjectIsSnow = 1 << 19,
+		DoAlphaTest = 1 << 20,
+		Snow = 1 << 21,
+		CharacterLight = 1 << 22,
+		AdditionalAlphaMask = 1 << 23
+	};
+
+	enum class BloodSplatterShaderTechniques
+	{
+		Splatter = 0,
+		Flare = 1,
+	};
+
+	enum class DistantTreeShaderTechniques
+	{
+		DistantTreeBlock = 0,
+		Depth = 1,
+	};
+
+	enum class DistantTreeShaderFlags
+	{
+		Deferred = 1 << 8,
+		AlphaTest = 1 << 16,
+	};
+
+	enum class SkyShaderTechniques
+	{
+		SunOcclude = 0,
+		SunGlare = 1,
+		MoonAndStarsMask = 2,
+		Stars = 3,
+		Clouds = 4,
+		CloudsLerp = 5,
+		CloudsFade = 6,
+		Texture = 7,
+		Sky = 8,
+	};
+
+	enum class GrassShaderTechniques
+	{
+		RenderDepth = 8,
+		TruePbr = 9,
+	};
+
+	enum class GrassShaderFlags
+	{
+		AlphaTest = 0x10000,
+	};
+
+	enum class ParticleShaderTechniques
+	{
+		Particles = 0,
+		ParticlesGryColor = 1,
+		ParticlesGryAlpha = 2,
+		ParticlesGryColorAlpha = 3,
+		EnvCubeSnow = 4,
+		EnvCubeRain = 5,
+	};
+
+	enum class WaterShaderTechniques
+	{
+		Underwater = 8,
+		Lod = 9,
+		Stencil = 10,
+		Simple = 11,
+	};
+
+	enum class WaterShaderFlags
+	{
+		Vc = 1 << 0,
+		NormalTexCoord = 1 << 1,
+		Reflections = 1 << 2,
+		Refractions = 1 << 3,
+		Depth = 1 << 4,
+		Interior = 1 << 5,
+		Wading = 1 << 6,
+		VertexAlphaDepth = 1 << 7,
+		Cubemap = 1 << 8,
+		Flowmap = 1 << 9,
+		BlendNormals = 1 << 10,
+	};
+
+	enum class EffectShaderFlags
+	{
+		Vc = 1 << 0,
+		TexCoord = 1 << 1,
+		TexCoordIndex = 1 << 2,
+		Skinned = 1 << 3,
+		Normals = 1 << 4,
+		BinormalTangent = 1 << 5,
+		Texture = 1 << 6,
+		IndexedTexture = 1 << 7,
+		Falloff = 1 << 8,
+		AddBlend = 1 << 10,
+		MultBlend = 1 << 11,
+		Particles = 1 << 12,
+		StripParticles = 1 << 13,
+		Blood = 1 << 14,
+		Membrane = 1 << 15,
+		Lighting = 1 << 16,
+		ProjectedUv = 1 << 17,
+		Soft = 1 << 18,
+		GrayscaleToColor = 1 << 19,
+		GrayscaleToAlpha = 1 << 20,
+		IgnoreTexAlpha = 1 << 21,
+		MultBlendDecal = 1 << 22,
+		AlphaTest = 1 << 23,
+		SkyObject = 1 << 24,
+		MsnSpuSkinned = 1 << 25,
+		MotionVectorsNormals = 1 << 26,
+		Deferred = 1 << 27
+	};
+
+	enum class UtilityShaderFlags : uint64_t
+	{
+		Vc = 1 << 0,
+		Texture = 1 << 1,
+		Skinned = 1 << 2,
+		Normals = 1 << 3,
+		BinormalTangent = 1 << 4,
+		AlphaTest = 1 << 7,
+		LodLandscape = 1 << 8,
+		RenderNormal = 1 << 9,
+		RenderNormalFalloff = 1 << 10,
+		RenderNormalClamp = 1 << 11,
+		RenderNormalClear = 1 << 12,
+		RenderDepth = 1 << 13,
+		RenderShadowmap = 1 << 14,
+		RenderShadowmapClamped = 1 << 15,
+		GrayscaleToAlpha = 1 << 15,
+		RenderShadowmapPb = 1 << 16,
+		AdditionalAlphaMask = 1 << 16,
+		DepthWriteDecals = 1 << 17,
+		DebugShadowSplit = 1 << 18,
+		DebugColor = 1 << 19,
+		GrayscaleMask = 1 << 20,
+		RenderShadowmask = 1 << 21,
+		RenderShadowmaskSpot = 1 << 22,
+		RenderShadowmaskPb = 1 << 23,
+		RenderShadowmaskDpb = 1 << 24,
+		RenderBaseTexture = 1 << 25,
+		TreeAnim = 1 << 26,
+		LodObject = 1 << 27,
+		LocalMapFogOfWar = 1 << 28,
+		OpaqueEffect = 1 << 29,
+	};
+
+	/**
+	 * Compile inputs that follow from a permutation's class, type and descriptor alone.
+	 *
+	 * Shared by the shader cache and the offline cache builder so both build identical macro
+	 * lists. Vanilla Lighting defines and ImageSpace macros come from the game and feature
+	 * defines from the loaded features; callers add those around what is built here.
+	 */
+	namespace ShaderPermutations
+	{
+		const char* GetProfile(ShaderClass a_class);
+		uint32_t GetCompileFlags(bool a_developerMode);
+
+		/**
+		 * @brief Writes the shader stage, debug and VR macros every permutation starts with.
+		 * @return Number of macros written, without a terminator.
+		 */
+		size_t GetClassDefines(ShaderClass a_class, bool a_developerMode, bool a_vr, std::span<D3D_SHADER_MACRO> o_defines);
+
+		/**
+		 * @brief Writes the macros a shader file derives from its descriptor.
+		 * @details For Lighting only the Community Shaders flags, which follow the vanilla defines. ImageSpace writes none.
+		 * @return Number of macros written, without a terminator.
+		 */
+		size_t GetDescriptorDefines(ShaderType a_type, uint32_t a_descriptor, std::span<D3D_SHADER_MACRO> o_defines);
+
+		/**
+		 * @brief Whether feature defines follow the descriptor defines of a type.
+		 */
+		bool HasFeatureDefines(ShaderType a_type);
+
+		/**
+		 * @brief Pixel shader descriptors True PBR draws with, before State::ModifyShaderLookup.
+		 */
+		std::vector<uint32_t> GetTruePBRPixelDescriptors(ShaderType a_type);
+	}
+}
@@ -0,0 +1,61 @@
+#include "ShaderReflection.h"
+
+namespace SIE
+{
+	void ShaderReflection::MapVariable(const Variable& a_variable, const std::function<int32_t(const char*)>& a_getIndex,
+		const std::function<void(std::string_view, bool)>& a_unknown)
+	{
+		auto getElementName = [&](uint32_t a_index) {
+			return std::string(a_variable.name) + '[' + std::to_string(a_index) + ']';
+		};
+
+		const auto variableIndex = a_getIndex(a_variable.name);
+		if (variableIndex != -1) {
+			constantTable[variableIndex] = static_cast<int8_t>(a_variable.startOffset / 4);
+		} else {
+			a_unknown(a_variable.name, false);
+		}
+
+		if (a_variable.elements == 0) {
+			return;
+		}
+		if (variableIndex == -1) {
+			const auto arrayName = getElementName(a_variable.elements);
+			if (const auto arrayIndex = a_getIndex(arrayName.c_str()); arrayIndex != -1) {
+				constantTable[arrayIndex] = static_cast<int8_t>(a_variable.startOffset / 4);
+			} else {
+				a_unknown(arrayName, true);
+			}
+		} else {
+			const auto elementSize = a_variable.size / a_variable.elements;
+			for (uint32_t element = 1; element < a_variable.elements; ++element) {
+				const auto elementName = getElementName(element);
+				if (const auto elementIndex = a_getIndex(elementName.c_str()); elementIndex != -1) {
+					constantTable[elementIndex] = static_cast<int8_t>((a_variable.startOffset + elementSize * element) / 4);
+				} else {
+					a_unknown(elementName, true);
+				}
+			}
+		}
+	}
+
+	void ShaderReflection::SetBufferSize(size_t a_buffer, uint32_t a_bytes)
+	{
+		bufferSizes[a_buffer] = ((a_bytes + 15) & ~15u) / 16;
+	}
+
+	bool ShaderReflection::Load(std::span<const uint8_t> a_stored, uint64_t a_bytecodeHash, ShaderReflection& o_reflection)
+	{
+		if (a_stored.size() != sizeof(ShaderReflection)) {
+			return false;
+		}
+		ShaderReflection reflection;
+		std::memcpy(&reflection, a_stored.data(), sizeof(ShaderReflection));
+		// the bytecode may have been recompiled since
+		if (reflection.magic != Magic || !reflection.reflected || reflection.bytecodeHash != a_bytecodeHash) {
+			return false;
+		}
+		o_reflection = reflection;
+		return true;
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+namespace SIE
+{
+	/**
+	 * @brief What reflecting a vertex or pixel shader yields: its constant offsets, constant
+	 * buffer sizes and, for vertex shaders, the vertex description built from its input signature.
+	 *
+	 * Stored in the disk archive next to the bytecode so a cached shader is created without
+	 * D3DReflect or matching variable names.
+	 */
+	struct ShaderReflection
+	{
+		static constexpr uint32_t Magic = 0x52535343;  // "CSSR"
+		static constexpr size_t MaxConstants = 64;
+
+		/**
+		 * @brief A constant buffer variable as D3DReflect describes it.
+		 */
+		struct Variable
+		{
+			const char* name;
+			uint32_t startOffset;  // in bytes
+			uint32_t size;         // in bytes, of the whole array for arrays
+			uint32_t elements;     // array length; only imagespace shaders name array elements, others pass 0
+		};
+
+		/**
+		 * @brief Stores the offset of a variable under its constant index and, for arrays, the offsets
+		 * of the elements named "Name[Index]", or of the array named "Name[Elements]" as a whole.
+		 * @param a_getIndex Maps a constant name to its index in the constant table, or -1.
+		 * @param a_unknown Receives the names a_getIndex does not know, and whether they name an array.
+		 */
+		void MapVariable(const Variable& a_variable, const std::function<int32_t(const char*)>& a_getIndex,
+			const std::function<void(std::string_view, bool)>& a_unknown);
+
+		void SetBufferSize(size_t a_buffer, uint32_t a_bytes);
+
+		/**
+		 * @brief Reads a stored record, refusing one that was not reflected from the bytecode hashed
+		 * to a_bytecodeHash.
+		 */
+		static bool Load(std::span<const uint8_t> a_stored, uint64_t a_bytecodeHash, ShaderReflection& o_reflection);
+
+		// reflections share the archive with the bytecode, under keys no permutation can have
+		static uint64_t GetArchiveKey(uint64_t a_permutationKey) { return a_permutationKey | (1ull << 63); }
+
+		uint32_t magic = Magic;
+		uint32_t reflected = 0;     // 0 if D3DReflect failed; such results are never stored
+		uint64_t bytecodeHash = 0;  // of the blob this was reflected from
+		uint64_t vertexDesc = 0;
+		std::array<uint32_t, 3> bufferSizes{};  // PerTechnique, PerMaterial and PerGeometry in 16 byte registers
+		uint32_t pad = 0;
+		std::array<int8_t, MaxConstants> constantTable{};
+	};
+	static_assert(sizeof(ShaderReflection) == 104);
+}
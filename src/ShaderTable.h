@@ -0,0 +1,222 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+namespace SIE
+{
+	/**
+	 * @brief Descriptor to shader map with a lock-free read path.
+	 *
+	 * Readers probe an open-addressing index that is only ever published, never mutated in a way
+	 * that breaks a concurrent probe. Writers serialize on a mutex, own the shader objects and
+	 * republish a larger index when the load factor grows. Replaced indices and erased shaders
+	 * are retired, and released and freed a few frames later, once no draw can still be reading them.
+	 */
+	template <class T>
+	class ShaderTable
+	{
+	public:
+		ShaderTable() = default;
+		~ShaderTable() { delete current.load(std::memory_order_relaxed); }
+		ShaderTable(const ShaderTable&) = delete;
+		ShaderTable& operator=(const ShaderTable&) = delete;
+
+		/**
+		 * @brief Looks up a shader without taking any lock.
+		 * @return The shader or nullptr if it has not been added.
+		 */
+		T* Find(uint32_t a_descriptor) const
+		{
+			const auto* index = current.load(std::memory_order_acquire);
+			if (!index) {
+				return nullptr;
+			}
+			const uint64_t tag = Tag(a_descriptor);
+			for (size_t i = Hash(a_descriptor) & index->mask;; i = (i + 1) & index->mask) {
+				const auto key = index->slots[i].key.load(std::memory_order_acquire);
+				if (key == tag) {
+					return index->slots[i].value.load(std::memory_order_acquire);
+				}
+				if (key == 0) {
+					return nullptr;
+				}
+			}
+		}
+
+		T* Insert(uint32_t a_descriptor, std::unique_ptr<T> a_shader)
+		{
+			std::scoped_lock lock{ writeMutex };
+			Reclaim();
+			auto* shader = a_shader.get();
+			if (auto it = owned.find(a_descriptor); it != owned.end()) {
+				Retire(std::move(it->second));
+				it->second = std::move(a_shader);
+			} else {
+				owned.emplace(a_descriptor, std::move(a_shader));
+			}
+			Publish(a_descriptor, shader);
+			return shader;
+		}
+
+		/**
+		 * @brief Removes a shader; a_release is called on it when it is freed, once no reader can still hold it.
+		 * @return true if the descriptor was present.
+		 */
+		bool Erase(uint32_t a_descriptor, std::function<void(T&)> a_release)
+		{
+			std::scoped_lock lock{ writeMutex };
+			Reclaim();
+			auto it = owned.find(a_descriptor);
+			if (it == owned.end()) {
+				return false;
+			}
+			Publish(a_descriptor, nullptr);
+			Retire(std::move(it->second), std::move(a_release));
+			owned.erase(it);
+			return true;
+		}
+
+		/**
+		 * @brief Removes all shaders; a_release is called on each when it is freed, once no reader can still hold it.
+		 */
+		void Clear(const std::function<void(T&)>& a_release)
+		{
+			std::scoped_lock lock{ writeMutex };
+			Reclaim();
+			for (auto& [descriptor, shader] : owned) {
+				Retire(std::move(shader), a_release);
+			}
+			owned.clear();
+			if (auto* index = current.exchange(nullptr, std::memory_order_acq_rel)) {
+				RetireIndex(index);
+			}
+		}
+
+		size_t Size()
+		{
+			std::scoped_lock lock{ writeMutex };
+			return owned.size();
+		}
+
+	private:
+		struct Slot
+		{
+			std::atomic<uint64_t> key{ 0 };  // 0 is empty, otherwise Tag(descriptor)
+			std::atomic<T*> value{ nullptr };
+		};
+
+		struct RetiredShader
+		{
+			uint32_t frame;
+			std::unique_ptr<T> shader;
+			std::function<void(T&)> release;
+		};
+
+		struct Index
+		{
+			explicit Index(size_t a_capacity) :
+				mask(a_capacity - 1), slots(std::make_unique<Slot[]>(a_capacity)) {}
+
+			size_t mask;
+			size_t used = 0;
+			std::unique_ptr<Slot[]> slots;
+		};
+
+		static constexpr size_t MinCapacity = 64;
+		static constexpr uint32_t RetireFrames = 3;
+
+		static uint64_t Tag(uint32_t a_descriptor) { return (1ull << 32) | a_descriptor; }
+
+		static size_t Hash(uint32_t a_descriptor)
+		{
+			// descriptors are bitfields, so spread them before masking
+			uint64_t h = a_descriptor * 0x9E3779B97F4A7C15ull;
+			return static_cast<size_t>(h ^ (h >> 29));
+		}
+
+		static uint32_t CurrentFrame() { return RE::BSGraphics::State::GetSingleton()->frameCount; }
+
+		void Publish(uint32_t a_descriptor, T* a_shader)
+		{
+			auto* index = current.load(std::memory_order_relaxed);
+			if (!index || (index->used + 1) * 4 > (index->mask + 1) * 3) {
+				index = Grow(index);
+			}
+			Store(*index, a_descriptor, a_shader);
+		}
+
+		static void Store(Index& a_index, uint32_t a_descriptor, T* a_shader)
+		{
+			const uint64_t tag = Tag(a_descriptor);
+			for (size_t i = Hash(a_descriptor) & a_index.mask;; i = (i + 1) & a_index.mask) {
+				auto& slot = a_index.slots[i];
+				const auto key = slot.key.load(std::memory_order_relaxed);
+				if (key == tag) {
+					slot.value.store(a_shader, std::memory_order_release);
+					return;
+				}
+				if (key == 0) {
+					// value must be visible before a reader can match the key
+					slot.value.store(a_shader, std::memory_order_relaxed);
+					slot.key.store(tag, std::memory_order_release);
+					++a_index.used;
+					return;
+				}
+			}
+		}
+
+		Index* Grow(Index* a_old)
+		{
+			size_t capacity = MinCapacity;
+			while (capacity * 3 < (owned.size() + 1) * 4 * 2) {
+				capacity *= 2;
+			}
+			auto* index = new Index(capacity);
+			for (auto& [descriptor, shader] : owned) {
+				if (shader) {
+					Store(*index, descriptor, shader.get());
+				}
+			}
+			current.store(index, std::memory_order_release);
+			if (a_old) {
+				RetireIndex(a_old);
+			}
+			return index;
+		}
+
+		void Retire(std::unique_ptr<T> a_shader, std::function<void(T&)> a_release = nullptr)
+		{
+			if (a_shader) {
+				retiredShaders.push_back({ CurrentFrame(), std::move(a_shader), std::move(a_release) });
+			}
+		}
+
+		void RetireIndex(Index* a_index)
+		{
+			retiredIndices.emplace_back(CurrentFrame(), std::unique_ptr<Index>(a_index));
+		}
+
+		void Reclaim()
+		{
+			const auto frame = CurrentFrame();
+			std::erase_if(retiredShaders, [frame](RetiredShader& a_entry) {
+				if (frame - a_entry.frame < RetireFrames) {
+					return false;
+				}
+				if (a_entry.release) {
+					a_entry.release(*a_entry.shader);
+				}
+				return true;
+			});
+			std::erase_if(retiredIndices, [frame](const auto& a_entry) { return frame - a_entry.first >= RetireFrames; });
+		}
+
+		std::atomic<Index*> current{ nullptr };
+		std::mutex writeMutex;
+		eastl::unordered_map<uint32_t, std::unique_ptr<T>> owned;
+		std::vector<RetiredShader> retiredShaders;
+		std::vector<std::pair<uint32_t, std::unique_ptr<Index>>> retiredIndices;
+	};
+}
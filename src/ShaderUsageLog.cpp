@@ -0,0 +1,162 @@
+#include "ShaderUsageLog.h"
+
+#include <fstream>
+
+namespace SIE
+{
+	ShaderUsageLog::ShaderUsageLog(const std::filesystem::path& a_path) :
+		path(a_path)
+	{}
+
+	bool ShaderUsageLog::Load()
+	{
+		std::ifstream stream(path, std::ios::binary);
+		if (!stream) {
+			return false;
+		}
+
+		Header header{};
+		if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != Magic || header.version != FormatVersion) {
+			logger::warn("Shader usage log {} has an unknown format; ignoring", path.string());
+			return false;
+		}
+
+		std::vector<Entry> entries(header.entryCount);
+		std::vector<LocationEntry> locationEntries(header.locationCount);
+		if (!stream.read(reinterpret_cast<char*>(entries.data()), entries.size() * sizeof(Entry)) ||
+			!stream.read(reinterpret_cast<char*>(locationEntries.data()), locationEntries.size() * sizeof(LocationEntry))) {
+			logger::warn("Shader usage log {} is truncated; ignoring", path.string());
+			return false;
+		}
+
+		std::scoped_lock lock{ logMutex };
+		usages.clear();
+		usages.reserve(entries.size());
+		for (const auto& entry : entries) {
+			auto& usage = usages[entry.key];
+			usage.firstUse = entry.firstUse;
+			usage.count = entry.count;
+		}
+		for (const auto& entry : locationEntries) {
+			if (auto it = usages.find(entry.key); it != usages.end()) {
+				it->second.locations.emplace_back(entry.location, entry.count);
+			}
+		}
+		lastLocation = header.lastLocation;
+		dirty = false;
+		logger::info("Loaded {} used shader permutations from {}", usages.size(), path.string());
+		return true;
+	}
+
+	bool ShaderUsageLog::Save()
+	{
+		std::scoped_lock saveLock{ saveMutex };
+		std::vector<Entry> entries;
+		std::vector<LocationEntry> locationEntries;
+		uint32_t savedLocation = 0;
+		{
+			std::scoped_lock lock{ logMutex };
+			if (!dirty) {
+				return true;
+			}
+			entries.reserve(usages.size());
+			for (const auto& [key, usage] : usages) {
+				entries.push_back({ key, usage.firstUse, usage.count });
+				for (const auto& [location, count] : usage.locations) {
+					locationEntries.push_back({ key, location, count });
+				}
+			}
+			savedLocation = location ? location : lastLocation;
+			dirty = false;
+		}
+
+		std::ranges::sort(entries, {}, &Entry::key);
+
+		std::error_code ec;
+		std::filesystem::create_directories(path.parent_path(), ec);
+		const auto tempPath = std::filesystem::path(path).concat(".tmp");
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			Header header{ Magic, FormatVersion, (uint32_t)entries.size(), (uint32_t)locationEntries.size(), savedLocation, 0 };
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(Entry));
+			out.write(reinterpret_cast<const char*>(locationEntries.data()), locationEntries.size() * sizeof(LocationEntry));
+			if (!out) {
+				logger::error("Failed to write shader usage log {}", tempPath.string());
+				out.close();
+				std::filesystem::remove(tempPath, ec);
+				return false;
+			}
+		}
+		std::filesystem::rename(tempPath, path, ec);
+		if (ec) {
+			logger::error("Failed to replace shader usage log {}: {}", path.string(), ec.message());
+			return false;
+		}
+		logger::debug("Saved {} used shader permutations to {}", entries.size(), path.string());
+		return true;
+	}
+
+	void ShaderUsageLog::RecordSlow(uint64_t a_key)
+	{
+		std::scoped_lock lock{ logMutex };
+		if (!visited.insert(a_key).second) {
+			return;
+		}
+		const auto now = (uint32_t)std::min<int64_t>(
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - sessionStart).count(), UINT32_MAX - 1);
+
+		auto& usage = usages[a_key];
+		usage.firstUse = std::min(usage.firstUse, now);
+		++usage.count;
+		auto it = std::ranges::find(usage.locations, location, &std::pair<uint32_t, uint32_t>::first);
+		if (it != usage.locations.end()) {
+			++it->second;
+		} else {
+			usage.locations.emplace_back(location, 1);
+		}
+		dirty = true;
+	}
+
+	void ShaderUsageLog::ResetSeen()
+	{
+		for (size_t i = 0; i < SeenSlots; ++i) {
+			seen[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	bool ShaderUsageLog::SetLocation(uint32_t a_location)
+	{
+		std::scoped_lock lock{ logMutex };
+		if (a_location == location) {
+			return false;
+		}
+		location = a_location;
+		visited.clear();
+		// a Record racing with this can leave a stale filter entry, which only drops that key from this visit
+		ResetSeen();
+		return true;
+	}
+
+	std::optional<uint64_t> ShaderUsageLog::GetPrewarmOrder(uint64_t a_key)
+	{
+		std::scoped_lock lock{ logMutex };
+		auto it = usages.find(a_key);
+		if (it == usages.end()) {
+			return std::nullopt;
+		}
+		const auto& usage = it->second;
+		// drawn where the last session ended first, then by how early it was needed, then by how often
+		const bool atLastLocation = lastLocation && std::ranges::find(usage.locations, lastLocation, &std::pair<uint32_t, uint32_t>::first) != usage.locations.end();
+		const uint64_t rarity = UINT16_MAX - std::min<uint32_t>(usage.count, UINT16_MAX);
+		return (static_cast<uint64_t>(!atLastLocation) << 63) |
+		       (static_cast<uint64_t>(std::min<uint32_t>(usage.firstUse, 0x7FFFFFFF)) << 16) |
+		       rarity;
+	}
+
+	bool ShaderUsageLog::IsEmpty()
+	{
+		std::scoped_lock lock{ logMutex };
+		return usages.empty();
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+namespace SIE
+{
+	/**
+	 * @brief Persisted record of which shader permutations are actually drawn.
+	 *
+	 * Keys are permutation keys without the defines epoch. For every key the log keeps when it was
+	 * first drawn (milliseconds after launch), how many location visits drew it and the same count
+	 * per location (worldspace or interior cell, 0 before the first one is entered). The shader cache uses it to compile
+	 * the working set of a load order before the rest of the permutations.
+	 */
+	class ShaderUsageLog
+	{
+	public:
+		static constexpr uint32_t Magic = 0x55535343;  // "CSSU"
+		static constexpr uint32_t FormatVersion = 1;
+
+		struct Header
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t entryCount;
+			uint32_t locationCount;
+			uint32_t lastLocation;
+			uint32_t pad;
+		};
+		static_assert(sizeof(Header) == 24);
+
+		struct Entry
+		{
+			uint64_t key;
+			uint32_t firstUse;  // milliseconds after launch
+			uint32_t count;     // location visits that drew the key
+		};
+		static_assert(sizeof(Entry) == 16);
+
+		struct LocationEntry
+		{
+			uint64_t key;
+			uint32_t location;
+			uint32_t count;
+		};
+		static_assert(sizeof(LocationEntry) == 16);
+
+		explicit ShaderUsageLog(const std::filesystem::path& a_path);
+
+		ShaderUsageLog(const ShaderUsageLog&) = delete;
+		ShaderUsageLog& operator=(const ShaderUsageLog&) = delete;
+
+		bool Load();
+
+		/**
+		 * @brief Writes the log if it changed. Safe to call from any thread.
+		 */
+		bool Save();
+
+		/**
+		 * @brief Notes that a key was drawn. Cheap enough to call for every technique.
+		 */
+		void Record(uint64_t a_key)
+		{
+			auto& slot = seen[SeenHash(a_key)];
+			if (slot.load(std::memory_order_relaxed) == a_key) {
+				return;
+			}
+			RecordSlow(a_key);
+			slot.store(a_key, std::memory_order_relaxed);
+		}
+
+		/**
+		 * @brief Starts a new location visit.
+		 * @return true if the location changed.
+		 */
+		bool SetLocation(uint32_t a_location);
+
+		/**
+		 * @brief Returns the prewarm order of a key; lower compiles first.
+		 * @return The order, or nullopt if the key was never drawn.
+		 */
+		std::optional<uint64_t> GetPrewarmOrder(uint64_t a_key);
+
+		bool IsEmpty();
+
+	private:
+		struct Usage
+		{
+			uint32_t firstUse = UINT32_MAX;
+			uint32_t count = 0;
+			std::vector<std::pair<uint32_t, uint32_t>> locations;  // location, count
+		};
+
+		static constexpr size_t SeenSlots = 4096;
+
+		static size_t SeenHash(uint64_t a_key)
+		{
+			uint64_t h = a_key * 0x9E3779B97F4A7C15ull;
+			return static_cast<size_t>(h >> 52) & (SeenSlots - 1);
+		}
+
+		void RecordSlow(uint64_t a_key);
+		void ResetSeen();
+
+		std::filesystem::path path;
+		std::chrono::steady_clock::time_point sessionStart = std::chrono::steady_clock::now();
+
+		// direct mapped filter of keys already recorded during this visit; a collision only costs a lock
+		std::unique_ptr<std::atomic<uint64_t>[]> seen = std::make_unique<std::atomic<uint64_t>[]>(SeenSlots);
+
+		ankerl::unordered_dense::map<uint64_t, Usage> usages;
+		ankerl::unordered_dense::set<uint64_t> visited;  // keys recorded during the current visit
+		uint32_t location = 0;
+		uint32_t lastLocation = 0;  // last non-menu location, loaded from the previous session
+		bool dirty = false;
+		std::mutex logMutex;
+		std::mutex saveMutex;  // serializes writers of the file, which share the temporary path
+	};
+}
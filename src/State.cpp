@@ -19,6 +19,7 @@
 #include "Upscaling.h"
 
 #include "VariableCache.h"
+#include "WaterDataGrid.h"
 
 void State::Draw()
 {
@@ -109,6 +110,7 @@ void State::Reset()
 			feature->Reset();
 	if (!RE::UI::GetSingleton()->GameIsPaused())
 		timer += RE::GetSecondsSinceLastFrame();
+	SIE::ShaderCache::Instance().UpdateUsageLocation();
 	lastModifiedPixelDescriptor = 0;
 	lastModifiedVertexDescriptor = 0;
 	lastPixelDescriptor = 0;
@@ -223,6 +225,8 @@ void State::Load(ConfigMode a_configMode, bool a_allowReload)
 				shaderCache.backgroundCompilationThreadCount = std::clamp(advanced["Background Compiler Threads"].get<int32_t>(), 1, static_cast<int32_t>(std::thread::hardware_concurrency()));
 			if (advanced["Use FileWatcher"].is_boolean())
 				shaderCache.SetFileWatcher(advanced["Use FileWatcher"]);
+			if (advanced["Prewarm Working Set Only"].is_boolean())
+				shaderCache.prewarmWorkingSetOnly = advanced["Prewarm Working Set Only"];
 			if (advanced["Frame Annotations"].is_boolean())
 				frameAnnotations = advanced["Frame Annotations"];
 		}
@@ -369,6 +373,7 @@ void State::Save(ConfigMode a_configMode)
 	advanced["Compiler Threads"] = shaderCache.compilationThreadCount;
 	advanced["Background Compiler Threads"] = shaderCache.backgroundCompilationThreadCount;
 	advanced["Use FileWatcher"] = shaderCache.UseFileWatcher();
+	advanced["Prewarm Working Set Only"] = shaderCache.prewarmWorkingSetOnly;
 	advanced["Frame Annotations"] = frameAnnotations;
 	settings["Advanced"] = advanced;
 
@@ -473,6 +478,7 @@ void State::SetDefines(std::string a_defines)
 		shaderDefines.push_back(std::pair(name, definition));
 	}
 	shaderDefinesString = shaderDefinesString.substr(0, shaderDefinesString.size() - 1);
+	shaderDefinesEpoch++;
 	logger::debug("Shader Defines set to {}", shaderDefinesString);
 }
 
@@ -513,9 +519,10 @@ void State::SetupResources()
 	permutationCB = new ConstantBuffer(ConstantBufferDesc<PermutationCB>());
 	sharedDataCB = new ConstantBuffer(ConstantBufferDesc<SharedDataCB>());
 
-	auto [data, size] = GetFeatureBufferData(false);
-	featureDataCB = new ConstantBuffer(ConstantBufferDesc((uint32_t)size));
-	delete[] data;
+	auto featureBuffer = FeatureBuffer::GetSingleton();
+	featureBuffer->Update(false);
+	featureDataCB = new ConstantBuffer(ConstantBufferDesc((uint32_t)featureBuffer->GetSize()));
+	featureDataCB->Update(featureBuffer->GetData(), featureBuffer->GetSize());
 
 	// Grab main texture to get resolution
 	// VR cannot use viewport->screenWidth/Height as it's the desktop preview window's resolution and not HMD
@@ -697,12 +704,7 @@ void State::UpdateSharedData(bool a_inWorld)
 		data.FrameCountAlwaysActive = viewport->frameCount;
 
 		if (a_inWorld) {
-			for (int i = -2; i <= 2; i++) {
-				for (int k = -2; k <= 2; k++) {
-					int waterTile = (i + 2) + ((k + 2) * 5);
-					data.WaterData[waterTile] = Util::TryGetWaterData((float)i * 4096.0f, (float)k * 4096.0f);
-				}
-			}
+			WaterDataGrid::GetSingleton()->GetWaterData(data.WaterData);
 		}
 
 		if (auto sky = RE::Sky::GetSingleton()) {
@@ -721,12 +723,9 @@ void State::UpdateSharedData(bool a_inWorld)
 		sharedDataCB->Update(data);
 	}
 
-	{
-		auto [data, size] = GetFeatureBufferData(a_inWorld);
-
-		featureDataCB->Update(data, size);
-
-		delete[] data;
+	// Feature settings rarely change, upload only when one did
+	if (auto featureBuffer = FeatureBuffer::GetSingleton(); featureBuffer->Update(a_inWorld)) {
+		featureDataCB->Update(featureBuffer->GetData(), featureBuffer->GetSize());
 	}
 
 	const auto& depth = RE::BSGraphics::Renderer::GetSingleton()->GetDepthStencilData().depthStencils[RE::RENDER_TARGETS_DEPTHSTENCIL::kPOST_ZPREPASS_COPY];
@@ -34,6 +34,7 @@ public:
 	spdlog::level::level_enum logLevel = spdlog::level::info;
 	std::string shaderDefinesString = "";
 	std::vector<std::pair<std::string, std::string>> shaderDefines{};  // data structure to parse string into; needed to avoid dangling pointers
+	std::atomic<uint16_t> shaderDefinesEpoch = 0;                     // bumped whenever shaderDefines changes; part of every shader key
 	const std::string folderPath = "Data\\SKSE\\Plugins\\CommunityShaders";
 	const std::string testConfigPath = "Data\\SKSE\\Plugins\\CommunityShaders\\SettingsTest.json";
 	const std::string userConfigPath = "Data\\SKSE\\Plugins\\CommunityShaders\\SettingsUser.json";
@@ -9,7 +9,30 @@
 #include "Util.h"
 #include "VariableCache.h"
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+#include <execution>
+
+// Appends the name, offset and size of a record field, and the layout of the field itself when it is a record too
+template <class T>
+static void AppendRecordField(std::string& o_layout, std::string_view a_name, size_t a_offset, size_t a_size, const T& a_field)
+{
+	o_layout += std::format("{}:{}:{};", a_name, a_offset, a_size);
+	if constexpr (requires { AppendRecordLayout(o_layout, a_field); }) {
+		AppendRecordLayout(o_layout, a_field);
+	}
+}
+
+#define PBR_RECORD_LAYOUT_FIELD(v1) AppendRecordField(o_layout, #v1, offsetof(Record, v1), sizeof(Record::v1), a_record.v1);
+
+// json conversion of a record type, plus AppendRecordLayout for the snapshot fingerprint; one field list for both
+#define PBR_DEFINE_RECORD(Type, ...)                                                     \
+	NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(Type, __VA_ARGS__)                   \
+	[[maybe_unused]] static void AppendRecordLayout(std::string& o_layout, const Type& a_record) \
+	{                                                                                    \
+		using Record = Type;                                                             \
+		NLOHMANN_JSON_EXPAND(NLOHMANN_JSON_PASTE(PBR_RECORD_LAYOUT_FIELD, __VA_ARGS__))  \
+	}
+
+PBR_DEFINE_RECORD(
 	GlintParameters,
 	enabled,
 	screenSpaceScale,
@@ -17,7 +40,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
 	microfacetRoughness,
 	densityRandomization);
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+PBR_DEFINE_RECORD(
 	TruePBR::PBRTextureSetData,
 	roughnessScale,
 	displacementScale,
@@ -33,7 +56,7 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
 	fuzzWeight,
 	glintParameters);
 
-NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
+PBR_DEFINE_RECORD(
 	TruePBR::PBRMaterialObjectData,
 	baseColorScale,
 	roughness,
@@ -42,39 +65,244 @@ NLOHMANN_DEFINE_TYPE_NON_INTRUSIVE_WITH_DEFAULT(
 
 namespace PNState
 {
-	void ReadPBRRecordConfigs(const std::string& rootPath, std::function<void(const std::string&, const json&)> recordReader)
+	constexpr uint32_t SnapshotMagic = 0x52425043;  // "CPBR"
+	constexpr uint32_t SnapshotFormatVersion = 2;
+
+	/**
+	 * @brief Hash of the defaults and the field layout of a record type.
+	 * Snapshots hold records by value and fill missing json fields with defaults, so a snapshot written by a build
+	 * with other fields, field order or defaults is not reused even when the record size matches.
+	 */
+	template <class T>
+	static uint64_t GetRecordFingerprint()
 	{
-		if (std::filesystem::exists(rootPath)) {
-			auto configs = clib_util::distribution::get_configs(rootPath, "", ".json");
+		std::string layout = json(T{}).dump();
+		AppendRecordLayout(layout, T{});
+		return ankerl::unordered_dense::hash<std::string_view>{}(layout);
+	}
 
-			if (configs.empty()) {
-				logger::warn("[TruePBR] no .json files were found within the {} folder, aborting...", rootPath);
-				return;
+	// Identity of a config file; a record is reused while size and modification time match, or when the content hash does
+	struct RecordFileStamp
+	{
+		std::string path;
+		uint64_t size = 0;
+		int64_t writeTime = 0;
+		uint64_t hash = 0;
+	};
+
+	template <class T>
+	struct RecordEntry
+	{
+		RecordFileStamp stamp;
+		std::optional<T> record;
+		std::string error;
+		bool stampMatched = false;  // taken from the snapshot without reading the file
+		bool parsed = false;
+	};
+
+	struct Writer
+	{
+		std::string data;
+
+		template <class T>
+		void Write(const T& a_value)
+		{
+			data.append(reinterpret_cast<const char*>(&a_value), sizeof(T));
+		}
+
+		void WriteString(std::string_view a_value)
+		{
+			Write(static_cast<uint16_t>(a_value.size()));
+			data.append(a_value);
+		}
+	};
+
+	struct Reader
+	{
+		const std::string& data;
+		size_t offset = 0;
+
+		template <class T>
+		bool Read(T& o_value)
+		{
+			if (offset + sizeof(T) > data.size()) {
+				return false;
 			}
+			memcpy(&o_value, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
 
-			logger::info("[TruePBR] {} matching jsons found", configs.size());
+		bool ReadString(std::string& o_value)
+		{
+			uint16_t size = 0;
+			if (!Read(size) || offset + size > data.size()) {
+				return false;
+			}
+			o_value.assign(data.data() + offset, size);
+			offset += size;
+			return true;
+		}
+	};
 
-			for (auto& path : configs) {
-				logger::info("[TruePBR] loading json : {}", path);
+	static std::string ReadFile(const std::filesystem::path& a_path)
+	{
+		std::string data;
+		std::ifstream stream(a_path, std::ios::binary | std::ios::ate);
+		if (!stream) {
+			return data;
+		}
+		data.resize((size_t)stream.tellg());
+		stream.seekg(0);
+		stream.read(data.data(), data.size());
+		return data;
+	}
 
-				std::ifstream fileStream(path);
-				if (!fileStream.is_open()) {
-					logger::error("[TruePBR] failed to read {}", path);
-					continue;
-				}
+	template <class T>
+	static ankerl::unordered_dense::map<std::string, RecordEntry<T>> ReadSnapshot(const char* a_snapshotPath)
+	{
+		ankerl::unordered_dense::map<std::string, RecordEntry<T>> entries;
+
+		const auto data = ReadFile(a_snapshotPath);
+		Reader reader{ data };
+		uint32_t magic = 0, version = 0, recordSize = 0, count = 0;
+		uint64_t fingerprint = 0;
+		if (!reader.Read(magic) || !reader.Read(version) || !reader.Read(recordSize) || !reader.Read(fingerprint) || !reader.Read(count) ||
+			magic != SnapshotMagic || version != SnapshotFormatVersion || recordSize != sizeof(T) || fingerprint != GetRecordFingerprint<T>() || count > data.size()) {
+			return entries;
+		}
 
-				json config;
-				try {
-					fileStream >> config;
-				} catch (const nlohmann::json::parse_error& e) {
-					logger::error("[TruePBR] failed to parse {} : {}", path, e.what());
-					continue;
-				}
+		entries.reserve(count);
+		for (uint32_t i = 0; i < count; i++) {
+			RecordEntry<T> entry;
+			T record{};
+			if (!reader.ReadString(entry.stamp.path) || !reader.Read(entry.stamp.size) || !reader.Read(entry.stamp.writeTime) ||
+				!reader.Read(entry.stamp.hash) || !reader.Read(record)) {
+				logger::warn("[TruePBR] snapshot {} is unreadable", a_snapshotPath);
+				return {};
+			}
+			entry.record = record;
+			auto path = entry.stamp.path;
+			entries.insert_or_assign(std::move(path), std::move(entry));
+		}
+		return entries;
+	}
 
-				const auto editorId = std::filesystem::path(path).stem().string();
-				recordReader(editorId, config);
+	template <class T>
+	static void WriteSnapshot(const char* a_snapshotPath, const std::vector<RecordEntry<T>>& a_entries)
+	{
+		Writer writer;
+		writer.Write(SnapshotMagic);
+		writer.Write(SnapshotFormatVersion);
+		writer.Write((uint32_t)sizeof(T));
+		writer.Write(GetRecordFingerprint<T>());
+		writer.Write((uint32_t)std::ranges::count_if(a_entries, [](const auto& a_entry) { return a_entry.record.has_value(); }));
+		for (const auto& entry : a_entries) {
+			if (entry.record) {
+				writer.WriteString(entry.stamp.path);
+				writer.Write(entry.stamp.size);
+				writer.Write(entry.stamp.writeTime);
+				writer.Write(entry.stamp.hash);
+				writer.Write(*entry.record);
 			}
 		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(std::filesystem::path(a_snapshotPath).parent_path(), ec);
+		std::ofstream out(a_snapshotPath, std::ios::binary | std::ios::trunc);
+		out.write(writer.data.data(), writer.data.size());
+		if (!out) {
+			logger::warn("[TruePBR] failed to write snapshot {}", a_snapshotPath);
+		}
+	}
+
+	/**
+	 * @brief Loads every .json record under a_rootPath into o_records, keyed by file stem.
+	 * Records of files unchanged since the last run come from a_snapshotPath; the rest are parsed in parallel
+	 * and the snapshot is rewritten when anything differed.
+	 */
+	template <class T>
+	void LoadPBRRecordConfigs(const std::string& a_rootPath, const char* a_snapshotPath, std::unordered_map<std::string, T>& o_records)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "records are stored in the snapshot by value");
+
+		if (!std::filesystem::exists(a_rootPath)) {
+			return;
+		}
+
+		auto configs = clib_util::distribution::get_configs(a_rootPath, "", ".json");
+		if (configs.empty()) {
+			logger::warn("[TruePBR] no .json files were found within the {} folder, aborting...", a_rootPath);
+			return;
+		}
+
+		logger::info("[TruePBR] {} matching jsons found", configs.size());
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto snapshot = ReadSnapshot<T>(a_snapshotPath);
+
+		std::vector<RecordEntry<T>> entries(configs.size());
+		std::for_each(std::execution::par, entries.begin(), entries.end(), [&](RecordEntry<T>& a_entry) {
+			const auto& path = configs[&a_entry - entries.data()];
+			auto& stamp = a_entry.stamp;
+			std::error_code ec;
+			stamp.path = path;
+			stamp.size = std::filesystem::file_size(path, ec);
+			stamp.writeTime = std::filesystem::last_write_time(path, ec).time_since_epoch().count();
+
+			const auto cached = snapshot.find(path);
+			if (cached != snapshot.end() && cached->second.stamp.size == stamp.size && cached->second.stamp.writeTime == stamp.writeTime) {
+				stamp.hash = cached->second.stamp.hash;
+				a_entry.record = cached->second.record;
+				a_entry.stampMatched = true;
+				return;
+			}
+
+			const auto content = ReadFile(path);
+			if (content.empty() && stamp.size != 0) {
+				a_entry.error = "failed to read";
+				return;
+			}
+			stamp.hash = ankerl::unordered_dense::hash<std::string_view>{}(content);
+
+			// touched but identical, e.g. reinstalled by a mod manager
+			if (cached != snapshot.end() && cached->second.stamp.size == stamp.size && cached->second.stamp.hash == stamp.hash) {
+				a_entry.record = cached->second.record;
+				return;
+			}
+
+			a_entry.parsed = true;
+			try {
+				const T record = json::parse(content);
+				a_entry.record = record;
+			} catch (const std::exception& e) {
+				a_entry.error = e.what();
+			}
+		});
+
+		size_t parsedCount = 0, stampMatchedCount = 0, recordCount = 0;
+		for (const auto& entry : entries) {
+			const auto editorId = std::filesystem::path(entry.stamp.path).stem().string();
+			if (!entry.record) {
+				logger::error("[TruePBR] failed to load {} : {}", entry.stamp.path, entry.error);
+				continue;
+			}
+			if (entry.parsed) {
+				logger::info("[TruePBR] loading json : {}", entry.stamp.path);
+				parsedCount++;
+			}
+			stampMatchedCount += entry.stampMatched;
+			recordCount++;
+			o_records.insert_or_assign(editorId, *entry.record);
+		}
+
+		logger::info("[TruePBR] {} records loaded, {} parsed and {} from snapshot ({} ms)", o_records.size(), parsedCount, recordCount - parsedCount,
+			std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+		// unchanged only if every snapshot record was still listed with the same stamp and nothing else loaded
+		if (stampMatchedCount != snapshot.size() || recordCount != stampMatchedCount) {
+			WriteSnapshot(a_snapshotPath, entries);
+		}
 	}
 
 	void SavePBRRecordConfig(const std::string& rootPath, const std::string& editorId, const json& config)
@@ -349,29 +577,26 @@ void TruePBR::SetupTextureSetData()
 	logger::info("[TruePBR] loading PBR texture set configs");
 
 	pbrTextureSets.clear();
+	pbrTextureSetsByFormID.Clear();
 
-	PNState::ReadPBRRecordConfigs("Data\\PBRTextureSets", [this](const std::string& editorId, const json& config) {
-		try {
-			pbrTextureSets.insert_or_assign(editorId, config);
-		} catch (const std::exception& e) {
-			logger::error("Failed to deserialize config for {}: {}.", editorId, e.what());
-		}
-	});
+	PNState::LoadPBRRecordConfigs("Data\\PBRTextureSets", TextureSetsSnapshotPath, pbrTextureSets);
+
+	if (pbrRecordsResolved) {
+		ResolvePBRRecords();
+	}
 }
 
 void TruePBR::ReloadTextureSetData()
 {
 	logger::info("[TruePBR] reloading PBR texture set configs");
 
-	PNState::ReadPBRRecordConfigs("Data\\PBRTextureSets", [this](const std::string& editorId, const json& config) {
-		try {
-			if (auto it = pbrTextureSets.find(editorId); it != pbrTextureSets.cend()) {
-				it->second = config;
-			}
-		} catch (const std::exception& e) {
-			logger::error("Failed to deserialize config for {}: {}.", editorId, e.what());
+	decltype(pbrTextureSets) textureSets;
+	PNState::LoadPBRRecordConfigs("Data\\PBRTextureSets", TextureSetsSnapshotPath, textureSets);
+	for (const auto& [editorId, textureSet] : textureSets) {
+		if (auto it = pbrTextureSets.find(editorId); it != pbrTextureSets.cend()) {
+			it->second = textureSet;
 		}
-	});
+	}
 
 	for (const auto& [material, textureSets] : BSLightingShaderMaterialPBRLandscape::All) {
 		for (uint32_t textureSetIndex = 0; textureSetIndex < BSLightingShaderMaterialPBRLandscape::NumTiles; ++textureSetIndex) {
@@ -386,6 +611,10 @@ TruePBR::PBRTextureSetData* TruePBR::GetPBRTextureSetData(const RE::TESForm* tex
 		return nullptr;
 	}
 
+	if (pbrRecordsResolved) {
+		return pbrTextureSetsByFormID.Find(textureSet->GetFormID());
+	}
+
 	auto it = pbrTextureSets.find(textureSet->GetFormEditorID());
 	if (it == pbrTextureSets.end()) {
 		return nullptr;
@@ -403,14 +632,13 @@ void TruePBR::SetupMaterialObjectData()
 	logger::info("[TruePBR] loading PBR material object configs");
 
 	pbrMaterialObjects.clear();
+	pbrMaterialObjectsByFormID.Clear();
 
-	PNState::ReadPBRRecordConfigs("Data\\PBRMaterialObjects", [this](const std::string& editorId, const json& config) {
-		try {
-			pbrMaterialObjects.insert_or_assign(editorId, config);
-		} catch (const std::exception& e) {
-			logger::error("Failed to deserialize config for {}: {}.", editorId, e.what());
-		}
-	});
+	PNState::LoadPBRRecordConfigs("Data\\PBRMaterialObjects", MaterialObjectsSnapshotPath, pbrMaterialObjects);
+
+	if (pbrRecordsResolved) {
+		ResolvePBRRecords();
+	}
 }
 
 TruePBR::PBRMaterialObjectData* TruePBR::GetPBRMaterialObjectData(const RE::TESForm* materialObject)
@@ -419,6 +647,10 @@ TruePBR::PBRMaterialObjectData* TruePBR::GetPBRMaterialObjectData(const RE::TESF
 		return nullptr;
 	}
 
+	if (pbrRecordsResolved) {
+		return pbrMaterialObjectsByFormID.Find(materialObject->GetFormID());
+	}
+
 	auto it = pbrMaterialObjects.find(materialObject->GetFormEditorID());
 	if (it == pbrMaterialObjects.end()) {
 		return nullptr;
@@ -426,106 +658,38 @@ TruePBR::PBRMaterialObjectData* TruePBR::GetPBRMaterialObjectData(const RE::TESF
 	return &it->second;
 }
 
-bool TruePBR::IsPBRMaterialObject(const RE::TESForm* materialObject)
+void TruePBR::ResolvePBRRecords()
 {
-	return GetPBRMaterialObjectData(materialObject) != nullptr;
+	pbrTextureSetsByFormID.Rebuild(pbrTextureSets, editorIDs);
+	pbrMaterialObjectsByFormID.Rebuild(pbrMaterialObjects, editorIDs);
+	pbrRecordsResolved = true;
+
+	logger::info("[TruePBR] resolved {}/{} texture set and {}/{} material object configs to forms",
+		pbrTextureSetsByFormID.GetSize(), pbrTextureSets.size(), pbrMaterialObjectsByFormID.GetSize(), pbrMaterialObjects.size());
 }
 
-namespace Permutations
+void TruePBR::ResolvePBRRecord(RE::FormID a_formID, const std::string& a_editorID)
 {
-	template <typename RangeType>
-	std::unordered_set<uint32_t> GenerateFlagPermutations(const RangeType& flags, uint32_t constantFlags)
-	{
-		std::vector<uint32_t> flagValues;
-		std::ranges::transform(flags, std::back_inserter(flagValues), [](auto flag) { return static_cast<uint32_t>(flag); });
-		const uint32_t size = static_cast<uint32_t>(flagValues.size());
-
-		std::unordered_set<uint32_t> result;
-		for (uint32_t mask = 0; mask < (1u << size); ++mask) {
-			uint32_t flag = constantFlags;
-			for (size_t index = 0; index < size; ++index) {
-				if (mask & (1 << index)) {
-					flag |= flagValues[index];
-				}
-			}
-			result.insert(flag);
-		}
-
-		return result;
-	}
-
-	uint32_t GetLightingShaderDescriptor(SIE::ShaderCache::LightingShaderTechniques technique, uint32_t flags)
-	{
-		return ((static_cast<uint32_t>(technique) & 0x3F) << 24) | flags;
-	}
-
-	void AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques technique, const std::unordered_set<uint32_t>& flags, std::unordered_set<uint32_t>& result)
-	{
-		for (uint32_t flag : flags) {
-			result.insert(GetLightingShaderDescriptor(technique, flag));
-		}
-	}
-
-	std::unordered_set<uint32_t> GeneratePBRLightingPixelPermutations()
-	{
-		using enum SIE::ShaderCache::LightingShaderFlags;
-
-		constexpr std::array defaultFlags{ Deferred, AnisoLighting, Skinned, DoAlphaTest };
-		constexpr std::array projectedUvFlags{ Deferred, AnisoLighting, DoAlphaTest, Snow };
-		constexpr std::array lodObjectsFlags{ Deferred, WorldMap, DoAlphaTest, ProjectedUV };
-		constexpr std::array treeFlags{ Deferred, AnisoLighting, Skinned, DoAlphaTest };
-		constexpr std::array landFlags{ Deferred, AnisoLighting };
-
-		constexpr uint32_t defaultConstantFlags = static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(VC);
-		constexpr uint32_t projectedUvConstantFlags = static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(VC) | static_cast<uint32_t>(ProjectedUV);
-
-		const std::unordered_set<uint32_t> defaultFlagValues = GenerateFlagPermutations(defaultFlags, defaultConstantFlags);
-		const std::unordered_set<uint32_t> projectedUvFlagValues = GenerateFlagPermutations(projectedUvFlags, projectedUvConstantFlags);
-		const std::unordered_set<uint32_t> lodObjectsFlagValues = GenerateFlagPermutations(lodObjectsFlags, defaultConstantFlags);
-		const std::unordered_set<uint32_t> treeFlagValues = GenerateFlagPermutations(treeFlags, defaultConstantFlags);
-		const std::unordered_set<uint32_t> landFlagValues = GenerateFlagPermutations(landFlags, defaultConstantFlags);
-
-		std::unordered_set<uint32_t> result;
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::None, defaultFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::None, projectedUvFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::LODObjects, lodObjectsFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::LODObjectHD, lodObjectsFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::TreeAnim, treeFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::MTLand, landFlagValues, result);
-		AddLightingShaderDescriptors(SIE::ShaderCache::LightingShaderTechniques::MTLandLODBlend, landFlagValues, result);
-		return result;
-	}
-
-	std::unordered_set<uint32_t> GeneratePBRGrassPixelPermutations()
-	{
-		using enum SIE::ShaderCache::GrassShaderTechniques;
-		using enum SIE::ShaderCache::GrassShaderFlags;
+	pbrTextureSetsByFormID.Resolve(pbrTextureSets, a_formID, a_editorID);
+	pbrMaterialObjectsByFormID.Resolve(pbrMaterialObjects, a_formID, a_editorID);
+}
 
-		return { static_cast<uint32_t>(TruePbr),
-			static_cast<uint32_t>(TruePbr) | static_cast<uint32_t>(AlphaTest) };
-	}
+bool TruePBR::IsPBRMaterialObject(const RE::TESForm* materialObject)
+{
+	return GetPBRMaterialObjectData(materialObject) != nullptr;
 }
 
 void TruePBR::GenerateShaderPermutations(RE::BSShader* shader)
 {
 	auto state = VariableCache::GetSingleton()->state;
 	auto shaderCache = VariableCache::GetSingleton()->shaderCache;
-	if (shader->shaderType == RE::BSShader::Type::Lighting) {
-		const auto pixelPermutations = Permutations::GeneratePBRLightingPixelPermutations();
-		for (auto descriptor : pixelPermutations) {
-			auto vertexShaderDesriptor = descriptor;
-			auto pixelShaderDescriptor = descriptor;
-			state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-			std::ignore = shaderCache->GetPixelShader(*shader, pixelShaderDescriptor);
-		}
-	} else if (shader->shaderType == RE::BSShader::Type::Grass) {
-		const auto pixelPermutations = Permutations::GeneratePBRGrassPixelPermutations();
-		for (auto descriptor : pixelPermutations) {
-			auto vertexShaderDesriptor = descriptor;
-			auto pixelShaderDescriptor = descriptor;
-			state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
-			std::ignore = shaderCache->GetPixelShader(*shader, pixelShaderDescriptor);
-		}
+	// empty for shader types True PBR has no permutations of
+	const auto pixelPermutations = SIE::ShaderPermutations::GetTruePBRPixelDescriptors(SIE::ToShaderType(shader->shaderType.get()));
+	for (auto descriptor : pixelPermutations) {
+		auto vertexShaderDesriptor = descriptor;
+		auto pixelShaderDescriptor = descriptor;
+		state->ModifyShaderLookup(*shader, vertexShaderDesriptor, pixelShaderDescriptor);
+		shaderCache->QueuePrewarm(SIE::ShaderClass::Pixel, *shader, pixelShaderDescriptor);
 	}
 }
 
@@ -1202,7 +1366,11 @@ struct TESForm_SetFormEditorID
 	static bool thunk(RE::TESForm* form, const char* editorId)
 	{
 		auto* singleton = VariableCache::GetSingleton()->truePBR;
-		singleton->editorIDs[form->GetFormID()] = editorId;
+		auto& storedEditorId = singleton->editorIDs[form->GetFormID()];
+		storedEditorId = editorId;
+		if (singleton->pbrRecordsResolved) {
+			singleton->ResolvePBRRecord(form->GetFormID(), storedEditorId);
+		}
 		return true;
 	}
 	static inline REL::Relocation<decltype(thunk)> func;
@@ -1590,6 +1758,8 @@ void TruePBR::PostPostLoad()
 
 void TruePBR::DataLoaded()
 {
+	ResolvePBRRecords();
+
 	defaultPbrLandTextureSet = RE::TESForm::LookupByEditorID<RE::BGSTextureSet>("DefaultPBRLand");
 	SetupDefaultPBRLandTextureSet();
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Buffer.h"
+#include "TruePBR/PBRRecordIndex.h"
 
 struct GlintParameters
 {
@@ -36,6 +37,14 @@ public:
 
 	std::unordered_map<uint32_t, std::string> editorIDs;
 
+	/**
+	 * @brief Binds every loaded PBR record config to the FormID of the form carrying its editor ID.
+	 * Runs once at data load; afterwards record lookups are keyed by FormID and never hash strings.
+	 */
+	void ResolvePBRRecords();
+	void ResolvePBRRecord(RE::FormID a_formID, const std::string& a_editorID);
+	bool pbrRecordsResolved = false;
+
 	struct PBRTextureSetData
 	{
 		float roughnessScale = 1.f;
@@ -59,6 +68,10 @@ public:
 
 	void SetupFrame();
 
+	// parsed record configs, reused while their json files keep their sizes and modification times or contents
+	static constexpr const char* TextureSetsSnapshotPath = "Data\\SKSE\\Plugins\\CommunityShaders\\PBRTextureSets.bin";
+	static constexpr const char* MaterialObjectsSnapshotPath = "Data\\SKSE\\Plugins\\CommunityShaders\\PBRMaterialObjects.bin";
+
 	void SetupTextureSetData();
 	void ReloadTextureSetData();
 	PBRTextureSetData* GetPBRTextureSetData(const RE::TESForm* textureSet);
@@ -67,6 +80,7 @@ public:
 	void SetupDefaultPBRLandTextureSet();
 
 	std::unordered_map<std::string, PBRTextureSetData> pbrTextureSets;
+	PBRRecordIndex<PBRTextureSetData> pbrTextureSetsByFormID;
 	RE::BGSTextureSet* defaultPbrLandTextureSet = nullptr;
 	bool defaultLandTextureSetReplaced = false;
 	std::string selectedPbrTextureSetName;
@@ -86,6 +100,7 @@ public:
 	bool IsPBRMaterialObject(const RE::TESForm* materialObject);
 
 	std::unordered_map<std::string, PBRMaterialObjectData> pbrMaterialObjects;
+	PBRRecordIndex<PBRMaterialObjectData> pbrMaterialObjectsByFormID;
 	std::string selectedPbrMaterialObjectName;
 	PBRMaterialObjectData* selectedPbrMaterialObject = nullptr;
 
@@ -0,0 +1,55 @@
+#pragma once
+
+/**
+ * FormID to record table for PBR record configs, which are keyed by editor ID.
+ *
+ * Bound once at data load from the editor IDs the TruePBR hooks collect, and kept up to date as
+ * editor IDs are set afterwards, so record lookups while cells stream in are one integer probe
+ * instead of an editor ID lookup and a string hash. Entries point into the name-keyed map, whose
+ * nodes stay put until it is cleared.
+ */
+template <class Record>
+class PBRRecordIndex
+{
+public:
+	using Records = std::unordered_map<std::string, Record>;
+	using EditorIDs = std::unordered_map<uint32_t, std::string>;
+
+	/**
+	 * @brief Binds every form in a_editorIDs whose editor ID names a record in a_records.
+	 */
+	void Rebuild(Records& a_records, const EditorIDs& a_editorIDs)
+	{
+		byFormID.clear();
+		byFormID.reserve(std::min(a_records.size(), a_editorIDs.size()));
+		for (const auto& [formID, editorID] : a_editorIDs) {
+			if (auto it = a_records.find(editorID); it != a_records.end()) {
+				byFormID.emplace(formID, &it->second);
+			}
+		}
+	}
+
+	/**
+	 * @brief Binds a_formID to the record named a_editorID, or unbinds it when there is none.
+	 */
+	void Resolve(Records& a_records, RE::FormID a_formID, const std::string& a_editorID)
+	{
+		if (auto it = a_records.find(a_editorID); it != a_records.end()) {
+			byFormID.insert_or_assign(a_formID, &it->second);
+		} else {
+			byFormID.erase(a_formID);
+		}
+	}
+
+	Record* Find(RE::FormID a_formID) const
+	{
+		auto it = byFormID.find(a_formID);
+		return it != byFormID.end() ? it->second : nullptr;
+	}
+
+	void Clear() { byFormID.clear(); }
+	size_t GetSize() const { return byFormID.size(); }
+
+private:
+	ankerl::unordered_dense::map<RE::FormID, Record*> byFormID;
+};
@@ -1,5 +1,6 @@
 #include "D3D.h"
 
+#include "ShaderCache.h"
 #include "State.h"
 #include "Utils/Format.h"
 
@@ -87,47 +88,11 @@ namespace Util
 		Resource->SetPrivateData(WKPDID_D3DDebugObjectNameT, len, buffer);
 	}
 
-	struct CustomInclude : public ID3DInclude
-	{
-		HRESULT Open([[maybe_unused]] D3D_INCLUDE_TYPE IncludeType, LPCSTR pFileName, [[maybe_unused]] LPCVOID pParentData, LPCVOID* ppData, UINT* pBytes) override
-		{
-			std::filesystem::path filePath = pFileName;
-			filePath = L"Data\\Shaders" / filePath;
-
-			std::ifstream file(filePath, std::ios::binary);
-			if (!file.is_open()) {
-				*ppData = NULL;
-				*pBytes = 0;
-				return E_FAIL;
-			}
+	// archive for the shaders compiled here; it shares the main cache's folder, version check and include graph
+	static constexpr const char* FeatureShaderArchive = "FeatureShaders";
 
-			// Get filesize
-			file.seekg(0, std::ios::end);
-			UINT size = static_cast<UINT>(file.tellg());
-			file.seekg(0, std::ios::beg);
-
-			// Create buffer and read file
-			char* data = new char[size];
-			file.read(data, size);
-			*ppData = data;
-			*pBytes = size;
-			return S_OK;
-		}
-
-		HRESULT Close(LPCVOID pData) override
-		{
-			if (pData)
-				delete[] pData;
-			return S_OK;
-		}
-	};
-
-	ID3D11DeviceChild* CompileShader(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program)
+	static ID3DBlob* CompileShaderBlob(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program)
 	{
-		auto& device = State::GetSingleton()->device;
-
-		CustomInclude include;
-
 		// Build defines (aka convert vector->D3DCONSTANT array)
 		std::vector<D3D_SHADER_MACRO> macros;
 		std::string str = Util::WStringToString(FilePath);
@@ -176,46 +141,129 @@ namespace Util
 		// Compiler setup
 		uint32_t flags = !State::GetSingleton()->IsDeveloperMode() ? (D3DCOMPILE_ENABLE_STRICTNESS | D3DCOMPILE_OPTIMIZATION_LEVEL3) : D3DCOMPILE_DEBUG;
 
-		ID3DBlob* shaderBlob;
-		ID3DBlob* shaderErrors;
+		// check diskcache
+		auto& cache = SIE::ShaderCache::Instance();
+		auto& dependencies = cache.GetDependencies();
+		const auto definesHash = SIE::ShaderDependencies::HashDefines(macros.data(), flags);
+		const auto diskKey = SIE::ShaderDependencies::HashContent(
+			std::format("{}:{}:{}:{:X}", SIE::ShaderDependencies::NormalizePath(FilePath), Program, ProgramType, definesHash));
+		auto archive = cache.IsDiskCache() ? cache.GetDiskArchive(FeatureShaderArchive) : nullptr;
+		if (archive) {
+			std::chrono::system_clock::time_point diskCacheTime;
+			if (auto diskBlob = archive->Read(diskKey, diskCacheTime)) {
+				if (dependencies.IsCurrent(FeatureShaderArchive, diskKey, definesHash)) {
+					logger::debug("Loaded {} from disk cache", str);
+					return diskBlob;
+				}
+				logger::debug("Diskcached {} depends on changed sources or defines", str);
+				diskBlob->Release();
+			}
+		}
 
-		if (!std::filesystem::exists(FilePath)) {
+		SIE::ShaderIncludeHandler include(FilePath, L"Data\\Shaders");
+		std::string source;
+		if (!include.ReadRoot(source)) {
 			logger::error("Failed to compile shader; {} does not exist", str);
 			return nullptr;
 		}
+
+		ID3DBlob* shaderBlob = nullptr;
+		ID3DBlob* shaderErrors = nullptr;
+
 		logger::debug("Compiling {} with {}", str, DefinesToString(macros));
-		if (FAILED(D3DCompileFromFile(FilePath, macros.data(), &include, Program, ProgramType, flags, 0, &shaderBlob, &shaderErrors))) {
+		if (FAILED(D3DCompile(source.data(), source.size(), str.c_str(), macros.data(), &include, Program, ProgramType, flags, 0, &shaderBlob, &shaderErrors))) {
 			logger::warn("Shader compilation failed:\n\n{}", shaderErrors ? static_cast<char*>(shaderErrors->GetBufferPointer()) : "Unknown error");
+			if (shaderErrors)
+				shaderErrors->Release();
+			if (shaderBlob)
+				shaderBlob->Release();
 			return nullptr;
 		}
-		if (shaderErrors)
+		if (shaderErrors) {
 			logger::debug("Shader logs:\n{}", static_cast<char*>(shaderErrors->GetBufferPointer()));
+			shaderErrors->Release();
+		}
+
+		// save shader to disk
+		if (archive) {
+			if (archive->Write(diskKey, shaderBlob)) {
+				dependencies.Record(FeatureShaderArchive, diskKey, definesHash, include.GetFiles());
+			} else {
+				logger::error("Failed to save {} to disk cache", str);
+			}
+		}
+		return shaderBlob;
+	}
+
+	ID3D11DeviceChild* CompileShader(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program)
+	{
+		auto& device = State::GetSingleton()->device;
+
+		ID3DBlob* shaderBlob = CompileShaderBlob(FilePath, Defines, ProgramType, Program);
+		if (!shaderBlob)
+			return nullptr;
+
+		ID3D11DeviceChild* result = nullptr;
 		if (!_stricmp(ProgramType, "ps_5_0")) {
 			ID3D11PixelShader* regShader;
 			device->CreatePixelShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader);
-			return regShader;
+			result = regShader;
 		} else if (!_stricmp(ProgramType, "vs_5_0")) {
 			ID3D11VertexShader* regShader;
 			device->CreateVertexShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader);
-			return regShader;
+			result = regShader;
 		} else if (!_stricmp(ProgramType, "hs_5_0")) {
 			ID3D11HullShader* regShader;
 			device->CreateHullShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader);
-			return regShader;
+			result = regShader;
 		} else if (!_stricmp(ProgramType, "ds_5_0")) {
 			ID3D11DomainShader* regShader;
 			device->CreateDomainShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader);
-			return regShader;
+			result = regShader;
 		} else if (!_stricmp(ProgramType, "cs_5_0")) {
 			ID3D11ComputeShader* regShader;
 			DX::ThrowIfFailed(device->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader));
-			return regShader;
+			result = regShader;
 		} else if (!_stricmp(ProgramType, "cs_4_0")) {
 			ID3D11ComputeShader* regShader;
 			DX::ThrowIfFailed(device->CreateComputeShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), nullptr, &regShader));
-			return regShader;
+			result = regShader;
 		}
 
-		return nullptr;
+		shaderBlob->Release();
+		return result;
+	}
+
+	std::shared_future<ID3D11DeviceChild*> CompileShaderAsync(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program)
+	{
+		// the task outlives the caller's strings, so it keeps copies
+		struct Request
+		{
+			std::wstring path;
+			std::vector<std::pair<std::string, std::optional<std::string>>> defines;
+			std::string programType;
+			std::string program;
+		};
+		Request request{ FilePath, {}, ProgramType, Program };
+		for (auto& [name, definition] : Defines) {
+			request.defines.emplace_back(name ? name : "", definition ? std::optional<std::string>(definition) : std::nullopt);
+		}
+
+		return SIE::ShaderCache::Instance().compilationPool.submit([request = std::move(request)]() {
+			std::vector<std::pair<const char*, const char*>> defines;
+			for (auto& [name, definition] : request.defines) {
+				defines.emplace_back(name.c_str(), definition ? definition->c_str() : nullptr);
+			}
+			return CompileShader(request.path.c_str(), defines, request.programType.c_str(), request.program.c_str());
+		}).share();
+	}
+
+	ID3D11DeviceChild* TakeShader(std::shared_future<ID3D11DeviceChild*>& a_task)
+	{
+		if (!a_task.valid())
+			return nullptr;
+		auto shader = a_task.get();
+		a_task = {};
+		return shader;
 	}
 }  // namespace Util
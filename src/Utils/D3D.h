@@ -1,5 +1,7 @@
 #pragma once
 
+#include <future>
+
 namespace Util
 {
 	ID3D11ShaderResourceView* GetSRVFromRTV(ID3D11RenderTargetView* a_rtv);
@@ -8,5 +10,19 @@ namespace Util
 	std::string GetNameFromRTV(ID3D11RenderTargetView* a_rtv);
 	void SetResourceName(ID3D11DeviceChild* Resource, const char* Format, ...);
 
+	/**
+	 * @brief Compiles a shader, or loads it from the disk cache if its sources and defines are unchanged.
+	 * @return The shader (owned by caller) or nullptr on failure.
+	 */
 	ID3D11DeviceChild* CompileShader(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program = "main");
+	/**
+	 * @brief Queues CompileShader() on the shader cache's thread pool so a feature can compile its shaders
+	 * in parallel ahead of first use.
+	 */
+	std::shared_future<ID3D11DeviceChild*> CompileShaderAsync(const wchar_t* FilePath, const std::vector<std::pair<const char*, const char*>>& Defines, const char* ProgramType, const char* Program = "main");
+	/**
+	 * @brief Waits for a shader queued by CompileShaderAsync() and resets the task.
+	 * @return The shader (owned by caller), or nullptr if nothing was queued or compilation failed.
+	 */
+	ID3D11DeviceChild* TakeShader(std::shared_future<ID3D11DeviceChild*>& a_task);
 }  // namespace Util
@@ -28,6 +28,26 @@ namespace Util
 		Dest.m[2][3] = Source.translate.z;
 	}
 
+	float3 GetCellWaterColor(RE::TESObjectCELL* a_cell)
+	{
+		RE::TESWaterForm* water = nullptr;
+		if (auto extraCellWaterType = a_cell->extraList.GetByType<RE::ExtraCellWaterType>())
+			water = extraCellWaterType->water;
+		if (!water)
+			if (auto worldSpace = RE::TES::GetSingleton()->GetRuntimeData2().worldSpace)
+				water = worldSpace->worldWater;
+		if (!water)
+			return float3(1.0f, 1.0f, 1.0f);
+
+		float3 color = { float(water->data.deepWaterColor.red) + float(water->data.shallowWaterColor.red),
+			float(water->data.deepWaterColor.green) + float(water->data.shallowWaterColor.green),
+			float(water->data.deepWaterColor.blue) + float(water->data.shallowWaterColor.blue) };
+
+		color /= 255.0f;
+		color *= 0.5f;
+		return color;
+	}
+
 	float4 TryGetWaterData(float offsetX, float offsetY)
 	{
 		if (RE::BSGraphics::RendererShadowState::GetSingleton()) {
@@ -36,52 +56,14 @@ namespace Util
 				position.x += offsetX;
 				position.y += offsetY;
 				if (auto cell = tes->GetCell(position)) {
-					float4 data = float4(1.0f, 1.0f, 1.0f, -FLT_MAX);
-
-					bool extraCellWater = false;
-
-					if (auto extraCellWaterType = cell->extraList.GetByType<RE::ExtraCellWaterType>()) {
-						if (auto water = extraCellWaterType->water) {
-							{
-								data = { float(water->data.deepWaterColor.red) + float(water->data.shallowWaterColor.red),
-									float(water->data.deepWaterColor.green) + float(water->data.shallowWaterColor.green),
-									float(water->data.deepWaterColor.blue) + float(water->data.shallowWaterColor.blue) };
-
-								data.x /= 255.0f;
-								data.y /= 255.0f;
-								data.z /= 255.0f;
-
-								data.x *= 0.5;
-								data.y *= 0.5;
-								data.z *= 0.5;
-								extraCellWater = true;
-							}
-						}
-					}
-
-					if (!extraCellWater) {
-						if (auto worldSpace = tes->GetRuntimeData2().worldSpace) {
-							if (auto water = worldSpace->worldWater) {
-								data = { float(water->data.deepWaterColor.red) + float(water->data.shallowWaterColor.red),
-									float(water->data.deepWaterColor.green) + float(water->data.shallowWaterColor.green),
-									float(water->data.deepWaterColor.blue) + float(water->data.shallowWaterColor.blue) };
-
-								data.x /= 255.0f;
-								data.y /= 255.0f;
-								data.z /= 255.0f;
-
-								data.x *= 0.5;
-								data.y *= 0.5;
-								data.z *= 0.5;
-							}
-						}
-					}
+					float3 color = GetCellWaterColor(cell);
+					float4 data = float4(color.x, color.y, color.z, 0.0f);
 
 					if (auto sky = RE::Sky::GetSingleton()) {
-						const auto& color = sky->skyColor[RE::TESWeather::ColorTypes::kWaterMultiplier];
-						data.x *= color.red;
-						data.y *= color.green;
-						data.z *= color.blue;
+						const auto& skyColor = sky->skyColor[RE::TESWeather::ColorTypes::kWaterMultiplier];
+						data.x *= skyColor.red;
+						data.y *= skyColor.green;
+						data.z *= skyColor.blue;
 					}
 
 					data.w = cell->GetExteriorWaterHeight() - position.z;
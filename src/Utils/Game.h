@@ -19,6 +19,10 @@ namespace Util
 {
 	void StoreTransform3x4NoScale(DirectX::XMFLOAT3X4& Dest, const RE::NiTransform& Source);
 
+	/**
+	 * @brief Average of the deep and shallow colors of the water in a cell, before the weather's water multiplier.
+	 */
+	float3 GetCellWaterColor(RE::TESObjectCELL* a_cell);
 	float4 TryGetWaterData(float offsetX, float offsetY);
 	float4 GetCameraData();
 	bool GetTemporal();
@@ -0,0 +1,55 @@
+// helpers for splitting per-frame work across a thread pool
+
+#pragma once
+
+#include "BS_thread_pool.hpp"
+
+namespace Util
+{
+	/**
+	 * @brief Calls a_func(i) for every i below a_count, in blocks shared between the calling thread and a_pool.
+	 *
+	 * The calling thread works through the blocks too and only waits for blocks a pool thread has
+	 * already started, so it never waits behind whatever else is queued on the pool. Pool tasks that
+	 * start after every block was taken return without touching a_func.
+	 */
+	template <class F>
+	void ParallelFor(BS::thread_pool& a_pool, size_t a_count, size_t a_blockSize, F&& a_func)
+	{
+		const size_t blockCount = (a_count + a_blockSize - 1) / a_blockSize;
+		if (blockCount <= 1) {
+			for (size_t i = 0; i < a_count; ++i) {
+				a_func(i);
+			}
+			return;
+		}
+
+		struct Blocks
+		{
+			std::atomic<size_t> next = 0;
+			std::atomic<size_t> done = 0;
+		};
+		auto blocks = std::make_shared<Blocks>();  // outlives this call for pool tasks that start late
+		auto* func = &a_func;
+		auto work = [blocks, func, a_count, a_blockSize, blockCount]() {
+			for (size_t block = blocks->next++; block < blockCount; block = blocks->next++) {
+				const size_t end = std::min(a_count, (block + 1) * a_blockSize);
+				for (size_t i = block * a_blockSize; i < end; ++i) {
+					(*func)(i);
+				}
+				if (++blocks->done == blockCount) {
+					blocks->done.notify_all();
+				}
+			}
+		};
+
+		const size_t helpers = std::min<size_t>(blockCount - 1, a_pool.get_thread_count());
+		for (size_t i = 0; i < helpers; ++i) {
+			a_pool.push_task(work);
+		}
+		work();
+		for (size_t done = blocks->done; done < blockCount; done = blocks->done) {
+			blocks->done.wait(done);
+		}
+	}
+}
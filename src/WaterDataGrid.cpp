@@ -0,0 +1,85 @@
+#include "WaterDataGrid.h"
+
+#include "Util.h"
+
+void WaterDataGrid::GetWaterData(float4 (&o_waterData)[Size * Size])
+{
+	auto tes = RE::TES::GetSingleton();
+	if (!RE::BSGraphics::RendererShadowState::GetSingleton() || !tes) {
+		std::fill(std::begin(o_waterData), std::end(o_waterData), float4(1.0f, 1.0f, 1.0f, -FLT_MAX));
+		return;
+	}
+
+	const auto position = Util::GetEyePosition(0);
+	const auto cellX = static_cast<int32_t>(std::floor(position.x / CellSize));
+	const auto cellY = static_cast<int32_t>(std::floor(position.y / CellSize));
+	const auto currentWorldSpace = tes->GetRuntimeData2().worldSpace;
+
+	if (invalidated.exchange(false) || worldSpace != currentWorldSpace) {
+		tiles.fill({});
+		worldSpace = currentWorldSpace;
+	}
+
+	// Keep the tiles still inside the grid after the eye crossed into another cell
+	if (cellX != originX || cellY != originY) {
+		std::array<Tile, Size * Size> shifted{};
+		for (int k = 0; k < Size; k++) {
+			for (int i = 0; i < Size; i++) {
+				const int oldI = i + cellX - originX;
+				const int oldK = k + cellY - originY;
+				if (oldI >= 0 && oldI < Size && oldK >= 0 && oldK < Size)
+					shifted[i + k * Size] = tiles[oldI + oldK * Size];
+			}
+		}
+		tiles = shifted;
+		originX = cellX;
+		originY = cellY;
+	}
+
+	float3 waterMultiplier = { 1.0f, 1.0f, 1.0f };
+	if (auto sky = RE::Sky::GetSingleton()) {
+		const auto& color = sky->skyColor[RE::TESWeather::ColorTypes::kWaterMultiplier];
+		waterMultiplier = { color.red, color.green, color.blue };
+	}
+
+	for (int k = 0; k < Size; k++) {
+		for (int i = 0; i < Size; i++) {
+			auto& tile = tiles[i + k * Size];
+			if (!tile.loaded) {
+				tile.loaded = true;
+				auto tilePosition = position;
+				tilePosition.x += (float)(i - Radius) * CellSize;
+				tilePosition.y += (float)(k - Radius) * CellSize;
+				auto cell = tes->GetCell(tilePosition);
+				tile.hasCell = cell != nullptr;
+				if (cell) {
+					tile.color = Util::GetCellWaterColor(cell);
+					tile.waterHeight = cell->GetExteriorWaterHeight();
+				}
+			}
+
+			if (tile.hasCell) {
+				const auto color = tile.color * waterMultiplier;
+				o_waterData[i + k * Size] = float4(color.x, color.y, color.z, tile.waterHeight - position.z);
+			} else {
+				o_waterData[i + k * Size] = float4(1.0f, 1.0f, 1.0f, -FLT_MAX);
+			}
+		}
+	}
+}
+
+void WaterDataGrid::Register()
+{
+	if (auto scripts = RE::ScriptEventSourceHolder::GetSingleton()) {
+		scripts->AddEventSink<RE::TESCellAttachDetachEvent>(this);
+		logger::info("Registered {}", typeid(*this).name());
+	} else {
+		logger::error("Script event source not found");
+	}
+}
+
+RE::BSEventNotifyControl WaterDataGrid::ProcessEvent(const RE::TESCellAttachDetachEvent*, RE::BSTEventSource<RE::TESCellAttachDetachEvent>*)
+{
+	invalidated = true;
+	return RE::BSEventNotifyControl::kContinue;
+}
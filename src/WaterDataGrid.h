@@ -0,0 +1,47 @@
+#pragma once
+
+/**
+ * Water color and height of the 5x5 cells around the eye, for SharedDataCB::WaterData.
+ *
+ * Looking up a cell's water walks its extra data every time, so the results are kept per cell
+ * and only cells that scrolled into the grid are looked up. Everything is dropped when cells
+ * attach or detach or the worldspace changes. The weather's water multiplier and the eye
+ * height are still applied every frame.
+ */
+class WaterDataGrid : public RE::BSTEventSink<RE::TESCellAttachDetachEvent>
+{
+public:
+	static WaterDataGrid* GetSingleton()
+	{
+		static WaterDataGrid singleton;
+		return &singleton;
+	}
+
+	static constexpr int Radius = 2;
+	static constexpr int Size = Radius * 2 + 1;
+	static constexpr float CellSize = 4096.0f;
+
+	/**
+	 * @brief Fills o_waterData with tile (i, k) at index (i + Radius) + (k + Radius) * Size.
+	 */
+	void GetWaterData(float4 (&o_waterData)[Size * Size]);
+
+	void Register();
+
+	RE::BSEventNotifyControl ProcessEvent(const RE::TESCellAttachDetachEvent* a_event, RE::BSTEventSource<RE::TESCellAttachDetachEvent>* a_eventSource) override;
+
+private:
+	struct Tile
+	{
+		bool loaded = false;
+		bool hasCell = false;
+		float3 color;
+		float waterHeight = 0.0f;
+	};
+
+	std::array<Tile, Size * Size> tiles{};
+	int32_t originX = 0;
+	int32_t originY = 0;
+	RE::TESWorldSpace* worldSpace = nullptr;
+	std::atomic<bool> invalidated = true;  // set from the main thread by attach and detach events
+};
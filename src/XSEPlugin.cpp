@@ -9,6 +9,7 @@
 #include "TruePBR.h"
 #include "Upscaling.h"
 #include "VariableCache.h"
+#include "WaterDataGrid.h"
 
 #include "ENB/ENBSeriesAPI.h"
 
@@ -116,12 +117,14 @@ void MessageHandler(SKSE::MessagingInterface::Message* message)
 			if (errors.empty()) {
 				VariableCache::GetSingleton()->OnDataLoaded();
 				FrameAnnotations::OnDataLoaded();
+				WaterDataGrid::GetSingleton()->Register();
 
 				auto& shaderCache = SIE::ShaderCache::Instance();
 				shaderCache.menuLoaded = true;
 				while (shaderCache.IsCompiling() && !shaderCache.backgroundCompilation) {
 					std::this_thread::sleep_for(100ms);
 				}
+				shaderCache.SubmitDeferredPrewarm();
 
 				if (shaderCache.IsDiskCache()) {
 					shaderCache.WriteDiskCacheInfo();
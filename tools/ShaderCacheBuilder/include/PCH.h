@@ -0,0 +1,83 @@
+#pragma once
+
+// Stand-in for the plugin's PCH so the disk cache sources build without CommonLibSSE.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <Windows.h>
+#endif
+
+#include <d3dcommon.h>
+
+#include <ankerl/unordered_dense.h>
+#include <spdlog/spdlog.h>
+
+using namespace std::literals;
+
+namespace logger
+{
+	using spdlog::critical;
+	using spdlog::debug;
+	using spdlog::error;
+	using spdlog::info;
+	using spdlog::trace;
+	using spdlog::warn;
+}
+
+namespace REL
+{
+	// only what Utils/Format.cpp needs
+	class Version
+	{
+	public:
+		constexpr Version(uint16_t a_major = 0, uint16_t a_minor = 0, uint16_t a_patch = 0, uint16_t a_build = 0) noexcept :
+			parts{ a_major, a_minor, a_patch, a_build } {}
+
+		std::string string(std::string_view a_separator = "-"sv) const
+		{
+			std::string result;
+			for (size_t i = 0; i < parts.size(); ++i) {
+				if (i > 0) {
+					result += a_separator;
+				}
+				result += std::to_string(parts[i]);
+			}
+			return result;
+		}
+
+	private:
+		std::array<uint16_t, 4> parts;
+	};
+}
+
+template <>
+struct ankerl::unordered_dense::hash<std::string>
+{
+	using is_transparent = void;  // enable heterogeneous overloads
+	using is_avalanching = void;  // mark class as high quality avalanching hash
+
+	[[nodiscard]] auto operator()(std::string_view str) const noexcept -> uint64_t
+	{
+		return ankerl::unordered_dense::hash<std::string_view>{}(str);
+	}
+};
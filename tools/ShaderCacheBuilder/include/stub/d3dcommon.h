@@ -0,0 +1,54 @@
+#pragma once
+
+// Minimal d3dcommon.h for platforms without the Windows SDK. Only declares what the shader
+// archive, include handler and compiler backends use.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+using HRESULT = int32_t;
+using UINT = uint32_t;
+using SIZE_T = size_t;
+using LPCSTR = const char*;
+using LPVOID = void*;
+using LPCVOID = const void*;
+
+#define S_OK ((HRESULT)0)
+#define E_FAIL ((HRESULT)0x80004005)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000E)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#ifndef __stdcall
+#	define __stdcall
+#endif
+
+struct D3D_SHADER_MACRO
+{
+	LPCSTR Name;
+	LPCSTR Definition;
+};
+
+enum D3D_INCLUDE_TYPE
+{
+	D3D_INCLUDE_LOCAL = 0,
+	D3D_INCLUDE_SYSTEM = 1,
+};
+
+struct ID3DInclude
+{
+	virtual HRESULT __stdcall Open(D3D_INCLUDE_TYPE a_includeType, LPCSTR a_fileName, LPCVOID a_parentData, LPCVOID* o_data, UINT* o_bytes) = 0;
+	virtual HRESULT __stdcall Close(LPCVOID a_data) = 0;
+};
+
+struct ID3DBlob
+{
+	virtual LPVOID __stdcall GetBufferPointer() = 0;
+	virtual SIZE_T __stdcall GetBufferSize() = 0;
+	virtual uint32_t __stdcall AddRef() = 0;
+	virtual uint32_t __stdcall Release() = 0;
+
+protected:
+	virtual ~ID3DBlob() = default;
+};
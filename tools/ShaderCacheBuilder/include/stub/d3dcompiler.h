@@ -0,0 +1,50 @@
+#pragma once
+
+// Minimal d3dcompiler.h for platforms without the Windows SDK. D3DCreateBlob is the only
+// function provided; compiling needs a backend that does not depend on D3DCompile.
+
+#include <new>
+
+#include "d3dcommon.h"
+
+#define D3DCOMPILE_DEBUG (1 << 0)
+#define D3DCOMPILE_SKIP_OPTIMIZATION (1 << 2)
+#define D3DCOMPILE_OPTIMIZATION_LEVEL3 (1 << 15)
+
+namespace D3DStub
+{
+	class Blob final : public ID3DBlob
+	{
+	public:
+		explicit Blob(size_t a_size) :
+			data(new uint8_t[a_size]), size(a_size) {}
+
+		LPVOID __stdcall GetBufferPointer() override { return data; }
+		SIZE_T __stdcall GetBufferSize() override { return size; }
+		uint32_t __stdcall AddRef() override { return ++refCount; }
+		uint32_t __stdcall Release() override
+		{
+			const auto count = --refCount;
+			if (count == 0) {
+				delete this;
+			}
+			return count;
+		}
+
+	private:
+		~Blob() override { delete[] data; }
+
+		uint8_t* data;
+		size_t size;
+		std::atomic<uint32_t> refCount = 1;
+	};
+}
+
+inline HRESULT D3DCreateBlob(SIZE_T a_size, ID3DBlob** o_blob)
+{
+	if (!o_blob) {
+		return E_FAIL;
+	}
+	*o_blob = new (std::nothrow) D3DStub::Blob(a_size);
+	return *o_blob ? S_OK : E_OUTOFMEMORY;
+}
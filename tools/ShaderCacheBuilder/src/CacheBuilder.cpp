@@ -0,0 +1,217 @@
+#include "CacheBuilder.h"
+
+#include "ShaderArchive.h"
+#include "ShaderDependencies.h"
+
+namespace ShaderCacheBuilder
+{
+	namespace SCacheBuilder
+	{
+		static constexpr auto ShaderFolder = "Data/Shaders";
+		static constexpr auto CacheFolder = "Data/ShaderCache";
+		static constexpr auto OutputMarker = ".shadercachebuilder";  // output folders are wiped, so only ones created by the builder are reused
+
+		static std::wstring GetArchivePath(std::string_view a_name)
+		{
+			return std::filesystem::path(fmt::format("{}/{}", CacheFolder, a_name)).wstring();
+		}
+	}
+
+	CacheBuilder::CacheBuilder(Options a_options, const CompilerBackend& a_backend) :
+		options(std::move(a_options)), backend(a_backend)
+	{
+	}
+
+	bool CacheBuilder::Run()
+	{
+		if (!manifest.Load(options.manifest)) {
+			return false;
+		}
+		if (manifest.GetPermutations().empty()) {
+			logger::error("{} has no permutations; run the game with the disk cache enabled first", options.manifest.string());
+			return false;
+		}
+		AddDerivedPermutations();
+		if (!StageSources()) {
+			return false;
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		CompilePermutations();
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		logger::info("Compiled {} of {} permutations with the {} backend in {:.1f}s, {} failed", compiled.load(), manifest.GetPermutations().size(),
+			backend.GetName(), seconds, failed.load());
+
+		// keep the manifest with the cache so the next build does not need the game either
+		if (!manifest.Save(fmt::format("{}/Permutations.bin", SCacheBuilder::CacheFolder))) {
+			return false;
+		}
+		return WriteCacheInfo() && failed == 0;
+	}
+
+	void CacheBuilder::AddDerivedPermutations()
+	{
+		// True PBR grass is drawn with permutations vanilla never requests; enumerate them for every
+		// grass shader the game recorded, so a manifest from a session without PBR grass still covers them
+		std::vector<std::pair<std::string, std::string>> grassShaders;
+		for (const auto& permutation : manifest.GetPermutations()) {
+			if (permutation.type == SIE::ShaderType::Grass) {
+				std::pair shader{ manifest.GetString(permutation.archive), manifest.GetString(permutation.source) };
+				if (std::ranges::find(grassShaders, shader) == grassShaders.end()) {
+					grassShaders.push_back(std::move(shader));
+				}
+			}
+		}
+
+		const auto count = manifest.GetPermutations().size();
+		for (const auto& [archive, source] : grassShaders) {
+			for (auto descriptor : SIE::ShaderPermutations::GetTruePBRPixelDescriptors(SIE::ShaderType::Grass)) {
+				manifest.Add(archive, source, SIE::ShaderType::Grass, SIE::ShaderClass::Pixel, descriptor);
+			}
+		}
+		if (manifest.GetPermutations().size() > count) {
+			logger::info("Added {} True PBR permutations the manifest did not record", manifest.GetPermutations().size() - count);
+		}
+	}
+
+	bool CacheBuilder::StageSources()
+	{
+		std::error_code ec;
+		options.output = std::filesystem::absolute(options.output, ec);
+		if (!std::filesystem::is_empty(options.output, ec) && !ec && !std::filesystem::exists(options.output / SCacheBuilder::OutputMarker, ec)) {
+			logger::error("{} is not empty and was not created by the cache builder; refusing to overwrite it", options.output.string());
+			return false;
+		}
+		std::filesystem::create_directories(options.output, ec);
+		std::ofstream(options.output / SCacheBuilder::OutputMarker).close();
+
+		for (const auto& folder : { SCacheBuilder::ShaderFolder, SCacheBuilder::CacheFolder }) {
+			std::filesystem::remove_all(options.output / folder, ec);
+			if (ec) {
+				logger::error("Failed to clear {}: {}", (options.output / folder).string(), ec.message());
+				return false;
+			}
+		}
+
+		const auto shaders = options.output / SCacheBuilder::ShaderFolder;
+		std::filesystem::create_directories(shaders, ec);
+		for (const auto& source : options.sources) {
+			const auto folder = source / "Shaders";
+			if (!std::filesystem::is_directory(folder, ec)) {
+				logger::warn("{} has no Shaders folder; skipping", source.string());
+				continue;
+			}
+			std::filesystem::copy(folder, shaders, std::filesystem::copy_options::recursive | std::filesystem::copy_options::overwrite_existing, ec);
+			if (ec) {
+				logger::error("Failed to copy {}: {}", folder.string(), ec.message());
+				return false;
+			}
+		}
+
+		std::filesystem::create_directories(options.output / SCacheBuilder::CacheFolder, ec);
+		std::filesystem::current_path(options.output, ec);
+		if (ec) {
+			logger::error("Failed to enter {}: {}", options.output.string(), ec.message());
+			return false;
+		}
+		return true;
+	}
+
+	void CacheBuilder::CompilePermutations()
+	{
+		const auto& permutations = manifest.GetPermutations();
+
+		ankerl::unordered_dense::map<uint32_t, std::unique_ptr<SIE::ShaderArchive>> archives;
+		for (const auto& permutation : permutations) {
+			auto& archive = archives[permutation.archive];
+			if (!archive) {
+				archive = std::make_unique<SIE::ShaderArchive>(SCacheBuilder::GetArchivePath(manifest.GetString(permutation.archive)));
+				archive->Open();
+			}
+		}
+		SIE::ShaderDependencies dependencies{ SCacheBuilder::GetArchivePath("Dependencies") };
+
+		const auto flags = manifest.GetFlags();
+		std::atomic<size_t> next = 0;
+		auto worker = [&]() {
+			for (size_t index = next++; index < permutations.size(); index = next++) {
+				const auto& permutation = permutations[index];
+				const auto& archiveName = manifest.GetString(permutation.archive);
+				const auto path = fmt::format("{}/{}.hlsl", SCacheBuilder::ShaderFolder, manifest.GetString(permutation.source));
+				const auto defines = manifest.GetDefines(permutation);
+				const auto shaderClass = static_cast<uint32_t>(permutation.shaderClass);
+
+				SIE::ShaderIncludeHandler includeHandler(path);
+				std::string source;
+				std::string errors;
+				ID3DBlob* shaderBlob = nullptr;
+				if (!includeHandler.ReadRoot(source)) {
+					errors = fmt::format("{} does not exist", path);
+				} else {
+					shaderBlob = backend.Compile(source, path, defines.data(), &includeHandler, SIE::ShaderPermutations::GetProfile(permutation.shaderClass), flags, errors);
+				}
+				if (!shaderBlob) {
+					logger::error("Failed to compile {}:{}:{:X}: {}", archiveName, shaderClass, permutation.descriptor, errors);
+					++failed;
+					continue;
+				}
+
+				const auto key = SIE::PermutationManifest::GetArchiveKey(shaderClass, permutation.descriptor);
+				if (archives.at(permutation.archive)->Write(key, shaderBlob)) {
+					dependencies.Record(archiveName, key, SIE::ShaderDependencies::HashDefines(defines.data(), flags), includeHandler.GetFiles());
+					const auto count = ++compiled;
+					if (count % 1000 == 0) {
+						logger::info("Compiled {} of {} permutations", count, permutations.size());
+					}
+				} else {
+					logger::error("Failed to save {}:{}:{:X} to disk cache", archiveName, shaderClass, permutation.descriptor);
+					++failed;
+				}
+				shaderBlob->Release();
+			}
+		};
+
+		const uint32_t threadCount = std::max(1u, options.threads ? options.threads : std::thread::hardware_concurrency());
+		logger::info("Compiling {} permutations on {} threads", permutations.size(), threadCount);
+		{
+			std::vector<std::jthread> threads;
+			for (uint32_t i = 0; i < threadCount; ++i) {
+				threads.emplace_back(worker);
+			}
+		}
+
+		for (auto& [name, archive] : archives) {
+			archive->Compact();
+		}
+		dependencies.Save();
+	}
+
+	bool CacheBuilder::WriteCacheInfo()
+	{
+		const auto path = fmt::format("{}/Info.ini", SCacheBuilder::CacheFolder);
+		if (!backend.ProducesBytecode()) {
+			logger::warn("The {} backend does not produce bytecode; not writing {} so the game ignores this cache", backend.GetName(), path);
+			return true;
+		}
+		if (manifest.GetCacheInfo().empty()) {
+			logger::error("{} has no cache info; save the disk cache in game once to record it", options.manifest.string());
+			return false;
+		}
+
+		std::ofstream ini(path, std::ios::trunc);
+		std::string_view section;
+		for (const auto& value : manifest.GetCacheInfo()) {
+			if (value.section != section) {
+				ini << (section.empty() ? "" : "\n") << '[' << value.section << "]\n";
+				section = value.section;
+			}
+			ini << value.key << " = " << value.value << '\n';
+		}
+		if (!ini) {
+			logger::error("Failed to write {}", path);
+			return false;
+		}
+		logger::info("Saved disk cache info");
+		return true;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "CompilerBackend.h"
+#include "PermutationManifest.h"
+
+namespace ShaderCacheBuilder
+{
+	/**
+	 * @brief Rebuilds the plugin's disk cache from a permutation manifest.
+	 *
+	 * The shader sources are staged into `<output>/Data/Shaders` and the cache is written to
+	 * `<output>/Data/ShaderCache`, with the working directory set to the output folder so the
+	 * include graph records the same relative paths as the game does. The output folder can be
+	 * installed like any other mod.
+	 */
+	class CacheBuilder
+	{
+	public:
+		struct Options
+		{
+			std::filesystem::path manifest;
+			std::filesystem::path output;
+			std::vector<std::filesystem::path> sources;  // folders containing a Shaders folder, later ones take precedence
+			uint32_t threads = 0;                         // 0 uses one per hardware thread
+		};
+
+		CacheBuilder(Options a_options, const CompilerBackend& a_backend);
+
+		/**
+		 * @brief Compiles every permutation of the manifest.
+		 * @return true if the cache was written and every permutation compiled.
+		 */
+		bool Run();
+
+	private:
+		/**
+		 * @brief Adds the permutations ShaderPermutations derives without the game.
+		 */
+		void AddDerivedPermutations();
+		bool StageSources();
+		void CompilePermutations();
+		bool WriteCacheInfo();
+
+		Options options;
+		const CompilerBackend& backend;
+		SIE::PermutationManifest manifest;
+
+		std::atomic<uint32_t> compiled = 0;
+		std::atomic<uint32_t> failed = 0;
+	};
+}
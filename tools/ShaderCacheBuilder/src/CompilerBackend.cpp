@@ -0,0 +1,125 @@
+#include "CompilerBackend.h"
+
+#include <d3dcompiler.h>
+
+#include "ShaderDependencies.h"
+
+namespace ShaderCacheBuilder
+{
+	namespace SCompilerBackend
+	{
+		/**
+		 * @brief Backend that walks the include graph like the compiler would and stores a hash of
+		 * the inputs instead of bytecode.
+		 *
+		 * Used to test enumeration, define merging, key generation and the archive format on
+		 * platforms without D3DCompile. Conditionals are not evaluated, so every include that exists
+		 * is followed and missing ones are skipped.
+		 */
+		class StubBackend final : public CompilerBackend
+		{
+		public:
+			std::string_view GetName() const override { return "stub"; }
+			bool ProducesBytecode() const override { return false; }
+
+			ID3DBlob* Compile(std::string_view a_source, const std::string& a_name, const D3D_SHADER_MACRO* a_defines, ID3DInclude* a_include,
+				const std::string& a_profile, uint32_t a_flags, std::string& o_errors) const override
+			{
+				std::string inputs(a_profile);
+				inputs += '\n';
+				inputs += a_source;
+				ankerl::unordered_dense::set<uint64_t> included;
+				if (!ReadIncludes(a_source, nullptr, a_include, included, inputs, o_errors, 0)) {
+					o_errors = fmt::format("{}: {}", a_name, o_errors);
+					return nullptr;
+				}
+
+				const std::array<uint64_t, 2> hashes{ SIE::ShaderDependencies::HashContent(inputs), SIE::ShaderDependencies::HashDefines(a_defines, a_flags) };
+				ID3DBlob* blob = nullptr;
+				if (FAILED(D3DCreateBlob(sizeof(hashes), &blob))) {
+					o_errors = "out of memory";
+					return nullptr;
+				}
+				memcpy(blob->GetBufferPointer(), hashes.data(), sizeof(hashes));
+				return blob;
+			}
+
+		private:
+			static constexpr uint32_t MaxIncludeDepth = 32;
+
+			// a file included twice is skipped the second time, as if it had include guards
+			static bool ReadIncludes(std::string_view a_source, LPCVOID a_parent, ID3DInclude* a_include, ankerl::unordered_dense::set<uint64_t>& a_included,
+				std::string& o_inputs, std::string& o_errors, uint32_t a_depth)
+			{
+				if (a_depth > MaxIncludeDepth) {
+					o_errors = "includes nested too deeply";
+					return false;
+				}
+				for (size_t pos = a_source.find("#include"); pos != std::string_view::npos; pos = a_source.find("#include", pos + 1)) {
+					const auto lineStart = a_source.rfind('\n', pos);
+					const auto prefix = a_source.substr(lineStart == std::string_view::npos ? 0 : lineStart + 1, pos - (lineStart == std::string_view::npos ? 0 : lineStart + 1));
+					if (prefix.find("//") != std::string_view::npos) {
+						continue;
+					}
+					const auto open = a_source.find_first_of("\"<", pos);
+					const auto lineEnd = a_source.find('\n', pos);
+					if (open == std::string_view::npos || open > lineEnd) {
+						continue;
+					}
+					const auto close = a_source.find(a_source[open] == '"' ? '"' : '>', open + 1);
+					if (close == std::string_view::npos || close > lineEnd) {
+						continue;
+					}
+
+					const std::string fileName(a_source.substr(open + 1, close - open - 1));
+					const auto type = a_source[open] == '"' ? D3D_INCLUDE_LOCAL : D3D_INCLUDE_SYSTEM;
+					LPCVOID data = nullptr;
+					UINT bytes = 0;
+					if (FAILED(a_include->Open(type, fileName.c_str(), a_parent, &data, &bytes))) {
+						continue;  // most likely behind a define of an uninstalled feature
+					}
+					const std::string_view content(static_cast<const char*>(data), bytes);
+					if (!a_included.insert(SIE::ShaderDependencies::HashContent(content)).second) {
+						a_include->Close(data);
+						continue;
+					}
+					o_inputs += '\n';
+					o_inputs += content;
+					const bool result = ReadIncludes(content, data, a_include, a_included, o_inputs, o_errors, a_depth + 1);
+					a_include->Close(data);
+					if (!result) {
+						return false;
+					}
+				}
+				return true;
+			}
+		};
+	}
+
+	std::unique_ptr<CompilerBackend> CreateStubBackend()
+	{
+		return std::make_unique<SCompilerBackend::StubBackend>();
+	}
+
+	std::unique_ptr<CompilerBackend> CompilerBackend::Create(std::string_view a_name)
+	{
+#ifdef _WIN32
+		if (a_name == "d3d") {
+			return CreateD3DBackend();
+		}
+#endif
+		if (a_name == "stub") {
+			return CreateStubBackend();
+		}
+		return nullptr;
+	}
+
+	std::string_view CompilerBackend::GetDefaultName()
+	{
+#ifdef _WIN32
+		return "d3d";
+#else
+		return "stub";
+#endif
+	}
+}
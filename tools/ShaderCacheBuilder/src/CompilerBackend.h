@@ -0,0 +1,50 @@
+#pragma once
+
+namespace ShaderCacheBuilder
+{
+	/**
+	 * @brief Turns one preprocessed permutation into the blob stored in the disk cache.
+	 *
+	 * Backends are called from several worker threads at once and must not keep state between calls.
+	 */
+	class CompilerBackend
+	{
+	public:
+		virtual ~CompilerBackend() = default;
+
+		virtual std::string_view GetName() const = 0;
+		/**
+		 * @brief Whether the blobs are real bytecode the game can load.
+		 *
+		 * Caches built by other backends are only useful to test the pipeline, so they are not
+		 * given the Info.ini that would make the plugin accept them.
+		 */
+		virtual bool ProducesBytecode() const = 0;
+
+		/**
+		 * @brief Compiles a shader.
+		 * @param a_source Contents of the root shader.
+		 * @param a_name Path of the root shader, used in diagnostics.
+		 * @param a_defines Null terminated macro list.
+		 * @param a_include Resolves includes and records them as dependencies.
+		 * @param a_profile Target profile, e.g. ps_5_0.
+		 * @param a_flags D3DCOMPILE flags.
+		 * @param o_errors Receives compiler output.
+		 * @return The compiled blob (owned by caller) or nullptr on failure.
+		 */
+		virtual ID3DBlob* Compile(std::string_view a_source, const std::string& a_name, const D3D_SHADER_MACRO* a_defines, ID3DInclude* a_include,
+			const std::string& a_profile, uint32_t a_flags, std::string& o_errors) const = 0;
+
+		/**
+		 * @brief Creates a backend by name.
+		 * @return nullptr if the backend is unknown or unavailable on this platform.
+		 */
+		static std::unique_ptr<CompilerBackend> Create(std::string_view a_name);
+		static std::string_view GetDefaultName();
+	};
+
+	std::unique_ptr<CompilerBackend> CreateStubBackend();
+#ifdef _WIN32
+	std::unique_ptr<CompilerBackend> CreateD3DBackend();
+#endif
+}
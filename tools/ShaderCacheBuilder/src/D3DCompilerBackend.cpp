@@ -0,0 +1,58 @@
+#include "CompilerBackend.h"
+
+#include <d3dcompiler.h>
+
+namespace ShaderCacheBuilder
+{
+	namespace SD3DCompilerBackend
+	{
+		/**
+		 * @brief Backend that compiles with D3DCompile and strips the result like the plugin does.
+		 */
+		class D3DBackend final : public CompilerBackend
+		{
+		public:
+			std::string_view GetName() const override { return "d3d"; }
+			bool ProducesBytecode() const override { return true; }
+
+			ID3DBlob* Compile(std::string_view a_source, const std::string& a_name, const D3D_SHADER_MACRO* a_defines, ID3DInclude* a_include,
+				const std::string& a_profile, uint32_t a_flags, std::string& o_errors) const override
+			{
+				ID3DBlob* shaderBlob = nullptr;
+				ID3DBlob* errorBlob = nullptr;
+				const auto result = D3DCompile(a_source.data(), a_source.size(), a_name.c_str(), a_defines, a_include, "main", a_profile.c_str(), a_flags, 0,
+					&shaderBlob, &errorBlob);
+				if (errorBlob) {
+					o_errors.assign(static_cast<const char*>(errorBlob->GetBufferPointer()), errorBlob->GetBufferSize());
+					errorBlob->Release();
+				}
+				if (FAILED(result)) {
+					if (shaderBlob) {
+						shaderBlob->Release();
+					}
+					return nullptr;
+				}
+
+				// strip debug info, debug builds keep it for shader debuggers
+				if (!(a_flags & D3DCOMPILE_DEBUG)) {
+					ID3DBlob* strippedShaderBlob = nullptr;
+
+					const uint32_t stripFlags = D3DCOMPILER_STRIP_DEBUG_INFO |
+					                            D3DCOMPILER_STRIP_TEST_BLOBS |
+					                            D3DCOMPILER_STRIP_PRIVATE_DATA;
+
+					if (SUCCEEDED(D3DStripShader(shaderBlob->GetBufferPointer(), shaderBlob->GetBufferSize(), stripFlags, &strippedShaderBlob))) {
+						std::swap(shaderBlob, strippedShaderBlob);
+						strippedShaderBlob->Release();
+					}
+				}
+				return shaderBlob;
+			}
+		};
+	}
+
+	std::unique_ptr<CompilerBackend> CreateD3DBackend()
+	{
+		return std::make_unique<SD3DCompilerBackend::D3DBackend>();
+	}
+}
@@ -0,0 +1,83 @@
+#include "CacheBuilder.h"
+
+namespace
+{
+	void PrintUsage()
+	{
+		fmt::print(
+			"Usage: ShaderCacheBuilder --manifest <Permutations.bin> --output <folder> --source <folder>... [options]\n"
+			"\n"
+			"  --manifest <file>   permutation manifest saved by the plugin next to the disk cache\n"
+			"  --output <folder>   folder the Data/Shaders and Data/ShaderCache trees are written to\n"
+			"  --source <folder>   folder containing a Shaders folder, e.g. package; may be repeated\n"
+			"  --features <folder> adds every subfolder as a source, e.g. features\n"
+			"  --threads <count>   number of compile threads, defaults to one per hardware thread\n"
+			"  --backend <name>    d3d (Windows only) or stub, defaults to {}\n"
+			"  --verbose           logs debug messages\n",
+			ShaderCacheBuilder::CompilerBackend::GetDefaultName());
+	}
+}
+
+int main(int a_argc, char* a_argv[])
+{
+	ShaderCacheBuilder::CacheBuilder::Options options;
+	std::string backendName(ShaderCacheBuilder::CompilerBackend::GetDefaultName());
+	spdlog::set_pattern("[%H:%M:%S.%e] [%l] %v");
+
+	const std::span args(a_argv + 1, a_argc - 1);
+	for (size_t i = 0; i < args.size(); ++i) {
+		const std::string_view arg = args[i];
+		if (arg == "--verbose") {
+			spdlog::set_level(spdlog::level::debug);
+			continue;
+		}
+		if (arg == "--help" || i + 1 == args.size()) {
+			PrintUsage();
+			return arg == "--help" ? 0 : 1;
+		}
+
+		const std::string_view value = args[++i];
+		if (arg == "--manifest") {
+			options.manifest = value;
+		} else if (arg == "--output") {
+			options.output = value;
+		} else if (arg == "--source") {
+			options.sources.emplace_back(value);
+		} else if (arg == "--features") {
+			std::vector<std::filesystem::path> features;
+			std::error_code ec;
+			for (const auto& entry : std::filesystem::directory_iterator(value, ec)) {
+				if (entry.is_directory()) {
+					features.push_back(entry.path());
+				}
+			}
+			if (ec) {
+				logger::error("Failed to list {}: {}", value, ec.message());
+				return 1;
+			}
+			std::ranges::sort(features);  // directory order is unspecified, keep builds reproducible
+			options.sources.insert(options.sources.end(), features.begin(), features.end());
+		} else if (arg == "--threads") {
+			options.threads = static_cast<uint32_t>(std::strtoul(value.data(), nullptr, 10));
+		} else if (arg == "--backend") {
+			backendName = value;
+		} else {
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (options.manifest.empty() || options.output.empty() || options.sources.empty()) {
+		PrintUsage();
+		return 1;
+	}
+
+	const auto backend = ShaderCacheBuilder::CompilerBackend::Create(backendName);
+	if (!backend) {
+		logger::error("Compiler backend {} is not available on this platform", backendName);
+		return 1;
+	}
+
+	ShaderCacheBuilder::CacheBuilder builder(std::move(options), *backend);
+	return builder.Run() ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Minimal checks and timing for the test and benchmark executables; each returns Tests::Result() from main.
+
+namespace Tests
+{
+	inline int failures = 0;
+
+	inline void Fail(const char* a_expr, const char* a_file, int a_line)
+	{
+		std::fprintf(stderr, "%s:%d: check failed: %s\n", a_file, a_line, a_expr);
+		++failures;
+	}
+
+	inline int Result()
+	{
+		if (failures)
+			std::fprintf(stderr, "%d check(s) failed\n", failures);
+		return failures ? 1 : 0;
+	}
+
+	/**
+	 * @brief Runs a_func a_iterations times after one warm-up call and prints the mean duration in microseconds.
+	 * @return Mean duration in microseconds.
+	 */
+	template <class F>
+	double Bench(std::string_view a_name, uint a_iterations, F&& a_func)
+	{
+		a_func();
+		const auto start = std::chrono::steady_clock::now();
+		for (uint i = 0; i < a_iterations; ++i)
+			a_func();
+		const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		const double mean = elapsed / std::max(a_iterations, 1u);
+		std::printf("%-48.*s %12.2f us\n", (int)a_name.size(), a_name.data(), mean);
+		return mean;
+	}
+}
+
+#define CHECK(expr)                                    \
+	do {                                               \
+		if (!(expr))                                   \
+			Tests::Fail(#expr, __FILE__, __LINE__);    \
+	} while (false)
@@ -0,0 +1,180 @@
+#pragma once
+
+// Stand-in for the plugin's PCH so the platform-neutral plugin sources build without CommonLibSSE.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <ankerl/unordered_dense.h>
+
+#if __has_include(<SimpleIni.h>)
+#	include <SimpleIni.h>
+#endif
+
+using namespace std::literals;
+
+using uint = uint32_t;
+
+// stand-in for DirectX::SimpleMath::Vector3, with the operations the neutral sources use
+struct float3
+{
+	float x = 0.0f;
+	float y = 0.0f;
+	float z = 0.0f;
+
+	float3& operator+=(const float3& a_rhs)
+	{
+		x += a_rhs.x;
+		y += a_rhs.y;
+		z += a_rhs.z;
+		return *this;
+	}
+	float3& operator/=(float a_rhs) { return *this = *this / a_rhs; }
+	float3 operator*(float a_rhs) const { return { x * a_rhs, y * a_rhs, z * a_rhs }; }
+	float3 operator/(float a_rhs) const { return { x / a_rhs, y / a_rhs, z / a_rhs }; }
+	bool operator==(const float3&) const = default;
+
+	static float Distance(const float3& a_lhs, const float3& a_rhs)
+	{
+		const float dx = a_lhs.x - a_rhs.x, dy = a_lhs.y - a_rhs.y, dz = a_lhs.z - a_rhs.z;
+		return std::sqrt(dx * dx + dy * dy + dz * dz);
+	}
+};
+
+// stand-ins for the game and EASTL types the plugin sources touch
+namespace RE
+{
+	using FormID = uint32_t;
+
+	struct NiPoint3
+	{
+		float x = 0.0f;
+		float y = 0.0f;
+		float z = 0.0f;
+
+		NiPoint3 operator-(const NiPoint3& a_rhs) const { return { x - a_rhs.x, y - a_rhs.y, z - a_rhs.z }; }
+		float Length() const { return std::sqrt(x * x + y * y + z * z); }
+	};
+
+	struct NiColor
+	{
+		float red = 0.0f;
+		float green = 0.0f;
+		float blue = 0.0f;
+
+		constexpr NiColor() = default;
+		constexpr NiColor(float a_red, float a_green, float a_blue) :
+			red(a_red), green(a_green), blue(a_blue) {}
+		constexpr NiColor(uint32_t a_hexValue) :
+			red(((a_hexValue >> 16) & 0xFF) / 255.0f), green(((a_hexValue >> 8) & 0xFF) / 255.0f), blue((a_hexValue & 0xFF) / 255.0f) {}
+	};
+}
+
+namespace REL
+{
+	// only what Utils/Format.cpp needs
+	class Version
+	{
+	public:
+		constexpr Version(uint16_t a_major = 0, uint16_t a_minor = 0, uint16_t a_patch = 0, uint16_t a_build = 0) noexcept :
+			parts{ a_major, a_minor, a_patch, a_build } {}
+
+		std::string string(std::string_view a_separator = "-"sv) const
+		{
+			std::string result;
+			for (size_t i = 0; i < parts.size(); ++i) {
+				if (i > 0) {
+					result += a_separator;
+				}
+				result += std::to_string(parts[i]);
+			}
+			return result;
+		}
+
+	private:
+		std::array<uint16_t, 4> parts;
+	};
+}
+
+namespace RE::BSGraphics
+{
+	struct State
+	{
+		uint32_t frameCount = 0;
+
+		static State* GetSingleton()
+		{
+			static State singleton;
+			return &singleton;
+		}
+	};
+}
+
+namespace eastl
+{
+	template <class Key, class Value>
+	using unordered_map = std::unordered_map<Key, Value>;
+}
+
+// the plugin logs through spdlog; here the messages are dropped without formatting
+namespace logger
+{
+	template <class... Args>
+	void trace(Args&&...)
+	{}
+	template <class... Args>
+	void debug(Args&&...)
+	{}
+	template <class... Args>
+	void info(Args&&...)
+	{}
+	template <class... Args>
+	void warn(Args&&...)
+	{}
+	template <class... Args>
+	void error(Args&&...)
+	{}
+}
+
+// ClibUtil's directory scan: the files of a_folder with the extension whose path contains a_suffix, sorted
+namespace clib_util::distribution
+{
+	inline std::vector<std::string> get_configs(std::string_view a_folder, std::string_view a_suffix, std::string_view a_extension)
+	{
+		std::vector<std::string> configs;
+		for (const auto& entry : std::filesystem::directory_iterator(a_folder)) {
+			if (const auto& path = entry.path(); entry.exists() && path.extension() == a_extension) {
+				if (auto fileName = path.string(); fileName.rfind(a_suffix) != std::string::npos) {
+					configs.push_back(std::move(fileName));
+				}
+			}
+		}
+		std::ranges::sort(configs);
+		return configs;
+	}
+}
@@ -0,0 +1,226 @@
+#include "Check.h"
+
+#include "Features/LightLimitFix/ClusterCulling.h"
+
+// Checks the CPU mirror of the cluster shaders against what ClusterBuildingCS and ClusterCullingCS work out
+// to for a plain perspective projection: every cluster is a slice of the view frustum, so its AABB has a
+// closed form, and lights placed inside, outside or across clusters have known light lists.
+
+namespace
+{
+	using ClusterCulling::ClusterAABB;
+	using ClusterCulling::Config;
+	using ClusterCulling::Light;
+	using ClusterCulling::LightGrid;
+	using ClusterCulling::Matrix;
+	using ClusterCulling::Vector3;
+
+	constexpr float Near = 10.0f;
+	constexpr float Far = 10000.0f;
+
+	// inverse of the D3D left-handed perspective projection with the given scales, for row vectors
+	Matrix MakeInvProjection(float a_xScale, float a_yScale)
+	{
+		Matrix result{};
+		result.m[0][0] = 1.0f / a_xScale;
+		result.m[1][1] = 1.0f / a_yScale;
+		result.m[2][3] = -(Far - Near) / (Near * Far);
+		result.m[3][2] = 1.0f;
+		result.m[3][3] = 1.0f / Near;
+		return result;
+	}
+
+	bool IsClose(float a_value, float a_expected)
+	{
+		return std::abs(a_value - a_expected) <= 1e-4f * std::max(1.0f, std::abs(a_expected));
+	}
+
+	// the slice between two depths of the frustum through a tile, bounded by its eight corners
+	ClusterAABB GetExpectedCluster(const Config& a_config, float a_xScale, float a_yScale, uint a_x, uint a_y, uint a_z)
+	{
+		const auto [sizeX, sizeY, sizeZ] = a_config.clusterSize;
+		const double depths[2] = { Near * std::pow(double(Far) / Near, double(a_z) / sizeZ), Near * std::pow(double(Far) / Near, double(a_z + 1) / sizeZ) };
+		const double clipX[2] = { 2.0 * a_x / sizeX - 1.0, 2.0 * (a_x + 1) / sizeX - 1.0 };
+		const double clipY[2] = { 1.0 - 2.0 * (a_y + 1) / sizeY, 1.0 - 2.0 * a_y / sizeY };
+
+		constexpr double Max = std::numeric_limits<double>::max();
+		double minPoint[3] = { Max, Max, Max };
+		double maxPoint[3] = { -Max, -Max, -Max };
+		for (double depth : depths) {
+			for (double x : clipX) {
+				for (double y : clipY) {
+					const double corner[3] = { x * depth / a_xScale, y * depth / a_yScale, depth };
+					for (int axis = 0; axis < 3; axis++) {
+						minPoint[axis] = std::min(minPoint[axis], corner[axis]);
+						maxPoint[axis] = std::max(maxPoint[axis], corner[axis]);
+					}
+				}
+			}
+		}
+		return { { float(minPoint[0]), float(minPoint[1]), float(minPoint[2]), 0.0f }, { float(maxPoint[0]), float(maxPoint[1]), float(maxPoint[2]), 0.0f } };
+	}
+
+	Vector3 GetCenter(const ClusterAABB& a_cluster)
+	{
+		return { (a_cluster.minPoint.x + a_cluster.maxPoint.x) * 0.5f, (a_cluster.minPoint.y + a_cluster.maxPoint.y) * 0.5f, (a_cluster.minPoint.z + a_cluster.maxPoint.z) * 0.5f };
+	}
+
+	// the culling shader's test against the closed-form clusters, in light order and cut off at the limit
+	std::vector<uint> GetExpectedLights(const Config& a_config, const ClusterAABB& a_cluster, std::span<const Light> a_lights)
+	{
+		auto intersects = [&](const Vector3& a_position, float a_radius) {
+			const double dx = std::clamp<double>(a_position.x, a_cluster.minPoint.x, a_cluster.maxPoint.x) - a_position.x;
+			const double dy = std::clamp<double>(a_position.y, a_cluster.minPoint.y, a_cluster.maxPoint.y) - a_position.y;
+			const double dz = std::clamp<double>(a_position.z, a_cluster.minPoint.z, a_cluster.maxPoint.z) - a_position.z;
+			return dx * dx + dy * dy + dz * dz <= double(a_radius) * a_radius;
+		};
+		std::vector<uint> result;
+		for (uint i = 0; i < a_lights.size() && result.size() < a_config.maxClusterLights; i++) {
+			if (intersects(a_lights[i].positionVS[0], a_lights[i].radius) || (a_config.stereo && intersects(a_lights[i].positionVS[1], a_lights[i].radius))) {
+				result.push_back(i);
+			}
+		}
+		return result;
+	}
+
+	std::vector<uint> GetClusterLights(const std::vector<LightGrid>& a_grid, const std::vector<uint>& a_lightIndices, size_t a_cluster)
+	{
+		const auto& cell = a_grid[a_cluster];
+		return { a_lightIndices.begin() + cell.offset, a_lightIndices.begin() + cell.offset + cell.lightCount };
+	}
+
+	void TestBuildClusters()
+	{
+		const Config config{ { 8, 5, 6 }, 64, false };
+		const float xScale = 0.75f, yScale = 1.3f;
+		const Matrix invProj[2] = { MakeInvProjection(xScale, yScale), MakeInvProjection(xScale, yScale) };
+
+		std::vector<ClusterAABB> clusters;
+		ClusterCulling::BuildClusters(config, invProj, Near, Far, clusters);
+		CHECK(clusters.size() == 8 * 5 * 6);
+
+		for (uint z = 0; z < 6; z++) {
+			for (uint y = 0; y < 5; y++) {
+				for (uint x = 0; x < 8; x++) {
+					const auto& cluster = clusters[x + y * 8 + z * 8 * 5];
+					const auto expected = GetExpectedCluster(config, xScale, yScale, x, y, z);
+					CHECK(IsClose(cluster.minPoint.x, expected.minPoint.x) && IsClose(cluster.minPoint.y, expected.minPoint.y) && IsClose(cluster.minPoint.z, expected.minPoint.z));
+					CHECK(IsClose(cluster.maxPoint.x, expected.maxPoint.x) && IsClose(cluster.maxPoint.y, expected.maxPoint.y) && IsClose(cluster.maxPoint.z, expected.maxPoint.z));
+					CHECK(cluster.minPoint.w == 0.0f && cluster.maxPoint.w == 0.0f);
+				}
+			}
+		}
+
+		// the first row of tiles is the top of the screen
+		CHECK(clusters[0].maxPoint.y > 0.0f && clusters[4 * 8].minPoint.y < 0.0f);
+
+		// in stereo a tile covers what it covers in either eye
+		Config stereo = config;
+		stereo.stereo = true;
+		const Matrix stereoInvProj[2] = { MakeInvProjection(xScale, yScale), MakeInvProjection(xScale * 2.0f, yScale) };
+		std::vector<ClusterAABB> stereoClusters;
+		ClusterCulling::BuildClusters(stereo, stereoInvProj, Near, Far, stereoClusters);
+		for (size_t i = 0; i < clusters.size(); i++) {
+			CHECK(stereoClusters[i].minPoint.x <= clusters[i].minPoint.x && stereoClusters[i].maxPoint.x >= clusters[i].maxPoint.x);
+			CHECK(stereoClusters[i].minPoint.z == clusters[i].minPoint.z && stereoClusters[i].maxPoint.z == clusters[i].maxPoint.z);
+		}
+	}
+
+	void TestCullLights()
+	{
+		const Config config{ { 4, 4, 4 }, 3, false };
+		const Matrix invProj[2] = { MakeInvProjection(1.0f, 1.0f), MakeInvProjection(1.0f, 1.0f) };
+		std::vector<ClusterAABB> clusters;
+		ClusterCulling::BuildClusters(config, invProj, Near, Far, clusters);
+
+		const size_t target = 1 + 2 * 4 + 3 * 16;
+		std::vector<Light> lights = {
+			{ { GetCenter(clusters[target]), GetCenter(clusters[target]) }, 0.01f },  // its own cluster, and neighbours whose AABB reaches it
+			{ { Vector3{ 0.0f, 0.0f, -500.0f }, Vector3{ 0.0f, 0.0f, -500.0f } }, 100.0f },  // behind the camera
+			{ { Vector3{ 0.0f, 0.0f, 0.0f }, Vector3{ 0.0f, 0.0f, 0.0f } }, 1e6f },  // everywhere
+		};
+
+		std::vector<LightGrid> grid;
+		std::vector<uint> lightIndices;
+		ClusterCulling::Statistics statistics;
+		ClusterCulling::CullLights(config, clusters, lights, grid, lightIndices, &statistics);
+
+		std::vector<ClusterAABB> expected;
+		for (uint z = 0; z < 4; z++)
+			for (uint y = 0; y < 4; y++)
+				for (uint x = 0; x < 4; x++)
+					expected.push_back(GetExpectedCluster(config, 1.0f, 1.0f, x, y, z));
+		auto checkLists = [&](const Config& a_config, std::span<const Light> a_lights) {
+			for (size_t i = 0; i < clusters.size(); i++) {
+				CHECK(GetClusterLights(grid, lightIndices, i) == GetExpectedLights(a_config, expected[i], a_lights));
+			}
+		};
+		checkLists(config, lights);
+		CHECK(GetClusterLights(grid, lightIndices, target) == (std::vector<uint>{ 0, 2 }));
+		CHECK(GetClusterLights(grid, lightIndices, 0) == std::vector<uint>{ 2 });
+		CHECK(statistics.lightCount == 3 && statistics.clusterCount == 64);
+		CHECK(statistics.emptyClusters == 0 && statistics.maxClusterLights == 2 && statistics.overflowedClusters == 0);
+
+		// lists are laid out in cluster order
+		for (size_t i = 1; i < grid.size(); i++) {
+			CHECK(grid[i].offset == grid[i - 1].offset + grid[i - 1].lightCount);
+		}
+
+		// lights past the limit are dropped in order, as the shader stops at MAX_CLUSTER_LIGHTS
+		lights.push_back(lights[2]);
+		lights.push_back(lights[2]);
+		statistics = {};
+		ClusterCulling::CullLights(config, clusters, lights, grid, lightIndices, &statistics);
+		checkLists(config, lights);
+		CHECK(GetClusterLights(grid, lightIndices, target) == (std::vector<uint>{ 0, 2, 3 }));
+		CHECK(GetClusterLights(grid, lightIndices, 0) == (std::vector<uint>{ 2, 3, 4 }));
+		uint overflowed = 0, dropped = 0;
+		for (const auto& cluster : expected) {
+			const auto all = static_cast<uint>(GetExpectedLights({ config.clusterSize, 64, false }, cluster, lights).size());
+			overflowed += all > config.maxClusterLights;
+			dropped += all - std::min(all, config.maxClusterLights);
+		}
+		CHECK(statistics.overflowedClusters == overflowed && statistics.droppedLights == dropped && statistics.maxClusterLights == 4);
+
+		// the second eye's position only counts in stereo
+		const Light rightEyeOnly{ { Vector3{ 0.0f, 0.0f, -500.0f }, GetCenter(clusters[target]) }, 0.01f };
+		ClusterCulling::CullLights(config, clusters, std::span(&rightEyeOnly, 1), grid, lightIndices);
+		CHECK(lightIndices.empty());
+		Config stereo = config;
+		stereo.stereo = true;
+		ClusterCulling::CullLights(stereo, clusters, std::span(&rightEyeOnly, 1), grid, lightIndices);
+		checkLists(stereo, std::span(&rightEyeOnly, 1));
+		CHECK(GetClusterLights(grid, lightIndices, target) == std::vector<uint>{ 0 });
+	}
+
+	// one frame at 1080p with the default 64 pixel tiles and 16 slices
+	void BenchCullLights()
+	{
+		const Config config{ { 30, 17, 16 }, 128, false };
+		const Matrix invProj[2] = { MakeInvProjection(0.75f, 1.33f), MakeInvProjection(0.75f, 1.33f) };
+		std::vector<ClusterAABB> clusters;
+		Tests::Bench("BuildClusters 30x17x16", 20, [&]() { ClusterCulling::BuildClusters(config, invProj, Near, Far, clusters); });
+
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for (uint lightCount : { 64u, 256u, 1024u }) {
+			std::vector<Light> lights(lightCount);
+			for (auto& light : lights) {
+				const float depth = 50.0f + std::abs(unit(rng)) * 4000.0f;
+				const Vector3 position{ unit(rng) * depth / 0.75f, unit(rng) * depth / 1.33f, depth };
+				light = { { position, position }, 100.0f + std::abs(unit(rng)) * 400.0f };
+			}
+			std::vector<LightGrid> grid;
+			std::vector<uint> lightIndices;
+			Tests::Bench("CullLights 30x17x16, " + std::to_string(lightCount) + " lights", 3, [&]() { ClusterCulling::CullLights(config, clusters, lights, grid, lightIndices); });
+		}
+	}
+}
+
+int main()
+{
+	TestBuildClusters();
+	TestCullLights();
+	BenchCullLights();
+	return Tests::Result();
+}
@@ -0,0 +1,172 @@
+#include "Check.h"
+
+#include "TruePBR/PBRRecordIndex.h"
+
+// Times resolving 10k TruePBR texture set configs to FormIDs as DataLoaded does, and record lookups by
+// FormID against the editor ID path they replaced. Checks both paths, and bindings kept up to date by
+// editor IDs set afterwards, find the same records.
+
+namespace
+{
+	struct Record
+	{
+		float roughnessScale = 1.0f;
+	};
+
+	using Index = PBRRecordIndex<Record>;
+
+	constexpr uint TextureSetCount = 10000;
+	constexpr uint MaterialObjectCount = 2000;
+	constexpr uint OtherFormCount = 30000;  // land textures, lighting templates and weathers have editor IDs too
+	constexpr uint UnboundCount = 200;      // configs for forms no loaded plugin has
+
+	struct Scene
+	{
+		Index::Records textureSets;
+		Index::Records materialObjects;
+		Index::EditorIDs editorIDs;
+		std::vector<RE::FormID> lookups;  // what cells streaming in ask for, bound or not
+	};
+
+	std::string GetName(const char* a_prefix, uint a_index)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "%s%05u", a_prefix, a_index);
+		return name;
+	}
+
+	Scene MakeScene()
+	{
+		Scene scene;
+		std::mt19937 rng(20);
+		auto addForm = [&](std::string a_editorID) {
+			RE::FormID formID;
+			do {
+				formID = (rng() % 0xFE) << 24 | (rng() & 0xFFFFFF);  // any load order slot
+			} while (scene.editorIDs.contains(formID));
+			scene.editorIDs.emplace(formID, std::move(a_editorID));
+			return formID;
+		};
+
+		for (uint i = 0; i < TextureSetCount + UnboundCount; ++i) {
+			scene.textureSets.emplace(GetName("PBRTextureSet_", i), Record{ static_cast<float>(i) });
+			if (i < TextureSetCount) {
+				scene.lookups.push_back(addForm(GetName("PBRTextureSet_", i)));
+			}
+		}
+		for (uint i = 0; i < MaterialObjectCount; ++i) {
+			scene.materialObjects.emplace(GetName("PBRMaterial_", i), Record{ static_cast<float>(i) });
+			scene.lookups.push_back(addForm(GetName("PBRMaterial_", i)));
+		}
+		for (uint i = 0; i < OtherFormCount; ++i) {
+			const auto formID = addForm(GetName("LandscapeOrWeather_", i));
+			if (i % 3 == 0) {
+				scene.lookups.push_back(formID);
+			}
+		}
+		std::ranges::shuffle(scene.lookups, rng);
+		return scene;
+	}
+
+	// the lookup GetPBRTextureSetData made before resolution: the editor ID through the GetFormEditorID
+	// hook's map, then the config by name
+	Record* FindByName(Index::Records& a_records, const Index::EditorIDs& a_editorIDs, RE::FormID a_formID)
+	{
+		const auto editorID = a_editorIDs.find(a_formID);
+		auto it = a_records.find(editorID != a_editorIDs.end() ? editorID->second.c_str() : "");
+		return it != a_records.end() ? &it->second : nullptr;
+	}
+
+	void CheckMatches(Index& a_index, Index::Records& a_records, const Index::EditorIDs& a_editorIDs)
+	{
+		uint bound = 0;
+		for (const auto& [formID, editorID] : a_editorIDs) {
+			const auto* record = a_index.Find(formID);
+			CHECK(record == FindByName(a_records, a_editorIDs, formID));
+			bound += record != nullptr;
+		}
+		CHECK(bound == a_index.GetSize());
+		CHECK(a_index.Find(0xFF000800) == nullptr);  // runtime forms have no editor ID
+	}
+
+	void Run(Scene& a_scene)
+	{
+		std::printf("%zu texture set and %zu material object configs, %zu editor IDs\n", a_scene.textureSets.size(), a_scene.materialObjects.size(), a_scene.editorIDs.size());
+
+		Index textureSets;
+		Index materialObjects;
+		Tests::Bench("  resolve", 20, [&]() {
+			textureSets.Rebuild(a_scene.textureSets, a_scene.editorIDs);
+			materialObjects.Rebuild(a_scene.materialObjects, a_scene.editorIDs);
+		});
+		CHECK(textureSets.GetSize() == TextureSetCount);
+		CHECK(materialObjects.GetSize() == MaterialObjectCount);
+		CheckMatches(textureSets, a_scene.textureSets, a_scene.editorIDs);
+		CheckMatches(materialObjects, a_scene.materialObjects, a_scene.editorIDs);
+
+		uint found = 0;
+		const double nameTime = Tests::Bench("  lookups by editor ID", 20, [&]() {
+			for (const auto formID : a_scene.lookups) {
+				found += FindByName(a_scene.textureSets, a_scene.editorIDs, formID) != nullptr;
+			}
+		});
+		const double formTime = Tests::Bench("  lookups by FormID", 20, [&]() {
+			for (const auto formID : a_scene.lookups) {
+				found += textureSets.Find(formID) != nullptr;
+			}
+		});
+		std::printf("  %zu lookups, %.2fx the time by FormID\n", a_scene.lookups.size(), formTime / std::max(nameTime, 1e-3));
+		CHECK(found == 42 * TextureSetCount);  // 21 runs of each, every bound texture set looked up once per run
+	}
+
+	// editor IDs set after data load keep the table what a full rebuild gives
+	void TestResolve(Scene& a_scene)
+	{
+		Index textureSets;
+		textureSets.Rebuild(a_scene.textureSets, a_scene.editorIDs);
+
+		std::mt19937 rng(21);
+		std::vector<RE::FormID> formIDs;
+		for (const auto& [formID, editorID] : a_scene.editorIDs) {
+			formIDs.push_back(formID);
+		}
+		for (uint i = 0; i < 2000; ++i) {
+			const RE::FormID formID = i % 4 == 0 ? 0x05000000 + i : formIDs[rng() % formIDs.size()];
+			std::string editorID;
+			switch (rng() % 3) {
+			case 0:
+				editorID = GetName("PBRTextureSet_", rng() % (TextureSetCount + UnboundCount));
+				break;
+			case 1:
+				editorID = GetName("LandscapeOrWeather_", rng() % OtherFormCount);
+				break;
+			default:
+				break;  // cleared
+			}
+			auto& stored = a_scene.editorIDs[formID];
+			stored = std::move(editorID);
+			textureSets.Resolve(a_scene.textureSets, formID, stored);
+		}
+
+		Index rebuilt;
+		rebuilt.Rebuild(a_scene.textureSets, a_scene.editorIDs);
+		CHECK(textureSets.GetSize() == rebuilt.GetSize());
+		for (const auto& [formID, editorID] : a_scene.editorIDs) {
+			CHECK(textureSets.Find(formID) == rebuilt.Find(formID));
+		}
+		CheckMatches(textureSets, a_scene.textureSets, a_scene.editorIDs);
+	}
+}
+
+int main()
+{
+	auto scene = MakeScene();
+	Run(scene);
+	TestResolve(scene);
+
+	Index empty;
+	Index::Records records;
+	empty.Rebuild(records, scene.editorIDs);
+	CHECK(empty.GetSize() == 0 && empty.Find(scene.lookups.front()) == nullptr);
+	return Tests::Result();
+}
@@ -0,0 +1,350 @@
+#include "Check.h"
+
+#include "Features/LightLimitFix/ParticleLightClustering.h"
+
+// Compares particle light clustering with the greedy pass it replaced, on light sets recorded in
+// game with "Record Particle Lights" (pass the files or folders as arguments) or, without any, on
+// synthetic torch and candle scenes. Also checks the grid against a brute-force search, and that
+// neither the order of the particles nor the threads the tiles are built on change the lights.
+
+namespace
+{
+	using ParticleLightClustering::Cluster;
+	using ParticleLightClustering::Sample;
+
+	constexpr float Threshold = 32.0f;
+
+	struct LightSet
+	{
+		std::string name;
+		std::vector<Sample> samples;
+	};
+
+	bool CanMerge(const Cluster& a_sum, const Sample& a_sample)
+	{
+		const auto count = static_cast<float>(a_sum.count);
+		return std::abs(a_sum.radius / count - a_sample.radius) + float3::Distance(a_sum.position / count, a_sample.position) <= Threshold;
+	}
+
+	void Add(Cluster& a_sum, const Sample& a_sample)
+	{
+		a_sum.position += a_sample.position;
+		a_sum.radius += a_sample.radius;
+		a_sum.color += a_sample.color;
+		a_sum.count++;
+	}
+
+	Cluster Average(Cluster a_sum)
+	{
+		a_sum.position /= static_cast<float>(a_sum.count);
+		a_sum.radius /= static_cast<float>(a_sum.count);
+		return a_sum;
+	}
+
+	// the pass UpdateLights used before: one open light, flushed when a particle does not fit it
+	void BuildGreedy(std::span<const Sample> a_samples, std::vector<Cluster>& o_clusters)
+	{
+		o_clusters.clear();
+		Cluster sum{};
+		for (const auto& sample : a_samples) {
+			if (sum.count && !CanMerge(sum, sample)) {
+				o_clusters.push_back(Average(sum));
+				sum = {};
+			}
+			Add(sum, sample);
+		}
+		if (sum.count) {
+			o_clusters.push_back(Average(sum));
+		}
+	}
+
+	// the grid's search order by brute force: the previous light, then the eight nearest cells in
+	// order, and within a cell the light filed into it last first; a light is filed under the cell
+	// of its average when the inputs move on from it. Inputs are sums, a particle a sum of one.
+	std::vector<Cluster> ClusterReference(std::span<const Cluster> a_inputs)
+	{
+		const float cellScale = 0.5f / Threshold;
+		auto cellOf = [&](const float3& a_position) {
+			return std::array<int64_t, 3>{ static_cast<int64_t>(std::floor(a_position.x * cellScale)), static_cast<int64_t>(std::floor(a_position.y * cellScale)),
+				static_cast<int64_t>(std::floor(a_position.z * cellScale)) };
+		};
+		auto canMerge = [](const Cluster& a_sum, const Cluster& a_input) {
+			const auto count = static_cast<float>(a_sum.count);
+			const auto inputCount = static_cast<float>(a_input.count);
+			return std::abs(a_sum.radius / count - a_input.radius / inputCount) + float3::Distance(a_sum.position / count, a_input.position / inputCount) <= Threshold;
+		};
+
+		std::vector<Cluster> sums;
+		std::vector<std::optional<std::array<int64_t, 3>>> cells;
+		std::vector<uint64_t> filed;
+		uint64_t clock = 0;
+		uint32_t previous = UINT32_MAX;
+		for (const auto& input : a_inputs) {
+			const float3 position = input.position / static_cast<float>(input.count);
+			uint32_t target = UINT32_MAX;
+			if (previous != UINT32_MAX) {
+				if (canMerge(sums[previous], input)) {
+					target = previous;
+				} else if (const auto cell = cellOf(sums[previous].position / static_cast<float>(sums[previous].count)); cell != cells[previous]) {
+					cells[previous] = cell;
+					filed[previous] = ++clock;
+				}
+			}
+
+			if (target == UINT32_MAX) {
+				const auto base = cellOf(position);
+				const float3 scaled = position * cellScale;
+				const std::array<float, 3> half = { std::floor(scaled.x - 0.5f), std::floor(scaled.y - 0.5f), std::floor(scaled.z - 0.5f) };
+				const std::array<int64_t, 3> side = { half[0] < base[0] ? -1 : 1, half[1] < base[1] ? -1 : 1, half[2] < base[2] ? -1 : 1 };
+				std::pair<uint32_t, uint64_t> best = { 8, 0 };
+				for (uint32_t cluster = 0; cluster < sums.size(); ++cluster) {
+					for (uint32_t neighbour = 0; neighbour < 8; ++neighbour) {
+						const std::array<int64_t, 3> cell = { base[0] + (neighbour & 1 ? side[0] : 0), base[1] + (neighbour & 2 ? side[1] : 0), base[2] + (neighbour & 4 ? side[2] : 0) };
+						if (cells[cluster] == cell && canMerge(sums[cluster], input) &&
+							(neighbour < best.first || (neighbour == best.first && filed[cluster] > best.second))) {
+							best = { neighbour, filed[cluster] };
+							target = cluster;
+						}
+					}
+				}
+			}
+
+			if (target == UINT32_MAX) {
+				target = static_cast<uint32_t>(sums.size());
+				sums.push_back({});
+				cells.push_back(std::nullopt);
+				filed.push_back(0);
+			}
+			sums[target].position += input.position;
+			sums[target].radius += input.radius;
+			sums[target].color += input.color;
+			sums[target].count += input.count;
+			previous = target;
+		}
+		return sums;
+	}
+
+	uint32_t OrderedBits(float a_value)
+	{
+		const auto bits = std::bit_cast<uint32_t>(a_value);
+		return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+	}
+
+	// tiles of 16 cells per axis in the order of their packed keys, each clustered on its samples
+	// sorted by cell and bits, then the lights within the threshold of a tile face once more
+	std::vector<Cluster> BuildReference(std::span<const Sample> a_samples)
+	{
+		const float cellScale = 0.5f / Threshold;
+		constexpr int64_t TileCells = ParticleLightClustering::Clusterer::TileCells;
+		struct Entry
+		{
+			std::array<int64_t, 3> cell;
+			std::array<int64_t, 3> tile;
+			Sample sample;
+		};
+		auto tileKey = [](const std::array<int64_t, 3>& a_tile) {
+			return (static_cast<uint64_t>(a_tile[0]) & 0x1FFFFF) | ((static_cast<uint64_t>(a_tile[1]) & 0x1FFFFF) << 21) | ((static_cast<uint64_t>(a_tile[2]) & 0x1FFFFF) << 42);
+		};
+		auto canonical = [&](const Entry& a_entry) {
+			const auto& s = a_entry.sample;
+			return std::tuple(tileKey(a_entry.tile), a_entry.cell[2] - a_entry.tile[2] * TileCells, a_entry.cell[1] - a_entry.tile[1] * TileCells, a_entry.cell[0] - a_entry.tile[0] * TileCells,
+				OrderedBits(s.position.x), OrderedBits(s.position.y), OrderedBits(s.position.z), OrderedBits(s.radius), OrderedBits(s.color.x), OrderedBits(s.color.y), OrderedBits(s.color.z));
+		};
+
+		std::vector<Entry> entries;
+		for (const auto& sample : a_samples) {
+			const std::array<int64_t, 3> cell = { static_cast<int64_t>(std::floor(sample.position.x * cellScale)), static_cast<int64_t>(std::floor(sample.position.y * cellScale)),
+				static_cast<int64_t>(std::floor(sample.position.z * cellScale)) };
+			const std::array<int64_t, 3> tile = { static_cast<int64_t>(std::floor(cell[0] / static_cast<double>(TileCells))), static_cast<int64_t>(std::floor(cell[1] / static_cast<double>(TileCells))),
+				static_cast<int64_t>(std::floor(cell[2] / static_cast<double>(TileCells))) };
+			entries.push_back({ cell, tile, sample });
+		}
+		std::ranges::sort(entries, {}, canonical);
+
+		std::vector<Cluster> result;
+		std::vector<Cluster> border;
+		for (size_t begin = 0; begin < entries.size();) {
+			const auto tile = entries[begin].tile;
+			std::vector<Cluster> inputs;
+			size_t end = begin;
+			for (; end < entries.size() && entries[end].tile == tile; ++end) {
+				inputs.push_back({ entries[end].sample.position, entries[end].sample.radius, entries[end].sample.color, 1 });
+			}
+			for (const auto& light : ClusterReference(inputs)) {
+				const float3 average = light.position / static_cast<float>(light.count);
+				const std::array<float, 3> local = { average.x * cellScale - static_cast<float>(tile[0] * TileCells), average.y * cellScale - static_cast<float>(tile[1] * TileCells),
+					average.z * cellScale - static_cast<float>(tile[2] * TileCells) };
+				if (std::ranges::any_of(local, [](float a_offset) { return a_offset <= 0.5f + 1.0f / 64.0f || a_offset >= TileCells - 0.5f - 1.0f / 64.0f; })) {
+					border.push_back(light);
+				} else {
+					result.push_back(Average(light));
+				}
+			}
+			begin = end;
+		}
+		for (const auto& light : ClusterReference(border)) {
+			result.push_back(Average(light));
+		}
+		return result;
+	}
+
+	bool Equal(const std::vector<Cluster>& a_lhs, const std::vector<Cluster>& a_rhs)
+	{
+		return std::ranges::equal(a_lhs, a_rhs, [](const Cluster& a, const Cluster& b) {
+			return a.position == b.position && a.radius == b.radius && a.color == b.color && a.count == b.count;
+		});
+	}
+
+	// systems of flickering flames, each a tight burst of particles; candle racks put systems close together
+	LightSet MakeScene(std::string a_name, uint a_seed, uint a_torches, uint a_candleRacks)
+	{
+		LightSet set{ std::move(a_name) };
+		std::mt19937 rng(a_seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		auto addSystem = [&](const float3& a_center, uint a_particles, float a_spread, float a_radius) {
+			for (uint i = 0; i < a_particles; ++i) {
+				set.samples.push_back({ float3{ a_center.x + unit(rng) * a_spread, a_center.y + unit(rng) * a_spread, a_center.z + std::abs(unit(rng)) * a_spread * 2.0f },
+					a_radius * (1.0f + unit(rng) * 0.3f), float3{ 1.0f, 0.6f, 0.2f } * (0.5f + 0.5f * unit(rng) * unit(rng)) });
+			}
+		};
+		for (uint i = 0; i < a_torches; ++i) {
+			addSystem({ unit(rng) * 4096.0f, unit(rng) * 4096.0f, unit(rng) * 512.0f }, 12 + rng() % 20, 24.0f, 20.0f);
+		}
+		for (uint i = 0; i < a_candleRacks; ++i) {
+			const float3 rack{ unit(rng) * 4096.0f, unit(rng) * 4096.0f, unit(rng) * 512.0f };
+			for (uint candle = 0; candle < 6; ++candle) {
+				addSystem({ rack.x + candle * 9.0f, rack.y + unit(rng) * 4.0f, rack.z }, 3 + rng() % 4, 2.0f, 6.0f);
+			}
+		}
+		return set;
+	}
+
+	void LoadRecordings(const std::filesystem::path& a_path, std::vector<LightSet>& o_sets)
+	{
+		std::vector<std::filesystem::path> files;
+		if (std::filesystem::is_directory(a_path)) {
+			for (const auto& entry : std::filesystem::directory_iterator(a_path)) {
+				if (entry.path().extension() == ".bin") {
+					files.push_back(entry.path());
+				}
+			}
+			std::ranges::sort(files);
+		} else {
+			files.push_back(a_path);
+		}
+		for (const auto& file : files) {
+			LightSet set{ file.filename().string() };
+			if (ParticleLightClustering::LoadSamples(file, set.samples)) {
+				o_sets.push_back(std::move(set));
+			} else {
+				std::fprintf(stderr, "%s is not a particle light recording\n", file.string().c_str());
+				Tests::failures++;
+			}
+		}
+	}
+
+	// tiles built on a few threads, each taking the next tile, the way the shader pool runs them
+	void BuildThreaded(ParticleLightClustering::Clusterer& a_clusterer, std::span<const Sample> a_samples, std::vector<Cluster>& o_clusters)
+	{
+		const size_t tileCount = a_clusterer.Partition(a_samples, Threshold);
+		std::atomic<size_t> next = 0;
+		std::vector<std::thread> threads;
+		for (uint i = 0; i < 4; ++i) {
+			threads.emplace_back([&]() {
+				for (size_t tile = next++; tile < tileCount; tile = next++) {
+					a_clusterer.BuildTile(tile);
+				}
+			});
+		}
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		a_clusterer.Finish(o_clusters);
+	}
+
+	void Run(const LightSet& a_set)
+	{
+		std::printf("%s: %zu particles\n", a_set.name.c_str(), a_set.samples.size());
+
+		ParticleLightClustering::Clusterer clusterer;
+		std::vector<Cluster> grid;
+		std::vector<Cluster> greedy;
+		const uint iterations = std::max(10u, 200000u / std::max<uint>(static_cast<uint>(a_set.samples.size()), 1u));
+		const double greedyTime = Tests::Bench("  greedy", iterations, [&]() { BuildGreedy(a_set.samples, greedy); });
+		const double gridTime = Tests::Bench("  grid", iterations, [&]() { clusterer.Build(a_set.samples, Threshold, grid); });
+		std::printf("  %zu lights greedy, %zu grid (%.2fx the time)\n", greedy.size(), grid.size(), gridTime / std::max(greedyTime, 1e-3));
+
+		// the part that runs on the pool against the part that stays on the render thread
+		const size_t tileCount = clusterer.Partition(a_set.samples, Threshold);
+		const double tilesTime = Tests::Bench("    tiles", iterations, [&]() {
+			for (size_t tile = 0; tile < tileCount; ++tile) {
+				clusterer.BuildTile(tile);
+			}
+		});
+		std::printf("  %zu tiles, %.0f%% of the grid's time parallel\n", tileCount, 100.0 * tilesTime / std::max(gridTime, 1e-3));
+		clusterer.Build(a_set.samples, Threshold, grid);
+
+		uint32_t count = 0;
+		for (const auto& cluster : grid) {
+			count += cluster.count;
+		}
+		CHECK(count == a_set.samples.size());
+
+		// a reused clusterer gives the same result as a fresh one, and so do tiles built on other threads
+		std::vector<Cluster> other;
+		ParticleLightClustering::Clusterer().Build(a_set.samples, Threshold, other);
+		CHECK(Equal(grid, other));
+		BuildThreaded(clusterer, a_set.samples, other);
+		CHECK(Equal(grid, other));
+
+		// and the order particle systems were gathered in does not matter
+		std::vector<Sample> shuffled = a_set.samples;
+		std::ranges::shuffle(shuffled, std::mt19937(12));
+		clusterer.Build(shuffled, Threshold, other);
+		CHECK(Equal(grid, other));
+
+		if (a_set.samples.size() <= 20000) {
+			CHECK(Equal(grid, BuildReference(a_set.samples)));
+		}
+	}
+
+	// a system on a tile corner is split between up to eight tiles, and the border pass joins it again
+	void TestTileBorder()
+	{
+		const float tileSize = ParticleLightClustering::Clusterer::TileCells * 2.0f * Threshold;
+		std::vector<Sample> samples;
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		for (uint i = 0; i < 64; ++i) {
+			samples.push_back({ float3{ tileSize + unit(rng) * 4.0f, -tileSize + unit(rng) * 4.0f, unit(rng) * 4.0f }, 10.0f, float3{ 1.0f, 0.5f, 0.25f } });
+		}
+		std::vector<Cluster> clusters;
+		ParticleLightClustering::Clusterer().Build(samples, Threshold, clusters);
+		CHECK(clusters.size() == 1 && clusters.front().count == samples.size());
+		CHECK(Equal(clusters, BuildReference(samples)));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<LightSet> sets;
+	for (int i = 1; i < argc; ++i) {
+		LoadRecordings(argv[i], sets);
+	}
+	if (argc == 1) {
+		sets.push_back(MakeScene("synthetic tavern", 1, 12, 8));
+		sets.push_back(MakeScene("synthetic town", 2, 90, 30));
+		sets.push_back(MakeScene("synthetic city", 3, 380, 120));
+	}
+
+	for (const auto& set : sets) {
+		Run(set);
+	}
+
+	TestTileBorder();
+
+	std::vector<Cluster> clusters;
+	ParticleLightClustering::Clusterer().Build({}, Threshold, clusters);
+	CHECK(clusters.empty());
+	return Tests::Result();
+}
@@ -0,0 +1,157 @@
+#include "Check.h"
+
+#include "Features/LightLimitFix/ParticleLightGrid.h"
+
+// Times the particle light luminance queries AI threads make per actor, through ParticleLightGrid and
+// through the linear scan it replaced, and checks that both give bit-identical sums and hit counts.
+
+namespace
+{
+	using Light = ParticleLightGrid::Light;
+
+	constexpr uint ActorCount = 100;
+
+	// LightLimitFix::CalculateLuminance
+	float CalculateLuminance(const Light& a_light, const RE::NiPoint3& a_point)
+	{
+		auto lightDirection = a_light.position - a_point;
+		float lightDist = lightDirection.Length();
+		float intensityFactor = std::clamp(lightDist / a_light.radius, 0.0f, 1.0f);
+		float intensityMultiplier = 1 - intensityFactor * intensityFactor;
+		return a_light.grey * intensityMultiplier;
+	}
+
+	struct Luminance
+	{
+		float lightLevel = 0.0f;
+		int hits = 0;
+
+		void Add(const Light& a_light, const RE::NiPoint3& a_point)
+		{
+			auto luminance = CalculateLuminance(a_light, a_point);
+			lightLevel += luminance;
+			if (luminance > 0.0)
+				hits++;
+		}
+
+		bool operator==(const Luminance& a_rhs) const
+		{
+			return std::bit_cast<uint32_t>(lightLevel) == std::bit_cast<uint32_t>(a_rhs.lightLevel) && hits == a_rhs.hits;
+		}
+	};
+
+	// what AddParticleLightLuminance did before the grid
+	Luminance ScanLinear(std::span<const Light> a_lights, const RE::NiPoint3& a_point)
+	{
+		Luminance result;
+		for (const auto& light : a_lights)
+			result.Add(light, a_point);
+		return result;
+	}
+
+	Luminance QueryGrid(const ParticleLightGrid& a_grid, const RE::NiPoint3& a_point)
+	{
+		Luminance result;
+		a_grid.ForEachLight(a_point, [&](const Light& a_light) { result.Add(a_light, a_point); });
+		return result;
+	}
+
+	struct Scene
+	{
+		std::vector<Light> lights;
+		std::vector<RE::NiPoint3> actors;
+	};
+
+	// torches and candles around a town at negative and positive coordinates, a few lights reaching far
+	// enough to be visited by every query, and actors standing among them or out in the open
+	Scene MakeScene(uint a_lightCount, uint a_seed)
+	{
+		Scene scene;
+		std::mt19937 rng(a_seed);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> grey(0.1f, 1.0f);
+
+		std::vector<RE::NiPoint3> spots;
+		for (uint i = 0; i < std::max(a_lightCount / 8, 1u); ++i)
+			spots.push_back({ unit(rng) * 16384.0f, unit(rng) * 16384.0f, unit(rng) * 2048.0f });
+
+		for (uint i = 0; i < a_lightCount; ++i) {
+			const auto& spot = spots[rng() % spots.size()];
+			const float radius = i % 97 == 0 ? 40000.0f : 100.0f + std::abs(unit(rng)) * 700.0f;
+			scene.lights.push_back({ grey(rng), { spot.x + unit(rng) * 512.0f, spot.y + unit(rng) * 512.0f, spot.z + unit(rng) * 128.0f }, radius });
+		}
+
+		for (uint i = 0; i + 2 < ActorCount; ++i) {
+			if (i % 4 == 0) {
+				scene.actors.push_back({ unit(rng) * 20000.0f, unit(rng) * 20000.0f, unit(rng) * 2048.0f });
+			} else {
+				const auto& spot = spots[rng() % spots.size()];
+				scene.actors.push_back({ spot.x + unit(rng) * 800.0f, spot.y + unit(rng) * 800.0f, spot.z });
+			}
+		}
+		// on cell boundaries, where a light's bounds end exactly
+		scene.actors.push_back({ 0.0f, 0.0f, 0.0f });
+		scene.actors.push_back({ -ParticleLightGrid::CellSize, ParticleLightGrid::CellSize, -0.0f });
+		return scene;
+	}
+
+	void CheckExact(const Scene& a_scene, const ParticleLightGrid& a_grid)
+	{
+		for (const auto& actor : a_scene.actors)
+			CHECK(QueryGrid(a_grid, actor) == ScanLinear(a_scene.lights, actor));
+	}
+
+	void Run(uint a_lightCount)
+	{
+		const auto scene = MakeScene(a_lightCount, a_lightCount);
+		std::printf("%u lights, %zu actors\n", a_lightCount, scene.actors.size());
+
+		const uint iterations = 200000 / a_lightCount;
+		std::optional<ParticleLightGrid> grid;
+		Tests::Bench("  build snapshot", iterations, [&]() { grid.emplace(scene.lights); });
+		CheckExact(scene, *grid);
+
+		float sink = 0.0f;
+		const double linearTime = Tests::Bench("  linear scan, all actors", iterations, [&]() {
+			for (const auto& actor : scene.actors)
+				sink += ScanLinear(scene.lights, actor).lightLevel;
+		});
+		const double gridTime = Tests::Bench("  grid, all actors", iterations, [&]() {
+			for (const auto& actor : scene.actors)
+				sink += QueryGrid(*grid, actor).lightLevel;
+		});
+		std::printf("  %.2fx faster (%d)\n", linearTime / std::max(gridTime, 1e-3), sink != 0.0f);
+	}
+
+	void TestEdgeCases()
+	{
+		// nothing to visit
+		const ParticleLightGrid empty{ std::span<const Light>{} };
+		CHECK(QueryGrid(empty, { 1.0f, 2.0f, 3.0f }) == Luminance{});
+
+		// lights that cannot be bucketed are visited by every query, in order with the bucketed ones
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const std::vector<Light> lights = {
+			{ 0.5f, { 10.0f, 10.0f, 10.0f }, 200.0f },
+			{ 0.25f, { nan, 0.0f, 0.0f }, 200.0f },
+			{ 0.75f, { 0.0f, 0.0f, 0.0f }, std::numeric_limits<float>::infinity() },
+			{ 1.0f, { -5.0f, 0.0f, 0.0f }, 100.0f },
+		};
+		const ParticleLightGrid grid{ lights };
+		CHECK(grid.GetLightCount() == lights.size());
+		for (const auto& point : { RE::NiPoint3{ 0.0f, 0.0f, 0.0f }, RE::NiPoint3{ 50000.0f, 0.0f, 0.0f }, RE::NiPoint3{ -1.0f, -1.0f, -1.0f } }) {
+			std::vector<float> visited;
+			grid.ForEachLight(point, [&](const Light& a_light) { visited.push_back(a_light.grey); });
+			CHECK(std::ranges::is_sorted(visited, {}, [&](float a_grey) { return std::ranges::find(lights, a_grey, &Light::grey) - lights.begin(); }));
+			CHECK(QueryGrid(grid, point) == ScanLinear(lights, point));
+		}
+	}
+}
+
+int main()
+{
+	TestEdgeCases();
+	for (uint lightCount : { 50u, 200u, 1000u })
+		Run(lightCount);
+	return Tests::Result();
+}
@@ -0,0 +1,204 @@
+#include "Check.h"
+
+#include "Features/LightLimitFix/ParticleLights.h"
+
+// Times ParticleLights::GetConfigs on a 5k-file ParticleLights folder, parsing the inis and reusing the
+// snapshot, against the sequential loop it replaced, and checks that all of them give the same configs.
+// Runs in a scratch folder; the plugin's Data\... paths are plain file names there on Linux.
+
+namespace
+{
+	using Configs = decltype(ParticleLights::particleLightConfigs);
+	using GradientConfigs = decltype(ParticleLights::particleLightGradientConfigs);
+
+	constexpr uint LightCount = 4500;
+	constexpr uint GradientCount = 500;
+
+	constexpr const char* ConfigFolder = "Data\\ParticleLights";
+	constexpr const char* GradientFolder = "Data\\ParticleLights\\Gradients";
+
+	bool operator==(const RE::NiColor& a_lhs, const RE::NiColor& a_rhs)
+	{
+		return a_lhs.red == a_rhs.red && a_lhs.green == a_rhs.green && a_lhs.blue == a_rhs.blue;
+	}
+
+	bool operator==(const ParticleLights::Config& a_lhs, const ParticleLights::Config& a_rhs)
+	{
+		return a_lhs.cull == a_rhs.cull && a_lhs.colorMult == a_rhs.colorMult && a_lhs.radiusMult == a_rhs.radiusMult && a_lhs.saturationMult == a_rhs.saturationMult;
+	}
+
+	bool operator==(const ParticleLights::GradientConfig& a_lhs, const ParticleLights::GradientConfig& a_rhs)
+	{
+		return a_lhs.color == a_rhs.color;
+	}
+
+	template <class Map>
+	bool Equal(const Map& a_lhs, const Map& a_rhs)
+	{
+		return a_lhs.size() == a_rhs.size() && std::ranges::all_of(a_lhs, [&](const auto& a_entry) {
+			const auto it = a_rhs.find(a_entry.first);
+			return it != a_rhs.end() && it->first == a_entry.first && it->second == a_entry.second;
+		});
+	}
+
+	std::string GetFileName(const char* a_prefix, uint a_index, const char* a_suffix)
+	{
+		char name[64];
+		std::snprintf(name, sizeof(name), "%s%04u%s.ini", a_prefix, a_index, a_suffix);
+		return name;
+	}
+
+	// mostly multipliers, every seventh light culled, gradients in all three hex spellings
+	void WriteFiles()
+	{
+		std::filesystem::create_directories(ConfigFolder);
+		std::filesystem::create_directories(GradientFolder);
+
+		std::mt19937 rng(17);
+		std::uniform_real_distribution<float> mult(0.25f, 2.0f);
+		for (uint i = 0; i < LightCount; ++i) {
+			std::ofstream out(std::filesystem::path(ConfigFolder) / GetFileName("FxFire", i, "_Glow"));
+			out << std::fixed << std::setprecision(3) << "[Light]\n";
+			if (i % 7 == 0) {
+				out << "Cull = true\n";
+			}
+			out << "ColorMultRed = " << mult(rng) << "\nColorMultGreen = " << mult(rng) << "\nColorMultBlue = " << mult(rng) << "\n";
+			out << "RadiusMult = " << mult(rng) << "\nSaturationMult = " << mult(rng) << "\n";
+		}
+
+		constexpr std::array<const char*, 3> prefixes = { "", "0x", "#" };
+		for (uint i = 0; i < GradientCount; ++i) {
+			std::ofstream out(std::filesystem::path(GradientFolder) / GetFileName("FxGradient", i, ""));
+			out << "[Gradient]\nColor = " << prefixes[i % prefixes.size()] << std::uppercase << std::hex << std::setw(6) << std::setfill('0') << (rng() & 0xFFFFFF) << "\n";
+		}
+
+		// skipped by both loaders
+		std::ofstream(std::filesystem::path(GradientFolder) / "FxBroken.ini") << "[Gradient]\nColor = zz\n";
+		std::ofstream(std::filesystem::path(GradientFolder) / "FxEmpty.ini") << "[Gradient]\n";
+	}
+
+	// the loop GetConfigs ran before it parsed in parallel and kept a snapshot, without its logging
+	void LoadSequential(Configs& o_configs, GradientConfigs& o_gradientConfigs)
+	{
+		o_configs.clear();
+		o_gradientConfigs.clear();
+
+		auto getStem = [](const std::string& a_path) {
+			std::string filename = a_path.substr(a_path.find_last_of("\\/") + 1);
+			filename.erase(filename.length() - 4);  // Remove ".ini"
+			std::transform(filename.begin(), filename.end(), filename.begin(), [](auto c) { return (char)::tolower(c); });
+			return filename;
+		};
+
+		for (auto& path : clib_util::distribution::get_configs(ConfigFolder, "", ".ini")) {
+			CSimpleIniA ini;
+			ini.SetUnicode();
+			ini.SetMultiKey();
+			if (ini.LoadFile(path.c_str()) < 0) {
+				continue;
+			}
+
+			ParticleLights::Config data{};
+			o_configs.insert({ "default", data });
+			data.cull = ini.GetBoolValue("Light", "Cull", false);
+			data.colorMult.red = (float)ini.GetDoubleValue("Light", "ColorMultRed", 1.0);
+			data.colorMult.green = (float)ini.GetDoubleValue("Light", "ColorMultGreen", 1.0);
+			data.colorMult.blue = (float)ini.GetDoubleValue("Light", "ColorMultBlue", 1.0);
+			data.radiusMult = (float)ini.GetDoubleValue("Light", "RadiusMult", 1.0);
+			data.saturationMult = (float)ini.GetDoubleValue("Light", "SaturationMult", 1.0);
+			o_configs.insert({ getStem(path), data });
+		}
+
+		for (auto& path : clib_util::distribution::get_configs(GradientFolder, "", ".ini")) {
+			CSimpleIniA ini;
+			ini.SetUnicode();
+			ini.SetMultiKey();
+			if (ini.LoadFile(path.c_str()) < 0) {
+				continue;
+			}
+
+			const char* value = ini.GetValue("Gradient", "Color");
+			if (!value || strcmp(value, "") == 0) {
+				continue;
+			}
+			std::string_view str = value;
+			if (str.starts_with("0x")) {
+				str.remove_prefix(2);
+			}
+			if (str.starts_with("#")) {
+				str.remove_prefix(1);
+			}
+			if (std::strspn(str.data(), "0123456789ABCDEFabcdef") != str.size()) {
+				continue;
+			}
+
+			ParticleLights::GradientConfig data{};
+			data.color = (uint32_t)std::stoi(str.data(), 0, 16);
+			o_gradientConfigs.insert({ getStem(path), data });
+		}
+	}
+
+	void Run()
+	{
+		auto* particleLights = ParticleLights::GetSingleton();
+		Configs sequential;
+		GradientConfigs sequentialGradients;
+		constexpr uint iterations = 5;
+
+		std::printf("%u light and %u gradient inis, warm file cache, %u threads\n", LightCount, GradientCount + 2, std::thread::hardware_concurrency());
+		const double sequentialTime = Tests::Bench("  sequential", iterations, [&]() { LoadSequential(sequential, sequentialGradients); });
+		const double parseTime = Tests::Bench("  GetConfigs, parsing", iterations, [&]() {
+			std::filesystem::remove(ParticleLights::SnapshotPath);
+			particleLights->GetConfigs();
+		});
+		CHECK(Equal(particleLights->particleLightConfigs, sequential));
+		CHECK(Equal(particleLights->particleLightGradientConfigs, sequentialGradients));
+
+		const double snapshotTime = Tests::Bench("  GetConfigs, snapshot", iterations, [&]() { particleLights->GetConfigs(); });
+		CHECK(Equal(particleLights->particleLightConfigs, sequential));
+		CHECK(Equal(particleLights->particleLightGradientConfigs, sequentialGradients));
+		std::printf("  parsing %.2fx, snapshot %.2fx the sequential time\n", parseTime / std::max(sequentialTime, 1e-3), snapshotTime / std::max(sequentialTime, 1e-3));
+
+		CHECK(particleLights->particleLightConfigs.size() == LightCount + 1);  // and "default"
+		CHECK(particleLights->particleLightGradientConfigs.size() == GradientCount);
+		CHECK(particleLights->particleLightConfigs.contains("FXFIRE0007_GLOW") && particleLights->particleLightConfigs.find("fxfire0007_glow")->second.cull);
+	}
+
+	// an edited ini no longer matches the snapshot, so it is parsed again instead of served stale
+	void TestEdit()
+	{
+		auto* particleLights = ParticleLights::GetSingleton();
+		std::ofstream(std::filesystem::path(ConfigFolder) / "FxFire0001_Glow.ini") << "[Light]\nCull = true\nRadiusMult = 3.5\n";
+		particleLights->GetConfigs();
+		const auto it = particleLights->particleLightConfigs.find("fxfire0001_glow");
+		CHECK(it != particleLights->particleLightConfigs.end() && it->second.cull && it->second.radiusMult == 3.5f && it->second.colorMult == RE::NiColor(1.0f, 1.0f, 1.0f));
+
+		// and the snapshot rewritten then holds the edit
+		particleLights->particleLightConfigs.clear();
+		particleLights->GetConfigs();
+		CHECK(particleLights->particleLightConfigs.contains("fxfire0001_glow") && particleLights->particleLightConfigs.find("fxfire0001_glow")->second.radiusMult == 3.5f);
+
+		// a truncated snapshot falls back to parsing
+		std::filesystem::resize_file(ParticleLights::SnapshotPath, std::filesystem::file_size(ParticleLights::SnapshotPath) / 2);
+		particleLights->particleLightConfigs.clear();
+		particleLights->GetConfigs();
+		CHECK(particleLights->particleLightConfigs.size() == LightCount + 1);
+	}
+}
+
+int main()
+{
+	const auto previous = std::filesystem::current_path();
+	const auto scratch = std::filesystem::temp_directory_path() / "ParticleLightsLoadBench";
+	std::filesystem::remove_all(scratch);
+	std::filesystem::create_directories(scratch);
+	std::filesystem::current_path(scratch);
+
+	WriteFiles();
+	Run();
+	TestEdit();
+
+	std::filesystem::current_path(previous);
+	std::filesystem::remove_all(scratch);
+	return Tests::Result();
+}
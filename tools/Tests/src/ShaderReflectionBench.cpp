@@ -0,0 +1,401 @@
+#include "Check.h"
+
+#include <d3dcompiler.h>
+
+#include "ShaderArchive.h"
+#include "ShaderDependencies.h"
+#include "ShaderReflection.h"
+
+// Times creating every shader of a populated disk archive by reflecting its bytecode, as the plugin did
+// before reflections were stored, against applying the reflection stored next to it, and checks both
+// give the same offset tables. D3DReflect is Windows only, so the bytecode here carries its constant
+// buffer layout in a small chunk a stand-in parses; the real D3DReflect costs far more, so the saving
+// shown is a lower bound. Variable names go through the plugin's lookups: a hash map per shader type
+// and class, and a linear scan of the constant names for imagespace shaders.
+
+namespace
+{
+	using SIE::ShaderReflection;
+
+	constexpr uint LightingPermutations = 4000;    // vertex and pixel shaders of the lighting, effect and water types
+	constexpr uint ImagespacePermutations = 600;   // their constant names are scanned linearly
+	constexpr size_t ShaderConstants = 40;         // constant table size of the stand-in shader
+	constexpr uint32_t ChunkMagic = 0x464C4552;    // "RLFL", stand-in reflection chunk
+
+	// stand-in of what D3DReflect exposes about one constant buffer
+	struct BufferDesc
+	{
+		std::string name;
+		uint32_t size = 0;
+		std::vector<std::string> variableNames;
+		std::vector<ShaderReflection::Variable> variables;  // names point into variableNames
+	};
+
+	struct ShaderDesc
+	{
+		std::vector<BufferDesc> buffers;
+	};
+
+	struct ShaderType
+	{
+		bool imagespace = false;
+		std::unordered_map<std::string, int32_t> indices;  // what GetVariableIndices builds per type and class
+		std::vector<std::string> constantNames;            // what imagespace shaders list instead
+	};
+
+	struct Permutation
+	{
+		uint64_t key;
+		const ShaderType* type;
+	};
+
+	// the bytecode: a random body, then a chunk of buffers with their sizes and variables
+	ID3DBlob* MakeBytecode(const ShaderDesc& a_desc, std::mt19937& a_rng)
+	{
+		std::string data(1024 + a_rng() % 6144, '\0');
+		for (auto& c : data) {
+			c = static_cast<char>(a_rng());
+		}
+		const size_t body = data.size();
+		auto write = [&](uint32_t a_value) { data.append(reinterpret_cast<const char*>(&a_value), sizeof(a_value)); };
+		auto writeString = [&](const std::string& a_value) {
+			write(static_cast<uint32_t>(a_value.size()));
+			data += a_value;
+		};
+		write(ChunkMagic);
+		write(static_cast<uint32_t>(a_desc.buffers.size()));
+		for (const auto& buffer : a_desc.buffers) {
+			writeString(buffer.name);
+			write(buffer.size);
+			write(static_cast<uint32_t>(buffer.variables.size()));
+			for (size_t i = 0; i < buffer.variables.size(); ++i) {
+				writeString(buffer.variableNames[i]);
+				write(buffer.variables[i].startOffset);
+				write(buffer.variables[i].size);
+				write(buffer.variables[i].elements);
+			}
+		}
+		write(static_cast<uint32_t>(body));
+
+		ID3DBlob* blob = nullptr;
+		D3DCreateBlob(data.size(), &blob);
+		std::memcpy(blob->GetBufferPointer(), data.data(), data.size());
+		return blob;
+	}
+
+	// stand-in for D3DReflect: builds the buffer descriptions from the chunk
+	bool Reflect(ID3DBlob& a_bytecode, ShaderDesc& o_desc)
+	{
+		const auto* data = static_cast<const uint8_t*>(a_bytecode.GetBufferPointer());
+		const size_t size = a_bytecode.GetBufferSize();
+		if (size < sizeof(uint32_t)) {
+			return false;
+		}
+		uint32_t offset;
+		std::memcpy(&offset, data + size - sizeof(uint32_t), sizeof(uint32_t));
+		auto read = [&](uint32_t& o_value) {
+			if (offset + sizeof(uint32_t) > size) {
+				return false;
+			}
+			std::memcpy(&o_value, data + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+			return true;
+		};
+		auto readString = [&](std::string& o_value) {
+			uint32_t length;
+			if (!read(length) || offset + length > size) {
+				return false;
+			}
+			o_value.assign(reinterpret_cast<const char*>(data + offset), length);
+			offset += length;
+			return true;
+		};
+
+		uint32_t magic, bufferCount;
+		if (!read(magic) || magic != ChunkMagic || !read(bufferCount)) {
+			return false;
+		}
+		o_desc.buffers.resize(bufferCount);
+		for (auto& buffer : o_desc.buffers) {
+			uint32_t variableCount;
+			if (!readString(buffer.name) || !read(buffer.size) || !read(variableCount)) {
+				return false;
+			}
+			buffer.variableNames.resize(variableCount);
+			buffer.variables.resize(variableCount);
+			for (uint32_t i = 0; i < variableCount; ++i) {
+				auto& variable = buffer.variables[i];
+				if (!readString(buffer.variableNames[i]) || !read(variable.startOffset) || !read(variable.size) || !read(variable.elements)) {
+					return false;
+				}
+			}
+			for (uint32_t i = 0; i < variableCount; ++i) {
+				buffer.variables[i].name = buffer.variableNames[i].c_str();
+			}
+		}
+		return true;
+	}
+
+	// GetVariableIndex
+	int32_t GetVariableIndex(const ShaderType& a_type, const char* a_name)
+	{
+		if (a_type.imagespace) {
+			for (size_t nameIndex = 0; nameIndex < a_type.constantNames.size(); ++nameIndex) {
+				if (std::string_view(a_type.constantNames[nameIndex].c_str()) == a_name) {
+					return static_cast<int32_t>(nameIndex);
+				}
+			}
+		} else if (auto it = a_type.indices.find(a_name); it != a_type.indices.cend()) {
+			return it->second;
+		}
+		return -1;
+	}
+
+	// ReflectShader, on the stand-in descriptions
+	ShaderReflection ReflectShader(ID3DBlob& a_bytecode, const ShaderType& a_type)
+	{
+		ShaderReflection reflection;
+		ShaderDesc desc;
+		if (!Reflect(a_bytecode, desc)) {
+			return reflection;
+		}
+		constexpr std::array<const char*, 3> bufferNames = { "PerTechnique", "PerMaterial", "PerGeometry" };
+		for (size_t buffer = 0; buffer < bufferNames.size(); ++buffer) {
+			const auto it = std::ranges::find(desc.buffers, std::string_view(bufferNames[buffer]), &BufferDesc::name);
+			if (it == desc.buffers.end()) {
+				continue;
+			}
+			for (auto variable : it->variables) {
+				if (!a_type.imagespace) {
+					variable.elements = 0;
+				}
+				reflection.MapVariable(
+					variable, [&](const char* a_name) { return GetVariableIndex(a_type, a_name); }, [](std::string_view, bool) {});
+			}
+			reflection.SetBufferSize(buffer, it->size);
+		}
+		reflection.reflected = 1;
+		return reflection;
+	}
+
+	// what CreateVertexShader and CreatePixelShader keep of a reflection
+	struct Shader
+	{
+		std::array<int8_t, ShaderConstants> constantTable{};
+		std::array<uint32_t, 3> bufferSizes{};
+		uint32_t byteCodeSize = 0;
+
+		void Apply(const ShaderReflection& a_reflection)
+		{
+			std::copy_n(a_reflection.constantTable.begin(), constantTable.size(), constantTable.begin());
+			bufferSizes = a_reflection.bufferSizes;
+		}
+
+		bool operator==(const Shader&) const = default;
+	};
+
+	struct Scene
+	{
+		std::vector<ShaderType> types;
+		std::vector<Permutation> permutations;
+	};
+
+	// a lighting-like type with named constants, and an imagespace type whose arrays are named by element
+	// or as a whole; permutations use random subsets of the constants, plus some the plugin does not know
+	Scene MakeScene(SIE::ShaderArchive& a_archive)
+	{
+		Scene scene;
+		scene.types.resize(2);
+		auto& lighting = scene.types[0];
+		for (int32_t i = 0; i < static_cast<int32_t>(ShaderConstants); ++i) {
+			lighting.indices.emplace("LightingConstant" + std::to_string(i), i);
+		}
+		auto& imagespace = scene.types[1];
+		imagespace.imagespace = true;
+		for (uint i = 0; i < 12; ++i) {
+			imagespace.constantNames.push_back("Param" + std::to_string(i));
+		}
+		imagespace.constantNames.push_back("BlurOffsets[8]");  // whole array
+		imagespace.constantNames.push_back("Kernel");          // element 0, then one name per element
+		for (uint i = 1; i < 6; ++i) {
+			imagespace.constantNames.push_back("Kernel[" + std::to_string(i) + "]");
+		}
+
+		std::mt19937 rng(10);
+		auto addPermutation = [&](const ShaderType& a_type, uint64_t a_key) {
+			ShaderDesc desc;
+			desc.buffers.resize(3);
+			desc.buffers[0].name = "PerTechnique";
+			desc.buffers[1].name = "PerMaterial";
+			desc.buffers[2].name = rng() % 4 ? "PerGeometry" : "PerFrame";  // not every shader has all three
+			for (auto& buffer : desc.buffers) {
+				auto add = [&](std::string a_name, uint32_t a_size, uint32_t a_elements) {
+					buffer.variableNames.push_back(std::move(a_name));
+					buffer.variables.push_back({ nullptr, buffer.size, a_size, a_elements });
+					buffer.size += a_size;
+				};
+				const uint count = 2 + rng() % 10;
+				for (uint i = 0; i < count; ++i) {
+					if (a_type.imagespace) {
+						add(a_type.constantNames[rng() % 12], 16, 0);
+					} else {
+						add("LightingConstant" + std::to_string(rng() % ShaderConstants), 16, 0);
+					}
+				}
+				if (a_type.imagespace && rng() % 2) {
+					add("BlurOffsets", 8 * 16, 8);
+					add("Kernel", 6 * 16, 6);
+				}
+				constexpr std::array<const char*, 3> unknownNames = { "FogColor", "DebugFlags", "Padding" };
+				add(unknownNames[rng() % unknownNames.size()], 16, 0);
+				buffer.size += rng() % 12;
+			}
+			auto* bytecode = MakeBytecode(desc, rng);
+			a_archive.Write(a_key, bytecode);
+
+			ShaderReflection reflection = ReflectShader(*bytecode, a_type);
+			reflection.bytecodeHash = SIE::ShaderDependencies::HashContent({ static_cast<const char*>(bytecode->GetBufferPointer()), bytecode->GetBufferSize() });
+			ID3DBlob* record = nullptr;
+			D3DCreateBlob(sizeof(ShaderReflection), &record);
+			std::memcpy(record->GetBufferPointer(), &reflection, sizeof(ShaderReflection));
+			a_archive.Write(ShaderReflection::GetArchiveKey(a_key), record);
+			record->Release();
+			bytecode->Release();
+			scene.permutations.push_back({ a_key, &a_type });
+		};
+		for (uint i = 0; i < LightingPermutations; ++i) {
+			addPermutation(lighting, (uint64_t(i % 2) << 32) | (i * 7919));
+		}
+		for (uint i = 0; i < ImagespacePermutations; ++i) {
+			addPermutation(imagespace, (uint64_t(2) << 32) | i);
+		}
+		CHECK(a_archive.Compact());
+		return scene;
+	}
+
+	// MakeAndAddVertexShader before reflections were stored
+	bool CreateReflected(SIE::ShaderArchive& a_archive, const Permutation& a_permutation, Shader& o_shader)
+	{
+		std::chrono::system_clock::time_point writeTime;
+		auto* bytecode = a_archive.Read(a_permutation.key, writeTime);
+		if (!bytecode) {
+			return false;
+		}
+		o_shader.byteCodeSize = static_cast<uint32_t>(bytecode->GetBufferSize());
+		o_shader.Apply(ReflectShader(*bytecode, *a_permutation.type));
+		bytecode->Release();
+		return true;
+	}
+
+	// MakeAndAddVertexShader with GetShaderReflection finding the stored record
+	bool CreateCached(SIE::ShaderArchive& a_archive, const Permutation& a_permutation, Shader& o_shader)
+	{
+		std::chrono::system_clock::time_point writeTime;
+		auto* bytecode = a_archive.Read(a_permutation.key, writeTime);
+		if (!bytecode) {
+			return false;
+		}
+		const auto bytecodeHash = SIE::ShaderDependencies::HashContent({ static_cast<const char*>(bytecode->GetBufferPointer()), bytecode->GetBufferSize() });
+		ShaderReflection reflection;
+		bool cached = false;
+		if (auto* record = a_archive.Read(ShaderReflection::GetArchiveKey(a_permutation.key), writeTime)) {
+			cached = ShaderReflection::Load({ static_cast<const uint8_t*>(record->GetBufferPointer()), record->GetBufferSize() }, bytecodeHash, reflection);
+			record->Release();
+		}
+		o_shader.byteCodeSize = static_cast<uint32_t>(bytecode->GetBufferSize());
+		o_shader.Apply(reflection);
+		bytecode->Release();
+		return cached;
+	}
+
+	void Run(SIE::ShaderArchive& a_archive, const Scene& a_scene)
+	{
+		std::printf("%zu shaders in one archive, %zu entries\n", a_scene.permutations.size(), a_archive.GetEntryCount());
+
+		std::vector<Shader> reflected(a_scene.permutations.size());
+		std::vector<Shader> cached(a_scene.permutations.size());
+		uint created = 0;
+		uint hits = 0;
+		const double reflectTime = Tests::Bench("  reflect", 5, [&]() {
+			for (size_t i = 0; i < a_scene.permutations.size(); ++i) {
+				created += CreateReflected(a_archive, a_scene.permutations[i], reflected[i]);
+			}
+		});
+		const double cachedTime = Tests::Bench("  stored reflection", 5, [&]() {
+			for (size_t i = 0; i < a_scene.permutations.size(); ++i) {
+				hits += CreateCached(a_archive, a_scene.permutations[i], cached[i]);
+			}
+		});
+		std::printf("  %.2fx the time with stored reflections\n", cachedTime / std::max(reflectTime, 1e-3));
+		CHECK(created == 6 * a_scene.permutations.size());
+		CHECK(hits == 6 * a_scene.permutations.size());
+		CHECK(reflected == cached);
+
+		// the tables hold what the stand-in shaders declared, arrays included
+		const auto& imagespace = a_scene.types[1];
+		uint arrays = 0;
+		for (size_t i = 0; i < a_scene.permutations.size(); ++i) {
+			if (a_scene.permutations[i].type == &imagespace && reflected[i].constantTable[12] != 0) {
+				++arrays;
+				CHECK(reflected[i].constantTable[13] + 4 * 5 == reflected[i].constantTable[18]);  // Kernel[5]
+			}
+			CHECK(reflected[i].bufferSizes[0] != 0 && reflected[i].bufferSizes[1] != 0);
+		}
+		CHECK(arrays > 0);
+	}
+
+	// a record is refused for recompiled bytecode, and for anything that is not a record
+	void TestStale(SIE::ShaderArchive& a_archive, const Scene& a_scene)
+	{
+		std::mt19937 rng(11);
+		const auto& permutation = a_scene.permutations[3];
+		Shader before;
+		CHECK(CreateCached(a_archive, permutation, before));
+
+		std::chrono::system_clock::time_point writeTime;
+		auto* bytecode = a_archive.Read(permutation.key, writeTime);
+		ShaderDesc desc;
+		CHECK(Reflect(*bytecode, desc));
+		for (auto& buffer : desc.buffers) {
+			buffer.size += 16;
+			for (auto& variable : buffer.variables) {
+				variable.startOffset += 16;
+			}
+		}
+		auto* recompiled = MakeBytecode(desc, rng);
+		a_archive.Write(permutation.key, recompiled);
+		recompiled->Release();
+		bytecode->Release();
+
+		Shader after;
+		Shader expected;
+		CHECK(!CreateCached(a_archive, permutation, after));
+		CHECK(CreateReflected(a_archive, permutation, expected));
+		CHECK(!(before == expected));
+
+		ShaderReflection reflection;
+		const ShaderReflection valid{ .reflected = 1, .bytecodeHash = 5 };
+		const auto* bytes = reinterpret_cast<const uint8_t*>(&valid);
+		CHECK(ShaderReflection::Load({ bytes, sizeof(valid) }, 5, reflection));
+		CHECK(!ShaderReflection::Load({ bytes, sizeof(valid) - 1 }, 5, reflection));
+		ShaderReflection failed = valid;
+		failed.reflected = 0;
+		CHECK(!ShaderReflection::Load({ reinterpret_cast<const uint8_t*>(&failed), sizeof(failed) }, 5, reflection));
+	}
+}
+
+int main()
+{
+	const auto scratch = std::filesystem::temp_directory_path() / "ShaderReflectionBench";
+	std::filesystem::remove_all(scratch);
+	std::filesystem::create_directories(scratch);
+	{
+		SIE::ShaderArchive archive((scratch / "Lighting").wstring());
+		CHECK(archive.Open());
+		const auto scene = MakeScene(archive);
+		Run(archive, scene);
+		TestStale(archive, scene);
+	}
+	std::filesystem::remove_all(scratch);
+	return Tests::Result();
+}
@@ -0,0 +1,172 @@
+#include "Check.h"
+
+#include "ShaderTable.h"
+
+// Compares per-draw shader lookups through SIE::ShaderTable with the mutex guarded map it replaced,
+// alone and while a compiler thread keeps inserting. Also checks that erased and cleared shaders
+// are only released once the retire frames have passed.
+
+namespace
+{
+	struct Shader
+	{
+		uint32_t descriptor = 0;
+	};
+
+	// the design ShaderCache used before: one mutex per table around an unordered map
+	class MutexTable
+	{
+	public:
+		Shader* Find(uint32_t a_descriptor)
+		{
+			std::scoped_lock lock{ mutex };
+			auto it = shaders.find(a_descriptor);
+			return it != shaders.end() ? it->second.get() : nullptr;
+		}
+
+		Shader* Insert(uint32_t a_descriptor, std::unique_ptr<Shader> a_shader)
+		{
+			std::scoped_lock lock{ mutex };
+			auto* shader = a_shader.get();
+			shaders[a_descriptor] = std::move(a_shader);
+			return shader;
+		}
+
+	private:
+		std::mutex mutex;
+		std::unordered_map<uint32_t, std::unique_ptr<Shader>> shaders;
+	};
+
+	constexpr uint32_t WorkingSet = 4096;  // shaders a frame draws with, about what a busy exterior uses
+
+	uint32_t MakeDescriptor(uint32_t a_index)
+	{
+		// descriptors are sparse bitfields, not dense counters
+		return (a_index * 0x2545F491u) | 1u;
+	}
+
+	template <class Table>
+	void Fill(Table& a_table)
+	{
+		for (uint32_t i = 0; i < WorkingSet; ++i)
+			a_table.Insert(MakeDescriptor(i), std::make_unique<Shader>(Shader{ MakeDescriptor(i) }));
+	}
+
+	// lookups per microsecond over all readers, with a compiler thread inserting new shaders if a_insert
+	template <class Table>
+	double MeasureThroughput(Table& a_table, uint a_readers, bool a_insert)
+	{
+		std::atomic<bool> stop = false;
+		std::atomic<uint64_t> lookups = 0;
+		std::atomic<uint64_t> misses = 0;
+
+		std::vector<std::thread> threads;
+		for (uint reader = 0; reader < a_readers; ++reader) {
+			threads.emplace_back([&, reader]() {
+				uint64_t count = 0;
+				uint64_t missed = 0;
+				uint32_t state = 0x9E3779B9u * (reader + 1);
+				while (!stop.load(std::memory_order_relaxed)) {
+					for (uint i = 0; i < 256; ++i) {
+						state = state * 1664525u + 1013904223u;
+						const auto descriptor = MakeDescriptor(state % WorkingSet);
+						const auto* shader = a_table.Find(descriptor);
+						missed += !shader || shader->descriptor != descriptor;
+					}
+					count += 256;
+				}
+				lookups += count;
+				misses += missed;
+			});
+		}
+
+		std::thread writer;
+		if (a_insert) {
+			writer = std::thread([&]() {
+				for (uint32_t i = WorkingSet; !stop.load(std::memory_order_relaxed); ++i)
+					a_table.Insert(MakeDescriptor(i), std::make_unique<Shader>(Shader{ MakeDescriptor(i) }));
+			});
+		}
+
+		const auto start = std::chrono::steady_clock::now();
+		std::this_thread::sleep_for(200ms);
+		stop = true;
+		for (auto& thread : threads)
+			thread.join();
+		const auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		if (writer.joinable())
+			writer.join();
+
+		// the working set is never erased, so every lookup finds its own shader
+		CHECK(misses == 0);
+		return lookups / elapsed;
+	}
+
+	void AdvanceFrames(uint32_t a_frames)
+	{
+		RE::BSGraphics::State::GetSingleton()->frameCount += a_frames;
+	}
+
+	void TestDeferredRelease()
+	{
+		SIE::ShaderTable<Shader> table;
+		std::vector<uint32_t> released;
+		auto release = [&](Shader& a_shader) { released.push_back(a_shader.descriptor); };
+
+		table.Insert(1, std::make_unique<Shader>(Shader{ 1 }));
+		auto* kept = table.Insert(2, std::make_unique<Shader>(Shader{ 2 }));
+
+		// an erased shader is unpublished at once, but released only once no draw can still hold it
+		CHECK(table.Erase(1, release));
+		CHECK(!table.Erase(1, release));
+		CHECK(table.Find(1) == nullptr && table.Find(2) == kept);
+		AdvanceFrames(2);
+		table.Insert(3, std::make_unique<Shader>(Shader{ 3 }));
+		CHECK(released.empty());
+
+		// cleared shaders likewise; retired shaders are released on the first write after their frames
+		table.Clear(release);
+		CHECK(table.Find(2) == nullptr && table.Find(3) == nullptr && table.Size() == 0);
+		AdvanceFrames(1);
+		table.Insert(4, std::make_unique<Shader>(Shader{ 4 }));
+		CHECK((released == std::vector<uint32_t>{ 1 }));
+
+		AdvanceFrames(3);
+		CHECK(!table.Erase(2, release));
+		std::ranges::sort(released);
+		CHECK((released == std::vector<uint32_t>{ 1, 2, 3 }));
+		CHECK(table.Find(4) != nullptr && table.Size() == 1);
+	}
+}
+
+int main()
+{
+	TestDeferredRelease();
+
+	SIE::ShaderTable<Shader> table;
+	MutexTable mutexTable;
+	Fill(table);
+	Fill(mutexTable);
+
+	// one lookup alone, the cost every draw pays
+	uint32_t sink = 0;
+	const double mutexLookup = Tests::Bench("mutex map, 1k lookups", 2000, [&]() {
+		for (uint32_t i = 0; i < 1000; ++i)
+			sink += mutexTable.Find(MakeDescriptor(i))->descriptor;
+	});
+	const double tableLookup = Tests::Bench("shader table, 1k lookups", 2000, [&]() {
+		for (uint32_t i = 0; i < 1000; ++i)
+			sink += table.Find(MakeDescriptor(i))->descriptor;
+	});
+	std::printf("  %.2fx the lookups per second alone (%u)\n", mutexLookup / std::max(tableLookup, 1e-3), sink & 1);
+
+	const uint readers = std::clamp(std::thread::hardware_concurrency() - 1, 1u, 4u);
+	for (bool insert : { false, true }) {
+		const double mutexRate = MeasureThroughput(mutexTable, readers, insert);
+		const double tableRate = MeasureThroughput(table, readers, insert);
+		std::printf("%u readers%s: mutex map %.1f, shader table %.1f lookups/us (%.2fx)\n", readers, insert ? " while inserting" : "",
+			mutexRate, tableRate, tableRate / std::max(mutexRate, 1e-3));
+	}
+
+	return Tests::Result();
+}
@@ -0,0 +1,157 @@
+#include "Check.h"
+
+#include "Features/Skylighting/Clipmap.h"
+
+// Scrolls the skylighting clipmap levels along eye paths and checks that every texel the probe update keeps
+// still holds the cell it held before, that exactly the cells that scrolled in are marked new, and that the
+// array wraps the same way across zero and the array edges.
+
+namespace
+{
+	using SkylightingClipmap::Dims;
+	using SkylightingClipmap::Float3;
+	using SkylightingClipmap::Int3;
+	using SkylightingClipmap::Scroll;
+
+	constexpr uint LevelCount = 2;
+	const Float3 Extent = { 4096.f * 2.5f, 4096.f * 2.5f, 4096.f * 2.5f * .5f };
+	const Dims LevelDims = { 128, 128, 64 };
+	const Dims SmallDims = { 8, 8, 4 };
+
+	// cell of the world a texel holds, from where UpdateProbesCS.hlsl places the probe of its relative cell
+	Int3 GetWorldCell(const Scroll& a_scroll, const Dims& a_dims, const Dims& a_texel)
+	{
+		const auto relative = SkylightingClipmap::GetRelativeCell(a_scroll, a_dims, a_texel);
+		Int3 cell;
+		for (size_t axis = 0; axis < 3; ++axis)
+			cell[axis] = a_scroll.cellID[axis] + static_cast<int32_t>(relative[axis]) - static_cast<int32_t>(a_dims[axis] / 2);
+		return cell;
+	}
+
+	template <class F>
+	void ForEachTexel(const Dims& a_dims, F&& a_func)
+	{
+		for (uint z = 0; z < a_dims[2]; ++z)
+			for (uint y = 0; y < a_dims[1]; ++y)
+				for (uint x = 0; x < a_dims[0]; ++x)
+					a_func(Dims{ x, y, z });
+	}
+
+	// one scroll step: kept texels hold the same world cell, new ones are the cells the level did not cover
+	void CheckStep(const Scroll& a_previous, const Scroll& a_current, const Dims& a_dims)
+	{
+		uint newCells = 0;
+		ForEachTexel(a_dims, [&](const Dims& a_texel) {
+			const auto before = GetWorldCell(a_previous, a_dims, a_texel);
+			const auto after = GetWorldCell(a_current, a_dims, a_texel);
+			bool coveredBefore = true;
+			for (size_t axis = 0; axis < 3; ++axis) {
+				const int32_t low = a_previous.cellID[axis] - static_cast<int32_t>(a_dims[axis] / 2);
+				coveredBefore &= after[axis] >= low && after[axis] < low + static_cast<int32_t>(a_dims[axis]);
+			}
+
+			const bool valid = SkylightingClipmap::IsValid(a_current, a_dims, SkylightingClipmap::GetRelativeCell(a_current, a_dims, a_texel));
+			CHECK(valid == coveredBefore);
+			if (valid)
+				CHECK(before == after);
+			newCells += !valid;
+		});
+
+		uint expected = 1;
+		uint kept = 1;
+		for (size_t axis = 0; axis < 3; ++axis) {
+			expected *= a_dims[axis];
+			kept *= a_dims[axis] - std::min<uint>(std::abs(a_current.cellID[axis] - a_previous.cellID[axis]), a_dims[axis]);
+		}
+		CHECK(newCells == expected - kept);
+	}
+
+	void TestCellSizes()
+	{
+		const auto fine = SkylightingClipmap::GetCellSize(Extent, LevelDims, 0, LevelCount);
+		const auto coarse = SkylightingClipmap::GetCellSize(Extent, LevelDims, 1, LevelCount);
+		for (size_t axis = 0; axis < 3; ++axis) {
+			CHECK(coarse[axis] == fine[axis] * 2.0f);
+			CHECK(coarse[axis] * LevelDims[axis] == Extent[axis]);  // the coarsest level spans the whole extent
+		}
+		CHECK(fine[0] == 40.0f && fine[2] == 40.0f);
+	}
+
+	void TestScroll()
+	{
+		const auto cellSize = SkylightingClipmap::GetCellSize(Extent, LevelDims, 0, LevelCount);
+
+		// the eye is always within half a cell of the cell origin
+		const auto scroll = SkylightingClipmap::ScrollLevel({ 1000.f, -1000.f, 15.f }, cellSize, LevelDims, std::nullopt);
+		CHECK((scroll.cellID == Int3{ 25, -25, 0 }));
+		CHECK(std::abs(scroll.posOffset[0]) <= cellSize[0] * .5f && std::abs(scroll.posOffset[2] + 15.f) < 1e-3f);
+
+		// the first frame has nothing valid
+		CHECK((scroll.validMargin == Int3{ 128, 128, 64 }));
+		uint valid = 0;
+		ForEachTexel(LevelDims, [&](const Dims& a_texel) { valid += SkylightingClipmap::IsValid(scroll, LevelDims, SkylightingClipmap::GetRelativeCell(scroll, LevelDims, a_texel)); });
+		CHECK(valid == 0);
+
+		// standing still keeps everything
+		const auto still = SkylightingClipmap::ScrollLevel({ 1000.f, -1000.f, 15.f }, cellSize, LevelDims, scroll.cellID);
+		CHECK((still.validMargin == Int3{ 0, 0, 0 }) && still.arrayOrigin == scroll.arrayOrigin);
+
+		// the array origin is the texel of the level's first cell, wrapped into the array even below zero
+		CHECK((scroll.arrayOrigin == Dims{ (25 - 64 + 128) % 128, (-25 - 64 + 256) % 128, (0 - 32 + 64) % 64 }));
+		const auto far = SkylightingClipmap::ScrollLevel({ -1.0e6f, 3.0e5f, -4.0e4f }, cellSize, LevelDims, std::nullopt);
+		for (size_t axis = 0; axis < 3; ++axis) {
+			CHECK(far.arrayOrigin[axis] < LevelDims[axis]);
+			CHECK((far.cellID[axis] - static_cast<int32_t>(LevelDims[axis] / 2) - static_cast<int32_t>(far.arrayOrigin[axis])) % static_cast<int32_t>(LevelDims[axis]) == 0);
+		}
+
+		// a teleport leaves nothing valid without overflowing the margin
+		const auto teleport = SkylightingClipmap::ScrollLevel({ 1.0e6f, 1.0e6f, 1.0e5f }, cellSize, LevelDims, far.cellID);
+		CHECK((teleport.validMargin == Int3{ -128, -128, -64 }));
+	}
+
+	// every level along the same path; the coarse level scrolls half as often and both wrap through zero
+	void TestPaths()
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> step(-120.f, 120.f);
+		for (const auto& dims : { SmallDims, LevelDims }) {
+			for (uint level = 0; level < LevelCount; ++level) {
+				const auto cellSize = SkylightingClipmap::GetCellSize(Extent, dims, level, LevelCount);
+				Float3 eye = { -3.f * cellSize[0], 2.f * cellSize[1], -.4f * cellSize[2] };
+				auto previous = SkylightingClipmap::ScrollLevel(eye, cellSize, dims, std::nullopt);
+				const uint steps = dims == SmallDims ? 400 : 12;
+				for (uint i = 0; i < steps; ++i) {
+					// mostly walking, sometimes a jump past the level
+					const float scale = (i % 37 == 36) ? 40.f : 1.f;
+					eye = { eye[0] + step(rng) * scale, eye[1] + step(rng) * scale, eye[2] + step(rng) * .25f * scale };
+					const auto current = SkylightingClipmap::ScrollLevel(eye, cellSize, dims, previous.cellID);
+					CheckStep(previous, current, dims);
+					previous = current;
+				}
+			}
+		}
+
+		// a walk along x crosses cell boundaries of the coarse level half as often
+		const auto fine = SkylightingClipmap::GetCellSize(Extent, LevelDims, 0, LevelCount);
+		const auto coarse = SkylightingClipmap::GetCellSize(Extent, LevelDims, 1, LevelCount);
+		std::optional<Int3> fineID, coarseID;
+		uint fineMoves = 0, coarseMoves = 0;
+		for (float x = -2000.f; x < 2000.f; x += 5.f) {
+			const auto fineScroll = SkylightingClipmap::ScrollLevel({ x, 0.f, 0.f }, fine, LevelDims, fineID);
+			const auto coarseScroll = SkylightingClipmap::ScrollLevel({ x, 0.f, 0.f }, coarse, LevelDims, coarseID);
+			fineMoves += fineID && fineScroll.validMargin[0] != 0;
+			coarseMoves += coarseID && coarseScroll.validMargin[0] != 0;
+			fineID = fineScroll.cellID;
+			coarseID = coarseScroll.cellID;
+		}
+		CHECK(fineMoves == 100 && coarseMoves == 50);
+	}
+}
+
+int main()
+{
+	TestCellSizes();
+	TestScroll();
+	TestPaths();
+	return Tests::Result();
+}
@@ -0,0 +1,307 @@
+#include "Check.h"
+
+#include "Features/TerrainShadows/ShadowSweep.h"
+
+namespace
+{
+	ShadowSweep::Maps MakeMaps(uint a_width, uint a_height, uint a_seed)
+	{
+		ShadowSweep::Maps maps{ .width = a_width, .height = a_height };
+		maps.heightTexels.resize((size_t)a_width * a_height);
+		maps.shadowHeights.resize(maps.heightTexels.size());
+
+		// a few ridges over noise, so long shadows cross strip boundaries
+		std::mt19937 rng(a_seed);
+		std::uniform_real_distribution<float> noise(0.f, .2f);
+		for (uint y = 0; y < a_height; ++y)
+			for (uint x = 0; x < a_width; ++x)
+				maps.heightTexels[(size_t)y * a_width + x] = noise(rng) + ((x * 7 + y * 3) % 97 == 0 ? .8f : 0.f);
+		return maps;
+	}
+
+	float MaxDifference(const std::vector<ShadowSweep::Heights>& a_lhs, const std::vector<ShadowSweep::Heights>& a_rhs, const ShadowSweep::Maps& a_maps, bool a_skipFirstRow, bool a_skipFirstColumn)
+	{
+		float result = 0.f;
+		for (uint y = a_skipFirstRow ? 1 : 0; y < a_maps.height; ++y) {
+			for (uint x = a_skipFirstColumn ? 1 : 0; x < a_maps.width; ++x) {
+				const size_t i = (size_t)y * a_maps.width + x;
+				result = std::max({ result, std::abs(a_lhs[i][0] - a_rhs[i][0]), std::abs(a_lhs[i][1] - a_rhs[i][1]) });
+			}
+		}
+		return result;
+	}
+
+	struct SweepRun
+	{
+		uint sweeps = 0;
+		float lastChange = 0.f;
+		bool coveredEveryStrip = true;
+	};
+
+	// drives the cursor the way TerrainShadows::UpdateShadow does, a few dispatches per frame with the eye strip first
+	SweepRun RunSweeps(ShadowSweep::Maps& a_maps, const ShadowSweep::Params& a_params, std::optional<uint> a_eyeStrip, uint a_maxSweeps, float a_tolerance)
+	{
+		const bool isVertical = std::abs(a_params.lightPxDir[1]) > std::abs(a_params.lightPxDir[0]);
+		const uint majorDim = isVertical ? a_maps.height : a_maps.width;
+		const bool forward = a_params.lightPxDir[isVertical ? 1 : 0] > 0;
+		const uint edgePxCoord = forward ? 0 : majorDim - 1;
+		const int signDir = forward ? 1 : -1;
+		const uint count = (majorDim + ShadowSweep::StepLength - 1) / ShadowSweep::StepLength;
+
+		SweepRun run;
+		ShadowSweep::Cursor cursor;
+		bool running = false;
+		std::vector<uint> dispatched;
+		auto before = a_maps.shadowHeights;
+		while (run.sweeps < a_maxSweeps) {
+			if (!running) {
+				cursor.Start(count, a_eyeStrip);
+				running = true;
+				dispatched.assign(count, 0);
+				before = a_maps.shadowHeights;
+			}
+
+			for (uint budget = 0; budget < 3; ++budget) {
+				const auto step = cursor.Advance();
+				ShadowSweep::Dispatch(a_maps, a_params, edgePxCoord + signDir * (int)(step.strip * ShadowSweep::StepLength));
+				dispatched[step.strip]++;
+
+				if (step.finishesSweep) {
+					running = false;
+					break;
+				}
+			}
+
+			if (!running) {
+				run.sweeps++;
+				for (uint strip = 0; strip < count; ++strip)
+					run.coveredEveryStrip &= dispatched[strip] == (a_eyeStrip == strip ? 2u : 1u);
+
+				run.lastChange = MaxDifference(before, a_maps.shadowHeights, a_maps, false, false);
+				if (run.lastChange < a_tolerance)
+					break;
+			}
+		}
+		return run;
+	}
+
+	// heights that only change along the light, so the first row and column of a window, which read their
+	// neighbour, see the same heights as the map around them and a window can match the whole map exactly
+	ShadowSweep::Maps MakeRidges(uint a_width, uint a_height, bool a_isVertical, uint a_seed)
+	{
+		std::mt19937 rng(a_seed);
+		std::uniform_real_distribution<float> noise(0.f, .2f);
+		std::vector<float> profile(a_isVertical ? a_height : a_width);
+		for (uint i = 0; i < profile.size(); ++i)
+			profile[i] = noise(rng) + (i % 53 == 0 ? .8f : 0.f);
+
+		ShadowSweep::Maps maps{ .width = a_width, .height = a_height };
+		for (uint y = 0; y < a_height; ++y)
+			for (uint x = 0; x < a_width; ++x)
+				maps.heightTexels.push_back(profile[a_isVertical ? y : x]);
+		maps.shadowHeights.resize(maps.heightTexels.size());
+		return maps;
+	}
+
+	template <class T>
+	std::vector<T> Cut(const std::vector<T>& a_texels, uint a_width, const ShadowSweep::Window& a_window)
+	{
+		std::vector<T> result;
+		for (uint y = 0; y < a_window.size[1]; ++y)
+			for (uint x = 0; x < a_window.size[0]; ++x)
+				result.push_back(a_texels[(size_t)(a_window.origin[1] + y) * a_width + a_window.origin[0] + x]);
+		return result;
+	}
+
+	// a window of a_map, continuing its rays from a_outerHeights over the whole map
+	ShadowSweep::Maps MakeWindow(const ShadowSweep::Maps& a_map, const ShadowSweep::Window& a_window, const ShadowSweep::OuterMap& a_outer)
+	{
+		ShadowSweep::Maps maps{ .width = a_window.size[0], .height = a_window.size[1], .heightTexels = Cut(a_map.heightTexels, a_map.width, a_window), .outer = &a_outer };
+		maps.shadowHeights.resize(maps.heightTexels.size());
+		return maps;
+	}
+
+	ShadowSweep::OuterMap MakeOuter(const ShadowSweep::Maps& a_map, const std::vector<ShadowSweep::Heights>& a_shadowHeights, const ShadowSweep::Window& a_window)
+	{
+		const float width = (float)a_map.width;
+		const float height = (float)a_map.height;
+		return { .width = a_map.width, .height = a_map.height, .shadowHeights = a_shadowHeights,
+			.transform = { a_window.size[0] / width, a_window.size[1] / height, a_window.origin[0] / width, a_window.origin[1] / height } };
+	}
+
+	void TestWindowPlacement()
+	{
+		// centred on the tile grid, clamped to the map, and never larger than it
+		auto window = ShadowSweep::PlaceWindow({ 1000.f, 700.f }, { 4096, 4096 }, 1024);
+		CHECK((window.origin == std::array<uint, 2>{ 512, 128 } && window.size == std::array<uint, 2>{ 1024, 1024 }));
+		window = ShadowSweep::PlaceWindow({ 4000.f, -50.f }, { 4096, 768 }, 1024);
+		CHECK((window.origin == std::array<uint, 2>{ 3072, 0 } && window.size == std::array<uint, 2>{ 1024, 768 }));
+
+		// moves are due a tile away from the centre, not before
+		window = ShadowSweep::PlaceWindow({ 2048.f, 2048.f }, { 4096, 4096 }, 1024);
+		CHECK(!ShadowSweep::IsOffCentre(window, { 2048.f + ShadowSweep::TileLength, 2048.f - ShadowSweep::TileLength }));
+		CHECK(ShadowSweep::IsOffCentre(window, { 2048.f, 2049.f + ShadowSweep::TileLength }));
+		const auto moved = ShadowSweep::PlaceWindow({ 2048.f, 2049.f + ShadowSweep::TileLength }, { 4096, 4096 }, 1024);
+		CHECK((moved.origin == std::array<uint, 2>{ 1536, 1536 + ShadowSweep::TileLength }));
+
+		CHECK((ShadowSweep::GetOverlap(window, moved) == ShadowSweep::Rect{ 0, 0, 1024, 1024 - ShadowSweep::TileLength }));
+		CHECK((ShadowSweep::GetOverlap(moved, window) == ShadowSweep::Rect{ 0, ShadowSweep::TileLength, 1024, 1024 }));
+		CHECK((ShadowSweep::GetOverlap(window, ShadowSweep::PlaceWindow({ 0.f, 0.f }, { 4096, 4096 }, 1024)) == ShadowSweep::Rect{}));
+
+		CHECK(ShadowSweep::GetCoarseMip({ 1024, 512 }, 1024) == 0);
+		CHECK(ShadowSweep::GetCoarseMip({ 4096, 3968 }, 1024) == 2);
+		CHECK(ShadowSweep::GetCoarseMip({ 1025, 16 }, 1024) == 1);
+
+		// the outer map is filtered like a linear clamp sampler
+		const ShadowSweep::OuterMap outer{ .width = 2, .height = 1, .shadowHeights = { { 0.f, 1.f }, { 1.f, 3.f } }, .transform = { 1.f, 1.f, 0.f, 0.f } };
+		CHECK((ShadowSweep::SampleOuter(outer, { .25f, .5f }) == ShadowSweep::Heights{ 0.f, 1.f }));
+		CHECK((ShadowSweep::SampleOuter(outer, { .5f, .5f }) == ShadowSweep::Heights{ .5f, 2.f }));
+		CHECK((ShadowSweep::SampleOuter(outer, { 1.5f, -1.f }) == ShadowSweep::Heights{ 1.f, 3.f }));
+	}
+
+	// the rows read from a map file hold the window; a block compressed one is read in whole blocks
+	void TestWindowRows()
+	{
+		auto read = [](const std::vector<uint16_t>& a_file, const ShadowSweep::WindowRows& a_rows) {
+			std::vector<uint16_t> result;
+			for (uint row = 0; row < a_rows.rowCount; ++row) {
+				const size_t first = (a_rows.firstByte + row * a_rows.rowStride) / sizeof(uint16_t);
+				result.insert(result.end(), a_file.begin() + first, a_file.begin() + first + a_rows.rowBytes / sizeof(uint16_t));
+			}
+			return result;
+		};
+
+		// 16 bit texels
+		const std::array<uint, 2> mapSize = { 300, 200 };
+		std::vector<uint16_t> texels((size_t)mapSize[0] * mapSize[1]);
+		std::iota(texels.begin(), texels.end(), uint16_t(0));
+		const ShadowSweep::Window window{ .origin = { 44, 70 }, .size = { 256, 130 } };
+		auto rows = ShadowSweep::GetWindowRows(window, mapSize, 1, 2);
+		CHECK(rows.blocks == window);
+		CHECK(read(texels, rows) == Cut(texels, mapSize[0], window));
+
+		// 4x4 blocks of 8 bytes, each holding its block coordinates; 10x7 texels are 3x2 blocks
+		std::vector<uint16_t> blocks;
+		for (uint16_t y = 0; y < 2; ++y)
+			for (uint16_t x = 0; x < 3; ++x)
+				blocks.insert(blocks.end(), { x, y, 0, 0 });
+		rows = ShadowSweep::GetWindowRows({ .origin = { 5, 3 }, .size = { 5, 4 } }, { 10, 7 }, 4, 8);
+		CHECK((rows.blocks == ShadowSweep::Window{ .origin = { 4, 0 }, .size = { 8, 8 } }));
+		CHECK(rows.rowStride == 24 && rows.rowBytes == 16 && rows.rowCount == 2);
+		CHECK((read(blocks, rows) == std::vector<uint16_t>{ 1, 0, 0, 0, 2, 0, 0, 0, 1, 1, 0, 0, 2, 1, 0, 0 }));
+	}
+
+	void TestWindowContinuesRays(std::array<float, 2> a_lightPxDir)
+	{
+		const bool isVertical = std::abs(a_lightPxDir[1]) > std::abs(a_lightPxDir[0]);
+		const auto map = MakeRidges(768, 640, isVertical, 5);
+		const ShadowSweep::Params params{
+			.lightPxDir = a_lightPxDir,
+			.lightDeltaZ = { -.002f, -.004f },
+			.posRange = { 0.f, 1.f },
+			.zRange = { 0.f, 1.f }
+		};
+		const auto whole = ShadowSweep::Converged(map, params);
+
+		// where its rays enter, a window reads the heights swept over the whole map and ends up with the same heights
+		const ShadowSweep::Window window = { .origin = { 256, 128 }, .size = { 384, 256 } };
+		const auto outer = MakeOuter(map, whole, window);
+		auto maps = MakeWindow(map, window, outer);
+		const auto expected = Cut(whole, map.width, window);
+		CHECK(MaxDifference(ShadowSweep::Converged(maps, params), expected, maps, false, false) < 1e-6f);
+
+		const auto run = RunSweeps(maps, params, 1u, 256, 1e-6f);
+		CHECK(run.lastChange < 1e-6f);
+		CHECK(MaxDifference(maps.shadowHeights, expected, maps, false, false) < 1e-4f);
+
+		// after a move, the texels both windows cover carry over and a single ordered sweep replaces the rest
+		const ShadowSweep::Window moved = { .origin = { window.origin[0] + ShadowSweep::TileLength, window.origin[1] + ShadowSweep::TileLength }, .size = window.size };
+		const auto movedOuter = MakeOuter(map, whole, moved);
+		auto movedMaps = MakeWindow(map, moved, movedOuter);
+		auto movedParams = params;
+		movedParams.keptRect = ShadowSweep::GetOverlap(window, moved);
+		for (uint y = movedParams.keptRect[1]; y < movedParams.keptRect[3]; ++y)
+			for (uint x = movedParams.keptRect[0]; x < movedParams.keptRect[2]; ++x)
+				movedMaps.shadowHeights[(size_t)y * moved.size[0] + x] = maps.shadowHeights[(size_t)(y + ShadowSweep::TileLength) * window.size[0] + x + ShadowSweep::TileLength];
+
+		const auto movedRun = RunSweeps(movedMaps, movedParams, std::nullopt, 1, 0.f);
+		CHECK(movedRun.sweeps == 1 && movedRun.coveredEveryStrip);
+		CHECK(MaxDifference(movedMaps.shadowHeights, Cut(whole, map.width, moved), movedMaps, false, false) < 1e-4f);
+	}
+
+	void TestCursorOrder()
+	{
+		ShadowSweep::Cursor cursor;
+		cursor.Start(4, 2u);
+
+		const std::array<uint, 5> expected = { 2, 0, 1, 2, 3 };
+		for (size_t i = 0; i < expected.size(); ++i) {
+			const auto step = cursor.Advance();
+			CHECK(step.strip == expected[i]);
+			CHECK(step.finishesSweep == (i + 1 == expected.size()));
+		}
+
+		// the next sweep starts over from the lit edge
+		cursor.Start(4, std::nullopt);
+		CHECK(cursor.Advance().strip == 0);
+
+		// a priority strip never finishes a sweep, even when the ordered sweep is about to wrap
+		cursor.Start(1, 0u);
+		CHECK(!cursor.Advance().finishesSweep);
+		CHECK(cursor.Advance().finishesSweep);
+	}
+
+	void TestConvergesToReference(std::array<float, 2> a_lightPxDir, std::optional<uint> a_eyeStrip)
+	{
+		auto maps = MakeMaps(512, 384, 7);
+		const ShadowSweep::Params params{
+			.lightPxDir = a_lightPxDir,
+			.lightDeltaZ = { -.002f, -.004f },
+			.posRange = { 0.f, 1.f },
+			.zRange = { 0.f, 1.f }
+		};
+
+		const auto run = RunSweeps(maps, params, a_eyeStrip, 256, 1e-6f);
+		CHECK(run.coveredEveryStrip);
+		CHECK(run.lastChange < 1e-6f);
+
+		// rows and columns at zero read their neighbour (inBoundA), so the exact mirror only holds inside them
+		const bool isVertical = std::abs(a_lightPxDir[1]) > std::abs(a_lightPxDir[0]);
+		const auto converged = ShadowSweep::Converged(maps, params);
+		CHECK(MaxDifference(converged, maps.shadowHeights, maps, !isVertical, isVertical) < 1e-4f);
+	}
+
+	void TestDiagonalConverges()
+	{
+		auto maps = MakeMaps(512, 512, 11);
+		const ShadowSweep::Params params{
+			.lightPxDir = { 1.f, -.37f },
+			.lightDeltaZ = { -.002f, -.004f },
+			.posRange = { 0.f, 1.f },
+			.zRange = { 0.f, 1.f }
+		};
+
+		const auto run = RunSweeps(maps, params, 2u, 256, 1e-6f);
+		CHECK(run.coveredEveryStrip);
+		CHECK(run.lastChange < 1e-6f);
+		std::printf("diagonal light converged after %u sweeps\n", run.sweeps);
+	}
+}
+
+int main()
+{
+	TestCursorOrder();
+	TestConvergesToReference({ 1.f, 0.f }, std::nullopt);
+	TestConvergesToReference({ 1.f, 0.f }, 2u);
+	TestConvergesToReference({ -1.f, 0.f }, 1u);
+	TestConvergesToReference({ 0.f, 1.f }, 1u);
+	TestConvergesToReference({ 0.f, -1.f }, 2u);
+	TestDiagonalConverges();
+	TestWindowPlacement();
+	TestWindowRows();
+	TestWindowContinuesRays({ 1.f, 0.f });
+	TestWindowContinuesRays({ -1.f, 0.f });
+	TestWindowContinuesRays({ 0.f, 1.f });
+	TestWindowContinuesRays({ 0.f, -1.f });
+	return Tests::Result();
+}